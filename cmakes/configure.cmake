@@ -16,4 +16,21 @@ if ("${BUILD_TYPE}" STREQUAL "debug")
 endif ()
 
 
-option(ENABLE_REDIS_TARGET "Enables redis target in event notifier" OFF)
\ No newline at end of file
+option(ENABLE_REDIS_TARGET "Enables redis target in event notifier" OFF)
+
+if (ENABLE_LOCK_PROFILING)
+	add_definitions(-DENABLE_LOCK_PROFILING=1)
+endif ()
+
+if (DISABLE_DEBUG_LOG)
+	add_definitions(-DDISABLE_DEBUG_LOG=1)
+endif ()
+
+if (ENABLE_USDT)
+	check_include_file_cxx("sys/sdt.h" HAVE_SYS_SDT_H)
+	if (HAVE_SYS_SDT_H)
+		add_definitions(-DENABLE_USDT=1)
+	else ()
+		message(STATUS "sys/sdt.h not found, USDT probes disabled (install systemtap-sdt-dev or systemtap-sdt-devel)")
+	endif ()
+endif ()
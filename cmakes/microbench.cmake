@@ -0,0 +1,31 @@
+set(PROJECT_NAME_MICROBENCH wssmicrobench)
+set(MICROBENCH_SOURCE_DIR ${CMAKE_CURRENT_SOURCE_DIR}/libs/benchmark)
+
+# vendored next to googletest, or system package
+if (EXISTS ${MICROBENCH_SOURCE_DIR}/CMakeLists.txt)
+	set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+	set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+	add_subdirectory(${MICROBENCH_SOURCE_DIR})
+else ()
+	find_package(benchmark REQUIRED)
+endif ()
+
+add_executable(${PROJECT_NAME_MICROBENCH}
+               src/benchmark/microbench.cpp
+               ${SERVER_SRC}
+               ${COMMON_LIBS_SRC})
+
+target_link_libraries(${PROJECT_NAME_MICROBENCH} benchmark::benchmark ${DL_LIBRARIES})
+linkdeps(${PROJECT_NAME_MICROBENCH} all)
+
+# writes ${CMAKE_BINARY_DIR}/microbench.json, to compare with previous runs (e.g. tools/compare.py from google/benchmark)
+add_custom_target(microbench-json
+                  COMMAND ${PROJECT_NAME_MICROBENCH}
+                  --benchmark_format=json
+                  --benchmark_out=${CMAKE_BINARY_DIR}/microbench.json
+                  --benchmark_out_format=json
+                  --benchmark_repetitions=3
+                  --benchmark_report_aggregates_only=true
+                  DEPENDS ${PROJECT_NAME_MICROBENCH}
+                  WORKING_DIRECTORY ${CMAKE_BINARY_DIR}
+                  COMMENT "Running microbenchmarks, report: ${CMAKE_BINARY_DIR}/microbench.json")
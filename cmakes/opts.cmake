@@ -2,9 +2,13 @@
 # Project options
 option(ENABLE_SSL "Certifacates required" OFF)
 option(ENABLE_REDIS_TARGET "Enables event notifier Redis target (queue or pub/sub channel)" ON)
+option(ENABLE_USDT "Compile USDT probes (requires sys/sdt.h), they cost nothing until tracer attached" ON)
+option(ENABLE_LOCK_PROFILING "Count acquisitions, wait and hold times of named server locks" OFF)
+option(DISABLE_DEBUG_LOG "Compile out debug log records, --verbosity 2 will print only info and above" OFF)
 
 option(WITH_ARCH "Define target compile architecture" OFF)
 option(WITH_BENCHMARK "Compile benchmark (dev only)" OFF)
+option(WITH_MICROBENCH "Compile Google Benchmark microbenchmarks (dev only)" OFF)
 option(WITH_TEST "Compile tests (dev only)" OFF)
 
 option(CMAKE_INSTALL_PREFIX "Install prefix" "/usr")
@@ -9,6 +9,10 @@ set(SERVER_SRC
     src/restapi/RestServer.h
     src/restapi/ChatRestServer.cpp
     src/restapi/ChatRestServer.h
+    src/restapi/MessageBatch.cpp
+    src/restapi/MessageBatch.h
+    src/restapi/StatsPage.cpp
+    src/restapi/StatsPage.h
     src/helpers/helpers.h
     src/helpers/helpers.cpp
     src/web/HttpClient.cpp
@@ -16,7 +20,18 @@ set(SERVER_SRC
     src/event/EventNotifier.h
     src/event/PostbackTarget.cpp
     src/event/PostbackTarget.h
+    src/event/UnixSocketTarget.cpp
+    src/event/UnixSocketTarget.h
+    src/event/NdjsonFileTarget.cpp
+    src/event/NdjsonFileTarget.h
     src/event/Target.hpp
+    src/event/RetryScheduler.hpp
+    src/event/CircuitBreaker.hpp
+    src/event/ConcurrencyLimiter.hpp
+    src/event/WorkerPool.hpp
+    src/event/Event.hpp
+    src/event/EventFilter.cpp
+    src/event/EventFilter.h
     src/helpers/base64.cpp
     src/helpers/base64.h
     src/base/StandaloneService.h
@@ -26,11 +41,23 @@ set(SERVER_SRC
     src/helpers/utility.hpp
     src/base/SocketLayerWrapper.hpp
     src/base/ws/WebsocketServer.hpp
+    src/base/ws/Frame.hpp
     src/base/http/HttpServer.h
+    src/base/http/HttpParser.cpp
+    src/base/http/HttpParser.h
+    src/base/http/RouteTable.h
     src/event/EventNotifier.cpp
     src/base/ServerStarter.cpp
     src/base/ServerStarter.h
     src/base/Settings.hpp
+    src/base/Metrics.cpp
+    src/base/Metrics.h
+    src/base/LockProfiler.cpp
+    src/base/LockProfiler.h
+    src/base/Log.cpp
+    src/base/Log.h
+    src/base/Probes.cpp
+    src/base/Probes.h
     src/base/auth/Auth.h
     src/base/auth/Auth.cpp
     src/base/auth/OneOfAuth.cpp
@@ -51,6 +78,26 @@ set(SERVER_SRC
     src/chat/ConnectionStorage.h
     src/chat/Statistics.cpp
     src/chat/Statistics.h
+    src/chat/PresenceMap.cpp
+    src/chat/PresenceMap.h
+    src/chat/MessageTracer.cpp
+    src/chat/MessageTracer.h
+    src/chat/UserStrands.cpp
+    src/chat/UserStrands.h
+    src/chat/RecipientGroups.cpp
+    src/chat/RecipientGroups.h
+    src/chat/RoomStorage.cpp
+    src/chat/RoomStorage.h
+    src/chat/IngressRing.cpp
+    src/chat/IngressRing.h
+    src/chat/BotChannel.cpp
+    src/chat/BotChannel.h
+    src/cluster/Protocol.cpp
+    src/cluster/Protocol.h
+    src/cluster/Directory.cpp
+    src/cluster/Directory.h
+    src/cluster/Cluster.cpp
+    src/cluster/Cluster.h
     src/base/unid.cpp
     src/base/unid.h
     )
@@ -10,9 +10,39 @@ elseif (APPLE)
 	add_definitions(-D__GLIBCXX__)
 endif ()
 
-add_executable(${PROJECT_NAME_TEST} ${SERVER_EXEC_SRCS}
-               tests/base/TestAuth.cpp
-               )
+set(TEST_SRCS
+    tests/base/TestAuth.cpp
+    tests/base/TestMetrics.cpp
+    tests/base/TestHttpParser.cpp
+    tests/base/TestRouteTable.cpp
+    tests/base/TestLockProfiler.cpp
+    tests/base/TestLog.cpp
+    tests/event/TestRetryScheduler.cpp
+    tests/event/TestEventFilter.cpp
+    tests/event/TestCircuitBreaker.cpp
+    tests/event/TestUnixSocketTarget.cpp
+    tests/event/TestNdjsonFileTarget.cpp
+    tests/event/TestEventNotifier.cpp
+    tests/chat/TestPresenceMap.cpp
+    tests/chat/TestMessageTracer.cpp
+    tests/chat/TestUserStrands.cpp
+    tests/chat/TestRoomStorage.cpp
+    tests/chat/TestIngressRing.cpp
+    tests/chat/TestBotChannel.cpp
+    tests/chat/TestRecipientGroups.cpp
+    tests/restapi/TestMessageBatch.cpp
+    tests/restapi/TestStatsPage.cpp
+    tests/restapi/TestChatRestServer.cpp
+    tests/cluster/TestCluster.cpp
+    )
+
+if (ENABLE_REDIS_TARGET)
+	set(TEST_SRCS
+	    ${TEST_SRCS}
+	    tests/event/TestRedisTarget.cpp)
+endif ()
+
+add_executable(${PROJECT_NAME_TEST} ${SERVER_EXEC_SRCS} ${TEST_SRCS})
 
 linkdeps(${PROJECT_NAME_TEST})
 
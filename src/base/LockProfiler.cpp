@@ -0,0 +1,123 @@
+/**
+ * wsserver
+ * LockProfiler.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <vector>
+#include <fmt/format.h>
+#include "LockProfiler.h"
+
+using wss::metrics::Histogram;
+using wss::metrics::Registry;
+
+/// \brief Upper bound of log2 bucket containing quantile, microseconds
+static double percentileMicros(const Histogram::Snapshot &snapshot, double quantile) {
+    uint64_t count = 0;
+    for (uint64_t bucket: snapshot.buckets) {
+        count += bucket;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    const auto rank = (uint64_t) std::max(1.0, quantile * count);
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < Histogram::BUCKETS; i++) {
+        seen += snapshot.buckets[i];
+        if (seen >= rank) {
+            const double upperNanos = i == 0 ? 0 : (i >= 64 ? 1.8e19 : (double) ((1ull << i) - 1));
+            return upperNanos / 1000.0;
+        }
+    }
+    return 0;
+}
+
+static std::string lockLabel(const std::string &name) {
+    return fmt::format("lock=\"{0}\"", name);
+}
+
+wss::sync::LockStats::LockStats(const std::string &name) :
+    name(name),
+    acquisitions(Registry::get().counter("wss_lock_acquisitions_total", "Lock acquisitions", lockLabel(name))),
+    contended(Registry::get().counter("wss_lock_contended_total",
+                                      "Lock acquisitions that waited for another owner", lockLabel(name))),
+    wait(Registry::get().histogram("wss_lock_wait_seconds", "Wait time of contended lock acquisitions",
+                                   lockLabel(name))),
+    hold(Registry::get().histogram("wss_lock_hold_seconds", "Time lock was held", lockLabel(name))) {
+}
+
+wss::sync::LockProfiler &wss::sync::LockProfiler::get() {
+    static LockProfiler profiler;
+    return profiler;
+}
+
+bool wss::sync::LockProfiler::isEnabled() {
+#ifdef ENABLE_LOCK_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+wss::sync::LockStats &wss::sync::LockProfiler::stats(const std::string &name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &stats = m_stats[name];
+    if (!stats) {
+        stats = std::make_unique<LockStats>(name);
+    }
+    return *stats;
+}
+
+nlohmann::json wss::sync::LockProfiler::toJson() const {
+    std::vector<nlohmann::json> items;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &it: m_stats) {
+            const LockStats &stats = *it.second;
+            const Histogram::Snapshot wait = stats.wait.snapshot();
+            const Histogram::Snapshot hold = stats.hold.snapshot();
+
+            nlohmann::json item;
+            item["name"] = stats.name;
+            item["acquisitions"] = stats.acquisitions.value();
+            item["contended"] = stats.contended.value();
+            item["waitSeconds"] = wait.sum / 1e9;
+            item["holdSeconds"] = hold.sum / 1e9;
+            item["waitP50Us"] = percentileMicros(wait, 0.5);
+            item["waitP99Us"] = percentileMicros(wait, 0.99);
+            item["holdP50Us"] = percentileMicros(hold, 0.5);
+            item["holdP99Us"] = percentileMicros(hold, 0.99);
+            items.push_back(std::move(item));
+        }
+    }
+
+    std::stable_sort(items.begin(), items.end(), [](const nlohmann::json &lhs, const nlohmann::json &rhs) {
+      return lhs["waitSeconds"].get<double>() > rhs["waitSeconds"].get<double>();
+    });
+
+    nlohmann::json out = nlohmann::json::array();
+    for (auto &item: items) {
+        out.push_back(std::move(item));
+    }
+    return out;
+}
+
+void wss::sync::LockProfiler::report(std::ostream &out) const {
+    out << fmt::format("{0:<28} {1:>12} {2:>10} {3:>10} {4:>10} {5:>10} {6:>10} {7:>10}\n",
+                       "lock", "acquisitions", "contended", "wait,s", "wait p99", "hold,s", "hold p50", "hold p99");
+    for (const auto &item: toJson()) {
+        out << fmt::format("{0:<28} {1:>12} {2:>10} {3:>10.4f} {4:>8.1f}us {5:>10.4f} {6:>8.1f}us {7:>8.1f}us\n",
+                           item["name"].get<std::string>(),
+                           item["acquisitions"].get<uint64_t>(),
+                           item["contended"].get<uint64_t>(),
+                           item["waitSeconds"].get<double>(),
+                           item["waitP99Us"].get<double>(),
+                           item["holdSeconds"].get<double>(),
+                           item["holdP50Us"].get<double>(),
+                           item["holdP99Us"].get<double>());
+    }
+}
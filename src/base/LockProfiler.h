@@ -0,0 +1,143 @@
+/**
+ * wsserver
+ * LockProfiler.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_LOCKPROFILER_H
+#define WSSERVER_LOCKPROFILER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include "json.hpp"
+#include "Metrics.h"
+
+namespace wss {
+namespace sync {
+
+/// \brief Counters of all locks with the same name (for example, timer mutex of every connection)
+struct LockStats {
+  explicit LockStats(const std::string &name);
+
+  const std::string name;
+  wss::metrics::Counter &acquisitions;
+  /// \brief Acquisitions, that had to wait for another owner
+  wss::metrics::Counter &contended;
+  /// \brief Wait time of contended acquisitions
+  wss::metrics::Histogram &wait;
+  wss::metrics::Histogram &hold;
+};
+
+/// \brief Registry of named lock statistics. Statistics are exposed in metrics registry as wss_lock_* families
+/// with label lock="name", and summarized by report functions.
+class LockProfiler {
+ public:
+    static LockProfiler &get();
+
+    /// \return true if server was built with ENABLE_LOCK_PROFILING
+    static bool isEnabled();
+
+    /// \brief Returns existing or creates new statistics. Reference is valid until exit
+    /// \param name lock name
+    LockStats &stats(const std::string &name);
+
+    /// \brief Locks summary, most waited first:
+    /// [{"name": "chat_connection", "acquisitions": 10, "contended": 2, "waitSeconds": 0.001, "holdSeconds": 0.01,
+    ///   "waitP50Us": 1.0, "waitP99Us": 2.0, "holdP50Us": 1.0, "holdP99Us": 2.0}]
+    /// Percentiles are upper bounds of log2 histogram buckets
+    nlohmann::json toJson() const;
+
+    /// \brief Writes summary as text table
+    void report(std::ostream &out) const;
+
+ private:
+    LockProfiler() = default;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<LockStats>> m_stats;
+};
+
+/// \brief Lock that counts acquisitions, contention, wait and hold times of its name
+/// \tparam M std::mutex or std::recursive_mutex. For recursive one, only outermost lock is counted
+template<typename M>
+class ProfiledMutex {
+ public:
+    explicit ProfiledMutex(const char *name) :
+        m_stats(LockProfiler::get().stats(name)) {
+    }
+
+    ProfiledMutex(const ProfiledMutex &) = delete;
+    ProfiledMutex &operator=(const ProfiledMutex &) = delete;
+
+    void lock() {
+        if (!m_mutex.try_lock()) {
+            const auto start = std::chrono::steady_clock::now();
+            m_mutex.lock();
+            m_stats.contended.inc();
+            m_stats.wait.observeSince(start);
+        }
+        acquired();
+    }
+
+    bool try_lock() {
+        if (!m_mutex.try_lock()) {
+            return false;
+        }
+        acquired();
+        return true;
+    }
+
+    void unlock() {
+        if (--m_depth == 0) {
+            m_stats.hold.observeSince(m_acquiredAt);
+        }
+        m_mutex.unlock();
+    }
+
+ private:
+    M m_mutex;
+    LockStats &m_stats;
+    // guarded by m_mutex itself
+    std::size_t m_depth = 0;
+    std::chrono::steady_clock::time_point m_acquiredAt;
+
+    void acquired() {
+        if (m_depth++ == 0) {
+            m_stats.acquisitions.inc();
+            m_acquiredAt = std::chrono::steady_clock::now();
+        }
+    }
+};
+
+/// \brief Plain lock with the same constructor as profiled one, used when profiling is disabled
+template<typename M>
+class NamedMutex : public M {
+ public:
+    explicit NamedMutex(const char *) { }
+};
+
+/// \brief Named locks are profiled only if built with ENABLE_LOCK_PROFILING. Waiting on condition requires
+/// UniqueLock and ConditionVariable, as std::condition_variable works only with std::mutex
+#ifdef ENABLE_LOCK_PROFILING
+using Mutex = ProfiledMutex<std::mutex>;
+using RecursiveMutex = ProfiledMutex<std::recursive_mutex>;
+using UniqueLock = std::unique_lock<Mutex>;
+using ConditionVariable = std::condition_variable_any;
+#else
+using Mutex = NamedMutex<std::mutex>;
+using RecursiveMutex = NamedMutex<std::recursive_mutex>;
+using UniqueLock = std::unique_lock<std::mutex>;
+using ConditionVariable = std::condition_variable;
+#endif
+
+}
+}
+
+#endif //WSSERVER_LOCKPROFILER_H
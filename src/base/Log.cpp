@@ -0,0 +1,312 @@
+/**
+ * wsserver
+ * Log.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <toolboxpp.h>
+#include "Log.h"
+#include "Metrics.h"
+
+using wss::log::Level;
+using wss::log::Record;
+using wss::log::RecordRing;
+
+std::atomic<uint8_t> wss::log::maxLevel(static_cast<uint8_t>(Level::Debug));
+
+static std::size_t roundUpPowerOfTwo(std::size_t n) {
+    std::size_t out = 1;
+    while (out < n) {
+        out <<= 1;
+    }
+    return out;
+}
+
+wss::log::RecordRing::RecordRing(std::size_t capacity) :
+    m_slots(roundUpPowerOfTwo(std::max<std::size_t>(capacity, 2))),
+    m_mask(m_slots.size() - 1),
+    m_head(0),
+    m_tail(0) {
+}
+
+bool wss::log::RecordRing::push(Record &&record) {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+        return false;
+    }
+    m_slots[tail & m_mask] = std::move(record);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool wss::log::RecordRing::pop(Record &record) {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record = std::move(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool wss::log::RecordRing::empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+std::size_t wss::log::RecordRing::capacity() const {
+    return m_slots.size();
+}
+
+static void writeToToolbox(const Record &record) {
+    auto &logger = toolboxpp::Logger::get();
+    switch (record.level) {
+        case Level::Error:
+            logger.error(record.file, record.line, record.tag, record.message);
+            break;
+        case Level::Warning:
+            logger.warning(record.file, record.line, record.tag, record.message);
+            break;
+        case Level::Info:
+            logger.info(record.file, record.line, record.tag, record.message);
+            break;
+        case Level::Debug:
+            logger.debug(record.file, record.line, record.tag, record.message);
+            break;
+    }
+}
+
+namespace {
+
+/// \brief Ring of single thread. Stays registered after its thread exit, until writer drains it
+struct ThreadRing {
+  explicit ThreadRing(std::size_t capacity) :
+      ring(capacity),
+      orphaned(false) {
+  }
+
+  RecordRing ring;
+  std::atomic<bool> orphaned;
+};
+
+/// \brief Marks ring orphaned on thread exit
+struct ThreadRingHolder {
+  std::shared_ptr<ThreadRing> ring;
+
+  ~ThreadRingHolder() {
+      if (ring) {
+          ring->orphaned.store(true, std::memory_order_release);
+      }
+  }
+};
+
+class Writer {
+ public:
+    static Writer &get() {
+        static Writer writer;
+        return writer;
+    }
+
+    ~Writer() {
+        stop();
+    }
+
+    void setSink(wss::log::Sink sink) {
+        std::lock_guard<std::mutex> lock(m_sinkMutex);
+        m_sink = sink ? std::move(sink) : writeToToolbox;
+    }
+
+    void write(Record &&record) {
+        if (m_running.load(std::memory_order_acquire)) {
+            ThreadRing &ring = threadRing();
+            if (ring.ring.push(std::move(record))) {
+                return;
+            }
+            if (record.level > Level::Warning) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                m_metricDropped.inc();
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_sinkMutex);
+        m_sink(record);
+    }
+
+    void start(std::size_t ringCapacity) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (m_running.load()) {
+            return;
+        }
+        m_capacity = ringCapacity;
+        m_running.store(true, std::memory_order_release);
+        m_thread = std::thread(&Writer::run, this);
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (!m_running.load()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> wakeLock(m_wakeMutex);
+            m_running.store(false, std::memory_order_release);
+        }
+        m_wake.notify_one();
+        m_thread.join();
+        drain();
+    }
+
+    /// \brief Writes queued records of all rings. Consumer side of rings, serialized by sink mutex
+    /// \return number of written records
+    std::size_t drain() {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            rings = m_rings;
+        }
+
+        std::lock_guard<std::mutex> lock(m_sinkMutex);
+        Record record;
+        std::size_t written = 0;
+        for (auto &ring: rings) {
+            while (ring->ring.pop(record)) {
+                m_sink(record);
+                written++;
+            }
+        }
+
+        const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDropped) {
+            Record report;
+            report.level = Level::Warning;
+            report.file = __FILE__;
+            report.line = __LINE__;
+            report.tag = "Log";
+            report.message = fmt::format("{0} log record(s) dropped, ring is full", dropped - m_reportedDropped);
+            m_sink(report);
+            m_reportedDropped = dropped;
+        }
+
+        std::lock_guard<std::mutex> ringsLock(m_ringsMutex);
+        m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<ThreadRing> &ring) {
+          return ring->orphaned.load(std::memory_order_acquire) && ring->ring.empty();
+        }), m_rings.end());
+        return written;
+    }
+
+    uint64_t getDropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+ private:
+    /// \brief Producers do not wake writer. It drains rings while they have records, then sleeps this interval
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{5};
+
+    std::mutex m_stateMutex;
+    std::atomic<bool> m_running;
+    std::size_t m_capacity;
+    std::thread m_thread;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+
+    std::mutex m_ringsMutex;
+    std::vector<std::shared_ptr<ThreadRing>> m_rings;
+
+    std::mutex m_sinkMutex;
+    wss::log::Sink m_sink;
+    std::atomic<uint64_t> m_dropped;
+    // guarded by m_sinkMutex
+    uint64_t m_reportedDropped;
+    wss::metrics::Counter &m_metricDropped;
+
+    Writer() :
+        m_running(false),
+        m_capacity(1024),
+        m_sink(writeToToolbox),
+        m_dropped(0),
+        m_reportedDropped(0),
+        m_metricDropped(wss::metrics::Registry::get().counter(
+            "wss_log_dropped_total", "Log records dropped because of full thread ring")) {
+    }
+
+    ThreadRing &threadRing() {
+        thread_local ThreadRingHolder holder;
+        if (!holder.ring) {
+            holder.ring = std::make_shared<ThreadRing>(m_capacity);
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            m_rings.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        while (m_running.load(std::memory_order_acquire)) {
+            lock.unlock();
+            const std::size_t written = drain();
+            lock.lock();
+            if (written > 0) {
+                continue;
+            }
+            m_wake.wait_for(lock, POLL_INTERVAL, [this] { return !m_running.load(std::memory_order_acquire); });
+        }
+    }
+};
+
+constexpr std::chrono::milliseconds Writer::POLL_INTERVAL;
+
+}
+
+void wss::log::setVerbosity(uint16_t verbosity) {
+    Level level;
+    switch (verbosity) {
+        case 0:
+            level = Level::Error;
+            break;
+        case 1:
+            level = Level::Info;
+            break;
+        default:
+            level = Level::Debug;
+            break;
+    }
+    maxLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void wss::log::setSink(wss::log::Sink sink) {
+    Writer::get().setSink(std::move(sink));
+}
+
+void wss::log::write(Level level, const char *file, int line, const char *tag, std::string message) {
+    Record record;
+    record.level = level;
+    record.file = file;
+    record.line = line;
+    record.tag = tag;
+    record.message = std::move(message);
+    Writer::get().write(std::move(record));
+}
+
+void wss::log::startWriter(std::size_t ringCapacity) {
+    Writer::get().start(ringCapacity);
+}
+
+void wss::log::stopWriter() {
+    Writer::get().stop();
+}
+
+void wss::log::flush() {
+    Writer::get().drain();
+}
+
+uint64_t wss::log::getDropped() {
+    return Writer::get().getDropped();
+}
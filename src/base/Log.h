@@ -0,0 +1,141 @@
+/**
+ * wsserver
+ * Log.h
+ *
+ * Lazy asynchronous logging. Level is checked before message is formatted, so disabled record costs single
+ * relaxed atomic load, and its arguments are not evaluated. Enabled record is formatted by calling thread and pushed
+ * to per-thread lock-free ring, that is drained by background writer into toolboxpp logger.
+ * With DISABLE_DEBUG_LOG, debug records are compiled out entirely.
+ *
+ * Usage (printf-style format, the same as toolboxpp L_*_F macros):
+ *  WSS_DEBUG_F("Chat::Send", "Sending message to %lu", uid);
+ *  WSS_WARN("Chat::Send", "Connection lost");
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_LOG_H
+#define WSSERVER_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <fmt/printf.h>
+
+namespace wss {
+namespace log {
+
+enum class Level : uint8_t {
+  Error = 0,
+  Warning,
+  Info,
+  Debug
+};
+
+/// \brief Formatted log record
+struct Record {
+  Level level = Level::Debug;
+  const char *file = "";
+  int line = 0;
+  const char *tag = "";
+  std::string message;
+};
+
+/// \brief Single producer single consumer ring of records. Producer is the thread owning the ring, consumer is writer
+class RecordRing {
+ public:
+    /// \param capacity rounded up to power of two
+    explicit RecordRing(std::size_t capacity);
+
+    RecordRing(const RecordRing &) = delete;
+    RecordRing &operator=(const RecordRing &) = delete;
+
+    /// \brief Producer side
+    /// \return false if ring is full, record is left untouched
+    bool push(Record &&record);
+
+    /// \brief Consumer side
+    /// \return false if ring is empty
+    bool pop(Record &record);
+
+    bool empty() const;
+    std::size_t capacity() const;
+
+ private:
+    static const std::size_t CACHE_LINE = 64;
+
+    std::vector<Record> m_slots;
+    const std::size_t m_mask;
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_head;
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_tail;
+};
+
+using Sink = std::function<void(const Record &)>;
+
+/// \brief Most verbose enabled level, Debug by default
+extern std::atomic<uint8_t> maxLevel;
+
+inline bool isEnabled(Level level) {
+    return static_cast<uint8_t>(level) <= maxLevel.load(std::memory_order_relaxed);
+}
+
+/// \brief Sets max level from verbosity argument: 0 - error, 1 - 0 + warning and info, 2 - all
+void setVerbosity(uint16_t verbosity);
+
+/// \brief Replaces destination of records, default is toolboxpp logger. Sink is called by single thread at a time
+/// \param sink empty function restores default
+void setSink(Sink sink);
+
+/// \brief Writes record: to calling thread ring if writer is running, otherwise directly to sink.
+/// If ring is full, errors and warnings are written directly, others are dropped and counted.
+void write(Level level, const char *file, int line, const char *tag, std::string message);
+
+/// \brief Starts background writer. Records are ordered within thread, but not across threads
+/// \param ringCapacity records per thread ring, applies to rings created after start
+void startWriter(std::size_t ringCapacity = 1024);
+
+/// \brief Stops writer and drains all rings. Further records are written directly to sink
+void stopWriter();
+
+/// \brief Writes all queued records to sink, may be called by any thread
+void flush();
+
+/// \brief Records dropped because of full ring
+uint64_t getDropped();
+
+}
+}
+
+#define WSS_LOG(level, tag, message) \
+    do { \
+        if (wss::log::isEnabled(level)) { \
+            wss::log::write(level, __FILE__, __LINE__, tag, message); \
+        } \
+    } while (0)
+
+#define WSS_LOG_F(level, tag, format, ...) \
+    do { \
+        if (wss::log::isEnabled(level)) { \
+            wss::log::write(level, __FILE__, __LINE__, tag, fmt::sprintf(format, __VA_ARGS__)); \
+        } \
+    } while (0)
+
+#define WSS_ERR(tag, message) WSS_LOG(wss::log::Level::Error, tag, message)
+#define WSS_ERR_F(tag, format, ...) WSS_LOG_F(wss::log::Level::Error, tag, format, __VA_ARGS__)
+#define WSS_WARN(tag, message) WSS_LOG(wss::log::Level::Warning, tag, message)
+#define WSS_WARN_F(tag, format, ...) WSS_LOG_F(wss::log::Level::Warning, tag, format, __VA_ARGS__)
+#define WSS_INFO(tag, message) WSS_LOG(wss::log::Level::Info, tag, message)
+#define WSS_INFO_F(tag, format, ...) WSS_LOG_F(wss::log::Level::Info, tag, format, __VA_ARGS__)
+
+#ifdef DISABLE_DEBUG_LOG
+#define WSS_DEBUG(tag, message) do { } while (0)
+#define WSS_DEBUG_F(tag, format, ...) do { } while (0)
+#else
+#define WSS_DEBUG(tag, message) WSS_LOG(wss::log::Level::Debug, tag, message)
+#define WSS_DEBUG_F(tag, format, ...) WSS_LOG_F(wss::log::Level::Debug, tag, format, __VA_ARGS__)
+#endif
+
+#endif //WSSERVER_LOG_H
@@ -0,0 +1,200 @@
+/**
+ * wsserver
+ * Metrics.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "Metrics.h"
+
+/// \brief Exposed histogram buckets: from 2^10ns (~1us) to 2^36ns (~68s), smaller values are counted in first one
+static const std::size_t EXPOSED_BUCKET_FIRST = 10;
+static const std::size_t EXPOSED_BUCKET_LAST = 36;
+
+const std::size_t wss::metrics::Histogram::BUCKETS;
+
+wss::metrics::Counter::Counter() {
+    for (auto &shard: m_shards) {
+        shard.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t wss::metrics::Counter::value() const {
+    uint64_t out = 0;
+    for (const auto &shard: m_shards) {
+        out += shard.value.load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+wss::metrics::Gauge::Gauge() {
+    for (auto &shard: m_shards) {
+        shard.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+int64_t wss::metrics::Gauge::value() const {
+    int64_t out = 0;
+    for (const auto &shard: m_shards) {
+        out += shard.value.load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+wss::metrics::Histogram::Histogram() {
+    for (auto &shard: m_shards) {
+        for (auto &bucket: shard.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shard.sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+wss::metrics::Histogram::Snapshot wss::metrics::Histogram::snapshot() const {
+    Snapshot out{};
+    for (const auto &shard: m_shards) {
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            const uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+            out.buckets[i] += n;
+            out.count += n;
+        }
+        out.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+wss::metrics::Registry &wss::metrics::Registry::get() {
+    static Registry registry;
+    return registry;
+}
+
+wss::metrics::Registry::Family &wss::metrics::Registry::getFamily(const std::string &name,
+                                                                  const std::string &help,
+                                                                  Type type) {
+    auto it = m_families.find(name);
+    if (it == m_families.end()) {
+        Family family;
+        family.type = type;
+        family.help = help;
+        it = m_families.emplace(name, std::move(family)).first;
+    } else if (it->second.type != type) {
+        throw std::logic_error("Metric " + name + " is already registered with other type");
+    }
+    return it->second;
+}
+
+wss::metrics::Counter &wss::metrics::Registry::counter(const std::string &name,
+                                                       const std::string &help,
+                                                       const std::string &labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = getFamily(name, help, Type::Counter).counters[labels];
+    if (!metric) {
+        metric = std::make_unique<Counter>();
+    }
+    return *metric;
+}
+
+wss::metrics::Gauge &wss::metrics::Registry::gauge(const std::string &name,
+                                                   const std::string &help,
+                                                   const std::string &labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = getFamily(name, help, Type::Gauge).gauges[labels];
+    if (!metric) {
+        metric = std::make_unique<Gauge>();
+    }
+    return *metric;
+}
+
+wss::metrics::Histogram &wss::metrics::Registry::histogram(const std::string &name,
+                                                           const std::string &help,
+                                                           const std::string &labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &metric = getFamily(name, help, Type::Histogram).histograms[labels];
+    if (!metric) {
+        metric = std::make_unique<Histogram>();
+    }
+    return *metric;
+}
+
+void wss::metrics::Registry::addCollector(const void *owner,
+                                          const std::string &name,
+                                          const std::string &help,
+                                          wss::metrics::Registry::Collector collector) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    getFamily(name, help, Type::Gauge).collectors.emplace_back(owner, std::move(collector));
+}
+
+void wss::metrics::Registry::removeCollectors(const void *owner) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &family: m_families) {
+        auto &collectors = family.second.collectors;
+        collectors.erase(std::remove_if(collectors.begin(), collectors.end(),
+                                        [owner](const std::pair<const void *, Collector> &item) {
+                                          return item.first == owner;
+                                        }),
+                         collectors.end());
+    }
+}
+
+/// \brief name{labels} or name{labels,extra}
+static std::string sampleName(const std::string &name, const std::string &labels, const std::string &extra = "") {
+    if (labels.empty() && extra.empty()) {
+        return name;
+    }
+    if (labels.empty() || extra.empty()) {
+        return fmt::format("{0}{{{1}}}", name, labels.empty() ? extra : labels);
+    }
+    return fmt::format("{0}{{{1},{2}}}", name, labels, extra);
+}
+
+std::string wss::metrics::Registry::expose() const {
+    std::string out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto &item: m_families) {
+        const std::string &name = item.first;
+        const Family &family = item.second;
+
+        const char *type = family.type == Type::Counter ? "counter"
+                                                        : family.type == Type::Gauge ? "gauge" : "histogram";
+        out += fmt::format("# HELP {0} {1}\n# TYPE {0} {2}\n", name, family.help, type);
+
+        for (const auto &metric: family.counters) {
+            out += fmt::format("{0} {1}\n", sampleName(name, metric.first), metric.second->value());
+        }
+        for (const auto &metric: family.gauges) {
+            out += fmt::format("{0} {1}\n", sampleName(name, metric.first), metric.second->value());
+        }
+        for (const auto &collector: family.collectors) {
+            Samples samples;
+            collector.second(samples);
+            for (const auto &sample: samples) {
+                out += fmt::format("{0} {1}\n", sampleName(name, sample.first), sample.second);
+            }
+        }
+        for (const auto &metric: family.histograms) {
+            const Histogram::Snapshot snapshot = metric.second->snapshot();
+            uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < Histogram::BUCKETS; i++) {
+                cumulative += snapshot.buckets[i];
+                if (i < EXPOSED_BUCKET_FIRST || i > EXPOSED_BUCKET_LAST) {
+                    continue;
+                }
+                // bucket i contains values < 2^i ns
+                const double le = (double) (1ULL << i) / 1e9;
+                out += fmt::format("{0} {1}\n",
+                                   sampleName(name + "_bucket", metric.first, fmt::format("le=\"{0}\"", le)),
+                                   cumulative);
+            }
+            out += fmt::format("{0} {1}\n", sampleName(name + "_bucket", metric.first, "le=\"+Inf\""), snapshot.count);
+            out += fmt::format("{0} {1}\n", sampleName(name + "_sum", metric.first), (double) snapshot.sum / 1e9);
+            out += fmt::format("{0} {1}\n", sampleName(name + "_count", metric.first), snapshot.count);
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,180 @@
+/**
+ * wsserver
+ * Metrics.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_METRICS_H
+#define WSSERVER_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wss {
+namespace metrics {
+
+/// \brief Number of per-thread slots of each metric. Threads are assigned to slots round-robin,
+/// so with not more threads than slots, every thread writes only to its own cache lines
+static const std::size_t SHARDS = 16;
+static const std::size_t CACHE_LINE = 64;
+
+/// \brief Slot of current thread
+inline std::size_t shardIndex() {
+    static std::atomic_size_t next(0);
+    thread_local const std::size_t index = next++ % SHARDS;
+    return index;
+}
+
+/// \brief Monotonic counter. inc() is single relaxed atomic add to thread slot
+class Counter {
+ public:
+    Counter();
+
+    void inc(uint64_t n = 1) {
+        m_shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+ private:
+    struct Shard {
+      std::atomic<uint64_t> value;
+      char padding[CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+    };
+    Shard m_shards[SHARDS];
+};
+
+/// \brief Value that goes up and down (queue depth, in-flight operations). Sum of thread slots
+class Gauge {
+ public:
+    Gauge();
+
+    void add(int64_t n = 1) {
+        m_shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void sub(int64_t n = 1) {
+        add(-n);
+    }
+
+    int64_t value() const;
+
+ private:
+    struct Shard {
+      std::atomic<int64_t> value;
+      char padding[CACHE_LINE - sizeof(std::atomic<int64_t>)];
+    };
+    Shard m_shards[SHARDS];
+};
+
+/// \brief Latency histogram with log2 buckets (like HdrHistogram with 1 significant bit): bucket N counts values
+/// from 2^(N-1) to 2^N-1 nanoseconds, so range from 1ns to centuries fits in 65 buckets. observe() costs two relaxed
+/// atomic adds to thread slot.
+class Histogram {
+ public:
+    static const std::size_t BUCKETS = 65;
+
+    struct Snapshot {
+      uint64_t buckets[BUCKETS];
+      uint64_t count;
+      /// \brief nanoseconds
+      uint64_t sum;
+    };
+
+    Histogram();
+
+    /// \param nanos
+    void observe(uint64_t nanos) {
+        Shard &shard = m_shards[shardIndex()];
+        shard.buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(nanos, std::memory_order_relaxed);
+    }
+
+    template<typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> duration) {
+        const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        observe((uint64_t) (nanos < 0 ? 0 : nanos));
+    }
+
+    /// \brief Observe time passed since start
+    void observeSince(std::chrono::steady_clock::time_point start) {
+        observe(std::chrono::steady_clock::now() - start);
+    }
+
+    static std::size_t bucketOf(uint64_t nanos) {
+        return nanos == 0 ? 0 : (std::size_t) (64 - __builtin_clzll(nanos));
+    }
+
+    /// \brief Sum of all thread slots. Not atomic as a whole, concurrent observations may be partially visible
+    Snapshot snapshot() const;
+
+ private:
+    struct Shard {
+      std::atomic<uint64_t> buckets[BUCKETS];
+      std::atomic<uint64_t> sum;
+      char padding[CACHE_LINE - (sizeof(std::atomic<uint64_t>) * (BUCKETS + 1)) % CACHE_LINE];
+    };
+    Shard m_shards[SHARDS];
+};
+
+/// \brief Named metrics and Prometheus text exposition. Metrics are created once (usually at startup or as static
+/// references) and live until exit, so hot path holds plain references and never touches registry lock.
+class Registry {
+ public:
+    /// \brief Value samples of collector: pairs of labels (like target="postback") and value
+    using Samples = std::vector<std::pair<std::string, double>>;
+    /// \brief Called on each scrape to read values, that are already tracked somewhere (queue sizes)
+    using Collector = std::function<void(Samples &)>;
+
+    static Registry &get();
+
+    /// \brief Returns existing metric with same name and labels, or creates new one
+    /// \param name metric name, for counters should end with _total
+    /// \param help description
+    /// \param labels optional labels without braces: result="ok"
+    /// \throws std::logic_error if name already registered with other type
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    /// \brief Histogram of durations, exposed in seconds
+    Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /// \brief Adds gauge collector, owned by object, that must remove it before destruction
+    /// \param owner any pointer to identify collectors for removeCollectors()
+    void addCollector(const void *owner, const std::string &name, const std::string &help, Collector collector);
+    void removeCollectors(const void *owner);
+
+    /// \brief Prometheus text format (version 0.0.4)
+    std::string expose() const;
+
+ private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Family {
+      Type type;
+      std::string help;
+      std::map<std::string, std::unique_ptr<Counter>> counters;
+      std::map<std::string, std::unique_ptr<Gauge>> gauges;
+      std::map<std::string, std::unique_ptr<Histogram>> histograms;
+      std::vector<std::pair<const void *, Collector>> collectors;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family> m_families;
+
+    Family &getFamily(const std::string &name, const std::string &help, Type type);
+};
+
+}
+}
+
+#endif //WSSERVER_METRICS_H
@@ -0,0 +1,20 @@
+/**
+ * wsserver
+ * Probes.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include "Probes.h"
+
+#ifdef ENABLE_USDT
+// semaphores are incremented by tracer (kernel uprobes) when it attaches to probe
+#define WSS_PROBE_DEFINE(name) \
+    __extension__ unsigned short WSS_PROBE_SEMAPHORE(name) \
+    __attribute__((unused)) __attribute__((section(".probes"))) = 0;
+
+extern "C" {
+WSS_PROBES(WSS_PROBE_DEFINE)
+}
+#endif
@@ -0,0 +1,68 @@
+/**
+ * wsserver
+ * Probes.h
+ *
+ * USDT (user-level statically defined tracing) probes of provider "wsserver". Probe is a single nop until tracer
+ * attaches to it, and its arguments are not even evaluated: every probe has a semaphore, that tracer increments.
+ * Example: bpftrace -e 'usdt:/usr/bin/wsserver:wsserver:write_completed { @[arg3] = count(); }'
+ * List: bpftrace -l 'usdt:/usr/bin/wsserver:*' or perf list sdt (after perf buildid-cache --add)
+ *
+ * Probes (arguments):
+ *  - connection_accept (connection handle)
+ *  - handshake_done (connection handle, const char* path)
+ *  - auth_done (connection handle, user id, connection id or 0 if rejected, authorized 0/1, auth time ns)
+ *  - frame_received (user id, connection id, payload bytes, fin_rsv_opcode)
+ *  - message_routed (sender id, recipient id, connection id, bytes)
+ *  - message_undeliverable (sender id, recipient id, bytes)
+ *  - write_completed (recipient id, connection id, bytes written, error code)
+ *  - event_sent (const char* target type, sender id, bytes, delivery time ns)
+ *  - event_failed (const char* target type, sender id, tries, const char* reason)
+ * Connection handle is address of connection object, the same in all probes, user and connection ids are known
+ * only after auth.
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_PROBES_H
+#define WSSERVER_PROBES_H
+
+#define WSS_PROBES(X) \
+    X(connection_accept) \
+    X(handshake_done) \
+    X(auth_done) \
+    X(frame_received) \
+    X(message_routed) \
+    X(message_undeliverable) \
+    X(write_completed) \
+    X(event_sent) \
+    X(event_failed)
+
+#ifdef ENABLE_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define WSS_PROBE_SEMAPHORE(name) wsserver_##name##_semaphore
+#define WSS_PROBE_DECLARE(name) \
+    __extension__ extern unsigned short WSS_PROBE_SEMAPHORE(name) \
+    __attribute__((unused)) __attribute__((section(".probes")));
+
+extern "C" {
+WSS_PROBES(WSS_PROBE_DECLARE)
+}
+
+/// \brief true if tracer is attached to probe
+#define WSS_PROBE_ENABLED(name) __builtin_expect(WSS_PROBE_SEMAPHORE(name) != 0, 0)
+/// \brief Fires probe, arguments are evaluated only if tracer is attached
+#define WSS_PROBE(name, ...) \
+    do { \
+        if (WSS_PROBE_ENABLED(name)) { \
+            STAP_PROBEV(wsserver, name, ##__VA_ARGS__); \
+        } \
+    } while (0)
+#else
+#define WSS_PROBE_ENABLED(name) false
+#define WSS_PROBE(name, ...) do { } while (0)
+#endif
+
+#endif //WSSERVER_PROBES_H
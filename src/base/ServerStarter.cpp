@@ -7,6 +7,9 @@
  */
 
 #include "ServerStarter.h"
+#include "../chat/MessageTracer.h"
+#include "LockProfiler.h"
+#include "Log.h"
 
 static wss::ServerStarter *self; // for signal instance
 
@@ -31,6 +34,7 @@ wss::ServerStarter::ServerStarter(int argc, const char **argv) : m_args() {
     }
 
     toolboxpp::Logger::get().setVerbosity(m_args.get<uint16_t>("verbosity"));
+    wss::log::setVerbosity(m_args.get<uint16_t>("verbosity"));
 
     m_args.parse_check(argc, const_cast<char **>(argv));
     const std::string configPath = m_args.get<std::string>("config");
@@ -121,6 +125,8 @@ wss::ServerStarter::ServerStarter(int argc, const char **argv) : m_args() {
         // configuring rest api service
         m_restServer->setAddress(settings.restApi.address);
         m_restServer->setPort(settings.restApi.port);
+        m_restServer->setWorkers(settings.restApi.workers);
+        m_restServer->setKeepAlive(settings.restApi.keepAlive, settings.restApi.keepAliveTimeoutSeconds);
         m_restServer->setAuth(settings.restApi.auth.data);
     }
 
@@ -128,6 +134,15 @@ wss::ServerStarter::ServerStarter(int argc, const char **argv) : m_args() {
     configureServer(settings);
     // configuring ws service chat
     configureChat(settings);
+    if (!configureCluster(settings)) {
+        m_valid = false;
+        return;
+    }
+    if (!configureIngress(settings)) {
+        m_valid = false;
+        return;
+    }
+    configureBotChannel(settings);
 
     // creating event notifier service
     m_eventNotifier = std::make_shared<wss::event::EventNotifier>(m_webSocket);
@@ -168,8 +183,15 @@ void wss::ServerStarter::stop() {
     for (auto &service: m_services) {
         service->stopService();
     }
+    wss::log::flush();
+
+    if (wss::sync::LockProfiler::isEnabled()) {
+        std::cout << "Locks profile:" << std::endl;
+        wss::sync::LockProfiler::get().report(std::cout);
+    }
 }
 void wss::ServerStarter::run() {
+    wss::log::startWriter();
     for (auto &service: m_services) {
         service->runService();
     }
@@ -177,6 +199,7 @@ void wss::ServerStarter::run() {
     std::for_each(m_services.rbegin(), m_services.rend(), [](const std::shared_ptr<wss::StandaloneService> &s) {
       s->joinThreads();
     });
+    wss::log::stopWriter();
 }
 void wss::ServerStarter::signalHandler(int signum) {
     std::cout << "[" << signum << "] Stopping server..." << std::endl;
@@ -192,6 +215,8 @@ bool wss::ServerStarter::hasKey(nlohmann::json &obj, const std::string &key) {
 void wss::ServerStarter::configureChat(wss::Settings &settings) {
     using toolboxpp::strings::matchRegexp;
 
+    wss::MessageTracer::get().configure(settings.chat.trace.sampleEvery, settings.chat.trace.capacity);
+
     std::string messageMaxSize = settings.chat.message.maxSize;
 
     auto res = matchRegexp(R"(^(\d+)(M|K)$)", messageMaxSize);
@@ -228,6 +253,51 @@ void wss::ServerStarter::configureServer(wss::Settings &settings) {
     m_webSocket->setThreadPoolSize(settings.server.workers);
     m_webSocket->setAuth(settings.server.auth.data);
 }
+bool wss::ServerStarter::configureCluster(wss::Settings &settings) {
+    if (!settings.cluster.enabled) {
+        return true;
+    }
+
+    std::vector<wss::cluster::NodeAddress> nodes;
+    for (const auto &node: settings.cluster.nodes) {
+        nodes.push_back({node.id, node.address, node.port});
+    }
+    try {
+        m_webSocket->setCluster(std::make_unique<wss::cluster::Cluster>(
+            settings.cluster.nodeId, settings.cluster.address, settings.cluster.port, nodes, settings.cluster.secret));
+    } catch (const std::exception &e) {
+        cerr << "Invalid cluster config: " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+bool wss::ServerStarter::configureIngress(wss::Settings &settings) {
+    if (!settings.chat.ingress.enabled) {
+        return true;
+    }
+
+    const std::string path = settings.server.tmpDir + "/wsserver_ingress.ring";
+    try {
+        m_webSocket->setIngress(wss::IngressRing::create(path, settings.chat.ingress.capacity),
+                                settings.chat.ingress.spin,
+                                std::chrono::milliseconds(settings.chat.ingress.idleWaitMs));
+    } catch (const std::runtime_error &e) {
+        cerr << "Unable to create ingress ring: " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+void wss::ServerStarter::configureBotChannel(wss::Settings &settings) {
+    if (!settings.chat.bot.enabled) {
+        return;
+    }
+
+    std::string path = settings.chat.bot.socket;
+    if (path.empty()) {
+        path = settings.server.tmpDir + "/wsserver_bot.sock";
+    }
+    m_webSocket->setBotChannel(std::make_unique<wss::BotChannel>(path, settings.chat.bot.maxPendingBytes));
+}
 bool wss::ServerStarter::configureEventNotifier(wss::Settings &settings) {
     if (!settings.event.enabled) {
         return true;
@@ -247,6 +317,10 @@ bool wss::ServerStarter::configureEventNotifier(wss::Settings &settings) {
 
     m_eventNotifier->setMaxTries(settings.event.retryCount);
     m_eventNotifier->setRetryIntervalSeconds(settings.event.retryIntervalSeconds);
+    m_eventNotifier->setMaxRetryIntervalSeconds(settings.event.retryMaxIntervalSeconds);
+    m_eventNotifier->setRetryJitter(settings.event.retryJitter);
+    m_eventNotifier->setIngestThreads(settings.event.ingestThreads);
+    m_eventNotifier->setDeliveryWorkers(settings.event.deliveryWorkers);
 
     int i = 0;
     for (auto &target: settings.event.targets) {
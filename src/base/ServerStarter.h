@@ -87,6 +87,17 @@ class ServerStarter {
     /// \param settings
     /// \return false if not valid config
     bool configureEventNotifier(wss::Settings &settings);
+    /// \brief Setup cluster mode settings
+    /// \param settings
+    /// \return false if not valid config
+    bool configureCluster(wss::Settings &settings);
+    /// \brief Create shared memory ingress ring in server.tmpDir
+    /// \param settings
+    /// \return false if ring can't be created
+    bool configureIngress(wss::Settings &settings);
+    /// \brief Setup bot channel socket, bound when server starts
+    /// \param settings
+    void configureBotChannel(wss::Settings &settings);
 };
 
 }
@@ -57,6 +57,9 @@ struct RestApi {
   bool enabled = false;
   std::string address = "*";
   uint16_t port = 8082;
+  uint32_t workers = 4;
+  bool keepAlive = true;
+  uint32_t keepAliveTimeoutSeconds = 5;
   AuthSettings auth;
   Secure secure;
 };
@@ -67,7 +70,30 @@ struct Chat {
     bool enableSendBack = false;
     std::vector<std::string> ignoreTypesSendBack;
   };
+  struct Trace {
+    uint32_t sampleEvery = 0;
+    uint32_t capacity = 1024;
+  };
+  struct Delivery {
+    uint32_t shards = 256;
+    uint32_t threads = 4;
+  };
+  struct Ingress {
+    bool enabled = false;
+    uint32_t capacity = 16 * 1024 * 1024;
+    uint32_t spin = 1000;
+    uint32_t idleWaitMs = 100;
+  };
+  struct Bot {
+    bool enabled = false;
+    std::string socket;
+    uint32_t maxPendingBytes = 16 * 1024 * 1024;
+  };
   Message message = Message();
+  Trace trace = Trace();
+  Delivery delivery = Delivery();
+  Ingress ingress = Ingress();
+  Bot bot = Bot();
   bool enableUndeliveredQueue = false;
 };
 struct Event {
@@ -75,12 +101,30 @@ struct Event {
   bool enableRetry = false;
   bool sendBotMessages = false;
   int retryIntervalSeconds = 10;
+  int retryMaxIntervalSeconds = 300;
+  double retryJitter = 0.2;
   int retryCount = 3;
   uint32_t maxParallelWorkers = 8;
+  uint32_t ingestThreads = 4;
+  uint32_t deliveryWorkers = 0;
   std::vector<std::string> ignoreTypes;
   nlohmann::json targets;
 };
 
+struct Cluster {
+  struct Node {
+    uint32_t id = 0;
+    std::string address;
+    uint16_t port = 8090;
+  };
+  bool enabled = false;
+  uint32_t nodeId = 1;
+  std::string address = "127.0.0.1";
+  uint16_t port = 8090;
+  std::string secret;
+  std::vector<Node> nodes;
+};
+
 struct Settings {
   static Settings &get() {
       static Settings s;
@@ -90,6 +134,7 @@ struct Settings {
   RestApi restApi;
   Chat chat;
   Event event;
+  Cluster cluster;
 };
 
 inline void from_json(const nlohmann::json &j, wss::Settings &in) {
@@ -126,6 +171,9 @@ inline void from_json(const nlohmann::json &j, wss::Settings &in) {
         setConfigDef(in.restApi.enabled, restApi, "enabled", false);
         setConfigDef(in.restApi.port, restApi, "port", (uint16_t) 8082);
         setConfigDef(in.restApi.address, restApi, "address", "*");
+        setConfigDef(in.restApi.workers, restApi, "workers", (uint32_t) 4);
+        setConfigDef(in.restApi.keepAlive, restApi, "keepAlive", true);
+        setConfigDef(in.restApi.keepAliveTimeoutSeconds, restApi, "keepAliveTimeoutSeconds", (uint32_t) 5);
         if (restApi.find("auth") != restApi.end()) {
             in.restApi.auth = wss::AuthSettings();
             setConfigDef(in.restApi.auth.type, restApi["auth"], "type", "noauth");
@@ -157,6 +205,52 @@ inline void from_json(const nlohmann::json &j, wss::Settings &in) {
                 in.chat.message.ignoreTypesSendBack.resize(0);
             }
         }
+
+        if (chat.find("trace") != chat.end()) {
+            nlohmann::json chatTrace = chat.at("trace");
+            setConfigDef(in.chat.trace.sampleEvery, chatTrace, "sampleEvery", (uint32_t) 0);
+            setConfigDef(in.chat.trace.capacity, chatTrace, "capacity", (uint32_t) 1024);
+        }
+
+        if (chat.find("delivery") != chat.end()) {
+            nlohmann::json chatDelivery = chat.at("delivery");
+            setConfigDef(in.chat.delivery.shards, chatDelivery, "shards", (uint32_t) 256);
+            setConfigDef(in.chat.delivery.threads, chatDelivery, "threads", (uint32_t) 4);
+        }
+
+        if (chat.find("ingress") != chat.end()) {
+            nlohmann::json chatIngress = chat.at("ingress");
+            setConfigDef(in.chat.ingress.enabled, chatIngress, "enabled", false);
+            setConfigDef(in.chat.ingress.capacity, chatIngress, "capacity", (uint32_t) (16 * 1024 * 1024));
+            setConfigDef(in.chat.ingress.spin, chatIngress, "spin", (uint32_t) 1000);
+            setConfigDef(in.chat.ingress.idleWaitMs, chatIngress, "idleWaitMs", (uint32_t) 100);
+        }
+
+        if (chat.find("bot") != chat.end()) {
+            nlohmann::json chatBot = chat.at("bot");
+            setConfigDef(in.chat.bot.enabled, chatBot, "enabled", false);
+            setConfigDef(in.chat.bot.socket, chatBot, "socket", "");
+            setConfigDef(in.chat.bot.maxPendingBytes, chatBot, "maxPendingBytes", (uint32_t) (16 * 1024 * 1024));
+        }
+    }
+
+    if (j.find("cluster") != j.end()) {
+        nlohmann::json cluster = j.at("cluster");
+        setConfigDef(in.cluster.enabled, cluster, "enabled", false);
+        setConfigDef(in.cluster.nodeId, cluster, "nodeId", (uint32_t) 1);
+        setConfigDef(in.cluster.address, cluster, "address", "127.0.0.1");
+        setConfigDef(in.cluster.port, cluster, "port", (uint16_t) 8090);
+        setConfigDef(in.cluster.secret, cluster, "secret", "");
+        in.cluster.nodes.clear();
+        if (cluster.find("nodes") != cluster.end() && cluster.at("nodes").is_array()) {
+            for (const auto &item: cluster.at("nodes")) {
+                wss::Cluster::Node node;
+                setConfig(node.id, item, "id");
+                setConfig(node.address, item, "address");
+                setConfigDef(node.port, item, "port", (uint16_t) 8090);
+                in.cluster.nodes.push_back(node);
+            }
+        }
     }
 
     if (j.find("event") != j.end()) {
@@ -175,8 +269,12 @@ inline void from_json(const nlohmann::json &j, wss::Settings &in) {
             setConfigDef(in.event.enableRetry, event, "enableRetry", true);
             setConfigDef(in.event.sendBotMessages, event, "sendBotMessages", false);
             setConfigDef(in.event.retryIntervalSeconds, event, "retryIntervalSeconds", 10);
+            setConfigDef(in.event.retryMaxIntervalSeconds, event, "retryMaxIntervalSeconds", 300);
+            setConfigDef(in.event.retryJitter, event, "retryJitter", 0.2);
             setConfigDef(in.event.retryCount, event, "retryCount", 3);
             setConfigDef(in.event.maxParallelWorkers, event, "maxParallelWorkers", (uint32_t) (nativeThreadsMax * 2));
+            setConfigDef(in.event.ingestThreads, event, "ingestThreads", (uint32_t) 4);
+            setConfigDef(in.event.deliveryWorkers, event, "deliveryWorkers", (uint32_t) 0);
 
             if (event.find("ignoreTypes") != event.end() && event.at("ignoreTypes").is_array()) {
                 in.event.ignoreTypes = event.at("ignoreTypes").get<std::vector<std::string>>();
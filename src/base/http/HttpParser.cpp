@@ -0,0 +1,269 @@
+/**
+ * wsserver
+ * HttpParser.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <boost/asio/buffer.hpp>
+
+// before utility.hpp, that includes it inside of namespace
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "HttpParser.h"
+
+const std::size_t wss::http::RequestView::MAX_HEADERS;
+
+using Status = wss::http::RequestParser::Status;
+
+/// \brief RFC 7230 tchar: allowed in method and header name
+static bool isTokenChar(unsigned char c) {
+    static const struct Table {
+      bool allowed[256];
+      Table() : allowed() {
+          for (int i = 0; i < 256; i++) {
+              allowed[i] = std::isalnum(i) != 0 && i < 0x80;
+          }
+          for (const char *c = "!#$%&'*+-.^_`|~"; *c; c++) {
+              allowed[(unsigned char) *c] = true;
+          }
+      }
+    } table;
+    return table.allowed[c];
+}
+
+static bool isToken(const char *begin, const char *end) {
+    if (begin == end) {
+        return false;
+    }
+    for (const char *c = begin; c < end; c++) {
+        if (!isTokenChar((unsigned char) *c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief Finds end of line that starts at begin. Tabs are allowed inside line, other control characters are not.
+/// \param lineEnd position of CR (or bare LF)
+/// \param next first byte after LF
+static Status nextLine(const char *begin, const char *end, const char *&lineEnd, const char *&next) {
+    const char *c = begin;
+    while (true) {
+        c = wss::http::RequestParser::findControl(c, end);
+        if (c == end) {
+            return Status::Incomplete;
+        }
+        if (*c == '\t') {
+            c++;
+            continue;
+        }
+        if (*c == '\r') {
+            if (c + 1 == end) {
+                return Status::Incomplete;
+            }
+            if (c[1] != '\n') {
+                return Status::Invalid;
+            }
+            lineEnd = c;
+            next = c + 2;
+            return Status::Complete;
+        }
+        if (*c == '\n') {
+            lineEnd = c;
+            next = c + 1;
+            return Status::Complete;
+        }
+        return Status::Invalid;
+    }
+}
+
+/// \brief METHOD SP request-target SP HTTP/version
+static bool parseRequestLine(const char *begin, const char *end, wss::http::RequestView &out) {
+    if (std::memchr(begin, '\t', (std::size_t) (end - begin)) != nullptr) {
+        return false;
+    }
+
+    const auto *methodEnd = (const char *) std::memchr(begin, ' ', (std::size_t) (end - begin));
+    if (methodEnd == nullptr || !isToken(begin, methodEnd)) {
+        return false;
+    }
+
+    const char *target = methodEnd + 1;
+    const auto *targetEnd = (const char *) std::memchr(target, ' ', (std::size_t) (end - target));
+    if (targetEnd == nullptr || targetEnd == target) {
+        return false;
+    }
+
+    const char *protocol = targetEnd + 1;
+    static const char httpPrefix[] = "HTTP/";
+    const std::size_t prefixLength = sizeof(httpPrefix) - 1;
+    if ((std::size_t) (end - protocol) <= prefixLength
+        || std::memcmp(protocol, httpPrefix, prefixLength) != 0
+        || std::memchr(protocol, ' ', (std::size_t) (end - protocol)) != nullptr) {
+        return false;
+    }
+
+    const auto *query = (const char *) std::memchr(target, '?', (std::size_t) (targetEnd - target));
+    out.method = wss::http::string_view(begin, (std::size_t) (methodEnd - begin));
+    if (query != nullptr) {
+        out.path = wss::http::string_view(target, (std::size_t) (query - target));
+        out.queryString = wss::http::string_view(query + 1, (std::size_t) (targetEnd - query - 1));
+    } else {
+        out.path = wss::http::string_view(target, (std::size_t) (targetEnd - target));
+        out.queryString = wss::http::string_view();
+    }
+    out.version = wss::http::string_view(protocol + prefixLength, (std::size_t) (end - protocol - prefixLength));
+    return true;
+}
+
+/// \brief name ":" OWS value OWS
+static bool parseHeaderLine(const char *begin, const char *end, wss::http::HeaderView &out) {
+    const auto *colon = (const char *) std::memchr(begin, ':', (std::size_t) (end - begin));
+    // also rejects obsolete line folding, as name can't start with whitespace
+    if (colon == nullptr || !isToken(begin, colon)) {
+        return false;
+    }
+
+    const char *value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        value++;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+        valueEnd--;
+    }
+
+    out.name = wss::http::string_view(begin, (std::size_t) (colon - begin));
+    out.value = wss::http::string_view(value, (std::size_t) (valueEnd - value));
+    return true;
+}
+
+wss::http::string_view wss::http::RequestView::header(wss::http::string_view name) const noexcept {
+    for (std::size_t i = 0; i < headersCount; i++) {
+        const string_view &candidate = headers[i].name;
+        if (candidate.size() == name.size()
+            && std::equal(candidate.begin(), candidate.end(), name.begin(), [](char a, char b) {
+              return std::tolower((unsigned char) a) == std::tolower((unsigned char) b);
+            })) {
+            return headers[i].value;
+        }
+    }
+    return string_view();
+}
+
+const char *wss::http::RequestParser::findControl(const char *begin, const char *end) noexcept {
+    const char *c = begin;
+#ifdef __SSE2__
+    const __m128i controlMax = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    while (end - c >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(c));
+        // unsigned chunk <= 0x1F: min(chunk, 0x1F) == chunk
+        const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, controlMax), chunk);
+        const int mask = _mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(chunk, del)));
+        if (mask != 0) {
+            return c + __builtin_ctz((unsigned) mask);
+        }
+        c += 16;
+    }
+#endif
+    for (; c < end; c++) {
+        const auto byte = (unsigned char) *c;
+        if (byte <= 0x1F || byte == 0x7F) {
+            return c;
+        }
+    }
+    return end;
+}
+
+Status wss::http::RequestParser::parse(const char *data,
+                                       std::size_t size,
+                                       wss::http::RequestView &out,
+                                       std::size_t &consumed) noexcept {
+    const char *p = data;
+    const char *end = data + size;
+    const char *lineEnd = nullptr;
+    const char *next = nullptr;
+    out.headersCount = 0;
+
+    // RFC 7230 3.5: server should ignore empty lines before request line
+    while (p < end && (*p == '\r' || *p == '\n')) {
+        p++;
+    }
+
+    Status status = nextLine(p, end, lineEnd, next);
+    if (status != Status::Complete) {
+        return status;
+    }
+    if (!parseRequestLine(p, lineEnd, out)) {
+        return Status::Invalid;
+    }
+    p = next;
+
+    while (true) {
+        status = nextLine(p, end, lineEnd, next);
+        if (status != Status::Complete) {
+            return status;
+        }
+        if (lineEnd == p) {
+            // empty line, end of head
+            consumed = (std::size_t) (next - data);
+            return Status::Complete;
+        }
+        if (out.headersCount == RequestView::MAX_HEADERS) {
+            return Status::Invalid;
+        }
+        if (!parseHeaderLine(p, lineEnd, out.headers[out.headersCount])) {
+            return Status::Invalid;
+        }
+        out.headersCount++;
+        p = next;
+    }
+}
+
+bool wss::http::RequestParser::parse(boost::asio::streambuf &buffer,
+                                     std::string &method,
+                                     std::string &path,
+                                     std::string &queryString,
+                                     std::string &version,
+                                     wss::utils::CaseInsensitiveMultimap &header) noexcept {
+    // asio::streambuf keeps readable bytes contiguous
+    const auto bytes = buffer.data();
+    const char *data = boost::asio::buffer_cast<const char *>(bytes);
+
+    RequestView view;
+    std::size_t consumed = 0;
+    if (parse(data, boost::asio::buffer_size(bytes), view, consumed) != Status::Complete) {
+        return false;
+    }
+
+    try {
+        method.assign(view.method.data(), view.method.size());
+        path.assign(view.path.data(), view.path.size());
+        queryString.assign(view.queryString.data(), view.queryString.size());
+        version.assign(view.version.data(), view.version.size());
+
+        header.clear();
+        for (std::size_t i = 0; i < view.headersCount; i++) {
+            const HeaderView &field = view.headers[i];
+            header.emplace(std::piecewise_construct,
+                           std::forward_as_tuple(field.name.data(), field.name.size()),
+                           std::forward_as_tuple(field.value.data(), field.value.size()));
+        }
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+
+    buffer.consume(consumed);
+    return true;
+}
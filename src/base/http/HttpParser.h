@@ -0,0 +1,86 @@
+/**
+ * wsserver
+ * HttpParser.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_HTTPPARSER_H
+#define WSSERVER_HTTPPARSER_H
+
+#include <cstddef>
+#include <string>
+#include <boost/asio/streambuf.hpp>
+#include <boost/utility/string_view.hpp>
+#include "../../helpers/utility.hpp"
+
+namespace wss {
+namespace http {
+
+using string_view = boost::string_view;
+
+struct HeaderView {
+  string_view name;
+  string_view value;
+};
+
+/// \brief Parsed request head. All views point into parsed buffer and are valid until it's consumed or changed
+struct RequestView {
+  static const std::size_t MAX_HEADERS = 64;
+
+  string_view method;
+  string_view path;
+  string_view queryString;
+  /// \brief without "HTTP/" prefix: 1.1
+  string_view version;
+  HeaderView headers[MAX_HEADERS];
+  std::size_t headersCount = 0;
+
+  /// \brief First header value with case-insensitive name
+  /// \param name
+  /// \return empty view if not found
+  string_view header(string_view name) const noexcept;
+};
+
+/// \brief Non-allocating HTTP/1.x request head parser. Works on contiguous bytes, never reads outside of
+/// [data, data + size) and never trusts input for sizes, so any byte sequence either parses, needs more bytes
+/// or is rejected. Line ends and forbidden control characters are found in one pass, 16 bytes at a time with SSE2.
+class RequestParser {
+ public:
+    enum class Status {
+      /// \brief head parsed, consumed contains its length including empty line
+      Complete,
+      /// \brief no empty line yet, read more and parse again
+      Incomplete,
+      /// \brief malformed request line or headers, more than RequestView::MAX_HEADERS headers
+      Invalid
+    };
+
+    /// \brief Parse request line and header fields
+    /// \param data buffer start
+    /// \param size buffer size
+    /// \param out parsed views into data
+    /// \param consumed head length, set only if status is Complete
+    static Status parse(const char *data, std::size_t size, RequestView &out, std::size_t &consumed) noexcept;
+
+    /// \brief Parse request head from the beginning of streambuf and consume it, so only content is left.
+    /// Replacement of utils::RequestMessage::parse: strings are assigned once from parsed views,
+    /// without intermediate line copies.
+    /// \return false if head is invalid or incomplete, streambuf is not changed in this case
+    static bool parse(boost::asio::streambuf &buffer,
+                      std::string &method,
+                      std::string &path,
+                      std::string &queryString,
+                      std::string &version,
+                      wss::utils::CaseInsensitiveMultimap &header) noexcept;
+
+    /// \brief Position of first control character (0x00-0x1F or 0x7F) in range
+    /// \return end if not found
+    static const char *findControl(const char *begin, const char *end) noexcept;
+};
+
+}
+}
+
+#endif //WSSERVER_HTTPPARSER_H
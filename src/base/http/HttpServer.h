@@ -12,8 +12,11 @@
 
 #include "utility.hpp"
 #include "crypto.hpp"
+#include "HttpParser.h"
+#include "RouteTable.h"
 #include "../BaseServer.h"
 #include "../SocketLayerWrapper.hpp"
+#include "../LockProfiler.h"
 #include <functional>
 #include <iostream>
 #include <limits>
@@ -200,6 +203,7 @@ class ServerBase : public BaseServer {
 
         CaseInsensitiveMultimap header;
 
+        /// Filled only if path matched regex resource, exact and prefix paths are dispatched without regex
         regexns::smatch path_match;
 
         std::shared_ptr<asio::ip::tcp::endpoint> remote_endpoint;
@@ -234,15 +238,18 @@ class ServerBase : public BaseServer {
         std::shared_ptr<ScopeRunner> handler_runner;
         // Socket must be unique_ptr since asio::ssl::stream<asio::ip::tcp::socket> is not movable
         std::unique_ptr<SocketLayerWrapper> socket;
-        std::mutex socket_close_mutex;
+        wss::sync::Mutex socket_close_mutex{"http_connection_close"};
 
         std::unique_ptr<asio::steady_timer> timer;
 
         std::shared_ptr<asio::ip::tcp::endpoint> remote_endpoint;
 
+        /// Bytes of pipelined requests, that were read together with previous request
+        std::string pipelined;
+
         void close() noexcept {
             error_code ec;
-            std::unique_lock<std::mutex>
+            std::unique_lock<wss::sync::Mutex>
                 lock(socket_close_mutex); // The following operations seems to be needed to run sequentially
             socket->lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both, ec);
             socket->lowest_layer().close(ec);
@@ -362,6 +369,7 @@ class ServerBase : public BaseServer {
         acceptor->bind(endpoint);
         acceptor->listen();
 
+        build_routes();
         accept();
 
         if (internal_io_service) {
@@ -390,7 +398,7 @@ class ServerBase : public BaseServer {
             acceptor->close(ec);
 
             {
-                std::unique_lock<std::mutex> lock(*connections_mutex);
+                std::unique_lock<wss::sync::Mutex> lock(*connections_mutex);
                 for (auto &connection : *connections)
                     connection->close();
                 connections->clear();
@@ -409,20 +417,25 @@ class ServerBase : public BaseServer {
     }
 
  protected:
+    using Methods = typename ResourceEndpoint::mapped_type;
+
+    /// Built from resource on start
+    wss::http::RouteTable<Methods *> routes;
+
     bool internal_io_service = false;
 
     std::unique_ptr<asio::ip::tcp::acceptor> acceptor;
     std::vector<std::thread> threads;
 
     std::shared_ptr<std::unordered_set<Connection *>> connections;
-    std::shared_ptr<std::mutex> connections_mutex;
+    std::shared_ptr<wss::sync::Mutex> connections_mutex;
 
     std::shared_ptr<ScopeRunner> handler_runner;
 
     ServerBase(unsigned short port) noexcept
         : config(port),
           connections(new std::unordered_set<Connection *>()),
-          connections_mutex(new std::mutex()),
+          connections_mutex(new wss::sync::Mutex("http_connections")),
           handler_runner(new ScopeRunner()) { }
 
     virtual void accept() override = 0;
@@ -435,7 +448,7 @@ class ServerBase : public BaseServer {
             new Connection(handler_runner, std::forward<Args>(args)...),
             [connections, connections_mutex](Connection *connection) {
               {
-                  std::unique_lock<std::mutex> lock(*connections_mutex);
+                  std::unique_lock<wss::sync::Mutex> lock(*connections_mutex);
                   auto it = connections->find(connection);
                   if (it != connections->end())
                       connections->erase(it);
@@ -443,19 +456,27 @@ class ServerBase : public BaseServer {
               delete connection;
             });
         {
-            std::unique_lock<std::mutex> lock(*connections_mutex);
+            std::unique_lock<wss::sync::Mutex> lock(*connections_mutex);
             connections->emplace(connection.get());
         }
         return connection;
     }
 
     void read(const std::shared_ptr<Session> &session) {
+        if (!session->connection->pipelined.empty()) {
+            // next request is (partially) read already, async_read_until completes immediately if it has delimiter
+            auto &pipelined = session->connection->pipelined;
+            session->request->streambuf.commit(
+                asio::buffer_copy(session->request->streambuf.prepare(pipelined.size()), asio::buffer(pipelined)));
+            pipelined.clear();
+        }
+
         session->connection->set_timeout(config.timeout_request);
 
         session->connection->socket->async_read_until(
             session->request->streambuf,
             "\r\n\r\n",
-            [this, session](const error_code &ec, std::size_t bytes_transferred) {
+            [this, session](const error_code &ec, std::size_t /*bytes_transferred*/) {
               session->connection->cancel_timeout();
               auto lock = session->connection->handler_runner->continueLock();
               if (!lock) {
@@ -474,20 +495,19 @@ class ServerBase : public BaseServer {
               if (!ec) {
                   // request->streambuf.size() is not necessarily the same as bytes_transferred, from Boost-docs:
                   // "After a successful async_read_until operation, the streambuf may contain additional data beyond the delimiter"
-                  // The chosen solution is to extract lines from the stream directly when parsing the header. What is left of the
-                  // streambuf (maybe some bytes of the content) is appended to in the async_read-function below (for retrieving content).
-                  std::size_t num_additional_bytes = session->request->streambuf.size() - bytes_transferred;
-
-                  if (!RequestMessage::parse(session->request->content,
-                                             session->request->method,
-                                             session->request->path,
-                                             session->request->query_string,
-                                             session->request->http_version,
-                                             session->request->header)) {
+                  // Parser reads header in place and consumes exactly its bytes. What is left of the streambuf
+                  // (maybe some bytes of the content) is appended to in the async_read-function below (for retrieving content).
+                  if (!wss::http::RequestParser::parse(session->request->streambuf,
+                                                       session->request->method,
+                                                       session->request->path,
+                                                       session->request->query_string,
+                                                       session->request->http_version,
+                                                       session->request->header)) {
                       if (this->on_error)
                           this->on_error(session->request, make_error_code::make_error_code(errc::protocol_error));
                       return;
                   }
+                  std::size_t num_additional_bytes = session->request->streambuf.size();
 
                   // If content, read that as well
                   auto header_it = session->request->header.find("Content-Length");
@@ -531,6 +551,7 @@ class ServerBase : public BaseServer {
                                     this->on_error(session->request, ec);
                               });
                       } else {
+                          this->keep_pipelined(session, content_length);
                           this->find_resource(session);
                       }
                   } else if (
@@ -539,13 +560,29 @@ class ServerBase : public BaseServer {
                       auto
                           chunks_streambuf = std::make_shared<asio::streambuf>(this->config.max_request_streambuf_size);
                       this->read_chunked_transfer_encoded(session, chunks_streambuf);
-                  } else
+                  } else {
+                      this->keep_pipelined(session, 0);
                       this->find_resource(session);
+                  }
               } else if (this->on_error)
                   this->on_error(session->request, ec);
             });
     }
 
+    /// Moves bytes following request content (next pipelined requests) from request buffer to connection,
+    /// so they will be parsed by next session instead of being seen as current request content.
+    void keep_pipelined(const std::shared_ptr<Session> &session, std::size_t content_length) {
+        auto &streambuf = session->request->streambuf;
+        if (streambuf.size() <= content_length)
+            return;
+
+        const std::string buffered(asio::buffers_begin(streambuf.data()), asio::buffers_end(streambuf.data()));
+        streambuf.consume(streambuf.size());
+        streambuf.commit(asio::buffer_copy(streambuf.prepare(content_length),
+                                           asio::buffer(buffered.data(), content_length)));
+        session->connection->pipelined.assign(buffered, content_length, std::string::npos);
+    }
+
     void read_chunked_transfer_encoded(const std::shared_ptr<Session> &session,
                                        const std::shared_ptr<asio::streambuf> &chunks_streambuf) {
         session->connection->set_timeout(config.timeout_content);
@@ -652,6 +689,8 @@ class ServerBase : public BaseServer {
         if (length > 0)
             read_chunked_transfer_encoded(session, chunks_streambuf);
         else {
+            // what is left after last chunk belongs to next pipelined requests, request buffer gets decoded body
+            this->keep_pipelined(session, 0);
             if (chunks_streambuf->size() > 0) {
                 std::ostream ostream(&session->request->streambuf);
                 ostream << chunks_streambuf.get();
@@ -660,6 +699,12 @@ class ServerBase : public BaseServer {
         }
     }
 
+    void build_routes() {
+        routes.clear();
+        for (auto &regex_method : resource)
+            routes.add(regex_method.first.pattern(), regex_method.first, &regex_method.second);
+    }
+
     void find_resource(const std::shared_ptr<Session> &session) {
         // Upgrade connection
         if (on_upgrade) {
@@ -667,7 +712,7 @@ class ServerBase : public BaseServer {
             if (it != session->request->header.end()) {
                 // remove connection from connections
                 {
-                    std::unique_lock<std::mutex> lock(*connections_mutex);
+                    std::unique_lock<wss::sync::Mutex> lock(*connections_mutex);
                     auto it = connections->find(session->connection.get());
                     if (it != connections->end())
                         connections->erase(it);
@@ -678,17 +723,17 @@ class ServerBase : public BaseServer {
             }
         }
         // Find path- and method-match, and call write
-        for (auto &regex_method : resource) {
-            auto it = regex_method.second.find(session->request->method);
-            if (it != regex_method.second.end()) {
-                regexns::smatch sm_res;
-                if (regexns::regex_match(session->request->path, sm_res, regex_method.first)) {
-                    session->request->path_match = std::move(sm_res);
-                    write(session, it->second);
-                    return;
-                }
-            }
-        }
+        const bool found = routes.find(session->request->path, [this, &session](Methods *methods,
+                                                                                regexns::smatch &match) {
+          auto it = methods->find(session->request->method);
+          if (it == methods->end())
+              return false;
+          session->request->path_match = std::move(match);
+          write(session, it->second);
+          return true;
+        });
+        if (found)
+            return;
         auto it = default_resource.find(session->request->method);
         if (it != default_resource.end())
             write(session, it->second);
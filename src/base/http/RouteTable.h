@@ -0,0 +1,192 @@
+/**
+ * wsserver
+ * RouteTable.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_ROUTETABLE_H
+#define WSSERVER_ROUTETABLE_H
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../helpers/utility.hpp"
+
+namespace wss {
+namespace http {
+
+/// \brief Path dispatch table, built once from endpoint patterns before server start.
+/// Patterns are regex sources, matched against whole path (like regex_match), but only real regexes are evaluated:
+///  - literal ("^/send-message$", "/stat") is exact route: one hash lookup
+///  - literal followed by ".*" ("^/files/.*$") is prefix route, stored in trie
+///  - anything else is regex route
+/// Candidates are visited in this order: exact, prefixes from longest to shortest, regexes in insertion order.
+/// Not thread-safe for modification, find() is safe to call concurrently after table is built.
+/// \tparam T route value, usually pointer to handler(s)
+template<typename T>
+class RouteTable {
+ public:
+    enum class Kind {
+      Exact,
+      Prefix,
+      Regex
+    };
+
+    /// \brief Detects route kind of pattern
+    /// \param pattern regex source
+    /// \param literal unescaped exact path or prefix, for Exact and Prefix kinds
+    static Kind classify(const std::string &pattern, std::string &literal) {
+        static const char *metaChars = ".[]{}()*+?|^$\\";
+        literal.clear();
+
+        std::size_t i = 0;
+        const std::size_t n = pattern.size();
+        if (i < n && pattern[i] == '^') {
+            i++;
+        }
+        for (; i < n; i++) {
+            const char c = pattern[i];
+            if (c == '\\') {
+                // escaped punctuation is literal, classes like \d are not
+                if (i + 1 < n && std::strchr(metaChars, pattern[i + 1]) != nullptr) {
+                    literal += pattern[++i];
+                    continue;
+                }
+                return Kind::Regex;
+            }
+            if (std::strchr(metaChars, c) == nullptr) {
+                literal += c;
+                continue;
+            }
+
+            const std::string rest = pattern.substr(i);
+            if (rest == "$") {
+                return Kind::Exact;
+            }
+            if (rest == ".*" || rest == ".*$") {
+                return Kind::Prefix;
+            }
+            return Kind::Regex;
+        }
+        return Kind::Exact;
+    }
+
+    /// \brief Adds route
+    /// \param pattern regex source
+    /// \param regex compiled pattern, used only if pattern is real regex. Must outlive table
+    /// \param value
+    /// \return detected kind
+    Kind add(const std::string &pattern, const regexns::regex &regex, T value) {
+        std::string literal;
+        const Kind kind = classify(pattern, literal);
+        switch (kind) {
+            case Kind::Exact:
+                m_exact[literal].push_back(std::move(value));
+                break;
+            case Kind::Prefix: {
+                Node *node = &m_root;
+                for (char c: literal) {
+                    auto &child = node->children[c];
+                    if (!child) {
+                        child = std::make_unique<Node>();
+                    }
+                    node = child.get();
+                }
+                node->values.push_back(std::move(value));
+                break;
+            }
+            case Kind::Regex:
+                m_regex.emplace_back(&regex, std::move(value));
+                break;
+        }
+        return kind;
+    }
+
+    /// \brief Visits routes matching path until visitor accepts one
+    /// \param path request path. For regex routes, match results refer to it
+    /// \param visitor bool(const T &value, regexns::smatch &match), match is empty for exact and prefix routes
+    /// \return true if visitor accepted route
+    template<typename Visitor>
+    bool find(const std::string &path, Visitor &&visitor) const {
+        regexns::smatch match;
+
+        const auto exact = m_exact.find(path);
+        if (exact != m_exact.end()) {
+            for (const T &value: exact->second) {
+                if (visitor(value, match)) {
+                    return true;
+                }
+            }
+        }
+
+        if (hasPrefixes()) {
+            const Node *matched[MAX_NESTED_PREFIXES];
+            std::size_t matchedCount = 0;
+            const Node *node = &m_root;
+            std::size_t i = 0;
+            while (node != nullptr) {
+                if (!node->values.empty() && matchedCount < MAX_NESTED_PREFIXES) {
+                    matched[matchedCount++] = node;
+                }
+                if (i == path.size()) {
+                    break;
+                }
+                const auto child = node->children.find(path[i++]);
+                node = child == node->children.end() ? nullptr : child->second.get();
+            }
+            while (matchedCount > 0) {
+                for (const T &value: matched[--matchedCount]->values) {
+                    if (visitor(value, match)) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        for (const auto &route: m_regex) {
+            if (regexns::regex_match(path, match, *route.first)) {
+                if (visitor(route.second, match)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void clear() {
+        m_exact.clear();
+        m_root.children.clear();
+        m_root.values.clear();
+        m_regex.clear();
+    }
+
+ private:
+    /// \brief Matching prefixes of one path that are visited, longer ones above limit are ignored
+    static const std::size_t MAX_NESTED_PREFIXES = 16;
+
+    struct Node {
+      std::unordered_map<char, std::unique_ptr<Node>> children;
+      std::vector<T> values;
+    };
+
+    std::unordered_map<std::string, std::vector<T>> m_exact;
+    Node m_root;
+    std::vector<std::pair<const regexns::regex *, T>> m_regex;
+
+    bool hasPrefixes() const {
+        return !m_root.children.empty() || !m_root.values.empty();
+    }
+};
+
+template<typename T>
+const std::size_t RouteTable<T>::MAX_NESTED_PREFIXES;
+
+}
+}
+
+#endif //WSSERVER_ROUTETABLE_H
@@ -0,0 +1,65 @@
+/**
+ * wsserver
+ * Frame.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_FRAME_HPP
+#define WSSERVER_FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+namespace wss {
+namespace server {
+namespace websocket {
+
+/// \brief RFC 6455 frame encoding helpers, used by connection send and read paths
+/// See http://tools.ietf.org/html/rfc6455#section-5.2
+class Frame {
+ public:
+    /// \brief Writes header of unmasked (server to client) frame
+    /// \param out header stream
+    /// \param finRsvOpcode 129=one fragment, text, 130=one fragment, binary, 136=close connection
+    /// \param length payload length
+    static void writeHeader(std::ostream &out, uint8_t finRsvOpcode, std::size_t length) {
+        out.put(static_cast<char>(finRsvOpcode));
+        // Unmasked (first length byte<128)
+        if (length >= 126) {
+            std::size_t numBytes;
+            if (length > 0xffff) {
+                numBytes = 8;
+                out.put(127);
+            } else {
+                numBytes = 2;
+                out.put(126);
+            }
+
+            for (std::size_t c = numBytes - 1; c != static_cast<std::size_t>(-1); c--)
+                out.put(static_cast<char>((length >> (8 * c)) % 256));
+        } else {
+            out.put(static_cast<char>(length));
+        }
+    }
+
+    /// \brief Reads masked (client to server) payload and writes it unmasked
+    /// \param in raw payload
+    /// \param out message
+    /// \param length payload length
+    /// \param mask 4 bytes masking key
+    static void unmask(std::istream &in, std::ostream &out, std::size_t length, const uint8_t *mask) {
+        for (std::size_t c = 0; c < length; c++) {
+            out.put(in.get() ^ mask[c % 4]);
+        }
+    }
+};
+
+}
+}
+}
+
+#endif //WSSERVER_FRAME_HPP
@@ -12,11 +12,17 @@
 
 #include "../BaseServer.h"
 #include "../SocketLayerWrapper.hpp"
+#include "../LockProfiler.h"
+#include "../Probes.h"
+#include "Frame.hpp"
+#include "../http/HttpParser.h"
+#include "../http/RouteTable.h"
 
 #include "crypto.hpp"
 #include "utility.hpp"
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <limits>
 #include <list>
@@ -67,6 +73,9 @@ class SocketServerBase : public BaseServer {
         std::size_t size() const noexcept {
             return streambuf.size();
         }
+
+        /// Time when stream left connection send queue and its write started
+        std::chrono::steady_clock::time_point writeStartedAt;
     };
 
     class Connection : public std::enable_shared_from_this<Connection> {
@@ -79,6 +88,7 @@ class SocketServerBase : public BaseServer {
             : socket(std::move(socket)),
               closed(false),
               id(0),
+              uniqueId(0),
               timeoutIdle(0),
               strand(this->socket->get_io_service()) { }
 
@@ -157,8 +167,8 @@ class SocketServerBase : public BaseServer {
 
         /// \brief Socket must be unique_ptr since asio::ssl::stream<asio::ip::tcp::socket> is not movable
         std::unique_ptr<SocketLayerWrapper> socket;
-        std::mutex socketCloseMutex;
-        std::mutex readIdMutex;
+        wss::sync::Mutex socketCloseMutex{"ws_connection_close"};
+        wss::sync::Mutex readIdMutex{"ws_connection_read_id"};
         std::list<SendData> sendQueue;
         asio::streambuf readBuffer;
         std::atomic<bool> closed;
@@ -167,13 +177,13 @@ class SocketServerBase : public BaseServer {
         uint64_t uniqueId;
         long timeoutIdle;
         std::unique_ptr<asio::steady_timer> timer;
-        std::mutex timerMutex;
+        wss::sync::Mutex timerMutex{"ws_connection_timer"};
         asio::io_service::strand strand;
 
         void close() noexcept {
             ErrorCode ec;
             /// The following operations seems to be needed to run sequentially
-            std::unique_lock<std::mutex> lock(socketCloseMutex);
+            std::unique_lock<wss::sync::Mutex> lock(socketCloseMutex);
             socket->lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both, ec);
             socket->lowest_layer().close(ec);
         }
@@ -185,7 +195,7 @@ class SocketServerBase : public BaseServer {
                 seconds = timeoutIdle;
             }
 
-            std::unique_lock<std::mutex> lock(timerMutex);
+            std::unique_lock<wss::sync::Mutex> lock(timerMutex);
 
             if (seconds == 0) {
                 timer = nullptr;
@@ -210,7 +220,7 @@ class SocketServerBase : public BaseServer {
         }
 
         void timeoutCancel() noexcept {
-            std::unique_lock<std::mutex> lock(timerMutex);
+            std::unique_lock<wss::sync::Mutex> lock(timerMutex);
             if (timer) {
                 ErrorCode ec;
                 timer->cancel(ec);
@@ -243,6 +253,7 @@ class SocketServerBase : public BaseServer {
 
               std::vector<asio::const_buffer> bufs(2);
               const SendData data = ((SendData) *self->sendQueue.begin());
+              data.messageStream->writeStartedAt = std::chrono::steady_clock::now();
               // headers
               bufs.push_back(data.headerStream->streambuf.data());
               // body
@@ -299,23 +310,7 @@ class SocketServerBase : public BaseServer {
             std::shared_ptr<SendStream> headerStream = std::make_shared<SendStream>();
             std::size_t length = messageStream->size();
 
-            headerStream->put(static_cast<char>(fin_rsv_opcode));
-            // Unmasked (first length byte<128)
-            if (length >= 126) {
-                std::size_t numBytes;
-                if (length > 0xffff) {
-                    numBytes = 8;
-                    headerStream->put(127);
-                } else {
-                    numBytes = 2;
-                    headerStream->put(126);
-                }
-
-                for (std::size_t c = numBytes - 1; c != static_cast<std::size_t>(-1); c--)
-                    headerStream->put(static_cast<char>((length >> (8 * c)) % 256));
-            } else {
-                headerStream->put(static_cast<char>(length));
-            }
+            Frame::writeHeader(*headerStream, fin_rsv_opcode, length);
 
             const std::shared_ptr<Connection> self = this->shared_from_this();
             strand.post([self, headerStream, messageStream, callback]() {
@@ -352,6 +347,8 @@ class SocketServerBase : public BaseServer {
 
      public:
         unsigned char fin_rsv_opcode;
+        /// Time when frame payload was completely read from socket
+        std::chrono::steady_clock::time_point receivedAt;
         std::size_t size() noexcept {
             return length;
         }
@@ -380,7 +377,7 @@ class SocketServerBase : public BaseServer {
 
      private:
         std::unordered_set<std::shared_ptr<Connection>> connections;
-        std::mutex connectionsMutex;
+        wss::sync::Mutex connectionsMutex{"ws_endpoint_connections"};
 
      public:
         std::function<void(std::shared_ptr<Connection>)> onOpen;
@@ -389,7 +386,7 @@ class SocketServerBase : public BaseServer {
         std::function<void(std::shared_ptr<Connection>, const ErrorCode &)> onError;
 
         std::unordered_set<std::shared_ptr<Connection>> getConnections() noexcept {
-            std::unique_lock<std::mutex> lock(connectionsMutex);
+            std::unique_lock<wss::sync::Mutex> lock(connectionsMutex);
             auto copy = connections;
             return copy;
         }
@@ -444,6 +441,10 @@ class SocketServerBase : public BaseServer {
         acceptor->bind(endpoint);
         acceptor->listen();
 
+        routes.clear();
+        for (auto &pair : this->endpoint) {
+            routes.add(pair.first.pattern(), pair.first, &pair.second);
+        }
         accept();
 
         if (internalIoService) {
@@ -469,7 +470,7 @@ class SocketServerBase : public BaseServer {
             acceptor->close(ec);
 
             for (auto &pair : endpoint) {
-                std::unique_lock<std::mutex> lock(pair.second.connectionsMutex);
+                std::unique_lock<wss::sync::Mutex> lock(pair.second.connectionsMutex);
                 for (auto &connection : pair.second.connections) {
                     connection->close();
                 }
@@ -524,6 +525,8 @@ class SocketServerBase : public BaseServer {
     Config config;
     /// Warning: do not add or remove endpoints after start() is called
     std::map<RegexOrderable, Endpoint> endpoint;
+    /// Built from endpoint on start
+    wss::http::RouteTable<Endpoint *> routes;
 
     bool internalIoService = false;
 
@@ -548,13 +551,12 @@ class SocketServerBase : public BaseServer {
               if (!lock)
                   return;
               if (!ec) {
-                  std::istream stream(&connection->readBuffer);
-                  if (RequestMessage::parse(stream,
-                                            connection->method,
-                                            connection->path,
-                                            connection->queryString,
-                                            connection->httpVersion,
-                                            connection->header))
+                  if (wss::http::RequestParser::parse(connection->readBuffer,
+                                                      connection->method,
+                                                      connection->path,
+                                                      connection->queryString,
+                                                      connection->httpVersion,
+                                                      connection->header))
 
                       // after success incoming handshake, sending server handshake
                       handshakeWrite(connection);
@@ -563,33 +565,31 @@ class SocketServerBase : public BaseServer {
     }
 
     void handshakeWrite(const std::shared_ptr<Connection> &connection) {
-        for (auto &regexEndpoint : endpoint) {
-            regexns::smatch pathMatch;
-            if (regexns::regex_match(connection->path, pathMatch, regexEndpoint.first)) {
-                auto writeBuffer = std::make_shared<asio::streambuf>();
-
-                if (connection->handshakeGenerate(writeBuffer)) {
-                    connection->pathMatch = std::move(pathMatch);
-                    connection->timeoutSet(config.timeoutRequest);
-                    connection->socket->async_write(
-                        *writeBuffer,
-                        [this, connection, writeBuffer, &regexEndpoint](const ErrorCode &ec, std::size_t) {
-                          connection->timeoutCancel();
-                          auto lock = connection->handlerRunner->continueLock();
-                          if (!lock) {
-                              return;
-                          }
+        routes.find(connection->path, [this, &connection](Endpoint *matched, regexns::smatch &pathMatch) {
+          auto writeBuffer = std::make_shared<asio::streambuf>();
 
-                          if (!ec) {
-                              onConnectionOpen(connection, regexEndpoint.second);
-                              readMessage(connection, regexEndpoint.second);
-                          } else
-                              onConnectionError(connection, regexEndpoint.second, ec);
-                        });
-                }
-                return;
-            }
-        }
+          if (connection->handshakeGenerate(writeBuffer)) {
+              connection->pathMatch = std::move(pathMatch);
+              connection->timeoutSet(config.timeoutRequest);
+              connection->socket->async_write(
+                  *writeBuffer,
+                  [this, connection, writeBuffer, matched](const ErrorCode &ec, std::size_t) {
+                    connection->timeoutCancel();
+                    auto lock = connection->handlerRunner->continueLock();
+                    if (!lock) {
+                        return;
+                    }
+
+                    if (!ec) {
+                        WSS_PROBE(handshake_done, connection.get(), connection->path.c_str());
+                        onConnectionOpen(connection, *matched);
+                        readMessage(connection, *matched);
+                    } else
+                        onConnectionError(connection, *matched, ec);
+                  });
+          }
+          return true;
+        });
     }
 
     void readMessage(const std::shared_ptr<Connection> &connection, Endpoint &endpoint) const {
@@ -733,6 +733,7 @@ class SocketServerBase : public BaseServer {
                     return;
                 }
 
+                const auto receivedAt = std::chrono::steady_clock::now();
                 std::istream rawMessageData(&connection->readBuffer);
 
                 // Read mask
@@ -742,11 +743,11 @@ class SocketServerBase : public BaseServer {
                 std::shared_ptr<Message> message(new Message());
                 message->length = length;
                 message->fin_rsv_opcode = fin_rsv_opcode;
+                message->receivedAt = receivedAt;
 
                 std::ostream messageDataOutStream(&message->streambuf);
-                for (std::size_t c = 0; c < length; c++) {
-                    messageDataOutStream.put(rawMessageData.get() ^ mask[c % 4]);
-                }
+                Frame::unmask(rawMessageData, messageDataOutStream, length, &mask[0]);
+                WSS_PROBE(frame_received, connection->getId(), connection->getUniqueId(), length, fin_rsv_opcode);
 
                 // If connection close
                 if ((fin_rsv_opcode & 0x0f) == 8) {
@@ -788,7 +789,7 @@ class SocketServerBase : public BaseServer {
         connection->timeoutSet();
 
         {
-            std::unique_lock<std::mutex> lock(endpoint.connectionsMutex);
+            std::unique_lock<wss::sync::Mutex> lock(endpoint.connectionsMutex);
             endpoint.connections.insert(connection);
         }
 
@@ -805,7 +806,7 @@ class SocketServerBase : public BaseServer {
         connection->timeoutSet();
 
         {
-            std::unique_lock<std::mutex> lock(endpoint.connectionsMutex);
+            std::unique_lock<wss::sync::Mutex> lock(endpoint.connectionsMutex);
             endpoint.connections.erase(connection);
         }
 
@@ -821,7 +822,7 @@ class SocketServerBase : public BaseServer {
         connection->timeoutSet();
 
         {
-            std::unique_lock<std::mutex> lock(endpoint.connectionsMutex);
+            std::unique_lock<wss::sync::Mutex> lock(endpoint.connectionsMutex);
             endpoint.connections.erase(connection);
         }
 
@@ -849,6 +850,7 @@ class SocketServer : public SocketServerBase {
               accept();
 
           if (!ec) {
+              WSS_PROBE(connection_accept, connection.get());
               asio::ip::tcp::no_delay option(true);
               connection->socket->set_option(option);
 
@@ -914,6 +916,7 @@ class SocketServerSecure : public SocketServerBase {
           }
 
           if (!ec) {
+              WSS_PROBE(connection_accept, connection.get());
               asio::ip::tcp::no_delay option(true);
               connection->socket->lowest_layer().set_option(option);
 
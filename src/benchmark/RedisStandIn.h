@@ -0,0 +1,188 @@
+/**
+ * wsserver
+ * RedisStandIn.h
+ *
+ * In-process redis stand-in for redis target benchmark and tests.
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_REDISSTANDIN_H
+#define WSSERVER_REDISSTANDIN_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <boost/asio.hpp>
+
+namespace wss {
+namespace benchmark {
+
+/// \brief Minimal RESP server: parses command arrays and replies integer 1 to each of them
+class RedisStandIn {
+ public:
+    using Command = std::vector<std::string>;
+
+    /// \param port 0 - any free port. Same port may be bound again after stop(), to emulate redis restart
+    /// \param record keep received commands for getCommands()
+    explicit RedisStandIn(uint16_t port = 0, bool record = false) :
+        m_acceptor(m_ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)),
+        m_record(record),
+        m_commands(0) {
+    }
+
+    ~RedisStandIn() {
+        stop();
+    }
+
+    uint16_t port() const {
+        return m_port;
+    }
+
+    size_t commands() const {
+        return m_commands;
+    }
+
+    /// \return received commands in order, if recording is on
+    std::vector<Command> getCommands() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_received;
+    }
+
+    void start() {
+        m_port = m_acceptor.local_endpoint().port();
+        m_acceptThread = std::thread([this] {
+          while (true) {
+              auto socket = std::make_shared<boost::asio::ip::tcp::socket>(m_ioService);
+              boost::system::error_code ec;
+              m_acceptor.accept(*socket, ec);
+              if (ec) {
+                  return;
+              }
+              socket->set_option(boost::asio::ip::tcp::no_delay(true));
+              std::lock_guard<std::mutex> lock(m_mutex);
+              m_sockets.push_back(socket);
+              m_threads.emplace_back(&RedisStandIn::serve, this, socket);
+          }
+        });
+    }
+
+    /// \brief Drop all clients and stop listening, as if redis went down
+    void stop() {
+        boost::system::error_code ec;
+        if (m_acceptor.is_open()) {
+            // close() alone does not wake blocking accept
+            ::shutdown(m_acceptor.native_handle(), SHUT_RDWR);
+        }
+        if (m_acceptThread.joinable()) {
+            m_acceptThread.join();
+        }
+        m_acceptor.close(ec);
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &socket: m_sockets) {
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            }
+            threads.swap(m_threads);
+        }
+        for (auto &t: threads) {
+            if (t.joinable()) t.join();
+        }
+        m_sockets.clear();
+    }
+
+ private:
+    boost::asio::io_service m_ioService;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    uint16_t m_port = 0;
+    const bool m_record;
+    std::atomic_size_t m_commands;
+    mutable std::mutex m_mutex;
+    std::thread m_acceptThread;
+    std::vector<std::thread> m_threads;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> m_sockets;
+    std::vector<Command> m_received;
+
+    void serve(std::shared_ptr<boost::asio::ip::tcp::socket> socket) {
+        std::string buffer;
+        std::vector<char> chunk(64 * 1024);
+        boost::system::error_code ec;
+        while (true) {
+            const size_t read = socket->read_some(boost::asio::buffer(chunk), ec);
+            if (ec) {
+                return;
+            }
+            buffer.append(chunk.data(), read);
+
+            size_t complete = 0, consumed = 0;
+            Command command;
+            while (parseCommand(buffer, consumed, m_record ? &command : nullptr)) {
+                complete++;
+                if (m_record) {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_received.push_back(std::move(command));
+                    command.clear();
+                }
+            }
+            buffer.erase(0, consumed);
+
+            if (complete > 0) {
+                m_commands += complete;
+                std::string replies;
+                replies.reserve(complete * 4);
+                for (size_t i = 0; i < complete; i++) {
+                    replies += ":1\r\n";
+                }
+                boost::asio::write(*socket, boost::asio::buffer(replies), ec);
+                if (ec) {
+                    return;
+                }
+            }
+        }
+    }
+
+    /// \brief Parse one "*N\r\n($len\r\n<bytes>\r\n){N}" command starting at offset
+    /// \param out receives command arguments if not null
+    /// \return false if command is not complete yet
+    static bool parseCommand(const std::string &buf, size_t &offset, Command *out) {
+        size_t pos = offset;
+        size_t items = 0;
+        if (!readNumber(buf, pos, '*', items)) return false;
+        Command command;
+        for (size_t i = 0; i < items; i++) {
+            size_t len = 0;
+            if (!readNumber(buf, pos, '$', len)) return false;
+            if (buf.size() < pos + len + 2) return false;
+            if (out) {
+                command.push_back(buf.substr(pos, len));
+            }
+            pos += len + 2;
+        }
+        offset = pos;
+        if (out) {
+            *out = std::move(command);
+        }
+        return true;
+    }
+
+    static bool readNumber(const std::string &buf, size_t &pos, char prefix, size_t &out) {
+        if (pos >= buf.size() || buf[pos] != prefix) return false;
+        const size_t end = buf.find("\r\n", pos);
+        if (end == std::string::npos) return false;
+        out = std::stoul(buf.substr(pos + 1, end - pos - 1));
+        pos = end + 2;
+        return true;
+    }
+};
+
+}
+}
+
+#endif //WSSERVER_REDISSTANDIN_H
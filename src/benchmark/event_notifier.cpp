@@ -0,0 +1,264 @@
+/**
+ * wsserver
+ * event_notifier.cpp
+ *
+ * Event notifier topology benchmark. Drives notifier with synthetic payloads against in-process HTTP sink
+ * (postback target) and reports delivered events per second for each combination of
+ * ingest threads, delivery workers and target pinned workers.
+ *
+ * Example: wssbench-events -n 100000 --ingest 1,2,4 --workers 0,16,64 --pinned 0,32
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <toolboxpp.h>
+#include "cmdline.hpp"
+#include "json.hpp"
+#include "../base/Settings.hpp"
+#include "../chat/ChatServer.h"
+#include "../event/EventNotifier.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+/// \brief Keep-alive HTTP session: reads request headers and body (by Content-Length), replies 200
+class SinkSession : public std::enable_shared_from_this<SinkSession> {
+ public:
+    SinkSession(asio::io_service &ioService, std::atomic_size_t &requests) :
+        m_socket(ioService),
+        m_requests(requests) {
+    }
+
+    tcp::socket &socket() {
+        return m_socket;
+    }
+
+    void readHeaders() {
+        auto self = shared_from_this();
+        asio::async_read_until(m_socket, m_buffer, "\r\n\r\n", [this, self](boost::system::error_code ec, size_t n) {
+          if (ec) {
+              return;
+          }
+
+          std::string headers(asio::buffers_begin(m_buffer.data()), asio::buffers_begin(m_buffer.data()) + n);
+          m_buffer.consume(n);
+          readBody(contentLength(headers));
+        });
+    }
+
+ private:
+    tcp::socket m_socket;
+    asio::streambuf m_buffer;
+    std::atomic_size_t &m_requests;
+
+    static size_t contentLength(const std::string &headers) {
+        std::string lower(headers);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        const size_t pos = lower.find("content-length:");
+        if (pos == std::string::npos) {
+            return 0;
+        }
+        return std::stoul(lower.substr(pos + 15));
+    }
+
+    void readBody(size_t length) {
+        if (m_buffer.size() >= length) {
+            m_buffer.consume(length);
+            respond();
+            return;
+        }
+
+        auto self = shared_from_this();
+        asio::async_read(m_socket, m_buffer, asio::transfer_exactly(length - m_buffer.size()),
+                         [this, self, length](boost::system::error_code ec, size_t) {
+                           if (ec) {
+                               return;
+                           }
+                           m_buffer.consume(length);
+                           respond();
+                         });
+    }
+
+    void respond() {
+        static const std::string response =
+            "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+        m_requests++;
+
+        auto self = shared_from_this();
+        asio::async_write(m_socket, asio::buffer(response), [this, self](boost::system::error_code ec, size_t) {
+          if (!ec) {
+              readHeaders();
+          }
+        });
+    }
+};
+
+/// \brief Local HTTP server, that accepts any request
+class HttpSink {
+ public:
+    explicit HttpSink(size_t threads) :
+        m_work(m_ioService),
+        m_acceptor(m_ioService, tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+        m_requests(0) {
+        accept();
+        for (size_t i = 0; i < std::max((size_t) 1, threads); i++) {
+            m_threads.emplace_back([this] { m_ioService.run(); });
+        }
+    }
+
+    ~HttpSink() {
+        m_ioService.stop();
+        for (auto &t: m_threads) {
+            t.join();
+        }
+    }
+
+    uint16_t port() const {
+        return m_acceptor.local_endpoint().port();
+    }
+
+    size_t requests() const {
+        return m_requests;
+    }
+
+ private:
+    asio::io_service m_ioService;
+    asio::io_service::work m_work;
+    tcp::acceptor m_acceptor;
+    std::atomic_size_t m_requests;
+    std::vector<std::thread> m_threads;
+
+    void accept() {
+        auto session = std::make_shared<SinkSession>(m_ioService, m_requests);
+        m_acceptor.async_accept(session->socket(), [this, session](boost::system::error_code ec) {
+          if (!ec) {
+              session->readHeaders();
+          }
+          accept();
+        });
+    }
+};
+
+static std::vector<uint32_t> parseList(const std::string &list) {
+    std::vector<uint32_t> out;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back((uint32_t) std::stoul(item));
+        }
+    }
+    return out;
+}
+
+struct RunResult {
+  size_t delivered;
+  double seconds;
+};
+
+static RunResult run(uint16_t port,
+                     size_t events,
+                     size_t producers,
+                     uint32_t ingest,
+                     uint32_t workers,
+                     uint32_t pinned,
+                     uint32_t limit,
+                     const std::function<size_t()> &delivered) {
+    auto &settings = wss::Settings::get().event;
+    settings.enableRetry = false;
+    settings.ingestThreads = ingest;
+    settings.deliveryWorkers = workers;
+
+    nlohmann::json target;
+    target["type"] = "postback";
+    target["url"] = fmt::format("http://127.0.0.1:{0}/sink", port);
+    target["workers"] = pinned;
+    target["circuitBreaker"] = {{"enabled", false}};
+    target["concurrency"] = {{"initialLimit", limit}, {"maxLimit", limit}};
+
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    wss::event::EventNotifier notifier(ws);
+    notifier.addTarget(target);
+    notifier.runService();
+
+    const size_t before = delivered();
+    const auto begin = std::chrono::steady_clock::now();
+
+    std::atomic_size_t next(0);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < producers; i++) {
+        threads.emplace_back([&] {
+          while (next++ < events) {
+              notifier.publish(wss::MessagePayload(1, 2, std::string(256, 'x')));
+          }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    const auto deadline = begin + std::chrono::seconds(120);
+    while (delivered() - before < events && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    RunResult result{delivered() - before,
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count()};
+
+    // sink counts request before response, let senders (detached threads in thread-per-send mode) finish
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    notifier.stopService();
+    notifier.joinThreads();
+    return result;
+}
+
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<size_t>("events", 'n', "Events per run", false, 50000);
+    args.add<size_t>("producers", 'p', "Threads publishing events (as chat server workers)", false, 4);
+    args.add<std::string>("ingest", 'i', "Comma-separated list of ingest threads", false, "1,2,4,8");
+    args.add<std::string>("workers", 'w', "Comma-separated list of delivery workers (0 - thread per send)", false, "0,16,64");
+    args.add<std::string>("pinned", 't', "Comma-separated list of target dedicated workers (0 - not pinned)", false, "0");
+    args.add<uint32_t>("limit", 'l', "Target concurrency limit", false, 64);
+    args.add<size_t>("sink-threads", 's', "In-process HTTP sink threads", false, 4);
+    args.parse_check(argc, argv);
+
+    toolboxpp::Logger::get().setVerbosity(0);
+
+    HttpSink sink(args.get<size_t>("sink-threads"));
+    const std::function<size_t()> delivered = [&sink] { return sink.requests(); };
+
+    const size_t events = args.get<size_t>("events");
+    const size_t producers = std::max((size_t) 1, args.get<size_t>("producers"));
+
+    cout << "ingest  workers  pinned  delivered  seconds  events/s" << endl;
+    for (uint32_t ingest: parseList(args.get<std::string>("ingest"))) {
+        for (uint32_t workers: parseList(args.get<std::string>("workers"))) {
+            for (uint32_t pinned: parseList(args.get<std::string>("pinned"))) {
+                const RunResult r = run(sink.port(), events, producers, ingest, workers, pinned,
+                                        args.get<uint32_t>("limit"), delivered);
+                cout << fmt::format("{0:>6}  {1:>7}  {2:>6}  {3:>9}  {4:>7.2f}  {5:>8}",
+                                    ingest, workers, pinned, r.delivered, r.seconds,
+                                    (size_t) (r.delivered / r.seconds))
+                     << endl;
+            }
+        }
+    }
+
+    return 0;
+}
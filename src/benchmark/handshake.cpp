@@ -0,0 +1,174 @@
+/**
+ * wsserver
+ * handshake.cpp
+ *
+ * WebSocket handshake benchmark. First measures request head parsing alone: legacy istream parser
+ * (utils::RequestMessage) against in-place wss::http::RequestParser. Then starts in-process chat server and runs
+ * reconnect storm: every client thread connects, sends upgrade request, waits for "101" and drops connection.
+ *
+ * Example: wssbench-handshake -n 50000 -c 32
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <fmt/format.h>
+#include <toolboxpp.h>
+#include "cmdline.hpp"
+#include "../base/http/HttpParser.h"
+#include "../chat/ChatServer.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+static std::string buildRequest(size_t id) {
+    return fmt::format("GET /chat?id={0} HTTP/1.1\r\n"
+                       "Host: 127.0.0.1\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n"
+                       "Origin: http://127.0.0.1\r\n"
+                       "User-Agent: wssbench-handshake\r\n"
+                       "\r\n", id);
+}
+
+template<typename Parse>
+static double measureParser(size_t iterations, Parse &&parse) {
+    const std::string request = buildRequest(1);
+    const auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        asio::streambuf buffer;
+        buffer.commit(asio::buffer_copy(buffer.prepare(request.size()), asio::buffer(request)));
+        if (!parse(buffer)) {
+            cerr << "Parse failed" << endl;
+            return 0;
+        }
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / iterations;
+}
+
+static void runParsers(size_t iterations) {
+    std::string method, path, query, version;
+    wss::utils::CaseInsensitiveMultimap header;
+
+    const double legacy = measureParser(iterations, [&](asio::streambuf &buffer) {
+      std::istream stream(&buffer);
+      return wss::utils::RequestMessage::parse(stream, method, path, query, version, header);
+    });
+    const double inplace = measureParser(iterations, [&](asio::streambuf &buffer) {
+      return wss::http::RequestParser::parse(buffer, method, path, query, version, header);
+    });
+    const double views = measureParser(iterations, [&](asio::streambuf &buffer) {
+      wss::http::RequestView view;
+      std::size_t consumed = 0;
+      const auto data = buffer.data();
+      return wss::http::RequestParser::parse(asio::buffer_cast<const char *>(data), asio::buffer_size(data),
+                                             view, consumed) == wss::http::RequestParser::Status::Complete;
+    });
+
+    cout << "parser               ns/request" << endl;
+    cout << fmt::format("istream (legacy)     {0:>10.1f}", legacy) << endl;
+    cout << fmt::format("in-place + strings   {0:>10.1f}", inplace) << endl;
+    cout << fmt::format("in-place views only  {0:>10.1f}", views) << endl;
+}
+
+static bool waitForServer(uint16_t port) {
+    asio::io_service ioService;
+    const tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    for (int i = 0; i < 500; i++) {
+        tcp::socket socket(ioService);
+        boost::system::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static void runStorm(uint16_t port, size_t handshakes, size_t connections) {
+    const tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    std::atomic_size_t next(0), succeeded(0), failed(0);
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < connections; i++) {
+        clients.emplace_back([&] {
+          asio::io_service ioService;
+          size_t n;
+          while ((n = next++) < handshakes) {
+              try {
+                  tcp::socket socket(ioService);
+                  socket.connect(endpoint);
+                  asio::write(socket, asio::buffer(buildRequest(n % 100000 + 1)));
+
+                  asio::streambuf response;
+                  asio::read_until(socket, response, "\r\n\r\n");
+                  const std::string status(asio::buffers_begin(response.data()),
+                                           asio::buffers_begin(response.data()) + 12);
+                  if (status == "HTTP/1.1 101") {
+                      succeeded++;
+                  } else {
+                      failed++;
+                  }
+              } catch (const std::exception &) {
+                  failed++;
+              }
+          }
+        });
+    }
+    for (auto &c: clients) {
+        c.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    cout << "connections  succeeded  failed  seconds  handshakes/s" << endl;
+    cout << fmt::format("{0:>11}  {1:>9}  {2:>6}  {3:>7.2f}  {4:>12}",
+                        connections, (size_t) succeeded, (size_t) failed, seconds, (size_t) (succeeded / seconds))
+         << endl;
+}
+
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<size_t>("handshakes", 'n', "Handshakes in reconnect storm", false, 50000);
+    args.add<size_t>("connections", 'c', "Client threads", false, 32);
+    args.add<size_t>("parse", 'i', "Parser iterations (0 - skip parser comparison)", false, 500000);
+    args.add<uint16_t>("port", 'p', "WebSocket server port", false, 18093);
+    args.parse_check(argc, argv);
+
+    toolboxpp::Logger::get().setVerbosity(0);
+
+    if (args.get<size_t>("parse") > 0) {
+        runParsers(args.get<size_t>("parse"));
+        cout << endl;
+    }
+
+    const auto port = args.get<uint16_t>("port");
+    wss::ChatServer ws("127.0.0.1", port, "^/chat$");
+    ws.setAuth({{"type", "noauth"}});
+    ws.runService();
+    if (!waitForServer(port)) {
+        cerr << "WebSocket server is not started on port " << port << endl;
+        return 1;
+    }
+
+    runStorm(port, args.get<size_t>("handshakes"), std::max((size_t) 1, args.get<size_t>("connections")));
+
+    ws.stopService();
+    ws.joinThreads();
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * wsserver
+ * local_targets.cpp
+ *
+ * Throughput benchmark for event notifier local targets: unixsocket and ndjson.
+ * For unixsocket starts in-process reader, that parses length-prefixed frames and counts them.
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include <toolboxpp.h>
+#include "cmdline.hpp"
+#include "json.hpp"
+#include "../event/UnixSocketTarget.h"
+#include "../event/NdjsonFileTarget.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace asio = boost::asio;
+
+/// \brief Accepts single connection and counts length-prefixed frames
+class FrameReader {
+ public:
+    explicit FrameReader(const std::string &path) :
+        m_acceptor(m_ioService),
+        m_socket(m_ioService),
+        m_frames(0) {
+        ::unlink(path.c_str());
+        asio::local::stream_protocol::endpoint endpoint(path);
+        m_acceptor.open(endpoint.protocol());
+        m_acceptor.bind(endpoint);
+        m_acceptor.listen();
+    }
+
+    ~FrameReader() {
+        boost::system::error_code ec;
+        m_acceptor.close(ec);
+        m_socket.shutdown(asio::local::stream_protocol::socket::shutdown_both, ec);
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    size_t frames() const {
+        return m_frames;
+    }
+
+    void start() {
+        m_thread = std::thread([this] {
+          boost::system::error_code ec;
+          m_acceptor.accept(m_socket, ec);
+          if (ec) {
+              return;
+          }
+
+          std::string buffer;
+          std::vector<char> chunk(256 * 1024);
+          while (true) {
+              const size_t read = m_socket.read_some(asio::buffer(chunk), ec);
+              if (ec) {
+                  return;
+              }
+              buffer.append(chunk.data(), read);
+
+              size_t pos = 0, complete = 0;
+              while (buffer.size() - pos >= 4) {
+                  const auto *p = (const unsigned char *) buffer.data() + pos;
+                  const size_t len = ((size_t) p[0] << 24) | ((size_t) p[1] << 16) | ((size_t) p[2] << 8) | p[3];
+                  if (buffer.size() - pos - 4 < len) {
+                      break;
+                  }
+                  pos += 4 + len;
+                  complete++;
+              }
+              buffer.erase(0, pos);
+              m_frames += complete;
+          }
+        });
+    }
+
+ private:
+    asio::io_service m_ioService;
+    asio::local::stream_protocol::acceptor m_acceptor;
+    asio::local::stream_protocol::socket m_socket;
+    std::atomic_size_t m_frames;
+    std::thread m_thread;
+};
+
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<std::string>("target", 't', "unixsocket or ndjson", false, "unixsocket");
+    args.add<size_t>("events", 'n', "Total events to send", false, 1000000);
+    args.add<size_t>("senders", 's', "Parallel sender threads", false, 1);
+    args.add<std::string>("path", 'p', "Socket or file path", false, "/tmp/wssbench-target");
+    args.add<bool>("durable", 'd', "ndjson: wait for fsync of group", false, false);
+    args.add<long>("window", 'w', "ndjson: group commit window, milliseconds", false, 5);
+    args.parse_check(argc, argv);
+
+    toolboxpp::Logger::get().setVerbosity(0);
+
+    const std::string type = args.get<std::string>("target");
+    const std::string path = args.get<std::string>("path");
+
+    std::unique_ptr<FrameReader> reader;
+    nlohmann::json config;
+    config["type"] = type;
+    config["path"] = path;
+    config["maxBuffered"] = 1000000;
+    if (type == "unixsocket") {
+        reader = std::make_unique<FrameReader>(path);
+        reader->start();
+    } else {
+        ::unlink(path.c_str());
+        config["durable"] = args.get<bool>("durable");
+        config["fsyncIntervalMs"] = args.get<long>("window");
+        config["maxFileSizeBytes"] = 1024L * 1024L * 1024L;
+    }
+
+    const size_t total = args.get<size_t>("events");
+    const size_t senders = std::max((size_t) 1, args.get<size_t>("senders"));
+    const wss::event::EventPtr event =
+        std::make_shared<const wss::event::Event>(wss::MessagePayload(1, 2, std::string(256, 'x')));
+
+    std::atomic_size_t next(0), ok(0), failed(0);
+    std::chrono::steady_clock::time_point begin;
+    {
+        std::unique_ptr<wss::event::Target> target;
+        if (type == "unixsocket") {
+            target = std::make_unique<wss::event::UnixSocketTarget>(config);
+        } else {
+            target = std::make_unique<wss::event::NdjsonFileTarget>(config);
+        }
+        if (!target->isValid()) {
+            cerr << target->getErrorMessage() << endl;
+            return 1;
+        }
+
+        begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < senders; i++) {
+            workers.emplace_back([&] {
+              std::string error;
+              while (next++ < total) {
+                  if (target->send(event, error)) {
+                      ok++;
+                  } else {
+                      failed++;
+                  }
+              }
+            });
+        }
+        for (auto &w: workers) {
+            w.join();
+        }
+
+        // events are counted as delivered when reader received them
+        while (reader && reader->frames() < ok) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // ndjson target flushes rest of buffer on destruction
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    cout
+        << "               Target:      " << type << endl
+        << "          Events sent:      " << ok << endl
+        << "        Events failed:      " << failed << endl
+        << "                 Time:      " << seconds << "s" << endl
+        << "           Throughput:      " << (size_t) (ok / seconds) << " events/s" << endl;
+
+    ::unlink(path.c_str());
+    return failed > 0 ? 1 : 0;
+}
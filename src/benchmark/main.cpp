@@ -1,305 +1,536 @@
+/**
+ * wsserver
+ * main.cpp
+ *
+ * Open-loop WebSocket load generator. Messages are scheduled at fixed arrival rate, independently of how fast
+ * server answers, and every latency is measured from the scheduled (intended) send time, not from the moment
+ * message was actually written. So if server (or client) stalls, queued messages are accounted with the time they
+ * waited (coordinated omission correction). Each message carries its intended send time, recipients (connected
+ * to the same process) measure end-to-end delivery latency from it.
+ *
+ * Result is printed (or written to --output) as JSON for regression tracking.
+ *
+ * Example: wssbench -e localhost:8085 -c 200 -r 5000 -d 30 --fanout 2 --payload uniform:64-4096
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
 #include <thread>
 #include <vector>
-#include <sstream>
-#include <boost/thread/thread.hpp>
 #include <boost/asio/io_service.hpp>
-#include <unordered_set>
-#include <csignal>
 #include <toolboxpp.h>
 #include <client_wss.hpp>
 
 #include "client_ws.hpp"
+#include "cmdline.hpp"
 #include "json.hpp"
 
-using namespace std::placeholders;
-using namespace boost;
-using WsClient = SimpleWeb::SocketClient<SimpleWeb::WSS>;
-using WsConnectionPtr = std::shared_ptr<WsClient::Connection>;
+using WsClient = SimpleWeb::SocketClient<SimpleWeb::WS>;
+using WssClient = SimpleWeb::SocketClient<SimpleWeb::WSS>;
 using logger = toolboxpp::Logger;
 using std::cout;
 using std::cerr;
 using std::endl;
+using Clock = std::chrono::steady_clock;
+
+/// \brief Prefix of message text, followed by intended send time (steady clock, nanoseconds) and ':'
+static const std::string MARKER = "wssbench:";
+
+struct Options {
+  std::string endpoint;
+  std::string path;
+  std::string token;
+  bool tls;
+  size_t connections;
+  size_t threads;
+  double rate;
+  double duration;
+  double warmup;
+  double drain;
+  size_t fanout;
+  std::string payload;
+  uint32_t seed;
+  std::string output;
+};
+
+/// \brief Log-linear latency histogram (like HdrHistogram with 2 significant digits): values below 64ns are exact,
+/// above - split into 64 sub-buckets per power of 2, so relative error is under 1.6%. Lock-free record().
+class LatencyHistogram {
+ public:
+    LatencyHistogram() : m_buckets(BUCKETS) {
+        for (auto &b: m_buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
 
-int lastSender;
-int lastRecipient;
-std::atomic_int connected;
-std::recursive_mutex lock;
-
-// CONFIG
-// TODO cli arguments
-const int RUN_TIMES = 20;
-const int CONCURRENCY = 50;
-const int MESSAGES = 2;
-const boost::int_least64_t SLEEP_MS = 0;
-//std::string endpoint = "localhost:8085";
-std::string endpoint = "localhost:8085";
-
-std::mutex connMutex;
-std::unordered_map<int, WsConnectionPtr> conns(CONCURRENCY);
-
-const static std::string DUMMY_TEXT =
-    "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Phasellus egestas, dui euismod aliquet ultrices, magna ex tincidunt ante, non tincidunt enim quam at ipsum. Etiam vel ligula pulvinar, pharetra magna at, finibus eros. Vestibulum ante ipsum primis in faucibus orci luctus et ultrices posuere cubilia Curae; Nullam nibh nibh, tincidunt sit amet posuere eget, lobortis eu quam. Sed tincidunt, nulla ac fringilla cursus, velit nibh condimentum nisl, eget suscipit orci ex at nibh. Nam malesuada, purus nec cursus feugiat, elit erat porta quam, in maximus dui nisi ut tortor. Duis felis magna, maximus quis tristique ac, pellentesque at elit. Pellentesque augue felis, vehicula ut egestas luctus, aliquet ut justo. Quisque iaculis ligula sit amet sollicitudin facilisis. Vivamus congue suscipit metus, vitae eleifend neque ornare nec. Nulla facilisi. Phasellus augue leo, laoreet non dapibus malesuada, auctor et purus. Etiam tempor tempus sagittis. Duis porta iaculis velit quis pretium. Donec at arcu luctus, vulputate magna id, tincidunt arcu.\n"
-    "\n"
-    "Integer fermentum vulputate lorem, eget aliquam lectus interdum at. In lobortis, lectus id pellentesque porttitor, magna nunc vestibulum urna, eu auctor nisl eros eget nibh. Fusce augue diam, tempus nec nisi ac, pharetra tempor erat. Aliquam ullamcorper urna vitae elit sagittis ornare. Quisque aliquam diam lorem, eget suscipit tellus venenatis ultrices. Proin at elit quis lectus accumsan mattis. Ut vel commodo justo. Vivamus gravida euismod lacus eu mattis. Duis vitae porttitor ligula, non pellentesque turpis. Donec sollicitudin lectus a sem egestas, eget lacinia libero blandit. Ut consequat nisl felis, id sodales tortor ultrices sed.\n"
-    "\n"
-    "Donec dictum gravida est. In hac habitasse platea dictumst. Sed in tristique est, in volutpat odio. Sed finibus felis mi, eget scelerisque orci interdum et. Proin ac orci non libero facilisis fringilla. Duis eget eleifend elit. Praesent consequat diam elit, lobortis porta tellus blandit at. Proin a felis nisl. Cras fermentum sollicitudin urna, non blandit erat scelerisque quis. Pellentesque habitant morbi tristique senectus et netus et malesuada fames ac turpis egestas.\n"
-    "\n"
-    "Maecenas elementum placerat pulvinar. Praesent porttitor maximus lorem, quis convallis magna laoreet maximus. Proin iaculis dapibus bibendum. Pellentesque ac velit feugiat, varius nulla nec, lobortis nibh. Nunc condimentum nisi ac malesuada tempor. Nunc et magna sed lectus viverra mollis id nec orci. Nunc aliquam euismod dui, eu scelerisque purus ornare quis. Suspendisse magna ipsum, porttitor ornare risus ac, aliquam lacinia quam. Donec venenatis faucibus consectetur. Integer ultrices, libero et imperdiet ullamcorper, magna elit laoreet velit, a auctor sem justo eu massa. Morbi ornare accumsan orci, a blandit massa vestibulum vitae. Vestibulum tortor velit, convallis eu tortor et, maximus rhoncus urna. Suspendisse vitae pulvinar sapien.\n"
-    "\n"
-    "Duis condimentum justo vitae malesuada laoreet. Pellentesque vitae lorem risus. Fusce at nulla vitae ex vestibulum viverra id ac risus. Ut non leo lectus. Phasellus venenatis erat non odio maximus sagittis. Duis id laoreet nulla. Cras lacinia eros sit amet sodales rhoncus. Fusce convallis convallis facilisis. Phasellus cursus tincidunt libero, sed placerat quam tempus quis. Nullam pellentesque, quam ut auctor tristique, diam justo tristique felis, a bibendum urna ipsum eget odio. Etiam congue euismod convallis.";
-
-struct stats_t {
-  std::vector<double> sendTimes;
-  std::atomic_int sentMessages;
-  std::atomic_int errorMessages;
-  std::atomic_int totalConnections;
-  std::atomic_long payloadTransferredBytes;
-  double timeTaken = 0;
-
-  std::vector<int> calcTime(long ms) {
-      int seconds = (int) (ms / 1000) % 60;
-      auto minutes = (int) ((ms / (1000 * 60)) % 60);
-      auto hours = (int) ((ms / (1000 * 60 * 60)) % 24);
-
-      return {
-          hours, minutes, seconds
-      };
-  }
-
-  void calculate() {
-      double minMax[3];
-      calcMinMaxTime(minMax);
-      double totalSendTimes = 0.0;
-      for (auto t: sendTimes) {
-          totalSendTimes += t;
-      }
-      double transferSpeedKbps = ((payloadTransferredBytes * 8) / totalSendTimes) / 1000;
-
-      const std::vector<int> times = calcTime(static_cast<long>(totalSendTimes));
-      cout
-          << endl
-          << "         MIN send time:      " << (minMax[0]) << "ms" << endl
-          << "         MAX send time:      " << (minMax[1]) << "ms" << endl
-          << "         AVG send time:      " << (minMax[2]) << "ms" << endl
-          << "            Total sent:      " << sendTimes.size() << endl
-          << "         Sent messages:      " << sentMessages << endl
-          << "        Error messages:      " << errorMessages << endl
-          << "     Total connections:      " << totalConnections << endl
-          << "   Transferred payload:      " << payloadTransferredBytes << " bytes ("
-          << (payloadTransferredBytes / 1000)
-          << " Kb)" << endl
-          << "Average transfer throughput: " << transferSpeedKbps << " Kb/s (" << (transferSpeedKbps / 1000) << " Mb/s)"
-          << endl
-          << "Benchmark time (total):      " << totalSendTimes << "ms (" << times[1] << " minutes" << " " << times[2]
-          << " seconds)" << endl
-          << endl;
-  }
-
-  void calcMinMaxTime(double *result) {
-      double min = 0, max = 0;
-      double sum = 0.0;
-      for (auto t: sendTimes) {
-          sum += t;
-          if (t > max) {
-              max = t;
-          }
-      }
-      min = max;
-      for (auto t: sendTimes) {
-          if (t < min) {
-              min = t;
-          }
-      }
-
-      result[0] = min;
-      result[1] = max;
-      result[2] = sum / static_cast<double>(sendTimes.size());
-
-  }
-}; // stats
-
-stats_t _statistics;
-std::mutex statLock;
+    void record(Clock::duration value) {
+        const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(value).count();
+        const uint64_t v = nanos < 0 ? 0 : (uint64_t) nanos;
+        m_buckets[indexOf(v)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed)) { }
+    }
 
-void handleOne(int sen, int rec, WsConnectionPtr &conn) {
-    std::lock_guard<std::mutex> locker(connMutex);
-    if (conn == nullptr) {
-        L_ERR_F("HandleOne", "Connection is NULL sen=%d, rec=%d", sen, rec);
-        return;
+    uint64_t count() const {
+        return m_count.load();
     }
 
-    std::string msg;
-    nlohmann::json obj;
-    std::vector<int> recps = {rec};
-    obj["sender"] = sen;
-    obj["recipients"] = recps;
-    obj["type"] = "text";
-    obj["text"] = DUMMY_TEXT;
-    msg = obj.dump();
-
-    for (int i = 0; i < MESSAGES; i++) {
-        std::stringstream ss;
-        ss << "client_" << sen << "_" << i;
-        const std::string tag = ss.str();
-
-        // DO NOT reuse stream, it will die after first sending
-        const std::shared_ptr<WsClient::SendStream> send_stream = std::make_shared<WsClient::SendStream>();
-        *send_stream << msg;
-
-        toolboxpp::Profiler::get().begin(tag);
-        try {
-            // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
-            conn->send(send_stream, [conn, tag](const SimpleWeb::error_code &errorCode) {
-              conn->send_close(1000, "OK");
-              if (errorCode) {
-                  std::stringstream ss;
-                  ss << "Server: Error sending message. " << errorCode.category().name()
-                     << " error message: " << errorCode.message() << endl;
-
-                  toolboxpp::Logger::get().debug("Send Message", ss.str());
-
-                  _statistics.errorMessages++;
-                  toolboxpp::Profiler::get().end(tag);
-                  return;
-              }
-              double sendTime;
-              toolboxpp::Profiler::get().end(tag, &sendTime);
-              statLock.lock();
-              _statistics.sendTimes.push_back(sendTime);
-              statLock.unlock();
-              _statistics.sentMessages++;
-
-
-            });
-        } catch (const std::exception &e) {
-            cerr << e.what() << endl;
+    /// \param quantile 0..1
+    /// \return nanoseconds, lower bound of bucket
+    uint64_t percentile(double quantile) const {
+        const uint64_t total = count();
+        if (total == 0) {
+            return 0;
         }
-
-        _statistics.payloadTransferredBytes += msg.length();
-
-        if (SLEEP_MS > 0) {
-            boost::this_thread::sleep_for(boost::chrono::milliseconds(SLEEP_MS));
+        const auto rank = std::max((uint64_t) 1, (uint64_t) std::ceil(quantile * total));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return valueOf(i);
+            }
         }
-
+        return m_max.load();
     }
 
-    L_DEBUG_F("Client", "[%d] sent message to client [%d]", sen, rec);
-}
+    nlohmann::json toJson() const {
+        const auto micros = [](uint64_t nanos) { return (double) nanos / 1000.0; };
+        const uint64_t total = count();
+        return {
+            {"count", total},
+            {"mean", total == 0 ? 0.0 : micros(m_sum.load()) / total},
+            {"p50", micros(percentile(0.5))},
+            {"p90", micros(percentile(0.9))},
+            {"p99", micros(percentile(0.99))},
+            {"p999", micros(percentile(0.999))},
+            {"max", micros(m_max.load())},
+        };
+    }
 
-void connect(int sen, int) {
+ private:
+    static const size_t SUB_BITS = 6;
+    static const size_t SUB_COUNT = 1u << SUB_BITS;
+    static const size_t BUCKETS = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
 
+    std::vector<std::atomic<uint64_t>> m_buckets;
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
 
-        if (conns.count(sen)) {
-            return;
+    static size_t indexOf(uint64_t v) {
+        if (v < SUB_COUNT) {
+            return (size_t) v;
         }
+        const size_t exponent = 63 - (size_t) __builtin_clzll(v);
+        const size_t shift = exponent - SUB_BITS;
+        return SUB_COUNT + shift * SUB_COUNT + (size_t) ((v >> shift) - SUB_COUNT);
+    }
 
+    static uint64_t valueOf(size_t index) {
+        if (index < SUB_COUNT) {
+            return index;
+        }
+        const size_t shift = (index - SUB_COUNT) / SUB_COUNT;
+        const uint64_t sub = (index - SUB_COUNT) % SUB_COUNT;
+        return (SUB_COUNT + sub) << shift;
+    }
+};
+
+const size_t LatencyHistogram::BUCKETS;
+
+/// \brief Payload (message text) size distribution: fixed:N, uniform:MIN-MAX or exp:MEAN
+class PayloadSize {
+ public:
+    explicit PayloadSize(const std::string &spec) {
+        const auto colon = spec.find(':');
+        const std::string type = spec.substr(0, colon);
+        const std::string args = colon == std::string::npos ? "" : spec.substr(colon + 1);
+        if (type == "fixed") {
+            m_type = Type::Fixed;
+            m_min = m_max = std::stoul(args);
+        } else if (type == "uniform") {
+            const auto dash = args.find('-');
+            if (dash == std::string::npos) {
+                throw std::invalid_argument("uniform payload requires MIN-MAX");
+            }
+            m_type = Type::Uniform;
+            m_min = std::stoul(args.substr(0, dash));
+            m_max = std::stoul(args.substr(dash + 1));
+            if (m_min > m_max) {
+                std::swap(m_min, m_max);
+            }
+        } else if (type == "exp") {
+            m_type = Type::Exponential;
+            m_min = m_max = std::stoul(args);
+        } else {
+            throw std::invalid_argument("Unknown payload distribution: " + type);
+        }
+    }
 
+    size_t next(std::mt19937_64 &rng) const {
+        switch (m_type) {
+            case Type::Uniform:
+                return std::uniform_int_distribution<size_t>(m_min, m_max)(rng);
+            case Type::Exponential:
+                return (size_t) std::exponential_distribution<double>(1.0 / std::max((size_t) 1, m_min))(rng);
+            default:
+                return m_min;
+        }
+    }
 
-    L_DEBUG_F("Client", "[%d] Connecting...", sen);
+ private:
+    enum class Type { Fixed, Uniform, Exponential };
+    Type m_type = Type::Fixed;
+    size_t m_min = 0;
+    size_t m_max = 0;
+};
+
+struct Results {
+  std::atomic<uint64_t> scheduled{0};
+  std::atomic<uint64_t> sent{0};
+  std::atomic<uint64_t> sendErrors{0};
+  std::atomic<uint64_t> delivered{0};
+  std::atomic<uint64_t> sentBytes{0};
+  std::atomic<uint64_t> connectionErrors{0};
+  LatencyHistogram sendLatency;
+  LatencyHistogram deliveryLatency;
+  double seconds = 0;
+};
+
+static std::unique_ptr<WsClient> makeClient(const std::string &url, const WsClient *) {
+    return std::make_unique<WsClient>(url);
+}
 
-    WsClient client(
-        std::string(endpoint + "/chat?id=" + std::to_string(sen)),
-        false
-    );
-    client.config.header.emplace("X-Auth-Token", "aOel0Pnx9Fi-h2EeknsHuAyDknV5rbSR");
+static std::unique_ptr<WssClient> makeClient(const std::string &url, const WssClient *) {
+    return std::make_unique<WssClient>(url, false);
+}
 
-    client.on_message = [](WsConnectionPtr, std::shared_ptr<WsClient::Message>) {
-//        cout << "Client: [" << sen << "] Message received: "<< endl;
-    };
+template<typename Client>
+class LoadRunner {
+ public:
+    using ConnectionPtr = std::shared_ptr<typename Client::Connection>;
+
+    LoadRunner(const Options &opts, Results &results) :
+        m_opts(opts),
+        m_results(results),
+        m_payloadSize(opts.payload),
+        m_ioService(std::make_shared<boost::asio::io_service>()),
+        m_connections(opts.connections),
+        m_connected(0) {
+    }
 
-    client.on_open = [sen](WsConnectionPtr connection) {
-      L_DEBUG_F("Client", "[%d] Connected!", sen);
-      std::lock_guard<std::mutex> locker(connMutex);
-      conns[sen] = connection;
-      connected++;
-    };
+    /// \brief Opens all connections
+    /// \return false if not all connections are open in 30 seconds
+    bool connect() {
+        m_work = std::make_unique<boost::asio::io_service::work>(*m_ioService);
+        for (size_t i = 0; i < m_opts.threads; i++) {
+            m_threads.emplace_back([this] { m_ioService->run(); });
+        }
 
-    client.on_close = [sen](WsConnectionPtr /*connection*/, int status, const std::string &reason) {
-      const char *s = reason.c_str();
-      L_DEBUG_F("Client", "[%d] Disconnected with status code %d: %s", sen, status, s);
-      std::lock_guard<std::mutex> locker(connMutex);
-      conns.erase(sen);
-      connected--;
-    };
+        for (size_t i = 0; i < m_opts.connections; i++) {
+            const size_t id = i + 1;
+            const std::string url = m_opts.endpoint + m_opts.path + "?id=" + std::to_string(id);
+            auto client = makeClient(url, (const Client *) nullptr);
+            client->io_service = m_ioService;
+            if (!m_opts.token.empty()) {
+                client->config.header.emplace("X-Auth-Token", m_opts.token);
+            }
+
+            client->on_open = [this, i](ConnectionPtr connection) {
+              std::lock_guard<std::mutex> lock(m_mutex);
+              m_connections[i] = connection;
+              m_connected++;
+              m_connectedCond.notify_all();
+            };
+            client->on_message = [this](ConnectionPtr, std::shared_ptr<typename Client::Message> message) {
+              onMessage(message->string());
+            };
+            client->on_error = [this, id](ConnectionPtr, const SimpleWeb::error_code &ec) {
+              L_ERR_F("Client", "[%lu] Error: %s", id, ec.message().c_str());
+              m_results.connectionErrors++;
+            };
+            client->start();
+            m_clients.push_back(std::move(client));
+        }
 
-    // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
-    client.on_error = [sen](WsConnectionPtr /*connection*/, const SimpleWeb::error_code &ec) {
-      L_ERR_F("Client", "[%d] Error: %s, error message: %s", sen, ec.category().name(), ec.message().c_str());
-      std::lock_guard<std::mutex> locker(connMutex);
-      conns.erase(sen);
-      connected--;
-    };
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_connectedCond.wait_for(lock, std::chrono::seconds(30), [this] {
+          return m_connected == m_opts.connections;
+        });
+    }
 
-    client.start();
-}
+    /// \brief Sends messages at fixed rate for warmup + duration, then waits for deliveries up to drain seconds
+    void run() {
+        const auto interval = std::chrono::nanoseconds((int64_t) (1e9 / m_opts.rate));
+        const auto begin = Clock::now();
+        m_measureFrom = begin + toDuration(m_opts.warmup);
+        const auto end = m_measureFrom + toDuration(m_opts.duration);
+        std::mt19937_64 rng(m_opts.seed);
+
+        for (uint64_t i = 0;; i++) {
+            const Clock::time_point intended = begin + interval * i;
+            if (intended >= end) {
+                break;
+            }
+            if (Clock::now() < intended) {
+                std::this_thread::sleep_until(intended);
+            }
+            // if we are late, message is sent immediately, but its latency still starts at intended time
+            send(i, intended, m_payloadSize.next(rng));
+        }
+        m_results.seconds = toSeconds(Clock::now() - m_measureFrom);
 
-void connectAll(asio::io_service *service) {
-    for (int i = 1; i < CONCURRENCY + 1; i += 2) {
-        service->post(boost::bind(&connect, i, i + 1));
-        service->post(boost::bind(&connect, i + 1, i));
-        _statistics.totalConnections += 2;
+        const auto drainUntil = Clock::now() + toDuration(m_opts.drain);
+        while (Clock::now() < drainUntil && m_results.delivered < expectedDeliveries()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
     }
-}
 
-void watchdog(asio::io_service &service) {
-    while (connected > 0) {
-        boost::this_thread::sleep_for(boost::chrono::seconds(1));
-        L_DEBUG_F("Watchdog", "Still have %d connections", connected.load())
+    uint64_t expectedDeliveries() const {
+        return m_results.sent * fanout();
     }
 
-    boost::this_thread::sleep_for(boost::chrono::seconds(2));
-    service.stop();
-}
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &connection: m_connections) {
+                if (connection) {
+                    connection->send_close(1000, "OK");
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        for (auto &client: m_clients) {
+            client->stop();
+        }
+        m_work.reset();
+        m_ioService->stop();
+        for (auto &t: m_threads) {
+            t.join();
+        }
+    }
 
-void run() {
-    asio::io_service ioService;
-    boost::thread_group threadGroup;
-    asio::io_service::work work(ioService);
+ private:
+    const Options &m_opts;
+    Results &m_results;
+    PayloadSize m_payloadSize;
+    std::shared_ptr<boost::asio::io_service> m_ioService;
+    std::unique_ptr<boost::asio::io_service::work> m_work;
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Client>> m_clients;
+    std::vector<ConnectionPtr> m_connections;
+    std::mutex m_mutex;
+    std::condition_variable m_connectedCond;
+    size_t m_connected;
+    Clock::time_point m_measureFrom;
+
+    static Clock::duration toDuration(double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
 
-    // run threads
-    for (int i = 0; i < CONCURRENCY * 2; i++) {
-        threadGroup.create_thread(
-            boost::bind(&asio::io_service::run, &ioService)
-        );
+    static double toSeconds(Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
     }
 
-    // connect
-    connectAll(&ioService);
+    size_t fanout() const {
+        return std::min(m_opts.fanout, m_opts.connections - 1);
+    }
 
+    void send(uint64_t seq, Clock::time_point intended, size_t payloadSize) {
+        const size_t sender = seq % m_opts.connections;
+        const bool measured = intended >= m_measureFrom;
 
-    // wait for all connected
-    while (connected < CONCURRENCY) {
-        cout << "Waiting for connecting all connections..." << endl;
-        boost::this_thread::sleep_for(boost::chrono::seconds(1));
-    }
+        std::string recipients;
+        for (size_t r = 1; r <= fanout(); r++) {
+            if (r > 1) {
+                recipients += ',';
+            }
+            recipients += std::to_string((sender + r) % m_opts.connections + 1);
+        }
 
-    // run message exchanges
-    for (int i = 1; i < CONCURRENCY + 1; i += 2) {
-        ioService.post(boost::bind(&handleOne, i, i + 1, conns[i]));
-        ioService.post(boost::bind(&handleOne, i + 1, i, conns[i + 1]));
-    }
+        const auto intendedNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            intended.time_since_epoch()).count();
+        std::string text = MARKER + std::to_string(intendedNanos) + ":";
+        if (payloadSize > text.size()) {
+            text.append(payloadSize - text.size(), 'x');
+        }
 
-    ioService.post(boost::bind(watchdog, boost::ref(ioService)));
+        auto stream = std::make_shared<typename Client::SendStream>();
+        *stream << "{\"sender\":" << (sender + 1)
+                << ",\"recipients\":[" << recipients << "]"
+                << ",\"type\":\"text\",\"text\":\"" << text << "\"}";
 
-    threadGroup.join_all();
+        ConnectionPtr connection = m_connections[sender];
+        if (measured) {
+            m_results.scheduled++;
+        }
+        connection->send(stream, [this, intended, measured, payloadSize](const SimpleWeb::error_code &ec) {
+          if (!measured) {
+              return;
+          }
+          if (ec) {
+              m_results.sendErrors++;
+              return;
+          }
+          m_results.sendLatency.record(Clock::now() - intended);
+          m_results.sent++;
+          m_results.sentBytes += payloadSize;
+        });
+    }
 
-    conns.clear();
+    void onMessage(const std::string &message) {
+        const auto now = Clock::now();
+        const auto pos = message.find(MARKER);
+        if (pos == std::string::npos) {
+            return;
+        }
+        const auto intendedNanos = std::strtoll(message.c_str() + pos + MARKER.size(), nullptr, 10);
+        const Clock::time_point intended(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(intendedNanos)));
+        if (intended < m_measureFrom) {
+            return;
+        }
+        m_results.deliveryLatency.record(now - intended);
+        m_results.delivered++;
+    }
+};
+
+template<typename Client>
+static int runBenchmark(const Options &opts, Results &results, uint64_t &expectedDeliveries) {
+    LoadRunner<Client> runner(opts, results);
+    if (!runner.connect()) {
+        cerr << "Not all connections are open, check server and auth token" << endl;
+        runner.stop();
+        return 1;
+    }
+    runner.run();
+    expectedDeliveries = runner.expectedDeliveries();
+    runner.stop();
+    return 0;
 }
 
-int main() {
-    L_LEVEL(logger::LEVEL_INFO | logger::LEVEL_ERROR | logger::LEVEL_WARNING);
-
-    if (CONCURRENCY % 2 != 0) {
-        cerr << "Concurrent connections number must be even" << endl;
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<std::string>("endpoint", 'e', "Server host:port", false, "localhost:8085");
+    args.add<std::string>("path", 0, "WebSocket path", false, "/chat");
+    args.add<std::string>("token", 0, "X-Auth-Token header value (empty - no header)", false,
+                          "aOel0Pnx9Fi-h2EeknsHuAyDknV5rbSR");
+    args.add("tls", 0, "Use wss:// (certificate is not verified)");
+    args.add<size_t>("connections", 'c', "Connections (users with ids 1..N)", false, 50);
+    args.add<size_t>("threads", 't', "Client io threads", false, std::max(1u, std::thread::hardware_concurrency()));
+    args.add<double>("rate", 'r', "Messages per second, total", false, 1000);
+    args.add<double>("duration", 'd', "Measured seconds", false, 10);
+    args.add<double>("warmup", 'w', "Seconds before measuring, at same rate", false, 2);
+    args.add<double>("drain", 0, "Seconds to wait for deliveries after last send", false, 5);
+    args.add<size_t>("fanout", 'f', "Recipients per message", false, 1);
+    args.add<std::string>("payload", 'p', "Text size distribution: fixed:N, uniform:MIN-MAX, exp:MEAN", false,
+                          "fixed:256");
+    args.add<uint32_t>("seed", 0, "Payload size random seed", false, 1);
+    args.add<std::string>("output", 'o', "Write JSON result to file instead of stdout", false, "");
+    args.add("verbose", 'v', "Log client errors");
+    args.parse_check(argc, argv);
+
+    Options opts;
+    opts.endpoint = args.get<std::string>("endpoint");
+    opts.path = args.get<std::string>("path");
+    opts.token = args.get<std::string>("token");
+    opts.tls = args.exist("tls");
+    opts.connections = args.get<size_t>("connections");
+    opts.threads = std::max((size_t) 1, args.get<size_t>("threads"));
+    opts.rate = args.get<double>("rate");
+    opts.duration = args.get<double>("duration");
+    opts.warmup = args.get<double>("warmup");
+    opts.drain = args.get<double>("drain");
+    opts.fanout = std::max((size_t) 1, args.get<size_t>("fanout"));
+    opts.payload = args.get<std::string>("payload");
+    opts.seed = args.get<uint32_t>("seed");
+    opts.output = args.get<std::string>("output");
+
+    if (opts.connections < 2) {
+        cerr << "At least 2 connections required" << endl;
+        return 1;
+    }
+    if (opts.rate <= 0 || opts.duration <= 0) {
+        cerr << "Rate and duration must be positive" << endl;
         return 1;
     }
+    try {
+        PayloadSize check(opts.payload);
+        (void) check;
+    } catch (const std::exception &e) {
+        cerr << "Invalid payload: " << e.what() << endl;
+        return 1;
+    }
+
+    if (args.exist("verbose")) {
+        L_LEVEL(logger::LEVEL_INFO | logger::LEVEL_ERROR | logger::LEVEL_WARNING);
+    } else {
+        toolboxpp::Logger::get().setVerbosity(0);
+    }
+
+    Results results;
+    uint64_t expectedDeliveries = 0;
+    const int status = opts.tls
+                       ? runBenchmark<WssClient>(opts, results, expectedDeliveries)
+                       : runBenchmark<WsClient>(opts, results, expectedDeliveries);
+    if (status != 0) {
+        return status;
+    }
+
+    const double seconds = results.seconds > 0 ? results.seconds : opts.duration;
+    const nlohmann::json out = {
+        {"config", {
+            {"endpoint", opts.endpoint},
+            {"tls", opts.tls},
+            {"connections", opts.connections},
+            {"rate", opts.rate},
+            {"duration", opts.duration},
+            {"warmup", opts.warmup},
+            {"fanout", std::min(opts.fanout, opts.connections - 1)},
+            {"payload", opts.payload},
+        }},
+        {"scheduled", results.scheduled.load()},
+        {"sent", results.sent.load()},
+        {"send_errors", results.sendErrors.load()},
+        {"connection_errors", results.connectionErrors.load()},
+        {"delivered", results.delivered.load()},
+        {"expected_deliveries", expectedDeliveries},
+        {"seconds", seconds},
+        {"throughput", {
+            {"sent_per_second", results.sent / seconds},
+            {"delivered_per_second", results.delivered / seconds},
+            {"payload_bytes_per_second", results.sentBytes / seconds},
+        }},
+        // microseconds, from intended send time
+        {"send_latency_us", results.sendLatency.toJson()},
+        {"delivery_latency_us", results.deliveryLatency.toJson()},
+    };
 
-    for (int i = 0; i < RUN_TIMES; i++) {
-        L_INFO_F("main", "Run benchmark %d time", i + 1);
-        run();
+    if (opts.output.empty()) {
+        cout << out.dump(2) << endl;
+    } else {
+        std::ofstream file(opts.output);
+        file << out.dump(2) << endl;
+        if (!file) {
+            cerr << "Can't write result to " << opts.output << endl;
+            return 1;
+        }
     }
-    _statistics.calculate();
 
     return 0;
 }
@@ -0,0 +1,230 @@
+/**
+ * wsserver
+ * microbench.cpp
+ *
+ * Hot path microbenchmarks (Google Benchmark). Run through "microbench-json" target to get JSON report,
+ * or directly: wssmicrobench --benchmark_format=json --benchmark_out=microbench.json
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include <benchmark/benchmark.h>
+#include <toolboxpp.h>
+#include "../base/Log.h"
+#include "../base/unid.h"
+#include "../base/ws/Frame.hpp"
+#include "../chat/ConnectionStorage.h"
+#include "../chat/IngressRing.h"
+#include "../chat/Message.h"
+#include "../chat/Statistics.h"
+#include "../helpers/helpers.h"
+
+using Frame = wss::server::websocket::Frame;
+
+static std::string makeText(std::size_t size) {
+    return std::string(size, 'x');
+}
+
+/// MessagePayload
+
+static void BM_MessagePayloadParse(benchmark::State &state) {
+    const std::string json = wss::MessagePayload(1, {2, 3, 4}, makeText((std::size_t) state.range(0))).toJson();
+    for (auto _: state) {
+        wss::MessagePayload payload(json);
+        benchmark::DoNotOptimize(payload.isValid());
+    }
+    state.SetBytesProcessed((int64_t) (state.iterations() * json.size()));
+}
+BENCHMARK(BM_MessagePayloadParse)->Arg(64)->Arg(1024)->Arg(16 * 1024);
+
+static void BM_MessagePayloadToJson(benchmark::State &state) {
+    // toJson() result is cached, so serialize fresh copy of payload, that was never serialized
+    const wss::MessagePayload source(1, {2, 3, 4}, makeText((std::size_t) state.range(0)));
+    for (auto _: state) {
+        wss::MessagePayload payload(source);
+        benchmark::DoNotOptimize(payload.toJson().data());
+    }
+}
+BENCHMARK(BM_MessagePayloadToJson)->Arg(64)->Arg(1024)->Arg(16 * 1024);
+
+/// Frames
+
+static void BM_FrameWriteHeader(benchmark::State &state) {
+    const auto length = (std::size_t) state.range(0);
+    for (auto _: state) {
+        boost::asio::streambuf buffer;
+        std::ostream out(&buffer);
+        Frame::writeHeader(out, 129, length);
+        benchmark::DoNotOptimize(buffer.size());
+    }
+}
+// 7-bit, 16-bit and 64-bit length
+BENCHMARK(BM_FrameWriteHeader)->Arg(100)->Arg(1000)->Arg(100000);
+
+static void BM_FrameUnmask(benchmark::State &state) {
+    const auto length = (std::size_t) state.range(0);
+    const std::string masked = makeText(length);
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    for (auto _: state) {
+        boost::asio::streambuf raw;
+        raw.commit(boost::asio::buffer_copy(raw.prepare(length), boost::asio::buffer(masked)));
+        boost::asio::streambuf message;
+        std::istream in(&raw);
+        std::ostream out(&message);
+        Frame::unmask(in, out, length, mask);
+        benchmark::DoNotOptimize(message.size());
+    }
+    state.SetBytesProcessed((int64_t) (state.iterations() * length));
+}
+BENCHMARK(BM_FrameUnmask)->Arg(128)->Arg(4096)->Arg(64 * 1024);
+
+/// ConnectionStorage
+
+static wss::io_context_service &ioService() {
+    static wss::io_context_service service;
+    return service;
+}
+
+static wss::WsConnectionPtr makeConnection(uint32_t address, unsigned short port) {
+    auto connection = std::make_shared<wss::WsBase::Connection>(
+        std::make_unique<wss::server::websocket::SocketLayerWrapper>(ioService()));
+    connection->remoteEndpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4(address), port);
+    return connection;
+}
+
+static wss::ConnectionStorage &sharedStorage() {
+    static wss::ConnectionStorage storage;
+    return storage;
+}
+
+/// \brief Every thread adds connections of its own user, iterates them (as send does) and removes,
+/// all under one storage lock
+static void BM_ConnectionStorageAddForEachRemove(benchmark::State &state) {
+    static std::atomic<wss::user_id_t> nextUser(1);
+    const wss::user_id_t user = nextUser++;
+    const auto perUser = (std::size_t) state.range(0);
+
+    std::vector<wss::WsConnectionPtr> connections;
+    for (std::size_t i = 0; i < perUser; i++) {
+        connections.push_back(makeConnection((uint32_t) (0x0A000000 + user), (unsigned short) (1000 + i)));
+    }
+
+    auto &storage = sharedStorage();
+    std::size_t visited = 0;
+    for (auto _: state) {
+        for (const auto &connection: connections) {
+            storage.add(user, connection);
+        }
+        storage.forEach(user, [&visited](size_t, const wss::WsConnectionPtr &, wss::conn_id_t, wss::user_id_t) {
+          visited++;
+        });
+        for (const auto &connection: connections) {
+            storage.remove(user, connection->getUniqueId());
+        }
+    }
+    benchmark::DoNotOptimize(visited);
+}
+BENCHMARK(BM_ConnectionStorageAddForEachRemove)->Arg(1)->Arg(4)->ThreadRange(1, 8)->UseRealTime();
+
+/// unid
+
+static void BM_UnidNext(benchmark::State &state) {
+    auto &generator = wss::unid::generator();
+    for (auto _: state) {
+        benchmark::DoNotOptimize(generator.next());
+    }
+}
+BENCHMARK(BM_UnidNext)->ThreadRange(1, 8)->UseRealTime();
+
+/// Timestamps
+
+static void BM_TimestampConfigAware(benchmark::State &state) {
+    for (auto _: state) {
+        benchmark::DoNotOptimize(wss::utils::getNowISODateTimeFractionalConfigAware());
+    }
+}
+BENCHMARK(BM_TimestampConfigAware);
+
+static void BM_TimestampUTCFractional(benchmark::State &state) {
+    for (auto _: state) {
+        benchmark::DoNotOptimize(wss::utils::getNowUTCISODateTimeFractional());
+    }
+}
+BENCHMARK(BM_TimestampUTCFractional);
+
+/// Statistics
+
+static void BM_StatisticsMessageUpdate(benchmark::State &state) {
+    // one user, updated by all threads: contended atomics
+    static wss::Statistics stat(1);
+    for (auto _: state) {
+        stat.addSendMessage().addBytesTransferred(256);
+    }
+    benchmark::DoNotOptimize(stat.getSentMessages());
+}
+BENCHMARK(BM_StatisticsMessageUpdate)->ThreadRange(1, 8)->UseRealTime();
+
+/// Log
+
+static void BM_LogDebugDisabled(benchmark::State &state) {
+    wss::log::setVerbosity(0);
+    const std::string tag = "Bench";
+    wss::user_id_t uid = 1;
+    for (auto _: state) {
+        WSS_DEBUG_F("Bench", "Sending message to %lu [%s]", uid++, tag.c_str());
+    }
+    benchmark::DoNotOptimize(uid);
+}
+BENCHMARK(BM_LogDebugDisabled);
+
+static void BM_LogDebugAsync(benchmark::State &state) {
+    // formatting and ring push on caller thread, writer drains into no-op sink
+    wss::log::setVerbosity(2);
+    wss::log::setSink([](const wss::log::Record &) { });
+    wss::log::startWriter(4096);
+    const uint64_t droppedBefore = wss::log::getDropped();
+    wss::user_id_t uid = 1;
+    for (auto _: state) {
+        WSS_DEBUG_F("Bench", "Sending message to %lu [%s]", uid++, "Bench");
+    }
+    benchmark::DoNotOptimize(uid);
+    wss::log::stopWriter();
+    state.counters["dropped"] = wss::log::getDropped() - droppedBefore;
+    wss::log::setSink(nullptr);
+    wss::log::setVerbosity(0);
+}
+BENCHMARK(BM_LogDebugAsync);
+
+/// Ingress ring
+
+static void BM_IngressRingPushDrain(benchmark::State &state) {
+    // producer push and consumer drain of one record, without routing
+    auto ring = wss::IngressRing::create("/tmp/wssmicrobench_" + std::to_string(getpid()) + ".ring", 1024 * 1024);
+    const std::string json = wss::MessagePayload(1, {2}, makeText((std::size_t) state.range(0))).toJson();
+    std::size_t received = 0;
+    for (auto _: state) {
+        ring->push(json);
+        ring->drain([&received](const char *, std::size_t size) { received += size; }, 1);
+    }
+    benchmark::DoNotOptimize(received);
+    state.SetBytesProcessed((int64_t) (state.iterations() * json.size()));
+}
+BENCHMARK(BM_IngressRingPushDrain)->Arg(64)->Arg(1024);
+
+int main(int argc, char **argv) {
+    toolboxpp::Logger::get().setVerbosity(0);
+    wss::log::setVerbosity(0);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
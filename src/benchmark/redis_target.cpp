@@ -0,0 +1,101 @@
+/**
+ * wsserver
+ * redis_target.cpp
+ *
+ * Throughput benchmark for event notifier redis target.
+ * By default starts in-process redis stand-in (accepts any command and replies ":1"),
+ * use --port to run against real redis-server.
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <toolboxpp.h>
+#include "cmdline.hpp"
+#include "json.hpp"
+#include "../event/RedisTarget.h"
+#include "RedisStandIn.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using wss::benchmark::RedisStandIn;
+
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<size_t>("events", 'n', "Total events to send", false, 200000);
+    args.add<size_t>("senders", 's', "Parallel sender threads (event notifier workers)", false, 64);
+    args.add<size_t>("connections", 'c', "Redis connections in target pool", false, 2);
+    args.add<size_t>("batch", 'b', "Maximum batch size", false, 256);
+    args.add<long>("window", 'w', "Batch window, microseconds", false, 500);
+    args.add<std::string>("mode", 'm', "queue or channel", false, "queue");
+    args.add<uint16_t>("port", 'p', "Real redis port. If not set, in-process stand-in is used", false, 0);
+    args.parse_check(argc, argv);
+
+    toolboxpp::Logger::get().setVerbosity(0);
+
+    std::unique_ptr<RedisStandIn> standIn;
+    uint16_t port = args.get<uint16_t>("port");
+    if (port == 0) {
+        standIn = std::make_unique<RedisStandIn>();
+        standIn->start();
+        port = standIn->port();
+    }
+
+    nlohmann::json config;
+    config["type"] = "redis";
+    config["address"] = "127.0.0.1";
+    config["port"] = port;
+    config["connections"] = args.get<size_t>("connections");
+    config["batchSize"] = args.get<size_t>("batch");
+    config["batchWindowMicroseconds"] = args.get<long>("window");
+    config["mode"] = {{"type", args.get<std::string>("mode")}, {"name", "wssbench_events"}};
+
+    wss::event::RedisTarget target(config);
+    if (!target.isValid()) {
+        cerr << target.getErrorMessage() << endl;
+        return 1;
+    }
+
+    const size_t total = args.get<size_t>("events");
+    const size_t senders = std::max((size_t) 1, args.get<size_t>("senders"));
+    const wss::event::EventPtr event =
+        std::make_shared<const wss::event::Event>(wss::MessagePayload(1, 2, std::string(256, 'x')));
+
+    std::atomic_size_t next(0), ok(0), failed(0);
+    const auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < senders; i++) {
+        workers.emplace_back([&] {
+          std::string error;
+          while (next++ < total) {
+              if (target.send(event, error)) {
+                  ok++;
+              } else {
+                  failed++;
+              }
+          }
+        });
+    }
+    for (auto &w: workers) {
+        w.join();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    cout
+        << "          Events sent:      " << ok << endl
+        << "        Events failed:      " << failed << endl
+        << "         Redis writes:      " << (standIn ? std::to_string(standIn->commands()) : "n/a") << endl
+        << "                 Time:      " << seconds << "s" << endl
+        << "           Throughput:      " << (size_t) (ok / seconds) << " events/s" << endl;
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * wsserver
+ * rest_api.cpp
+ *
+ * REST API send-message benchmark. Starts in-process rest server and measures requests per second for each
+ * combination of server workers and keep-alive mode. Previous behavior (single thread, connection per request)
+ * is "--workers 1 --keep-alive 0".
+ *
+ * Example: wssbench-rest -n 100000 -c 32 --workers 1,4,8 --keep-alive 0,1 --pipeline 8
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <toolboxpp.h>
+#include "cmdline.hpp"
+#include "json.hpp"
+#include "../chat/ChatServer.h"
+#include "../chat/Message.h"
+#include "../restapi/ChatRestServer.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+struct ClientOptions {
+  uint16_t port;
+  size_t requests;
+  size_t connections;
+  size_t pipeline;
+  bool keepAlive;
+};
+
+struct RunResult {
+  size_t succeeded;
+  size_t failed;
+  double seconds;
+};
+
+static std::vector<uint32_t> parseList(const std::string &list) {
+    std::vector<uint32_t> out;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back((uint32_t) std::stoul(item));
+        }
+    }
+    return out;
+}
+
+static std::string buildRequest(bool keepAlive) {
+    const std::string body = wss::MessagePayload(1, 2, std::string(256, 'x')).toJson();
+    std::stringstream ss;
+    ss << "POST /send-message HTTP/1.1\r\n"
+       << "Host: 127.0.0.1\r\n"
+       << "Content-Type: application/json\r\n"
+       << "Content-Length: " << body.length() << "\r\n";
+    if (!keepAlive) {
+        ss << "Connection: close\r\n";
+    }
+    ss << "\r\n" << body;
+    return ss.str();
+}
+
+/// \brief Reads single response (headers and body by Content-Length)
+/// \return true if status is 202 Accepted
+static bool readResponse(tcp::socket &socket, asio::streambuf &buffer) {
+    const size_t headerSize = asio::read_until(socket, buffer, "\r\n\r\n");
+    std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerSize);
+    buffer.consume(headerSize);
+
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+    size_t length = 0;
+    const size_t pos = headers.find("content-length:");
+    if (pos != std::string::npos) {
+        length = std::stoul(headers.substr(pos + 15));
+    }
+    if (buffer.size() < length) {
+        asio::read(socket, buffer, asio::transfer_exactly(length - buffer.size()));
+    }
+    buffer.consume(length);
+
+    return headers.compare(0, 12, "http/1.1 202") == 0;
+}
+
+static bool waitForServer(uint16_t port) {
+    asio::io_service ioService;
+    const tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    for (int i = 0; i < 500; i++) {
+        tcp::socket socket(ioService);
+        boost::system::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static RunResult runClients(const ClientOptions &opts) {
+    const std::string request = buildRequest(opts.keepAlive);
+    const tcp::endpoint endpoint(asio::ip::address_v4::loopback(), opts.port);
+    std::atomic_size_t next(0), succeeded(0), failed(0);
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < opts.connections; i++) {
+        clients.emplace_back([&] {
+          asio::io_service ioService;
+          asio::streambuf buffer;
+          tcp::socket socket(ioService);
+          bool connected = false;
+          const size_t depth = opts.keepAlive ? opts.pipeline : 1;
+          std::string batchRequest;
+
+          while (true) {
+              const size_t start = next.fetch_add(depth);
+              if (start >= opts.requests) {
+                  break;
+              }
+              const size_t batch = std::min(depth, opts.requests - start);
+
+              try {
+                  if (!connected) {
+                      socket = tcp::socket(ioService);
+                      buffer.consume(buffer.size());
+                      socket.connect(endpoint);
+                      connected = true;
+                  }
+
+                  // pipelining: all requests of batch are written before reading responses
+                  batchRequest.clear();
+                  for (size_t r = 0; r < batch; r++) {
+                      batchRequest += request;
+                  }
+                  asio::write(socket, asio::buffer(batchRequest));
+                  for (size_t r = 0; r < batch; r++) {
+                      if (readResponse(socket, buffer)) {
+                          succeeded++;
+                      } else {
+                          failed++;
+                      }
+                  }
+              } catch (const std::exception &) {
+                  failed += batch;
+                  connected = false;
+                  continue;
+              }
+
+              if (!opts.keepAlive) {
+                  boost::system::error_code ec;
+                  socket.close(ec);
+                  connected = false;
+              }
+          }
+        });
+    }
+    for (auto &c: clients) {
+        c.join();
+    }
+
+    return {succeeded, failed, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count()};
+}
+
+int main(int argc, char **argv) {
+    cmdline::parser args;
+    args.add<size_t>("requests", 'n', "Requests per run", false, 100000);
+    args.add<size_t>("connections", 'c', "Client connections (threads)", false, 16);
+    args.add<size_t>("pipeline", 'P', "Requests written before reading responses (keep-alive only)", false, 1);
+    args.add<std::string>("workers", 'w', "Comma-separated list of rest server workers", false, "1,4,8");
+    args.add<std::string>("keep-alive", 'k', "Comma-separated list of keep-alive modes (0, 1)", false, "0,1");
+    args.add<uint16_t>("port", 'p', "Rest server port", false, 18092);
+    args.parse_check(argc, argv);
+
+    toolboxpp::Logger::get().setVerbosity(0);
+
+    ClientOptions opts;
+    opts.port = args.get<uint16_t>("port");
+    opts.requests = args.get<size_t>("requests");
+    opts.connections = std::max((size_t) 1, args.get<size_t>("connections"));
+    opts.pipeline = std::max((size_t) 1, args.get<size_t>("pipeline"));
+
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+
+    cout << "workers  keep-alive  pipeline  succeeded  failed  seconds  requests/s" << endl;
+    for (uint32_t workers: parseList(args.get<std::string>("workers"))) {
+        for (uint32_t keepAlive: parseList(args.get<std::string>("keep-alive"))) {
+            opts.keepAlive = keepAlive != 0;
+
+            RunResult r{};
+            {
+                wss::ChatRestServer server(ws, "127.0.0.1", opts.port);
+                server.setAuth({{"type", "noauth"}});
+                server.setWorkers(workers);
+                server.setKeepAlive(opts.keepAlive, 5);
+                server.runService();
+                if (!waitForServer(opts.port)) {
+                    cerr << "Rest server is not started on port " << opts.port << endl;
+                    return 1;
+                }
+
+                r = runClients(opts);
+                server.stopService();
+                server.joinThreads();
+            }
+
+            cout << fmt::format("{0:>7}  {1:>10}  {2:>8}  {3:>9}  {4:>6}  {5:>7.2f}  {6:>10}",
+                                workers, opts.keepAlive ? "on" : "off", opts.keepAlive ? opts.pipeline : 1,
+                                r.succeeded, r.failed, r.seconds, (size_t) (r.succeeded / r.seconds))
+                 << endl;
+        }
+    }
+
+    return 0;
+}
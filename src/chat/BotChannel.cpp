@@ -0,0 +1,281 @@
+/**
+ * wsserver
+ * BotChannel.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/asio/write.hpp>
+#include "BotChannel.h"
+#include "../base/Log.h"
+#include "../base/Metrics.h"
+
+using boost::asio::local::stream_protocol;
+using wss::metrics::Registry;
+
+static wss::metrics::Counter &metricSent =
+    Registry::get().counter("wss_chat_bot_sent_total", "Messages queued to bot channel");
+static wss::metrics::Counter &metricDropped =
+    Registry::get().counter("wss_chat_bot_dropped_total",
+                            "Messages to bot dropped, because bot channel pending limit is reached or write failed");
+static wss::metrics::Counter &metricReceived =
+    Registry::get().counter("wss_chat_bot_received_total", "Messages received from bot channel");
+
+static const std::size_t FRAME_HEADER = 4;
+
+static std::size_t countFrames(const std::string &frames) {
+    std::size_t count = 0;
+    for (std::size_t offset = 0; offset + FRAME_HEADER <= frames.size(); count++) {
+        const auto *header = reinterpret_cast<const unsigned char *>(frames.data() + offset);
+        offset += FRAME_HEADER + ((uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+            | (uint32_t(header[2]) << 8) | uint32_t(header[3]));
+    }
+    return count;
+}
+
+wss::BotChannel::BotChannel(const std::string &path, std::size_t maxPendingBytes) :
+    m_path(path),
+    m_maxPendingBytes(maxPendingBytes),
+    m_work(std::make_unique<boost::asio::io_service::work>(m_ioService)),
+    m_acceptor(m_ioService) {
+    Registry::get().addCollector(this, "wss_chat_bot_connected", "1 if bot is connected to bot channel",
+                                 [this](Registry::Samples &samples) {
+                                   samples.emplace_back("", isConnected() ? 1.0 : 0.0);
+                                 });
+    Registry::get().addCollector(this, "wss_chat_bot_pending_bytes", "Bytes queued to bot and not written yet",
+                                 [this](Registry::Samples &samples) {
+                                   samples.emplace_back("", (double) getPending());
+                                 });
+}
+
+wss::BotChannel::~BotChannel() {
+    Registry::get().removeCollectors(this);
+    stop();
+    join();
+}
+
+void wss::BotChannel::setMessageHandler(wss::BotChannel::MessageHandler handler) {
+    m_onMessage = std::move(handler);
+}
+
+void wss::BotChannel::start() {
+    if (m_thread) {
+        return;
+    }
+    // socket file left by previous run
+    ::unlink(m_path.c_str());
+    const stream_protocol::endpoint endpoint(m_path);
+    m_acceptor.open(endpoint.protocol());
+    m_acceptor.bind(endpoint);
+    m_acceptor.listen();
+    ::chmod(m_path.c_str(), 0660);
+    WSS_INFO_F("Bot", "Waiting for bot at %s", m_path.c_str());
+
+    accept();
+    m_thread = std::make_unique<boost::thread>([this] {
+      m_ioService.run();
+    });
+}
+
+void wss::BotChannel::stop() {
+    if (!m_work) {
+        return;
+    }
+    m_ioService.post([this] {
+      boost::system::error_code ignored;
+      m_acceptor.close(ignored);
+      if (m_accepting) {
+          m_accepting->close(ignored);
+      }
+      if (m_socket) {
+          m_socket->close(ignored);
+      }
+      std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+      m_connected = false;
+    });
+    // thread exits, when handlers of closed sockets are done
+    m_work.reset();
+}
+
+void wss::BotChannel::join() {
+    if (m_thread) {
+        m_thread->join();
+        m_thread.reset();
+        ::unlink(m_path.c_str());
+    }
+}
+
+bool wss::BotChannel::send(const std::string &json) {
+    if (json.size() > MAX_FRAME_SIZE) {
+        metricDropped.inc();
+        return false;
+    }
+
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    if (m_pending.size() + FRAME_HEADER + json.size() > m_maxPendingBytes) {
+        metricDropped.inc();
+        return false;
+    }
+    const auto size = (uint32_t) json.size();
+    m_pending.push_back((char) (size >> 24));
+    m_pending.push_back((char) (size >> 16));
+    m_pending.push_back((char) (size >> 8));
+    m_pending.push_back((char) size);
+    m_pending += json;
+    metricSent.inc();
+
+    if (m_connected && !m_writing) {
+        m_writing = true;
+        m_ioService.post([this] { write(); });
+    }
+    return true;
+}
+
+bool wss::BotChannel::isConnected() const {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    return m_connected;
+}
+
+std::size_t wss::BotChannel::getPending() const {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+const std::string &wss::BotChannel::getPath() const {
+    return m_path;
+}
+
+void wss::BotChannel::accept() {
+    m_accepting = std::make_shared<Socket>(m_ioService);
+    m_acceptor.async_accept(*m_accepting, [this](const boost::system::error_code &ec) {
+      if (ec == boost::asio::error::operation_aborted || !m_acceptor.is_open()) {
+          return;
+      }
+      if (ec) {
+          WSS_WARN_F("Bot", "Accept failed: %s", ec.message().c_str());
+          accept();
+          return;
+      }
+
+      boost::system::error_code ignored;
+      if (m_socket) {
+          WSS_WARN("Bot", "New bot connection replaces previous one");
+          m_socket->close(ignored);
+      }
+      m_socket = std::move(m_accepting);
+      m_readBuffer.clear();
+
+      uint64_t generation;
+      {
+          std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+          m_connected = true;
+          generation = ++m_generation;
+          // messages kept while bot was away
+          if (!m_writing && !m_pending.empty()) {
+              m_writing = true;
+              m_ioService.post([this] { write(); });
+          }
+      }
+      WSS_INFO("Bot", "Bot connected");
+      read(generation);
+      accept();
+    });
+}
+
+void wss::BotChannel::read(uint64_t generation) {
+    auto socket = m_socket;
+    socket->async_read_some(boost::asio::buffer(m_buffer),
+                            [this, socket, generation](const boost::system::error_code &ec, std::size_t length) {
+                              if (generation != m_generation) {
+                                  return;
+                              }
+                              if (ec) {
+                                  fail(generation, ec);
+                                  return;
+                              }
+                              m_readBuffer.append(m_buffer, length);
+                              if (!handleFrames()) {
+                                  WSS_WARN("Bot", "Invalid frame size, closing bot connection");
+                                  fail(generation, boost::asio::error::invalid_argument);
+                                  return;
+                              }
+                              read(generation);
+                            });
+}
+
+bool wss::BotChannel::handleFrames() {
+    std::size_t offset = 0;
+    while (m_readBuffer.size() - offset >= FRAME_HEADER) {
+        const auto *header = reinterpret_cast<const unsigned char *>(m_readBuffer.data() + offset);
+        const uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+            | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+        if (size > MAX_FRAME_SIZE) {
+            return false;
+        }
+        if (m_readBuffer.size() - offset - FRAME_HEADER < size) {
+            break;
+        }
+        std::string json = m_readBuffer.substr(offset + FRAME_HEADER, size);
+        offset += FRAME_HEADER + size;
+        metricReceived.inc();
+        if (m_onMessage) {
+            m_onMessage(std::move(json));
+        }
+    }
+    m_readBuffer.erase(0, offset);
+    return true;
+}
+
+void wss::BotChannel::write() {
+    if (m_inFlight) {
+        // completion of current write calls it again
+        return;
+    }
+    uint64_t generation;
+    {
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        if (!m_connected || m_pending.empty()) {
+            m_writing = false;
+            return;
+        }
+        m_writeBuffer.swap(m_pending);
+        m_pending.clear();
+        generation = m_generation;
+    }
+
+    m_inFlight = true;
+    auto socket = m_socket;
+    boost::asio::async_write(*socket, boost::asio::buffer(m_writeBuffer),
+                             [this, socket, generation](const boost::system::error_code &ec, std::size_t) {
+                               m_inFlight = false;
+                               if (ec) {
+                                   // bot may have taken part of them, they are not sent again
+                                   const std::size_t lost = countFrames(m_writeBuffer);
+                                   WSS_WARN_F("Bot", "Write failed, %lu messages dropped: %s",
+                                              lost, ec.message().c_str());
+                                   metricDropped.inc(lost);
+                                   fail(generation, ec);
+                               }
+                               // continues with messages queued meanwhile, or with new connection
+                               write();
+                             });
+}
+
+void wss::BotChannel::fail(uint64_t generation, const boost::system::error_code &ec) {
+    {
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        if (!m_connected || generation != m_generation) {
+            return;
+        }
+        m_connected = false;
+        m_writing = false;
+    }
+    boost::system::error_code ignored;
+    m_socket->close(ignored);
+    if (ec != boost::asio::error::operation_aborted) {
+        WSS_INFO_F("Bot", "Bot disconnected: %s. Messages are kept until it connects again", ec.message().c_str());
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ * wsserver
+ * BotChannel.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_BOTCHANNEL_H
+#define WSSERVER_BOTCHANNEL_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/thread.hpp>
+#include "../base/LockProfiler.h"
+
+namespace wss {
+
+/// \brief Persistent link to bot over Unix domain socket. Server listens, bot connects. Both directions carry
+/// frames: 4 bytes big-endian payload length, then payload json. Server sends messages addressed to bot,
+/// bot sends replies, that are routed as any other message.
+///
+/// Only one bot is connected at a time, new connection replaces previous one. While bot is disconnected,
+/// messages are kept, up to pending bytes limit, and sent to next connection. All socket work runs on single own thread.
+class BotChannel {
+ public:
+    /// \brief Handler of message json received from bot. Called on channel thread, next frames are not read until it returns
+    using MessageHandler = std::function<void(std::string &&json)>;
+
+    /// \brief Maximum frame payload in both directions
+    static const uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+    /// \param path socket file path, stale file is replaced
+    /// \param maxPendingBytes messages are dropped while this many bytes are waiting for bot
+    BotChannel(const std::string &path, std::size_t maxPendingBytes);
+    ~BotChannel();
+
+    BotChannel(const BotChannel &) = delete;
+    BotChannel &operator=(const BotChannel &) = delete;
+
+    void setMessageHandler(MessageHandler handler);
+
+    /// \brief Binds socket and starts accepting bot. Throws boost::system::system_error if socket can't be bound
+    void start();
+    void stop();
+    void join();
+
+    /// \brief Queue message to bot, any thread. Never blocks
+    /// \param json
+    /// \return false if message is dropped, because bot does not take messages fast enough (or is not connected)
+    bool send(const std::string &json);
+
+    bool isConnected() const;
+
+    /// \return queued and not yet written bytes
+    std::size_t getPending() const;
+
+    const std::string &getPath() const;
+
+ private:
+    using Socket = boost::asio::local::stream_protocol::socket;
+
+    const std::string m_path;
+    const std::size_t m_maxPendingBytes;
+
+    boost::asio::io_service m_ioService;
+    std::unique_ptr<boost::asio::io_service::work> m_work;
+    boost::asio::local::stream_protocol::acceptor m_acceptor;
+    std::unique_ptr<boost::thread> m_thread;
+    MessageHandler m_onMessage;
+
+    // channel thread only
+    // handlers keep their socket alive, it may be replaced by new connection meanwhile
+    std::shared_ptr<Socket> m_socket;
+    std::shared_ptr<Socket> m_accepting;
+    std::string m_writeBuffer;
+    bool m_inFlight = false;
+    std::string m_readBuffer;
+    char m_buffer[64 * 1024];
+
+    mutable wss::sync::Mutex m_mutex{"chat_bot_channel"};
+    bool m_connected = false;
+    bool m_writing = false;
+    // handlers of previous connection are ignored
+    uint64_t m_generation = 0;
+    std::string m_pending;
+
+    void accept();
+    void read(uint64_t generation);
+    void write();
+    void fail(uint64_t generation, const boost::system::error_code &ec);
+    bool handleFrames();
+};
+
+}
+
+#endif //WSSERVER_BOTCHANNEL_H
@@ -10,6 +10,42 @@
 #include "ChatServer.h"
 #include "../helpers/helpers.h"
 #include "../base/Settings.hpp"
+#include "../base/Metrics.h"
+#include "MessageTracer.h"
+#include "../base/Probes.h"
+#include "../base/Log.h"
+
+using wss::metrics::Registry;
+static wss::metrics::Counter &metricInboundFrames =
+    Registry::get().counter("wss_chat_inbound_frames_total", "WebSocket data frames received");
+static wss::metrics::Counter &metricInboundBytes =
+    Registry::get().counter("wss_chat_inbound_bytes_total", "WebSocket data frames payload bytes received");
+static wss::metrics::Histogram &metricParse =
+    Registry::get().histogram("wss_chat_parse_seconds", "Time of parsing and validating incoming payload");
+static wss::metrics::Histogram &metricRoute =
+    Registry::get().histogram("wss_chat_route_seconds",
+                              "Time of routing payload: event listeners, connections lookup and enqueue of writes");
+static wss::metrics::Histogram &metricWrite =
+    Registry::get().histogram("wss_chat_write_seconds", "Time from enqueue of write to connection till its completion");
+static wss::metrics::Gauge &metricSendQueue =
+    Registry::get().gauge("wss_chat_send_queue_depth", "Writes enqueued to connections and not completed yet");
+static wss::metrics::Gauge &metricUndelivered =
+    Registry::get().gauge("wss_chat_undelivered_messages", "Messages in undelivered queue");
+static wss::metrics::Histogram &metricAuth =
+    Registry::get().histogram("wss_chat_auth_seconds", "Time of connection authorization");
+static wss::metrics::Counter &metricHandshakeAccepted =
+    Registry::get().counter("wss_chat_handshakes_total", "WebSocket connections by handshake result",
+                            "result=\"accepted\"");
+static wss::metrics::Counter &metricHandshakeRejected =
+    Registry::get().counter("wss_chat_handshakes_total", "WebSocket connections by handshake result",
+                            "result=\"rejected\"");
+static wss::metrics::Counter &metricIngressMessages =
+    Registry::get().counter("wss_chat_ingress_messages_total", "Messages taken from shared memory ingress ring");
+static wss::metrics::Counter &metricIngressRejected =
+    Registry::get().counter("wss_chat_ingress_rejected_total", "Invalid or bot messages skipped in ingress ring");
+
+/// \brief Records routed at once, taken from ingress ring
+static const std::size_t INGRESS_BATCH = 256;
 
 
 wss::ChatServer::ChatServer(
@@ -18,7 +54,8 @@ wss::ChatServer::ChatServer(
     m_useSSL(true),
     m_maxMessageSize(10 * 1024 * 1024),
     m_server(std::make_unique<WssServer>(crtPath, privKeyPath)),
-    m_connectionStorage(std::make_unique<wss::ConnectionStorage>()) {
+    m_connectionStorage(std::make_unique<wss::ConnectionStorage>()),
+    m_rooms(std::make_unique<wss::RoomStorage>(wss::Settings::get().server.tmpDir + "/wsserver_rooms.bin")) {
 
 
     m_server->getConfig().port = port;
@@ -40,11 +77,11 @@ wss::ChatServer::ChatServer(
 
     m_endpoint->onOpen = std::bind(&wss::ChatServer::onConnected, this, std::placeholders::_1);
     m_endpoint->onError = [](WsConnectionPtr conn, const boost::system::error_code &ec) {
-      L_DEBUG_F("Server::Connection::Info", "Connection error[%lu]: %s %s",
-               conn->getId(),
-               ec.category().name(),
-               ec.message().c_str()
-      )
+      WSS_DEBUG_F("Server::Connection::Info", "Connection error[%lu]: %s %s",
+                 conn->getId(),
+                 ec.category().name(),
+                 ec.message().c_str()
+      );
     };
     m_endpoint->onClose = std::bind(&wss::ChatServer::onDisconnected,
                                     this,
@@ -52,13 +89,16 @@ wss::ChatServer::ChatServer(
                                     std::placeholders::_2,
                                     std::placeholders::_3);
 
+    setDeliveryConcurrency(wss::Settings::get().chat.delivery.shards, wss::Settings::get().chat.delivery.threads);
+    registerMetrics();
 }
 
 wss::ChatServer::ChatServer(const std::string &host, unsigned short port, const std::string &regexPath) :
     m_useSSL(false),
     m_maxMessageSize(10 * 1024 * 1024),
     m_server(std::make_unique<WsServer>()),
-    m_connectionStorage(std::make_unique<wss::ConnectionStorage>()) {
+    m_connectionStorage(std::make_unique<wss::ConnectionStorage>()),
+    m_rooms(std::make_unique<wss::RoomStorage>(wss::Settings::get().server.tmpDir + "/wsserver_rooms.bin")) {
     m_server->getConfig().port = port;
     m_server->getConfig().threadPoolSize = std::thread::hardware_concurrency();
     m_server->getConfig().maxMessageSize = m_maxMessageSize;
@@ -78,10 +118,10 @@ wss::ChatServer::ChatServer(const std::string &host, unsigned short port, const
 
     m_endpoint->onOpen = std::bind(&wss::ChatServer::onConnected, this, std::placeholders::_1);
     m_endpoint->onError = [](WsConnectionPtr, const boost::system::error_code &ec) {
-        L_DEBUG_F("Server::Connection::Info", "Connection error: %s %s",
-                 ec.category().name(),
-                 ec.message().c_str()
-        )
+        WSS_DEBUG_F("Server::Connection::Info", "Connection error: %s %s",
+                   ec.category().name(),
+                   ec.message().c_str()
+        );
     };
     m_endpoint->onClose = std::bind(&wss::ChatServer::onDisconnected,
                                     this,
@@ -89,17 +129,82 @@ wss::ChatServer::ChatServer(const std::string &host, unsigned short port, const
                                     std::placeholders::_2,
                                     std::placeholders::_3);
 
+    setDeliveryConcurrency(wss::Settings::get().chat.delivery.shards, wss::Settings::get().chat.delivery.threads);
+    registerMetrics();
+}
+
+void wss::ChatServer::registerMetrics() {
+    Registry::get().addCollector(this, "wss_chat_online_users", "Users with at least one connection",
+                                 [this](Registry::Samples &samples) {
+                                   samples.emplace_back("", (double) m_presence.count());
+                                 });
 }
 
 wss::ChatServer::~ChatServer() {
+    Registry::get().removeCollectors(this);
     stopService();
     joinThreads();
 }
 
+void wss::ChatServer::setCluster(std::unique_ptr<wss::cluster::Cluster> cluster) {
+    m_cluster = std::move(cluster);
+    // forwarded message is delivered only to local connections, never forwarded again
+    m_cluster->setMessageHandler([this](user_id_t recipient, std::string &&json) {
+      auto payload = std::make_shared<const MessagePayload>(MessagePayload::fromForwarded(std::move(json)));
+      if (!payload->isValid()) {
+          WSS_WARN_F("Chat::Cluster", "Invalid forwarded payload: %s", payload->getError().c_str());
+          return;
+      }
+      m_strands->post(recipient, [this, recipient, payload] {
+        deliverTo(recipient, *payload, false);
+      });
+    });
+    // not sent to node, because link to it was lost
+    m_cluster->setReturnHandler([this](user_id_t recipient, std::string &&json) {
+      auto payload = std::make_shared<const MessagePayload>(MessagePayload::fromForwarded(std::move(json)));
+      m_strands->post(recipient, [this, recipient, payload] {
+        if (!m_connectionStorage->size(recipient)) {
+            handleUndeliverable(recipient, *payload);
+        }
+      });
+    });
+}
+void wss::ChatServer::setBotChannel(std::unique_ptr<wss::BotChannel> channel) {
+    m_botChannel = std::move(channel);
+    // bot replies are routed as messages sent through REST API
+    m_botChannel->setMessageHandler([this](std::string &&json) {
+      const MessagePayload payload(json);
+      if (!payload.isValid() || payload.isForBot()) {
+          WSS_WARN_F("Bot", "Skipped message from bot: %s",
+                     payload.isValid() ? "bot can't send message to itself" : payload.getError().c_str());
+          return;
+      }
+      send(payload);
+    });
+}
+void wss::ChatServer::setIngress(std::unique_ptr<wss::IngressRing> ring,
+                                 std::size_t spin,
+                                 std::chrono::milliseconds idleWait) {
+    m_ingress = std::move(ring);
+    m_ingressSpin = spin;
+    m_ingressIdleWait = idleWait;
+}
+void wss::ChatServer::setDeliveryConcurrency(std::size_t shards, std::size_t threads) {
+    m_strands = std::make_unique<wss::UserStrands>(shards, threads);
+    m_undelivered.clear();
+    m_undelivered.resize(m_strands->getShards());
+}
 void wss::ChatServer::setThreadPoolSize(std::size_t size) {
     m_server->getConfig().threadPoolSize = size;
 }
 void wss::ChatServer::joinThreads() {
+    if (m_cluster) {
+        m_cluster->join();
+    }
+    if (m_botChannel) {
+        m_botChannel->join();
+    }
+    m_strands->join();
     if (m_workerThread && m_workerThread->joinable()) {
         m_workerThread->join();
     }
@@ -107,6 +212,10 @@ void wss::ChatServer::joinThreads() {
     if (m_watchdogThread && m_watchdogThread->joinable()) {
         m_watchdogThread->join();
     }
+
+    if (m_ingressThread && m_ingressThread->joinable()) {
+        m_ingressThread->join();
+    }
 }
 void wss::ChatServer::detachThreads() {
     if (m_workerThread) {
@@ -115,6 +224,9 @@ void wss::ChatServer::detachThreads() {
     if (m_watchdogThread) {
         m_watchdogThread->detach();
     }
+    if (m_ingressThread) {
+        m_ingressThread->detach();
+    }
 }
 void wss::ChatServer::runService() {
     std::string hostname = "0.0.0.0";
@@ -122,23 +234,47 @@ void wss::ChatServer::runService() {
         hostname = m_server->getConfig().address;
     }
     const char *proto = m_useSSL ? "wss" : "ws";
-    L_INFO_F("WebSocket Server", "Started at %s://%s:%d", proto, hostname.c_str(),
-             m_server->getConfig().port);
+    m_rooms->load();
+    m_strands->start();
+    if (m_cluster) {
+        m_cluster->start();
+    }
+    if (m_botChannel) {
+        m_botChannel->start();
+    }
+    WSS_INFO_F("WebSocket Server", "Started at %s://%s:%d", proto, hostname.c_str(),
+               m_server->getConfig().port);
     m_workerThread = std::make_unique<boost::thread>([this] {
       this->m_server->start();
     });
 
     if (wss::Settings::get().server.watchdog.enabled) {
-        L_INFO("Watchdog", "Started with interval in 1 minute");
+        WSS_INFO("Watchdog", "Started with interval in 1 minute");
         m_watchdogThread =
             std::make_unique<boost::thread>(boost::bind(&wss::ChatServer::watchdogWorker, this));
     }
+
+    if (m_ingress) {
+        WSS_INFO_F("Ingress", "Reading ring of %lu bytes", m_ingress->getCapacity());
+        m_ingressThread = std::make_unique<boost::thread>(boost::bind(&wss::ChatServer::ingressWorker, this));
+    }
 }
 void wss::ChatServer::stopService() {
     this->m_server->stop();
+    if (m_cluster) {
+        m_cluster->stop();
+    }
+    if (m_botChannel) {
+        m_botChannel->stop();
+    }
+    m_strands->stop();
     if (m_watchdogThread) {
         m_watchdogThread->interrupt();
     }
+    if (m_ingressThread) {
+        m_ingressThread->interrupt();
+        m_ingress->wake();
+    }
 }
 
 void wss::ChatServer::watchdogWorker() {
@@ -152,13 +288,60 @@ void wss::ChatServer::watchdogWorker() {
                 "Dangling connection"
             );
             if (disconnected > 0) {
-                L_DEBUG_F("Watchdog", "Disconnected %lu dangling connections", disconnected);
+                WSS_DEBUG_F("Watchdog", "Disconnected %lu dangling connections", disconnected);
             }
 
             m_connectionStorage->verify(FLAG_PING);
         }
     } catch (const boost::thread_interrupted &) {
-        L_INFO("Watchdog", "Stopping...");
+        WSS_INFO("Watchdog", "Stopping...");
+    }
+}
+
+void wss::ChatServer::ingressWorker() {
+    std::vector<MessagePayload> batch;
+    batch.reserve(INGRESS_BATCH);
+    std::size_t idle = 0;
+    const auto take = [this, &batch](const char *data, std::size_t size) {
+      MessagePayload payload(std::string(data, size));
+      if (!payload.isValid() || payload.isForBot()) {
+          metricIngressRejected.inc();
+          WSS_WARN_F("Ingress", "Skipped message: %s",
+                     payload.isValid() ? "can't send message to bot" : payload.getError().c_str());
+          return;
+      }
+      batch.push_back(std::move(payload));
+    };
+
+    try {
+        while (true) {
+            if (m_ingress->drain(take, INGRESS_BATCH) == 0) {
+                // spin keeps latency in microseconds while producers are active, then producers wake worker
+                if (++idle < m_ingressSpin) {
+                    boost::this_thread::yield();
+                } else {
+                    m_ingress->wait(m_ingressIdleWait);
+                }
+                boost::this_thread::interruption_point();
+                continue;
+            }
+
+            idle = 0;
+            if (!batch.empty()) {
+                metricIngressMessages.inc(batch.size());
+                sendBatch(batch);
+                batch.clear();
+            }
+        }
+    } catch (const boost::thread_interrupted &) {
+        WSS_INFO("Ingress", "Stopping...");
+    } catch (const std::runtime_error &e) {
+        // ring is closed by consumer, producers stop writing to it. Records before corrupted one are taken
+        WSS_ERR_F("Ingress", "Stopped reading ring: %s", e.what());
+        if (!batch.empty()) {
+            metricIngressMessages.inc(batch.size());
+            sendBatch(batch);
+        }
     }
 }
 
@@ -167,24 +350,27 @@ void wss::ChatServer::onPong(wss::WsConnectionPtr &connection, wss::WsMessagePtr
 }
 
 void wss::ChatServer::onMessage(WsConnectionPtr &connection, WsMessagePtr message) {
-    std::lock_guard<std::recursive_mutex> lock(m_connectionMutex);
-    L_DEBUG_F("Chat::Incoming", "On thread: %lu", getThreadName());
+    wss::MessageTracer::Scope trace(wss::MessageTracer::get(), message->receivedAt);
+    trace.dispatched();
+    WSS_DEBUG_F("Chat::Incoming", "On thread: %lu", getThreadName());
     MessagePayload payload;
     const short opcode = message->fin_rsv_opcode;
+    metricInboundFrames.inc();
+    metricInboundBytes.inc(message->size());
 
     if (opcode != FLAG_FRAME_TEXT && opcode != FLAG_FRAME_BINARY) {
         // fragmented frame message
         user_id_t senderId = connection->getId();
 
         if (opcode == FLAG_FRAGMENT_BEGIN_TEXT || opcode == FLAG_FRAGMENT_BEGIN_BINARY) {
-            L_DEBUG_F("Chat::Message", "Fragmented frame begin (flag: 0x%08x)", opcode);
+            WSS_DEBUG_F("Chat::Message", "Fragmented frame begin (flag: 0x%08x)", opcode);
             writeFrameBuffer(senderId, message->string(), true);
             return;
         } else if (opcode == FLAG_FRAGMENT_CONTINUE) {
             writeFrameBuffer(senderId, message->string(), false);
             return;
         } else if (opcode == FLAG_FRAGMENT_END) {
-            L_DEBUG("Chat::Message", "Fragmented frame end");
+            WSS_DEBUG("Chat::Message", "Fragmented frame end");
             std::stringstream final;
             final << readFrameBuffer(senderId, true);
             final << message->string();
@@ -202,17 +388,32 @@ void wss::ChatServer::onMessage(WsConnectionPtr &connection, WsMessagePtr messag
                 return;
             }
 
+            const auto parseStart = std::chrono::steady_clock::now();
             payload = MessagePayload(buffered);
+            metricParse.observeSince(parseStart);
         }
     } else {
         // one frame message
+        const auto parseStart = std::chrono::steady_clock::now();
         payload = MessagePayload(message->string());
+        metricParse.observeSince(parseStart);
     }
 
     if (!payload.isValid()) {
         connection->sendClose(STATUS_INVALID_MESSAGE_PAYLOAD, "Invalid payload. " + payload.getError());
         return;
     }
+    trace.parsed(payload.getSender(), message->size());
+
+    // sender field is set by client, membership is checked for authenticated connection user
+    if (payload.isForRoom() && payload.getSender() != connection->getId()) {
+        connection->sendClose(STATUS_INVALID_MESSAGE_PAYLOAD, "Invalid payload. Sender does not match connection");
+        return;
+    }
+    if (payload.isForRoom() && !m_rooms->isMember(payload.getRoom(), connection->getId())) {
+        connection->sendClose(STATUS_INVALID_MESSAGE_PAYLOAD, "Invalid payload. Sender is not a member of room");
+        return;
+    }
 
     if (wss::Settings::get().chat.message.enableSendBack) {
         bool isIgnoredType = false;
@@ -227,7 +428,9 @@ void wss::ChatServer::onMessage(WsConnectionPtr &connection, WsMessagePtr messag
         }
     }
 
+    const auto routeStart = std::chrono::steady_clock::now();
     send(payload);
+    metricRoute.observeSince(routeStart);
 }
 
 void wss::ChatServer::onMessageSent(wss::MessagePayload &&payload, std::size_t bytesTransferred, bool hasSent) {
@@ -255,13 +458,15 @@ void wss::ChatServer::onConnected(WsConnectionPtr connection) {
     request.setHeaders(connection->header);
 
     if (request.getParams().empty()) {
-        L_DEBUG_F("Chat::Connect::Error", "Invalid request: %s", connection->queryString.c_str());
+        WSS_DEBUG_F("Chat::Connect::Error", "Invalid request: %s", connection->queryString.c_str());
         connection->sendClose(STATUS_INVALID_QUERY_PARAMS, "Invalid request");
+        metricHandshakeRejected.inc();
         return;
     } else if (!request.hasParam("id") || request.getParam("id").empty()) {
-        L_DEBUG("Chat::Connect::Error", "Id required in query parameter: ?id={id}");
+        WSS_DEBUG("Chat::Connect::Error", "Id required in query parameter: ?id={id}");
 
         connection->sendClose(STATUS_INVALID_QUERY_PARAMS, "Id required in query parameter: ?id={id}");
+        metricHandshakeRejected.inc();
         return;
     }
 
@@ -270,51 +475,63 @@ void wss::ChatServer::onConnected(WsConnectionPtr connection) {
         id = std::stoul(request.getParam("id"));
     } catch (const std::invalid_argument &e) {
         const std::string errReason = "Passed invalid id: id=" + request.getParam("id") + ". " + e.what();
-        L_DEBUG("Chat::Connect::Error", errReason);
+        WSS_DEBUG("Chat::Connect::Error", errReason);
         connection->sendClose(STATUS_INVALID_QUERY_PARAMS, errReason);
+        metricHandshakeRejected.inc();
         return;
     }
 
     boost::thread authThread([this, id, connection, request] {
+      const auto authStart = std::chrono::steady_clock::now();
       bool authorized = m_auth->validateAuth(request);
+      const auto authTime = std::chrono::steady_clock::now() - authStart;
+      metricAuth.observe(authTime);
 
       if (!authorized) {
+          WSS_PROBE(auth_done, connection.get(), id, 0, 0,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(authTime).count());
           connection->sendClose(STATUS_UNAUTHORIZED, "Unauthorized");
+          metricHandshakeRejected.inc();
           return;
       }
+      metricHandshakeAccepted.inc();
 
-      {
-          std::lock_guard<std::recursive_mutex> conLock(m_connectionMutex);
-          m_connectionStorage->add(id, connection);
-      }
+      // messages sent to user before, are redelivered before any new one
+      m_strands->post(id, [this, id, connection, authTime] {
+        m_connectionStorage->add(id, connection);
+        WSS_PROBE(auth_done, connection.get(), id, connection->getUniqueId(), 1,
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(authTime).count());
 
-      getStat(id)->addConnection();
+        updateConnectionStat(id, true);
 
-      L_DEBUG_F("Chat::Connect", "User %lu connected (%s:%d) on thread %lu",
-                id,
-                connection->remoteEndpointAddress().c_str(),
-                connection->remoteEndpointPort(),
-                getThreadName()
-      );
+        WSS_DEBUG_F("Chat::Connect", "User %lu connected (%s:%d) on thread %lu",
+                    id,
+                    connection->remoteEndpointAddress().c_str(),
+                    connection->remoteEndpointPort(),
+                    getThreadName()
+        );
 
-      redeliverMessagesTo(id);
+        redeliverMessagesTo(id);
+      });
     });
     authThread.detach();
 }
 void wss::ChatServer::onDisconnected(WsConnectionPtr connection, int status, const std::string &reason) {
-    if (!m_connectionStorage->exists(connection->getId())) {
-        return;
-    }
+    m_strands->post(connection->getId(), [this, connection, status, reason] {
+      if (!m_connectionStorage->exists(connection->getId())) {
+          return;
+      }
 
-    L_DEBUG_F("Chat::Disconnect", "User %lu (%lu) has disconnected by reason: %s[%d]",
-              connection->getId(),
-              connection->getUniqueId(),
-              reason.c_str(),
-              status
-    );
+      WSS_DEBUG_F("Chat::Disconnect", "User %lu (%lu) has disconnected by reason: %s[%d]",
+                  connection->getId(),
+                  connection->getUniqueId(),
+                  reason.c_str(),
+                  status
+      );
 
-    getStat(connection->getId())->addDisconnection();
-    m_connectionStorage->remove(connection);
+      updateConnectionStat(connection->getId(), false);
+      m_connectionStorage->remove(connection);
+    });
 }
 
 bool wss::ChatServer::hasFrameBuffer(wss::user_id_t senderId) {
@@ -322,7 +539,7 @@ bool wss::ChatServer::hasFrameBuffer(wss::user_id_t senderId) {
 }
 
 bool wss::ChatServer::writeFrameBuffer(wss::user_id_t senderId, const std::string &input, bool clear) {
-    std::lock_guard<std::mutex> fbLock(m_frameBufferMutex);
+    std::lock_guard<wss::sync::Mutex> fbLock(m_frameBufferMutex);
     if (!hasFrameBuffer(senderId)) {
         m_frameBuffer[senderId] = std::make_shared<std::stringstream>();
     } else if (clear) {
@@ -334,7 +551,7 @@ bool wss::ChatServer::writeFrameBuffer(wss::user_id_t senderId, const std::strin
     return true;
 }
 const std::string wss::ChatServer::readFrameBuffer(wss::user_id_t senderId, bool clear) {
-    std::lock_guard<std::mutex> fbLock(m_frameBufferMutex);
+    std::lock_guard<wss::sync::Mutex> fbLock(m_frameBufferMutex);
     if (!hasFrameBuffer(senderId)) {
         return std::string();
     }
@@ -346,45 +563,22 @@ const std::string wss::ChatServer::readFrameBuffer(wss::user_id_t senderId, bool
     return out;
 }
 
-int wss::ChatServer::redeliverMessagesTo(const wss::MessagePayload &payload) {
-    int cnt = 0;
-    for (user_id_t id: payload.getRecipients()) {
-        cnt += redeliverMessagesTo(id);
-    }
-
-    return cnt;
-}
 bool wss::ChatServer::hasUndeliveredMessages(user_id_t recipientId) {
-    std::lock_guard<std::mutex> locker(m_undeliveredMutex);
-    L_DEBUG_F("Chat::Underlivered",
-              "Check for undelivered messages for user %lu: %lu",
-              recipientId,
-              m_undeliveredMessagesMap[recipientId].size());
-    return !m_undeliveredMessagesMap[recipientId].empty();
+    const UserMap<MessageQueue> &shard = m_undelivered[m_strands->shardOf(recipientId)];
+    const auto it = shard.find(recipientId);
+    WSS_DEBUG_F("Chat::Underlivered",
+                "Check for undelivered messages for user %lu: %lu",
+                recipientId,
+                it == shard.end() ? 0 : it->second.size());
+    return it != shard.end() && !it->second.empty();
 }
 wss::MessageQueue &wss::ChatServer::getUndeliveredMessages(user_id_t recipientId) {
-    std::lock_guard<std::mutex> locker(m_undeliveredMutex);
-    return m_undeliveredMessagesMap[recipientId];
+    return m_undelivered[m_strands->shardOf(recipientId)][recipientId];
 }
 
-std::vector<wss::MessageQueue *>
-wss::ChatServer::getUndeliveredMessages(const MessagePayload &payload) {
-    std::vector<wss::MessageQueue *> out;
-    {
-        std::lock_guard<std::mutex> locker(m_undeliveredMutex);
-        for (user_id_t id: payload.getRecipients()) {
-            out.push_back(&m_undeliveredMessagesMap[id]);
-        }
-    }
-
-    return out;
-}
-
-void wss::ChatServer::enqueueUndeliveredMessage(const wss::MessagePayload &payload) {
-    std::unique_lock<std::mutex> uniqueLock(m_undeliveredMutex);
-    for (auto recipient: payload.getRecipients()) {
-        m_undeliveredMessagesMap[recipient].push(payload);
-    }
+void wss::ChatServer::enqueueUndeliveredMessage(user_id_t recipientId, const wss::MessagePayload &payload) {
+    getUndeliveredMessages(recipientId).push(payload);
+    metricUndelivered.add();
 }
 int wss::ChatServer::redeliverMessagesTo(user_id_t recipientId) {
     if (not wss::Settings::get().chat.enableUndeliveredQueue) {
@@ -395,13 +589,20 @@ int wss::ChatServer::redeliverMessagesTo(user_id_t recipientId) {
         return 0;
     }
 
+    // taken out, as messages that fail again are enqueued back
+    MessageQueue queue;
+    std::swap(queue, getUndeliveredMessages(recipientId));
+    m_undelivered[m_strands->shardOf(recipientId)].erase(recipientId);
+
     int cnt = 0;
-    auto &queue = getUndeliveredMessages(recipientId);
-    L_DEBUG_F("Chat::Undelivered", "Redeliver %lu message(s) to user %lu", queue.size(), recipientId);
+    WSS_DEBUG_F("Chat::Undelivered", "Redeliver %lu message(s) to user %lu", queue.size(), recipientId);
     while (!queue.empty()) {
-        MessagePayload payload = queue.front();
+        MessagePayload payload = std::move(queue.front());
         queue.pop();
-        send(payload);
+        metricUndelivered.sub();
+        callOnMessageListeners(payload);
+        // already on recipient strand: delivered right now, ahead of messages waiting in strand
+        deliverTo(recipientId, payload);
         cnt++;
     }
 
@@ -409,103 +610,245 @@ int wss::ChatServer::redeliverMessagesTo(user_id_t recipientId) {
 }
 
 void wss::ChatServer::send(const wss::MessagePayload &payload) {
+    // serialize once: event listeners receive payload copy with cached json, recipients share single copy with it
+    payload.toJson();
+
     // if recipient is a BOT, than we don't need to find conneciton, just trigger event notifier ilsteners
     if (payload.isForBot()) {
         callOnMessageListeners(payload);
-        L_DEBUG("Chat::Send", "Sending message to bot");
+        WSS_DEBUG("Chat::Send", "Sending message to bot");
+        if (m_botChannel) {
+            m_botChannel->send(payload.toJson());
+        }
         return;
     }
 
     callOnMessageListeners(payload);
 
+    const auto shared = std::make_shared<const MessagePayload>(payload);
+    if (payload.isForRoom()) {
+        publishTo(payload.getRoom(), shared);
+        return;
+    }
+
     for (user_id_t uid: payload.getRecipients()) {
         if (uid == 0L) {
             // just in case, prevent sending bot-only message to nobody
             continue;
         }
 
-        sendTo(uid, payload);
+        postTo(uid, shared);
+    }
+}
+
+void wss::ChatServer::sendBatch(const std::vector<wss::MessagePayload> &payloads) {
+    for (std::size_t i = 0; i < payloads.size(); i++) {
+        // serialized once for all recipients and connections
+        payloads[i].toJson();
+        callOnMessageListeners(payloads[i]);
+        if (payloads[i].isForBot()) {
+            if (m_botChannel) {
+                m_botChannel->send(payloads[i].toJson());
+            }
+        } else if (payloads[i].isForRoom()) {
+            publishTo(payloads[i].getRoom(), std::make_shared<const MessagePayload>(payloads[i]));
+        }
+    }
+
+    // single batch copy shared by all recipient strands, messages to one recipient keep batch order
+    const auto shared = std::make_shared<const std::vector<MessagePayload>>(payloads);
+    for (auto &group: wss::groupByRecipient(payloads)) {
+        const user_id_t recipient = group.first;
+        auto indexes = std::make_shared<const std::vector<std::size_t>>(std::move(group.second));
+        m_strands->post(recipient, [this, recipient, shared, indexes] {
+          deliverTo(recipient, *shared, *indexes);
+        });
     }
 }
 
 void wss::ChatServer::sendTo(user_id_t recipient, const wss::MessagePayload &payload) {
-    using toolboxpp::Logger;
-    const std::string payloadString = payload.toJson();
-    std::size_t payloadSize = payloadString.length();
-    uint8_t fin_rsv_opcode = 129;//@TODO static_cast<uint8_t>(payload.isBinary() ? 130 : 129);
+    payload.toJson();
+    postTo(recipient, std::make_shared<const MessagePayload>(payload));
+}
+
+void wss::ChatServer::postTo(user_id_t recipient, std::shared_ptr<const wss::MessagePayload> payload) {
+    // message trace continues on strand thread
+    wss::MessageTracer::Handoff trace;
+    m_strands->post(recipient, [this, recipient, payload, trace] {
+      wss::MessageTracer::Scope scope(trace);
+      deliverTo(recipient, *payload);
+    });
+}
+
+void wss::ChatServer::publishTo(room_id_t room, std::shared_ptr<const wss::MessagePayload> payload) {
+    const wss::RoomStorage::Members members = m_rooms->getMembers(room);
+    if (!members) {
+        WSS_DEBUG_F("Chat::Send", "Room %lu does not exist, message skipped", room);
+        return;
+    }
 
-//    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    // members grouped by shard in single array: offsets[shard]..offsets[shard + 1] are members of shard
+    const std::size_t shards = m_strands->getShards();
+    std::vector<std::size_t> offsets(shards + 1, 0);
+    for (user_id_t uid: *members) {
+        if (uid != payload->getSender()) {
+            offsets[m_strands->shardOf(uid) + 1]++;
+        }
+    }
+    for (std::size_t i = 1; i <= shards; i++) {
+        offsets[i] += offsets[i - 1];
+    }
+    auto grouped = std::make_shared<std::vector<user_id_t>>(offsets[shards]);
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (user_id_t uid: *members) {
+        if (uid != payload->getSender()) {
+            (*grouped)[fill[m_strands->shardOf(uid)]++] = uid;
+        }
+    }
+
+    wss::MessageTracer::Handoff trace;
+    for (std::size_t shard = 0; shard < shards; shard++) {
+        const std::size_t begin = offsets[shard], end = offsets[shard + 1];
+        if (begin == end) {
+            continue;
+        }
+        m_strands->postToShard(shard, [this, payload, grouped, begin, end, trace] {
+          wss::MessageTracer::Scope scope(trace);
+          for (std::size_t i = begin; i < end; i++) {
+              deliverTo((*grouped)[i], *payload);
+          }
+        });
+    }
+}
+
+void wss::ChatServer::deliverTo(user_id_t recipient, const wss::MessagePayload &payload, bool forward) {
+    // recipient connected to other cluster nodes gets message there too
+    const uint64_t remoteNodes = forward && m_cluster ? m_cluster->getRemoteNodes(recipient) : 0;
+    if (remoteNodes != 0) {
+        m_cluster->forward(remoteNodes, recipient, payload.toJson());
+    }
 
     if (!m_connectionStorage->size(recipient)) {
+        if (remoteNodes != 0) {
+            return;
+        }
         handleUndeliverable(recipient, payload);
         MessagePayload sent = payload; // copy to move, referenced payload will goes out of scope
         sent.setRecipient(recipient);
-        onMessageSent(std::move(sent), payloadSize, false);
+        onMessageSent(std::move(sent), payload.toJson().length(), false);
         return;
     }
 
-        m_connectionStorage->forEach(recipient, [this, fin_rsv_opcode, payload, payloadString]
-        (size_t i, const wss::WsConnectionPtr &conn, wss::conn_id_t cid, wss::user_id_t uid){
-          // DO NOT reuse stream, it will die after first sending
-          auto sendStream = std::make_shared<WsMessageStream>();
-          *sendStream << payloadString;
-
-          Logger::get().debug(__FILE__, __LINE__, "Chat::Send",
-                              fmt::format("Sending message [thread={0}] to recipient {1}, connection[{2}]",
-                                          getThreadName(), uid, i
-                              ));
-
-          // connection->send is an asynchronous function
-          conn->send(sendStream, [this, uid, payload, cid]
-              (const wss::server::websocket::ErrorCode &errorCode, std::size_t ts) {
-            if (errorCode) {
-                // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
-                Logger::get().debug(__FILE__, __LINE__, "Chat::Send::Error",
-                                    fmt::format(
-                                        "Unable to send message to {0}. Cause: {1} error: {2}",
-                                        uid, errorCode.category().name(), errorCode.message()
-                                    ));
-
-                if (errorCode.value() == boost::system::errc::broken_pipe) {
-                    Logger::get().debug(__FILE__, __LINE__, "Chat::Send::Error",
-                                        fmt::format("Disconnecting Broken connection {0} ({1})", uid, cid));
-                    m_connectionStorage->remove(uid, cid);
-                }
-                handleUndeliverable(uid, payload);
-            } else {
-                MessagePayload sent = payload;
-                sent.setRecipient(uid);
-                onMessageSent(std::move(sent), ts, true);
+    m_connectionStorage->forEach(recipient, [this, &payload]
+        (size_t i, const wss::WsConnectionPtr &conn, wss::conn_id_t cid, wss::user_id_t uid) {
+      sendToConnection(conn, cid, uid, payload);
+    }, [this, &payload](wss::user_id_t uid, wss::conn_id_t) {
+      WSS_DEBUG("Chat::Send", "Connection not found exception. Adding payload to undelivered");
+      handleUndeliverable(uid, payload);
+    });
+}
+
+void wss::ChatServer::deliverTo(user_id_t recipient,
+                                const std::vector<wss::MessagePayload> &payloads,
+                                const std::vector<std::size_t> &indexes) {
+    const uint64_t remoteNodes = m_cluster ? m_cluster->getRemoteNodes(recipient) : 0;
+    if (remoteNodes != 0) {
+        for (std::size_t idx: indexes) {
+            m_cluster->forward(remoteNodes, recipient, payloads[idx].toJson());
+        }
+    }
+
+    if (!m_connectionStorage->size(recipient)) {
+        if (remoteNodes != 0) {
+            return;
+        }
+        for (std::size_t idx: indexes) {
+            handleUndeliverable(recipient, payloads[idx]);
+            MessagePayload sent = payloads[idx];
+            sent.setRecipient(recipient);
+            onMessageSent(std::move(sent), payloads[idx].toJson().length(), false);
+        }
+        return;
+    }
+
+    // single connections lookup (and lock) for all recipient messages of batch
+    m_connectionStorage->forEach(recipient, [this, &payloads, &indexes]
+        (size_t i, const wss::WsConnectionPtr &conn, wss::conn_id_t cid, wss::user_id_t uid) {
+      for (std::size_t idx: indexes) {
+          sendToConnection(conn, cid, uid, payloads[idx]);
+      }
+    }, [this, &payloads, &indexes](wss::user_id_t uid, wss::conn_id_t) {
+      WSS_DEBUG("Chat::Send", "Connection not found exception. Adding payload to undelivered");
+      for (std::size_t idx: indexes) {
+          handleUndeliverable(uid, payloads[idx]);
+      }
+    });
+}
+
+void wss::ChatServer::sendToConnection(const wss::WsConnectionPtr &conn,
+                                       wss::conn_id_t cid,
+                                       wss::user_id_t uid,
+                                       const wss::MessagePayload &payload) {
+    wss::MessageTracer::DeliveryTrace trace(uid, cid);
+    uint8_t fin_rsv_opcode = 129;//@TODO static_cast<uint8_t>(payload.isBinary() ? 130 : 129);
+
+    // DO NOT reuse stream, it will die after first sending
+    auto sendStream = std::make_shared<WsMessageStream>();
+    *sendStream << payload.toJson();
+
+    WSS_DEBUG_F("Chat::Send", "Sending message [thread=%lu] to recipient %lu, connection[%lu]",
+                getThreadName(), uid, cid);
+
+    metricSendQueue.add();
+    const auto writeStart = std::chrono::steady_clock::now();
+    trace.enqueued();
+
+    // connection->send is an asynchronous function
+    conn->send(sendStream, [this, uid, payload, cid, writeStart, trace, sendStream]
+        (const wss::server::websocket::ErrorCode &errorCode, std::size_t ts) mutable {
+      metricSendQueue.sub();
+      metricWrite.observeSince(writeStart);
+      trace.completed(sendStream->writeStartedAt, !errorCode);
+      WSS_PROBE(write_completed, uid, cid, ts, errorCode.value());
+      if (errorCode) {
+          // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
+          WSS_DEBUG_F("Chat::Send::Error", "Unable to send message to %lu. Cause: %s error: %s",
+                      uid, errorCode.category().name(), errorCode.message());
+
+          const bool brokenPipe = errorCode.value() == boost::system::errc::broken_pipe;
+          m_strands->post(uid, [this, uid, cid, brokenPipe, failed = std::move(payload)] {
+            if (brokenPipe) {
+                WSS_DEBUG_F("Chat::Send::Error", "Disconnecting Broken connection %lu (%lu)", uid, cid);
+                m_connectionStorage->remove(uid, cid);
             }
-          }, fin_rsv_opcode);
-        }, [this, payload] (wss::user_id_t uid, wss::conn_id_t) {
-          L_DEBUG("Chat::Send", "Connection not found exception. Adding payload to undelivered");
-          handleUndeliverable(uid, payload);
-        });
+            handleUndeliverable(uid, failed);
+          });
+      } else {
+          MessagePayload sent = payload;
+          sent.setRecipient(uid);
+          onMessageSent(std::move(sent), ts, true);
+      }
+    }, fin_rsv_opcode);
+    WSS_PROBE(message_routed, payload.getSender(), uid, cid, sendStream->size());
 }
 
 void wss::ChatServer::handleUndeliverable(wss::user_id_t uid, const wss::MessagePayload &payload) {
+    WSS_PROBE(message_undeliverable, payload.getSender(), uid, payload.toJson().length());
     if (!wss::Settings::get().chat.enableUndeliveredQueue) {
-        L_DEBUG_F("Chat::Send", "User %lu is unavailable. Skipping message.", uid);
+        WSS_DEBUG_F("Chat::Send", "User %lu is unavailable. Skipping message.", uid);
         return;
     }
     MessagePayload inaccessibleUserPayload = payload;
     inaccessibleUserPayload.setRecipient(uid);
     // as messages did not sent to exact user, we add to undelivered queue exact this user in payload recipients
-    enqueueUndeliveredMessage(inaccessibleUserPayload);
-    L_DEBUG_F("Chat::Send", "User %lu is unavailable. Adding message to queue", uid);
+    enqueueUndeliveredMessage(uid, inaccessibleUserPayload);
+    WSS_DEBUG_F("Chat::Send", "User %lu is unavailable. Adding message to queue", uid);
 }
 
 std::size_t wss::ChatServer::getThreadName() {
-    const std::thread::id id = std::this_thread::get_id();
-    static std::size_t nextindex = 0;
-    static std::mutex my_mutex;
-    static std::map<std::thread::id, std::size_t> ids;
-    std::lock_guard<std::mutex> lock(my_mutex);
-    if (ids.find(id) == ids.end())
-        ids[id] = nextindex++;
-
-    return ids[id];
+    static std::atomic_size_t nextIndex(0);
+    thread_local const std::size_t index = nextIndex++;
+    return index;
 }
 void wss::ChatServer::setMessageSizeLimit(size_t bytes) {
     m_maxMessageSize = bytes;
@@ -526,7 +869,7 @@ void wss::ChatServer::addStopListener(wss::ChatServer::OnServerStopListener call
     m_stopListeners.push_back(callback);
 }
 std::unique_ptr<wss::Statistics> &wss::ChatServer::getStat(wss::user_id_t id) {
-    std::lock_guard<std::mutex> locker(m_statMutex);
+    std::lock_guard<wss::sync::Mutex> locker(m_statMutex);
     if (m_statistics.find(id) == m_statistics.end()) {
         m_statistics[id] = std::make_unique<wss::Statistics>(id);
     }
@@ -534,9 +877,56 @@ std::unique_ptr<wss::Statistics> &wss::ChatServer::getStat(wss::user_id_t id) {
     return m_statistics[id];
 }
 
+void wss::ChatServer::updateConnectionStat(wss::user_id_t id, bool connected) {
+    std::lock_guard<wss::sync::Mutex> locker(m_statMutex);
+    auto &stat = m_statistics[id];
+    if (!stat) {
+        stat = std::make_unique<wss::Statistics>(id);
+    }
+
+    if (connected) {
+        stat->addConnection();
+    } else {
+        stat->addDisconnection();
+    }
+    // user may have several connections, bit is cleared only with the last one
+    const bool wasOnline = m_presence.isOnline(id);
+    m_presence.set(id, stat->isOnline());
+    if (m_cluster && wasOnline != stat->isOnline()) {
+        m_cluster->setLocalPresence(id, stat->isOnline());
+    }
+}
+
+bool wss::ChatServer::isOnline(wss::user_id_t id) const {
+    return m_presence.isOnline(id);
+}
+
+wss::RoomStorage &wss::ChatServer::getRooms() {
+    return *m_rooms;
+}
+const wss::PresenceMap &wss::ChatServer::getPresence() const {
+    return m_presence;
+}
+
 const wss::UserMap<std::unique_ptr<wss::Statistics>> &wss::ChatServer::getStats() {
     return m_statistics;
 }
+void wss::ChatServer::forEachStat(const std::function<void(wss::user_id_t, wss::Statistics &)> &callback) {
+    std::lock_guard<wss::sync::Mutex> locker(m_statMutex);
+    for (auto &stat: m_statistics) {
+        callback(stat.first, *stat.second);
+    }
+}
+void wss::ChatServer::forEachStat(const std::vector<wss::user_id_t> &ids,
+                                  const std::function<void(wss::user_id_t, wss::Statistics &)> &callback) {
+    std::lock_guard<wss::sync::Mutex> locker(m_statMutex);
+    for (wss::user_id_t id: ids) {
+        const auto it = m_statistics.find(id);
+        if (it != m_statistics.end()) {
+            callback(id, *it->second);
+        }
+    }
+}
 void wss::ChatServer::callOnMessageListeners(wss::MessagePayload payload) {
     for (auto &listener: m_messageListeners) {
         listener(std::move(payload));
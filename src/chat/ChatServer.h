@@ -21,6 +21,7 @@
 #include <utility>
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include <ctime>
 #include <functional>
 #include <toolboxpp.h>
@@ -32,6 +33,14 @@
 #include "ConnectionStorage.h"
 #include "../base/auth/Auth.h"
 #include "Statistics.h"
+#include "PresenceMap.h"
+#include "UserStrands.h"
+#include "RoomStorage.h"
+#include "RecipientGroups.h"
+#include "IngressRing.h"
+#include "BotChannel.h"
+#include "../cluster/Cluster.h"
+#include "../base/LockProfiler.h"
 
 namespace wss {
 
@@ -154,14 +163,44 @@ class ChatServer : public virtual StandaloneService {
     void runService() override;
     void stopService() override;
 
-    /// \brief Send payload. Payload already contains recipients and sender
+    /// \brief Send payload. Payload already contains recipients and sender. Room payload is sent to room members
+    /// except sender, its recipients are not used
     /// \param payload
     void send(const MessagePayload &payload);
 
-    /// \brief Send payload to specified recipient. NOT used payload recipient
+    /// \brief Send payload to specified recipient. NOT used payload recipient. Delivery runs on recipient strand:
+    /// messages to one recipient are written in order of calls
     /// \param payload
     void sendTo(user_id_t recipient, const MessagePayload &payload);
 
+    /// \brief Send batch of payloads. Messages are grouped by recipient: connections of recipient are looked up once
+    /// for all its messages, each payload is serialized once for all recipients. Order of messages to one recipient
+    /// is kept as in batch. Room messages are published to room members ahead of direct ones.
+    /// \param payloads valid payloads, bot messages are only passed to message listeners and bot channel
+    void sendBatch(const std::vector<MessagePayload> &payloads);
+
+    /// \brief Set number of recipient strands and threads running them. Must be called before service is started
+    /// \param shards users are spread over shards by id, every shard delivers to its users sequentially
+    /// \param threads
+    void setDeliveryConcurrency(std::size_t shards, std::size_t threads);
+
+    /// \brief Enable cluster mode. Messages to users connected to other nodes are forwarded there,
+    /// undelivered queue is used only for users offline on all nodes. Must be called before service is started
+    /// \param cluster not started cluster node
+    void setCluster(std::unique_ptr<wss::cluster::Cluster> cluster);
+
+    /// \brief Enable shared memory ingress: own thread drains ring in batches and routes them like sendBatch().
+    /// Must be called before service is started
+    /// \param ring ring created by server side
+    /// \param spin empty ring polls with yield before worker waits on ring doorbell
+    /// \param idleWait longest doorbell wait, after it ring is polled again
+    void setIngress(std::unique_ptr<wss::IngressRing> ring, std::size_t spin, std::chrono::milliseconds idleWait);
+
+    /// \brief Enable bot channel: messages to bot (recipient 0) are written to it right away, in addition to
+    /// message listeners, and messages from bot are routed like send(). Must be called before service is started
+    /// \param channel not started channel
+    void setBotChannel(std::unique_ptr<wss::BotChannel> channel);
+
     /// \brief Max number of workers for incoming messages
     /// \param size Recommended - core numbers
     void setThreadPoolSize(std::size_t size);
@@ -193,6 +232,28 @@ class ChatServer : public virtual StandaloneService {
     /// \return
     const UserMap<std::unique_ptr<wss::Statistics>> &getStats();
 
+    /// \brief Iterate over all users statistics under statistics lock. Callback must be fast and must not call server
+    /// \param callback semantic: void(user_id_t, wss::Statistics&)
+    void forEachStat(const std::function<void(user_id_t, wss::Statistics &)> &callback);
+
+    /// \brief Iterate over statistics of given users under single statistics lock. Unknown ids are skipped
+    /// \param ids
+    /// \param callback semantic: void(user_id_t, wss::Statistics&)
+    void forEachStat(const std::vector<user_id_t> &ids, const std::function<void(user_id_t, wss::Statistics &)> &callback);
+
+    /// \brief Lock-free online check, backed by presence bitmap
+    /// \param id user id
+    /// \return true if user has at least one connection
+    bool isOnline(user_id_t id) const;
+
+    /// \brief Presence bitmap, kept in sync with connections
+    /// \return
+    const wss::PresenceMap &getPresence() const;
+
+    /// \brief Server-side rooms, persisted to server.tmpDir
+    /// \return
+    wss::RoomStorage &getRooms();
+
  protected:
     /// \brief Called when pong frame received from client
     /// \param connection
@@ -220,8 +281,10 @@ class ChatServer : public virtual StandaloneService {
     /// \param reason Disconnection string reason. May be empty.
     void onDisconnected(WsConnectionPtr connection, int status, const std::string &reason);
     void watchdogWorker();
+    void ingressWorker();
 
-    /// \brief Check for entire user has undelivered message
+    /// \brief Check for entire user has undelivered message. Undelivered queues belong to recipient strand,
+    /// so this and functions below must be called only from it
     /// \param recipientId recipient id
     /// \return
     inline bool hasUndeliveredMessages(user_id_t recipientId);
@@ -230,25 +293,17 @@ class ChatServer : public virtual StandaloneService {
     /// \return
     MessageQueue &getUndeliveredMessages(user_id_t recipientId);
 
-    /// \brief Returns list of queues of undelivered messages.
-    /// \param payload Function takes all recipients from payload
-    /// \return
-    std::vector<MessageQueue *> getUndeliveredMessages(const MessagePayload &payload);
-
-    /// \brief Store undelivered message for payload recipients (for each recipient - single queue element)
-    /// \param payload
-    void enqueueUndeliveredMessage(const MessagePayload &payload);
+    /// \brief Store undelivered message for recipient
+    /// \param recipientId
+    /// \param payload payload with single recipient
+    void enqueueUndeliveredMessage(user_id_t recipientId, const MessagePayload &payload);
 
-    /// \brief Take from undelivered queue messages for recipient, and tries to resend them
+    /// \brief Take from undelivered queue messages for recipient, and tries to resend them before any message
+    /// posted to recipient later
     /// \param recipientId
-    /// \return Number of successfully sent messages
+    /// \return Number of resent messages
     int redeliverMessagesTo(user_id_t recipientId);
 
-    /// \brief Works like wss::ChatMessageServer::redeliverMessagesTo(user_id_t recipientId) but uses multiple recipients from payload
-    /// \param payload
-    /// \return Number of successfully sent messages
-    int redeliverMessagesTo(const MessagePayload &payload);
-
     /// \brief Returns statistics for entire user
     /// \param id
     /// \return
@@ -270,21 +325,29 @@ class ChatServer : public virtual StandaloneService {
     std::vector<wss::ChatServer::OnMessageSentListener> m_messageListeners;
     std::vector<OnServerStopListener> m_stopListeners;
 
-    std::mutex m_frameBufferMutex;
-    std::recursive_mutex m_connectionMutex;
-    std::mutex m_undeliveredMutex;
-    std::mutex m_statMutex;
+    wss::sync::Mutex m_frameBufferMutex{"chat_frame_buffer"};
+    wss::sync::Mutex m_statMutex{"chat_stat"};
 
     std::unique_ptr<boost::thread> m_workerThread;
     std::unique_ptr<boost::thread> m_watchdogThread;
+    std::unique_ptr<boost::thread> m_ingressThread;
 
     WsBase::Endpoint *m_endpoint;
     std::unique_ptr<wss::server::websocket::SocketServerBase> m_server;
 
     const std::unique_ptr<wss::ConnectionStorage> m_connectionStorage;
+    const std::unique_ptr<wss::RoomStorage> m_rooms;
+    std::unique_ptr<wss::cluster::Cluster> m_cluster;
+    std::unique_ptr<wss::IngressRing> m_ingress;
+    std::size_t m_ingressSpin = 0;
+    std::chrono::milliseconds m_ingressIdleWait{0};
+    std::unique_ptr<wss::BotChannel> m_botChannel;
     UserMap<std::shared_ptr<std::stringstream>> m_frameBuffer;
-    UserMap<std::queue<wss::MessagePayload>> m_undeliveredMessagesMap;
+    /// \brief Recipient strands and their undelivered queues, by shard index
+    std::unique_ptr<wss::UserStrands> m_strands;
+    std::vector<UserMap<MessageQueue>> m_undelivered;
     UserMap<std::unique_ptr<Statistics>> m_statistics;
+    wss::PresenceMap m_presence;
     UserMap<bool> m_sentUniqueId;
 
     /// \todo move out to server side
@@ -316,6 +379,32 @@ class ChatServer : public virtual StandaloneService {
     void callOnMessageListeners(wss::MessagePayload paylod);
 
     void handleUndeliverable(user_id_t uid, const wss::MessagePayload &payload);
+
+    /// \brief Adds collectors of this server values to metrics registry, removed in destructor
+    void registerMetrics();
+
+    /// \brief Count connection or disconnection in statistics and update presence bitmap under single statistics lock
+    /// \param id user id
+    /// \param connected
+    void updateConnectionStat(user_id_t id, bool connected);
+
+    /// \brief Post delivery of shared payload to recipient strand
+    void postTo(user_id_t recipient, std::shared_ptr<const MessagePayload> payload);
+
+    /// \brief Post delivery of shared payload to room members: single task per strand delivers it to all members
+    /// of that strand, so large rooms cost at most number of strands posts
+    void publishTo(room_id_t room, std::shared_ptr<const MessagePayload> payload);
+
+    /// \brief Send payload to all recipient connections. Runs on recipient strand
+    /// \param forward false for message forwarded by other node: only local connections are used
+    void deliverTo(user_id_t recipient, const MessagePayload &payload, bool forward = true);
+
+    /// \brief Send batch payloads with given indexes to recipient. Runs on recipient strand
+    void deliverTo(user_id_t recipient, const std::vector<MessagePayload> &payloads,
+                   const std::vector<std::size_t> &indexes);
+
+    /// \brief Asynchronously send payload to single recipient connection
+    void sendToConnection(const WsConnectionPtr &conn, conn_id_t cid, user_id_t uid, const MessagePayload &payload);
 };
 
 }
@@ -8,6 +8,7 @@
 
 #include "ConnectionStorage.h"
 #include <fmt/format.h>
+#include "../base/Log.h"
 
 wss::ConnectionStorage::~ConnectionStorage() {
     for (auto &kv: m_idMap) {
@@ -23,11 +24,11 @@ wss::ConnectionStorage::~ConnectionStorage() {
 }
 bool wss::ConnectionStorage::exists(wss::user_id_t id) const {
     // мы проверяем только наличие мапы, но есть ли такое содениение с уникальным айдишником - нет, тут баг
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     return m_idMap.find(id) != m_idMap.end();
 }
 bool wss::ConnectionStorage::verify(uint8_t pingFlag) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     for (const std::pair<user_id_t, std::unordered_map<conn_id_t, WsConnectionPtr>> &t: m_idMap) {
         for (const auto &conn: t.second) {
             if (!conn.second) {
@@ -54,11 +55,11 @@ bool wss::ConnectionStorage::verify(uint8_t pingFlag) {
     return true;
 }
 std::size_t wss::ConnectionStorage::size() const {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     return m_idMap.size();
 }
 std::size_t wss::ConnectionStorage::size(wss::user_id_t id) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
 
     if (m_idMap.find(id) == m_idMap.end()) {
         return 0;
@@ -67,17 +68,17 @@ std::size_t wss::ConnectionStorage::size(wss::user_id_t id) {
     return m_idMap[id].size();
 }
 void wss::ConnectionStorage::add(wss::user_id_t id, const wss::WsConnectionPtr &connection) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     connection->setId(id);
     m_idMap[id][connection->getUniqueId()] = connection;
-    L_DEBUG_F("Connection::Add", "Adding connection for %lu. Now size: %lu", connection->getId(), m_idMap[id].size());
+    WSS_DEBUG_F("Connection::Add", "Adding connection for %lu. Now size: %lu", connection->getId(), m_idMap[id].size());
 }
 void wss::ConnectionStorage::remove(wss::user_id_t id) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     m_idMap.erase(id);
 }
 void wss::ConnectionStorage::remove(wss::user_id_t id, wss::conn_id_t connectionId) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     const auto &it = m_idMap.find(id);
     if (it != m_idMap.end()) {
         if (it->second.find(connectionId) != it->second.end()) {
@@ -86,7 +87,7 @@ void wss::ConnectionStorage::remove(wss::user_id_t id, wss::conn_id_t connection
     }
 }
 void wss::ConnectionStorage::remove(const wss::WsConnectionPtr &connection) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     const user_id_t id = connection->getId();
     const conn_id_t connId = connection->getUniqueId();
 
@@ -97,13 +98,13 @@ void wss::ConnectionStorage::remove(const wss::WsConnectionPtr &connection) {
         }
     }
 
-    L_DEBUG_F("Connection::Remove", "User %lu (%lu). Left connections: %lu",
-              connection->getId(),
-              connection->getUniqueId(),
-              m_idMap[id].size());
+    WSS_DEBUG_F("Connection::Remove", "User %lu (%lu). Left connections: %lu",
+                connection->getId(),
+                connection->getUniqueId(),
+                userMapIt != m_idMap.end() ? userMapIt->second.size() : 0);
 }
 wss::ConnectionMap<wss::WsConnectionPtr> &wss::ConnectionStorage::get(wss::user_id_t id) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     if (!exists(id)) {
         throw ConnectionNotFound();
     }
@@ -113,26 +114,26 @@ const wss::UserMap<wss::ConnectionMap<wss::WsConnectionPtr>> &wss::ConnectionSto
     return m_idMap;
 }
 void wss::ConnectionStorage::handle(wss::user_id_t id, std::function<void(wss::WsConnectionPtr &)> &&handler) {
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
     for (auto &conn: get(id)) {
         handler(conn.second);
     }
 }
 void wss::ConnectionStorage::markPongWait(const wss::WsConnectionPtr &connection) {
-    std::lock_guard<std::mutex> locker(m_pongMutex);
+    std::lock_guard<wss::sync::Mutex> locker(m_pongMutex);
     m_waitForPong[connection->getUniqueId()] = {connection->getId(), false};
 }
 void wss::ConnectionStorage::markPongReceived(const wss::WsConnectionPtr &connection) {
-    std::lock_guard<std::mutex> locker(m_pongMutex);
+    std::lock_guard<wss::sync::Mutex> locker(m_pongMutex);
     m_waitForPong[connection->getUniqueId()].second = true;
 }
 std::size_t wss::ConnectionStorage::disconnectWithoutPong(int statusCode, const std::string &reason) {
-    std::lock_guard<std::mutex> locker(m_pongMutex);
+    std::lock_guard<wss::sync::Mutex> locker(m_pongMutex);
     std::size_t disconnected = 0;
     for (auto it = m_waitForPong.begin(); it != m_waitForPong.end();) {
         if (!it->second.second) {
             {
-                std::lock_guard<std::recursive_mutex> sublock(m_connectionMutex);
+                std::lock_guard<wss::sync::RecursiveMutex> sublock(m_connectionMutex);
                 WsConnectionPtr &conn = m_idMap[it->second.first][it->first];
                 if (conn) {
                     conn->sendClose(statusCode, reason);
@@ -161,7 +162,7 @@ void wss::ConnectionStorage::forEach(
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> locker(m_connectionMutex);
+    std::lock_guard<wss::sync::RecursiveMutex> locker(m_connectionMutex);
 
     try {
         const auto &connections = get(recipient);
@@ -181,8 +182,8 @@ void wss::ConnectionStorage::forEach(
         }
 
     } catch (const std::exception &e) {
-        Logger::get().warning(__FILE__, __LINE__, "Connection::Handle", fmt::format("Unknown error: {0}", e.what()));
+        WSS_WARN("Connection::Handle", fmt::format("Unknown error: {0}", e.what()));
     } catch (...) {
-        Logger::get().warning(__FILE__, __LINE__, "Connection::Handle", "Unknown error");
+        WSS_WARN("Connection::Handle", "Unknown error");
     }
 }
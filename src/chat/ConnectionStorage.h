@@ -17,6 +17,7 @@
 #include <atomic>
 #include <toolboxpp.h>
 #include "../wsserver_core.h"
+#include "../base/LockProfiler.h"
 
 using toolboxpp::Logger;
 
@@ -31,8 +32,8 @@ struct ConnectionNotFound : std::exception {
 /// \brief Container for handling and storing client connections
 class ConnectionStorage {
  private:
-    mutable std::recursive_mutex m_connectionMutex;
-    mutable std::mutex m_pongMutex;
+    mutable wss::sync::RecursiveMutex m_connectionMutex{"storage_connection"};
+    mutable wss::sync::Mutex m_pongMutex{"storage_pong"};
     wss::UserMap<wss::ConnectionMap<WsConnectionPtr>> m_idMap;
     wss::ConnectionMap<std::pair<user_id_t, bool>> m_waitForPong;
 
@@ -0,0 +1,288 @@
+/**
+ * wsserver
+ * IngressRing.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "IngressRing.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Ring is shared between processes, atomics must be lock-free");
+static_assert(sizeof(std::atomic<uint32_t>) == 4 && sizeof(std::atomic<uint64_t>) == 8,
+              "Ring layout requires plain-sized atomics");
+
+static const char RING_MAGIC[8] = {'W', 'S', 'S', 'R', 'I', 'N', 'G', '1'};
+static const std::size_t MAX_CAPACITY = std::size_t(1) << 30;
+
+struct wss::IngressRing::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t capacity;
+  std::atomic<uint32_t> closed;
+  std::atomic<uint32_t> doorbell;
+  std::atomic<uint32_t> sleeping;
+  // producers and consumer write different cache lines
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint64_t> head;
+  char reserved[56];
+};
+
+static std::size_t alignRecord(std::size_t size) {
+    return (size + 7) & ~std::size_t(7);
+}
+
+// not private futex: waiter and wakers are different processes
+static void futexWait(std::atomic<uint32_t> &word, uint32_t expected, std::chrono::milliseconds timeout) {
+#ifdef __linux__
+    struct timespec ts{};
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    (void) word;
+    (void) expected;
+    std::this_thread::sleep_for(std::min(timeout, std::chrono::milliseconds(1)));
+#endif
+}
+
+static void futexWake(std::atomic<uint32_t> &word) {
+#ifdef __linux__
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+static std::runtime_error ringError(const std::string &what, const std::string &path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+std::unique_ptr<wss::IngressRing> wss::IngressRing::create(const std::string &path, std::size_t capacity) {
+    static_assert(sizeof(Header) == 192, "Ring header layout changed");
+    std::size_t size = MIN_CAPACITY;
+    while (size < capacity && size < MAX_CAPACITY) {
+        size <<= 1;
+    }
+
+    // producers still attached to ring of previous server run must not write into unlinked file
+    try {
+        attach(path)->m_header->closed.store(1, std::memory_order_release);
+    } catch (const std::runtime_error &) {
+    }
+    ::unlink(path.c_str());
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0) {
+        throw ringError("Can't create ingress ring", path);
+    }
+    std::unique_ptr<IngressRing> ring(new IngressRing(path, fd, true));
+    if (::ftruncate(fd, sizeof(Header) + size) != 0) {
+        throw ringError("Can't resize ingress ring", path);
+    }
+    ring->map(sizeof(Header) + size);
+
+    // file is zero-filled: counters and all record words start at 0
+    std::memcpy(ring->m_header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    ring->m_header->version = VERSION;
+    ring->m_header->capacity = (uint32_t) size;
+    ring->m_capacity = size;
+    std::atomic_thread_fence(std::memory_order_release);
+    return ring;
+}
+
+std::unique_ptr<wss::IngressRing> wss::IngressRing::attach(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        throw ringError("Can't open ingress ring", path);
+    }
+    std::unique_ptr<IngressRing> ring(new IngressRing(path, fd, false));
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        throw ringError("Can't stat ingress ring", path);
+    }
+    if ((std::size_t) st.st_size < sizeof(Header)) {
+        throw std::runtime_error("Not an ingress ring: " + path);
+    }
+    ring->map((std::size_t) st.st_size);
+
+    const Header &header = *ring->m_header;
+    const std::size_t capacity = header.capacity;
+    if (std::memcmp(header.magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0
+        || header.version != VERSION
+        || capacity < MIN_CAPACITY
+        || (capacity & (capacity - 1)) != 0
+        || sizeof(Header) + capacity != (std::size_t) st.st_size) {
+        throw std::runtime_error("Not an ingress ring: " + path);
+    }
+    ring->m_capacity = capacity;
+    return ring;
+}
+
+wss::IngressRing::IngressRing(const std::string &path, int fd, bool owner) :
+    m_path(path),
+    m_fd(fd),
+    m_owner(owner) {
+}
+
+wss::IngressRing::~IngressRing() {
+    if (m_owner && m_header) {
+        m_header->closed.store(1, std::memory_order_release);
+        // file could be already replaced by another server instance
+        struct stat own{}, current{};
+        if (::fstat(m_fd, &own) == 0 && ::stat(m_path.c_str(), &current) == 0
+            && own.st_ino == current.st_ino && own.st_dev == current.st_dev) {
+            ::unlink(m_path.c_str());
+        }
+    }
+    if (m_map) {
+        ::munmap(m_map, m_mapSize);
+    }
+    ::close(m_fd);
+}
+
+void wss::IngressRing::map(std::size_t size) {
+    void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED) {
+        throw ringError("Can't map ingress ring", m_path);
+    }
+    m_map = static_cast<char *>(addr);
+    m_mapSize = size;
+    m_header = reinterpret_cast<Header *>(m_map);
+    m_data = m_map + sizeof(Header);
+}
+
+std::atomic<uint32_t> &wss::IngressRing::wordAt(uint64_t position) const {
+    return *reinterpret_cast<std::atomic<uint32_t> *>(m_data + (position & (m_capacity - 1)));
+}
+
+bool wss::IngressRing::push(const char *data, std::size_t size) {
+    if (size == 0 || size > m_capacity / 2 - RECORD_HEADER || isClosed()) {
+        return false;
+    }
+
+    const std::size_t need = RECORD_HEADER + alignRecord(size);
+    uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+    std::size_t toEnd, total;
+    for (;;) {
+        // acquire: bytes zeroed by consumer are visible before they are reused
+        const uint64_t head = m_header->head.load(std::memory_order_acquire);
+        toEnd = m_capacity - (tail & (m_capacity - 1));
+        // record is never split: rest of ring before wrap is taken by padding
+        total = need <= toEnd ? need : toEnd + need;
+        if (tail + total - head > m_capacity) {
+            return false;
+        }
+        if (m_header->tail.compare_exchange_weak(tail, tail + total, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (total != need) {
+        wordAt(tail).store(COMMITTED | PADDING | (uint32_t) (toEnd - RECORD_HEADER), std::memory_order_release);
+        tail += toEnd;
+    }
+    std::memcpy(m_data + (tail & (m_capacity - 1)) + RECORD_HEADER, data, size);
+    wordAt(tail).store(COMMITTED | (uint32_t) size, std::memory_order_release);
+
+    // pairs with fence in wait(): either consumer sees record, or producer sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_header->sleeping.load(std::memory_order_relaxed) != 0) {
+        wake();
+    }
+    return true;
+}
+
+bool wss::IngressRing::push(const std::string &data) {
+    return push(data.data(), data.size());
+}
+
+std::size_t wss::IngressRing::drain(const wss::IngressRing::Handler &handler, std::size_t max) {
+    const uint64_t start = m_header->head.load(std::memory_order_relaxed);
+    uint64_t head = start;
+    std::size_t count = 0;
+    std::string corrupted;
+    while (count < max) {
+        const uint32_t word = wordAt(head).load(std::memory_order_acquire);
+        if ((word & COMMITTED) == 0) {
+            // empty or producer is still copying payload
+            break;
+        }
+        const std::size_t length = word & LENGTH_MASK;
+        const std::size_t offset = head & (m_capacity - 1);
+        // word is written by other processes: record must end before wrap, payload can't exceed push() limit
+        if (RECORD_HEADER + alignRecord(length) > m_capacity - offset
+            || ((word & PADDING) == 0 && length > m_capacity / 2 - RECORD_HEADER)) {
+            corrupted = "Corrupted ingress ring record at offset " + std::to_string(offset)
+                + ": word " + std::to_string(word);
+            break;
+        }
+        if ((word & PADDING) == 0) {
+            handler(m_data + offset + RECORD_HEADER, length);
+            count++;
+        }
+        head += RECORD_HEADER + alignRecord(length);
+    }
+
+    if (head != start) {
+        // any offset may become record word later, so whole consumed range is cleared
+        for (uint64_t pos = start; pos < head;) {
+            const std::size_t offset = pos & (m_capacity - 1);
+            const std::size_t chunk = std::min<std::size_t>(head - pos, m_capacity - offset);
+            std::memset(m_data + offset, 0, chunk);
+            pos += chunk;
+        }
+        m_header->head.store(head, std::memory_order_release);
+    }
+
+    if (!corrupted.empty()) {
+        // next record can't be found: producers must stop writing, server has to recreate ring
+        m_header->closed.store(1, std::memory_order_release);
+        throw std::runtime_error(corrupted + " in " + m_path);
+    }
+    return count;
+}
+
+void wss::IngressRing::wait(std::chrono::milliseconds timeout) {
+    const uint32_t bell = m_header->doorbell.load(std::memory_order_acquire);
+    m_header->sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    if ((wordAt(head).load(std::memory_order_acquire) & COMMITTED) == 0) {
+        // returns right away if doorbell was rung after it was read
+        futexWait(m_header->doorbell, bell, timeout);
+    }
+    m_header->sleeping.store(0, std::memory_order_relaxed);
+}
+
+void wss::IngressRing::wake() {
+    m_header->doorbell.fetch_add(1, std::memory_order_release);
+    futexWake(m_header->doorbell);
+}
+
+bool wss::IngressRing::isClosed() const {
+    return m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+std::size_t wss::IngressRing::getCapacity() const {
+    return m_capacity;
+}
+
+std::size_t wss::IngressRing::getUsed() const {
+    return m_header->tail.load(std::memory_order_relaxed) - m_header->head.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,121 @@
+/**
+ * wsserver
+ * IngressRing.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_INGRESSRING_H
+#define WSSERVER_INGRESSRING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace wss {
+
+/// \brief Multi-producer single-consumer ring of framed payloads in shared memory file. Lets co-located services
+/// pass messages to server without HTTP: producer processes attach to file and push, server drains it.
+///
+/// File layout (little-endian, offsets in bytes):
+///  0..63    header: magic "WSSRING1", uint32 version, uint32 capacity (power of 2), uint32 closed flag,
+///           uint32 doorbell, uint32 sleeping flag
+///  64..127  uint64 tail: reserved bytes counter, producers advance it by CAS
+///  128..191 uint64 head: consumed bytes counter, advanced by consumer
+///  192..    data, capacity bytes
+/// Record at (counter & (capacity - 1)), 8 bytes aligned: uint32 word, uint32 unused, payload padded to 8 bytes.
+/// Word is 0 until record is written, then COMMITTED | length, or COMMITTED | PADDING | length for filler that
+/// skips rest of ring before wrap. Consumer zeroes consumed bytes before advancing head.
+///
+/// Idle consumer sets sleeping flag and waits on doorbell word (Linux futex, shared). Producer, after committing
+/// record, issues full fence and, if flag is set, increments doorbell and wakes consumer. Producers of other
+/// languages must do the same, or consumer picks their records only after its wait timeout.
+///
+/// Producer that dies between reservation and commit stalls the ring: records after it are not drained
+/// until server recreates ring.
+class IngressRing {
+ public:
+    using Handler = std::function<void(const char *data, std::size_t size)>;
+
+    static const uint32_t VERSION = 2;
+    static const uint32_t COMMITTED = 0x80000000u;
+    static const uint32_t PADDING = 0x40000000u;
+    static const uint32_t LENGTH_MASK = 0x3FFFFFFFu;
+    static const std::size_t RECORD_HEADER = 8;
+    static const std::size_t MIN_CAPACITY = 4096;
+
+    /// \brief Create new ring for consumer (server). Existing file is replaced, producers attached to it
+    /// see it closed
+    /// \param path file path, preferably on tmpfs
+    /// \param capacity data size, rounded up to power of 2
+    /// \throws std::runtime_error if file can't be created or mapped
+    static std::unique_ptr<IngressRing> create(const std::string &path, std::size_t capacity);
+
+    /// \brief Attach producer to ring created by server
+    /// \param path
+    /// \throws std::runtime_error if file is missing or is not a ring
+    static std::unique_ptr<IngressRing> attach(const std::string &path);
+
+    /// \brief Ring created by create() is marked closed and its file is removed
+    ~IngressRing();
+
+    IngressRing(const IngressRing &) = delete;
+    IngressRing &operator=(const IngressRing &) = delete;
+
+    /// \brief Producer side, thread and process safe. Never blocks
+    /// \param data
+    /// \param size
+    /// \return false if ring is full, closed or payload is larger than half of ring
+    bool push(const char *data, std::size_t size);
+    bool push(const std::string &data);
+
+    /// \brief Consumer side, one thread only. Calls handler for each committed record in order of reservation
+    /// \param handler receives pointer into ring, valid only during call
+    /// \param max maximum records to take
+    /// \return number of drained records
+    /// \throws std::runtime_error if record word is out of ring bounds. Records before it are drained,
+    /// ring is marked closed
+    std::size_t drain(const Handler &handler, std::size_t max);
+
+    /// \brief Consumer side, blocks until producer commits record, wake() is called or timeout expires.
+    /// Returns right away if ring is not empty
+    /// \param timeout
+    void wait(std::chrono::milliseconds timeout);
+
+    /// \brief Wakes consumer blocked in wait(), any thread
+    void wake();
+
+    /// \return true if server has destroyed ring, producer should attach again
+    bool isClosed() const;
+
+    std::size_t getCapacity() const;
+
+    /// \return reserved but not consumed bytes
+    std::size_t getUsed() const;
+
+ private:
+    struct Header;
+
+    IngressRing(const std::string &path, int fd, bool owner);
+
+    std::string m_path;
+    int m_fd;
+    bool m_owner;
+    std::size_t m_mapSize = 0;
+    char *m_map = nullptr;
+    Header *m_header = nullptr;
+    char *m_data = nullptr;
+    std::size_t m_capacity = 0;
+
+    std::atomic<uint32_t> &wordAt(uint64_t position) const;
+    void map(std::size_t size);
+};
+
+}
+
+#endif //WSSERVER_INGRESSRING_H
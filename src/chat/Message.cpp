@@ -10,6 +10,7 @@
 
 #include <fmt/format.h>
 #include <toolboxpp.h>
+#include "../base/Log.h"
 
 using namespace wss;
 using std::cout;
@@ -77,12 +78,16 @@ wss::MessagePayload::MessagePayload(const std::string &json) noexcept:
 
 wss::MessagePayload::MessagePayload(const wss::json &obj) noexcept:
     m_id(wss::unid::generator()()) {
-    fromJson(obj);
-    validate();
+    try {
+        fromJson(obj);
+        validate();
+    } catch (const std::exception &e) {
+        handleJsonException(e, obj.dump());
+    }
 }
 
 void wss::MessagePayload::validate() {
-    if (m_recipients.empty()) {
+    if (m_recipients.empty() && m_room == 0) {
         m_validState = false;
         m_errorCause = "Recipients can't be empty";
     }
@@ -97,10 +102,16 @@ const unid_t MessagePayload::getId() const {
 user_id_t wss::MessagePayload::getSender() const {
     return m_sender;
 }
-const std::vector<user_id_t> wss::MessagePayload::getRecipients() const {
+const std::vector<user_id_t> &wss::MessagePayload::getRecipients() const {
     return m_recipients;
 }
-const std::string wss::MessagePayload::toJson() const {
+room_id_t MessagePayload::getRoom() const {
+    return m_room;
+}
+bool MessagePayload::isForRoom() const {
+    return m_room != 0;
+}
+const std::string &wss::MessagePayload::toJson() const {
     if (m_isCached) {
         return m_cachedJson;
     }
@@ -119,7 +130,7 @@ bool wss::MessagePayload::isMyMessage(user_id_t id) const {
     return getSender() == id;
 }
 bool wss::MessagePayload::isValid() const {
-    return m_validState && !m_recipients.empty();
+    return m_validState && (!m_recipients.empty() || m_room != 0);
 }
 
 bool MessagePayload::isFromBot() const {
@@ -143,7 +154,7 @@ bool wss::MessagePayload::typeIs(const char *t) const {
     const char *lc = m_type.c_str();
     return strcmp(lc, t) == 0;
 }
-const std::string MessagePayload::getType() const {
+const std::string &MessagePayload::getType() const {
     return m_type;
 }
 const std::string wss::MessagePayload::getError() const {
@@ -178,7 +189,7 @@ void wss::MessagePayload::handleJsonException(const std::exception &e, const std
     std::stringstream ss;
     ss << "Invalid payload: " << e.what();
     m_errorCause = ss.str();
-    L_WARN("Chat::Message::Payload", ss.str().c_str())
+    WSS_WARN("Chat::Message::Payload", ss.str().c_str());
 }
 
 void MessagePayload::clearCachedJson() {
@@ -198,6 +209,12 @@ wss::MessagePayload &MessagePayload::addRecipient(user_id_t to) {
     return *this;
 }
 
+wss::MessagePayload &MessagePayload::setRoom(room_id_t room) {
+    m_room = room;
+    clearCachedJson();
+    return *this;
+}
+
 void wss::to_json(wss::json &j, const wss::MessagePayload &in) {
     j = json{
         {"id",         in.m_id},
@@ -208,6 +225,9 @@ void wss::to_json(wss::json &j, const wss::MessagePayload &in) {
         {"recipients", in.m_recipients},
         {"data",       in.m_data}
     };
+    if (in.m_room != 0) {
+        j["room"] = in.m_room;
+    }
 }
 
 void wss::from_json(const wss::json &j, wss::MessagePayload &in) {
@@ -215,7 +235,19 @@ void wss::from_json(const wss::json &j, wss::MessagePayload &in) {
         throw InvalidPayloadException("$.type must be a string");
     } else if (j.find("sender") == j.end() || j.at("sender").is_null() || !j.at("sender").is_number()) {
         throw InvalidPayloadException("$.sender must be uint64_t");
-    } else if (j.find("recipients") == j.end() || j.at("recipients").is_null() || !j.at("recipients").is_array()) {
+    }
+
+    in.m_room = 0;
+    if (j.find("room") != j.end() && !j.at("room").is_null()) {
+        if (!j.at("room").is_number_unsigned() || j.at("room").get<room_id_t>() == 0) {
+            throw InvalidPayloadException("$.room must be uint64_t greater than 0");
+        }
+        in.m_room = j.at("room").get<room_id_t>();
+    }
+
+    // room messages are sent to room members, recipients are optional for them
+    const bool hasRecipients = j.find("recipients") != j.end() && !j.at("recipients").is_null();
+    if (hasRecipients ? !j.at("recipients").is_array() : in.m_room == 0) {
         throw InvalidPayloadException("$.recipients[] must be uint64_t[]");
     }
 
@@ -235,8 +267,8 @@ void wss::from_json(const wss::json &j, wss::MessagePayload &in) {
     }
 
     in.m_sender = j.at("sender").get<user_id_t>();
-    in.m_recipients = j.at("recipients").get<std::vector<user_id_t>>();
-    if (in.m_recipients.empty()) {
+    in.m_recipients = hasRecipients ? j.at("recipients").get<std::vector<user_id_t>>() : std::vector<user_id_t>();
+    if (in.m_recipients.empty() && in.m_room == 0) {
         throw InvalidPayloadException("$.recipients[] must contains at least 1 value");
     }
 
@@ -261,6 +293,15 @@ wss::MessagePayload MessagePayload::createSendStatus(user_id_t to) {
 
     return payload;
 }
+wss::MessagePayload MessagePayload::fromForwarded(std::string &&json) {
+    MessagePayload payload(json);
+    if (payload.isValid()) {
+        // keeps message id and timestamp given by origin node
+        payload.m_cachedJson = std::move(json);
+        payload.m_isCached = true;
+    }
+    return payload;
+}
 wss::MessagePayload MessagePayload::createSendStatus(const MessagePayload &payload) {
     return createSendStatus(payload.getSender());
 }
@@ -41,6 +41,7 @@ class MessagePayload {
     unid_t m_id;
     user_id_t m_sender;
     std::vector<user_id_t> m_recipients;
+    room_id_t m_room = 0;
     std::string m_text;
     std::string m_type;
     std::string m_timestamp;
@@ -69,6 +70,11 @@ class MessagePayload {
     /// \return
     static MessagePayload createSendStatus(const MessagePayload &payload);
 
+    /// \brief Payload forwarded by other cluster node. Parsed for routing, but sent to connections exactly as received
+    /// \param json
+    /// \return payload, check isValid()
+    static MessagePayload fromForwarded(std::string &&json);
+
     MessagePayload();
     MessagePayload(user_id_t from, user_id_t to, const std::string &message);
     MessagePayload(user_id_t from, user_id_t to, std::string &&message);
@@ -94,20 +100,28 @@ class MessagePayload {
 
     /// \brief Recipients ids
     /// \return std::vector<UserId>
-    const std::vector<user_id_t> getRecipients() const;
+    const std::vector<user_id_t> &getRecipients() const;
+
+    /// \brief Room id, message is published to all room members instead of recipients
+    /// \return 0 if message is not for room
+    room_id_t getRoom() const;
+
+    /// \brief Check message is published to room (recipients may be empty then)
+    /// \return
+    bool isForRoom() const;
 
     /// \brief Message type
     /// \return string type. Predefined types:
     /// \see constants TYPE_TEXT, TYPE_BINARY, TYPE_B64_IMAGE, TYPE_URL_IMAGE, TYPE_NOTIFICATION_RECEIVED
-    const std::string getType() const;
+    const std::string &getType() const;
 
     /// \brief Text message
     /// \return string or empty if type not a TYPE_TEXT
     const std::string getText() const;
 
-    /// \brief Converts this payload to json string
+    /// \brief Converts this payload to json string. Result is cached until payload is changed
     /// \return valid json string
-    const std::string toJson() const;
+    const std::string &toJson() const;
 
     /// \brief Checks by passed id, that current payload belongs to sender
     /// \param id UserId
@@ -152,6 +166,7 @@ class MessagePayload {
     MessagePayload &setRecipients(const std::vector<user_id_t> &recipients);
     MessagePayload &setRecipients(std::vector<user_id_t> &&recipients);
     MessagePayload &addRecipient(user_id_t to);
+    MessagePayload &setRoom(room_id_t room);
 };
 
 void to_json(wss::json &j, const wss::MessagePayload &in);
@@ -0,0 +1,252 @@
+/**
+ * wsserver
+ * MessageTracer.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include "MessageTracer.h"
+#include "../base/Metrics.h"
+
+using wss::metrics::Registry;
+static const char *STAGE_METRIC = "wss_chat_stage_seconds";
+static const char *STAGE_HELP = "Time between trace points of message: frame complete, dispatched, parsed, routed, "
+                                "enqueued, write started, write completed";
+static wss::metrics::Histogram &stageDispatch =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"dispatch\"");
+static wss::metrics::Histogram &stageParse =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"parse\"");
+static wss::metrics::Histogram &stageRoute =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"route\"");
+static wss::metrics::Histogram &stageEnqueue =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"enqueue\"");
+static wss::metrics::Histogram &stageQueueWait =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"queue_wait\"");
+static wss::metrics::Histogram &stageWrite =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"write\"");
+static wss::metrics::Histogram &stageTotal =
+    Registry::get().histogram(STAGE_METRIC, STAGE_HELP, "stage=\"total\"");
+
+/// \brief Scope of message handled by this thread
+static thread_local wss::MessageTracer::Scope *currentScope = nullptr;
+
+static double microsSince(wss::MessageTracer::Clock::time_point from, wss::MessageTracer::Clock::time_point to) {
+    if (to == wss::MessageTracer::Clock::time_point()) {
+        return -1;
+    }
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+wss::MessageTracer::Pending::Pending(wss::MessageTracer *tracer) :
+    tracer(tracer) {
+}
+
+wss::MessageTracer::Pending::~Pending() {
+    tracer->store(std::move(sample));
+}
+
+wss::MessageTracer::Scope::Scope(wss::MessageTracer &tracer, Clock::time_point frameComplete) :
+    m_tracer(tracer),
+    m_frameComplete(frameComplete) {
+    currentScope = this;
+}
+
+wss::MessageTracer::Scope::Scope(const wss::MessageTracer::Handoff &handoff) :
+    m_tracer(handoff.m_tracer ? *handoff.m_tracer : MessageTracer::get()),
+    m_frameComplete(handoff.m_frameComplete),
+    m_dispatched(handoff.m_dispatched),
+    m_parsed(handoff.m_parsed),
+    m_pending(handoff.m_pending) {
+    currentScope = this;
+}
+
+wss::MessageTracer::Scope::~Scope() {
+    currentScope = nullptr;
+}
+
+wss::MessageTracer::Handoff::Handoff() {
+    if (currentScope == nullptr) {
+        return;
+    }
+    m_tracer = &currentScope->m_tracer;
+    m_frameComplete = currentScope->m_frameComplete;
+    m_dispatched = currentScope->m_dispatched;
+    m_parsed = currentScope->m_parsed;
+    m_pending = currentScope->m_pending;
+}
+
+void wss::MessageTracer::Scope::dispatched() {
+    m_dispatched = Clock::now();
+    stageDispatch.observe(m_dispatched - m_frameComplete);
+}
+
+void wss::MessageTracer::Scope::parsed(wss::user_id_t sender, std::size_t bytes) {
+    m_parsed = Clock::now();
+    stageParse.observe(m_parsed - m_dispatched);
+
+    if (!m_tracer.shouldSample()) {
+        return;
+    }
+    m_pending = std::make_shared<Pending>(&m_tracer);
+    Sample &sample = m_pending->sample;
+    sample.sender = sender;
+    sample.bytes = bytes;
+    sample.time = std::chrono::system_clock::now() - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        m_parsed - m_frameComplete);
+    sample.frameComplete = m_frameComplete;
+    sample.dispatched = m_dispatched;
+    sample.parsed = m_parsed;
+}
+
+wss::MessageTracer::DeliveryTrace::DeliveryTrace(wss::user_id_t recipient, wss::conn_id_t connection) :
+    m_routed(Clock::now()) {
+    if (currentScope == nullptr || currentScope->m_parsed == Clock::time_point()) {
+        return;
+    }
+
+    m_frameComplete = currentScope->m_frameComplete;
+    m_parsed = currentScope->m_parsed;
+    stageRoute.observe(m_routed - m_parsed);
+
+    if (currentScope->m_pending) {
+        m_pending = currentScope->m_pending;
+        Delivery delivery;
+        delivery.recipient = recipient;
+        delivery.connection = connection;
+        delivery.routed = m_routed;
+
+        // previous deliveries may be completing on other threads
+        std::lock_guard<std::mutex> lock(m_pending->mutex);
+        m_index = m_pending->sample.deliveries.size();
+        m_pending->sample.deliveries.push_back(delivery);
+    }
+}
+
+void wss::MessageTracer::DeliveryTrace::enqueued() {
+    m_enqueued = Clock::now();
+    stageEnqueue.observe(m_enqueued - m_routed);
+
+    if (m_pending) {
+        std::lock_guard<std::mutex> lock(m_pending->mutex);
+        m_pending->sample.deliveries[m_index].enqueued = m_enqueued;
+    }
+}
+
+void wss::MessageTracer::DeliveryTrace::completed(Clock::time_point writeStarted, bool sent) {
+    const Clock::time_point now = Clock::now();
+    if (writeStarted == Clock::time_point() || writeStarted < m_enqueued) {
+        writeStarted = m_enqueued;
+    }
+    stageQueueWait.observe(writeStarted - m_enqueued);
+    stageWrite.observe(now - writeStarted);
+    if (m_frameComplete != Clock::time_point()) {
+        stageTotal.observe(now - m_frameComplete);
+    }
+
+    if (m_pending) {
+        {
+            std::lock_guard<std::mutex> lock(m_pending->mutex);
+            Delivery &delivery = m_pending->sample.deliveries[m_index];
+            delivery.writeStarted = writeStarted;
+            delivery.writeCompleted = now;
+            delivery.sent = sent;
+        }
+        // callback may be kept by connection for a while, release sample for storing as soon as possible
+        m_pending.reset();
+    }
+}
+
+wss::MessageTracer &wss::MessageTracer::get() {
+    static MessageTracer tracer;
+    return tracer;
+}
+
+wss::MessageTracer::MessageTracer(std::size_t capacity) :
+    m_sampleEvery(0),
+    m_ring(capacity == 0 ? 1 : capacity) {
+}
+
+void wss::MessageTracer::configure(uint32_t sampleEvery, std::size_t capacity) {
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        if (capacity != m_ring.size()) {
+            m_ring.clear();
+            m_ring.resize(capacity);
+            m_next = 0;
+            m_size = 0;
+        }
+    }
+    m_sampleEvery = sampleEvery;
+}
+
+uint32_t wss::MessageTracer::getSampleEvery() const {
+    return m_sampleEvery;
+}
+
+std::vector<wss::MessageTracer::Sample> wss::MessageTracer::dump() const {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    std::vector<Sample> out;
+    out.reserve(m_size);
+    const std::size_t first = (m_next + m_ring.size() - m_size) % m_ring.size();
+    for (std::size_t i = 0; i < m_size; i++) {
+        out.push_back(m_ring[(first + i) % m_ring.size()]);
+    }
+    return out;
+}
+
+nlohmann::json wss::MessageTracer::toJson() const {
+    nlohmann::json out = nlohmann::json::array();
+    for (const auto &sample: dump()) {
+        nlohmann::json item;
+        item["timestamp"] = std::chrono::duration_cast<std::chrono::microseconds>(
+            sample.time.time_since_epoch()).count();
+        item["sender"] = sample.sender;
+        item["bytes"] = sample.bytes;
+        item["dispatchedUs"] = microsSince(sample.frameComplete, sample.dispatched);
+        item["parsedUs"] = microsSince(sample.frameComplete, sample.parsed);
+
+        nlohmann::json deliveries = nlohmann::json::array();
+        for (const auto &delivery: sample.deliveries) {
+            nlohmann::json d;
+            d["recipient"] = delivery.recipient;
+            d["connection"] = delivery.connection;
+            d["routedUs"] = microsSince(sample.frameComplete, delivery.routed);
+            d["enqueuedUs"] = microsSince(sample.frameComplete, delivery.enqueued);
+            d["writeStartedUs"] = microsSince(sample.frameComplete, delivery.writeStarted);
+            d["writeCompletedUs"] = microsSince(sample.frameComplete, delivery.writeCompleted);
+            d["sent"] = delivery.sent;
+            deliveries.push_back(std::move(d));
+        }
+        item["deliveries"] = std::move(deliveries);
+        out.push_back(std::move(item));
+    }
+    return out;
+}
+
+void wss::MessageTracer::clear() {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    m_next = 0;
+    m_size = 0;
+}
+
+bool wss::MessageTracer::shouldSample() {
+    const uint32_t every = m_sampleEvery.load(std::memory_order_relaxed);
+    if (every == 0) {
+        return false;
+    }
+    thread_local uint32_t counter = 0;
+    return ++counter % every == 0;
+}
+
+void wss::MessageTracer::store(wss::MessageTracer::Sample &&sample) {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    m_ring[m_next] = std::move(sample);
+    m_next = (m_next + 1) % m_ring.size();
+    if (m_size < m_ring.size()) {
+        m_size++;
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ * wsserver
+ * MessageTracer.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_MESSAGETRACER_H
+#define WSSERVER_MESSAGETRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "json.hpp"
+#include "../wsserver_core.h"
+
+namespace wss {
+
+/// \brief Per-message latency tracing through chat pipeline. Every incoming message is timestamped at points:
+///  - frame complete: last frame payload read from socket
+///  - dispatched: message handler started on worker thread (stage "dispatch")
+///  - parsed: payload parsed and validated
+/// and every its delivery to recipient connection at:
+///  - routed: connection found in storage, on recipient strand (includes wait in strand queue)
+///  - enqueued: write added to connection send queue
+///  - write started: write left send queue
+///  - write completed: socket write finished
+/// Time between neighbour points is observed in wss_chat_stage_seconds{stage="..."} histograms. Additionally,
+/// every N-th message (per thread) is sampled with all its deliveries into ring buffer, see dump().
+///
+/// Message timings are passed to send path through thread-local Scope, so send functions keep their signatures.
+/// If delivery continues on another thread, scope is carried there with Handoff.
+class MessageTracer {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Delivery {
+      user_id_t recipient = 0;
+      conn_id_t connection = 0;
+      Clock::time_point routed;
+      Clock::time_point enqueued;
+      Clock::time_point writeStarted;
+      Clock::time_point writeCompleted;
+      /// \brief false if write failed or not completed yet
+      bool sent = false;
+    };
+
+    struct Sample {
+      user_id_t sender = 0;
+      std::size_t bytes = 0;
+      /// \brief Wall clock time of frame complete, to find sample in logs
+      std::chrono::system_clock::time_point time;
+      Clock::time_point frameComplete;
+      Clock::time_point dispatched;
+      Clock::time_point parsed;
+      std::vector<Delivery> deliveries;
+    };
+
+ private:
+    /// \brief Sample collected while its deliveries are in flight, stored to ring when last delivery released it
+    struct Pending {
+      explicit Pending(MessageTracer *tracer);
+      ~Pending();
+
+      MessageTracer *tracer;
+      std::mutex mutex;
+      Sample sample;
+    };
+
+ public:
+    class DeliveryTrace;
+    class Handoff;
+
+    /// \brief Trace of message handled by current thread. Lives on stack of message handler, from frame complete
+    /// until writes to all recipients are enqueued. Scopes may not be nested.
+    class Scope {
+     public:
+        /// \param tracer
+        /// \param frameComplete time when last frame of message was read
+        Scope(MessageTracer &tracer, Clock::time_point frameComplete);
+        /// \brief Resumes scope captured on another thread
+        explicit Scope(const Handoff &handoff);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        /// \brief Message handler started
+        void dispatched();
+
+        /// \brief Payload parsed and valid, will be routed. Decides whether message is sampled
+        /// \param sender
+        /// \param bytes payload size
+        void parsed(user_id_t sender, std::size_t bytes);
+
+     private:
+        friend class DeliveryTrace;
+        friend class Handoff;
+        MessageTracer &m_tracer;
+        Clock::time_point m_frameComplete;
+        Clock::time_point m_dispatched;
+        Clock::time_point m_parsed;
+        std::shared_ptr<Pending> m_pending;
+    };
+
+    /// \brief Copy of current thread scope, captured when message is passed to another thread, for example
+    /// to recipient strand, and resumed there with Scope(handoff)
+    class Handoff {
+     public:
+        /// \brief Captures scope of current thread, empty if there is no scope
+        Handoff();
+
+     private:
+        friend class Scope;
+        MessageTracer *m_tracer = nullptr;
+        Clock::time_point m_frameComplete;
+        Clock::time_point m_dispatched;
+        Clock::time_point m_parsed;
+        std::shared_ptr<Pending> m_pending;
+    };
+
+    /// \brief Timings of single delivery. Created when recipient connection was found, copied into write callback.
+    /// Works without scope too (messages from REST API), then only enqueue and socket stages are observed.
+    class DeliveryTrace {
+     public:
+        /// \brief Marks delivery routed, takes message timings from current thread scope
+        DeliveryTrace(user_id_t recipient, conn_id_t connection);
+
+        /// \brief Write added to connection send queue
+        void enqueued();
+
+        /// \brief Write completed or failed
+        /// \param writeStarted time when write left connection send queue, may be empty if unknown
+        /// \param sent
+        void completed(Clock::time_point writeStarted, bool sent);
+
+     private:
+        Clock::time_point m_frameComplete;
+        Clock::time_point m_parsed;
+        Clock::time_point m_routed;
+        Clock::time_point m_enqueued;
+        std::shared_ptr<Pending> m_pending;
+        std::size_t m_index = 0;
+    };
+
+    static MessageTracer &get();
+
+    /// \param capacity ring buffer size
+    explicit MessageTracer(std::size_t capacity = 1024);
+
+    /// \brief Enable sampling
+    /// \param sampleEvery sample every N-th message of thread, 0 - disable sampling (stage histograms are always on)
+    /// \param capacity ring buffer size, previously collected samples are dropped if changed
+    void configure(uint32_t sampleEvery, std::size_t capacity);
+
+    uint32_t getSampleEvery() const;
+
+    /// \brief Collected samples, oldest first
+    std::vector<Sample> dump() const;
+
+    /// \brief Samples as json array. Points are microseconds since frame complete, -1 if point was not reached:
+    /// [{"timestamp": unix time microseconds, "sender": 1, "bytes": 10, "dispatchedUs": 1.5, "parsedUs": 10.2,
+    ///   "deliveries": [{"recipient": 2, "connection": 3, "routedUs": 12, "enqueuedUs": 15, "writeStartedUs": 16,
+    ///                   "writeCompletedUs": 40, "sent": true}]}]
+    nlohmann::json toJson() const;
+
+    /// \brief Drop collected samples
+    void clear();
+
+ private:
+    std::atomic<uint32_t> m_sampleEvery;
+    mutable std::mutex m_ringMutex;
+    std::vector<Sample> m_ring;
+    std::size_t m_next = 0;
+    std::size_t m_size = 0;
+
+    bool shouldSample();
+    void store(Sample &&sample);
+};
+
+}
+
+#endif //WSSERVER_MESSAGETRACER_H
@@ -0,0 +1,112 @@
+/**
+ * wsserver
+ * PresenceMap.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include "PresenceMap.h"
+
+const uint32_t wss::PresenceMap::BLOCK_BITS;
+const uint32_t wss::PresenceMap::BLOCKS;
+const uint32_t wss::PresenceMap::WORDS_PER_BLOCK;
+
+wss::PresenceMap::Block::Block() {
+    for (auto &word: words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+wss::PresenceMap::PresenceMap() :
+    m_blocks(new std::atomic<Block *>[BLOCKS]),
+    m_allocatedBlocks(0),
+    m_count(0) {
+    for (uint32_t i = 0; i < BLOCKS; i++) {
+        m_blocks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+wss::PresenceMap::~PresenceMap() {
+    for (uint32_t i = 0; i < BLOCKS; i++) {
+        delete m_blocks[i].load(std::memory_order_relaxed);
+    }
+}
+
+wss::PresenceMap::Block *wss::PresenceMap::getOrCreateBlock(uint32_t index) {
+    Block *block = m_blocks[index].load(std::memory_order_acquire);
+    if (block != nullptr) {
+        return block;
+    }
+
+    std::lock_guard<wss::sync::Mutex> lock(m_allocMutex);
+    block = m_blocks[index].load(std::memory_order_relaxed);
+    if (block == nullptr) {
+        block = new Block();
+        m_blocks[index].store(block, std::memory_order_release);
+        m_allocatedBlocks++;
+    }
+    return block;
+}
+
+void wss::PresenceMap::set(wss::user_id_t id, bool online) {
+    if (id > UINT32_MAX) {
+        std::lock_guard<wss::sync::Mutex> lock(m_overflowMutex);
+        if (online && m_overflow.insert(id).second) {
+            m_count++;
+        } else if (!online && m_overflow.erase(id) > 0) {
+            m_count--;
+        }
+        return;
+    }
+
+    const auto id32 = (uint32_t) id;
+    const uint32_t offset = id32 & ((1u << BLOCK_BITS) - 1);
+    const uint64_t mask = 1ULL << (offset & 63u);
+
+    Block *block;
+    if (online) {
+        block = getOrCreateBlock(id32 >> BLOCK_BITS);
+    } else {
+        block = m_blocks[id32 >> BLOCK_BITS].load(std::memory_order_acquire);
+        if (block == nullptr) {
+            return;
+        }
+    }
+
+    std::atomic<uint64_t> &word = block->words[offset >> 6];
+    const uint64_t prev = online
+                          ? word.fetch_or(mask, std::memory_order_release)
+                          : word.fetch_and(~mask, std::memory_order_release);
+
+    const bool wasOnline = (prev & mask) != 0;
+    if (online && !wasOnline) {
+        m_count++;
+    } else if (!online && wasOnline) {
+        m_count--;
+    }
+}
+
+bool wss::PresenceMap::isOnline(wss::user_id_t id) const {
+    if (id > UINT32_MAX) {
+        std::lock_guard<wss::sync::Mutex> lock(m_overflowMutex);
+        return m_overflow.count(id) > 0;
+    }
+
+    const auto id32 = (uint32_t) id;
+    const Block *block = m_blocks[id32 >> BLOCK_BITS].load(std::memory_order_acquire);
+    if (block == nullptr) {
+        return false;
+    }
+
+    const uint32_t offset = id32 & ((1u << BLOCK_BITS) - 1);
+    return (block->words[offset >> 6].load(std::memory_order_acquire) >> (offset & 63u)) & 1u;
+}
+
+std::size_t wss::PresenceMap::count() const {
+    return m_count;
+}
+
+std::size_t wss::PresenceMap::getAllocatedBytes() const {
+    return m_allocatedBlocks * sizeof(Block) + BLOCKS * sizeof(std::atomic<Block *>);
+}
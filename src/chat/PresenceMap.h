@@ -0,0 +1,74 @@
+/**
+ * wsserver
+ * PresenceMap.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_PRESENCEMAP_H
+#define WSSERVER_PRESENCEMAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include "../wsserver_core.h"
+#include "../base/LockProfiler.h"
+
+namespace wss {
+
+/// \brief Online flag per user, stored as bitset split into 65536-bit blocks (like roaring bitmap containers):
+/// high 16 bits of 32-bit id select block, low 16 bits - bit in block. Blocks are allocated on first set
+/// and live until map is destroyed, so readers never take locks: lookup is two atomic loads.
+/// Ids that don't fit 32 bits are kept in mutex guarded set.
+/// Writers for the same id must be serialized by caller (chat server does it under statistics lock).
+class PresenceMap {
+ public:
+    PresenceMap();
+    ~PresenceMap();
+
+    PresenceMap(const PresenceMap &) = delete;
+    PresenceMap &operator=(const PresenceMap &) = delete;
+
+    /// \brief Set or clear online flag
+    /// \param id user id
+    /// \param online
+    void set(user_id_t id, bool online);
+
+    /// \brief Lock-free (for 32-bit ids) online check
+    /// \param id user id
+    /// \return true if user is online
+    bool isOnline(user_id_t id) const;
+
+    /// \brief Number of online users
+    std::size_t count() const;
+
+    /// \brief Memory used by allocated blocks, bytes
+    std::size_t getAllocatedBytes() const;
+
+ private:
+    static const uint32_t BLOCK_BITS = 16;
+    static const uint32_t BLOCKS = 1u << (32 - BLOCK_BITS);
+    static const uint32_t WORDS_PER_BLOCK = (1u << BLOCK_BITS) / 64;
+
+    struct Block {
+      std::atomic<uint64_t> words[WORDS_PER_BLOCK];
+      Block();
+    };
+
+    std::unique_ptr<std::atomic<Block *>[]> m_blocks;
+    wss::sync::Mutex m_allocMutex{"presence_alloc"};
+    std::atomic_size_t m_allocatedBlocks;
+    std::atomic_size_t m_count;
+
+    mutable wss::sync::Mutex m_overflowMutex{"presence_overflow"};
+    std::unordered_set<user_id_t> m_overflow;
+
+    Block *getOrCreateBlock(uint32_t index);
+};
+
+}
+
+#endif //WSSERVER_PRESENCEMAP_H
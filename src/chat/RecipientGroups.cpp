@@ -0,0 +1,32 @@
+/**
+ * wsserver
+ * RecipientGroups.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <unordered_map>
+#include "RecipientGroups.h"
+
+std::vector<wss::RecipientGroup> wss::groupByRecipient(const std::vector<wss::MessagePayload> &payloads) {
+    std::vector<RecipientGroup> groups;
+    // recipient -> its group position
+    std::unordered_map<user_id_t, std::size_t> positions;
+    for (std::size_t i = 0; i < payloads.size(); i++) {
+        if (payloads[i].isForBot() || payloads[i].isForRoom()) {
+            continue;
+        }
+        for (user_id_t uid: payloads[i].getRecipients()) {
+            if (uid == 0L) {
+                continue;
+            }
+            const auto inserted = positions.emplace(uid, groups.size());
+            if (inserted.second) {
+                groups.emplace_back(uid, std::vector<std::size_t>());
+            }
+            groups[inserted.first->second].second.push_back(i);
+        }
+    }
+    return groups;
+}
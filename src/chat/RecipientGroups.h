@@ -0,0 +1,32 @@
+/**
+ * wsserver
+ * RecipientGroups.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_RECIPIENTGROUPS_H
+#define WSSERVER_RECIPIENTGROUPS_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Message.h"
+#include "../wsserver_core.h"
+
+namespace wss {
+
+/// \brief Recipient and indexes of its messages in batch
+using RecipientGroup = std::pair<user_id_t, std::vector<std::size_t>>;
+
+/// \brief Group direct messages of batch by recipient, so each recipient gets all its messages with single
+/// connections lookup. Groups are ordered by first message to recipient, indexes in group keep batch order.
+/// Bot and room messages are not grouped.
+/// \param payloads
+/// \return one group per recipient
+std::vector<RecipientGroup> groupByRecipient(const std::vector<wss::MessagePayload> &payloads);
+
+}
+
+#endif //WSSERVER_RECIPIENTGROUPS_H
@@ -0,0 +1,294 @@
+/**
+ * wsserver
+ * RoomStorage.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include "RoomStorage.h"
+#include "../base/Log.h"
+
+/// \brief Journal file starts with it, followed by records: op byte, varint room, varint users count,
+/// varint sorted users (first one as is, others as difference with previous)
+static const char JOURNAL_MAGIC[8] = {'W', 'S', 'S', 'R', 'O', 'O', 'M', '1'};
+
+static void writeVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static bool readVarint(const std::string &in, std::size_t &pos, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        const auto byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::vector<wss::user_id_t> sortedUnique(std::vector<wss::user_id_t> users) {
+    std::sort(users.begin(), users.end());
+    users.erase(std::unique(users.begin(), users.end()), users.end());
+    return users;
+}
+
+static std::vector<wss::user_id_t> merged(const std::vector<wss::user_id_t> &members,
+                                          const std::vector<wss::user_id_t> &sortedUsers) {
+    std::vector<wss::user_id_t> out;
+    out.reserve(members.size() + sortedUsers.size());
+    std::set_union(members.begin(), members.end(), sortedUsers.begin(), sortedUsers.end(), std::back_inserter(out));
+    return out;
+}
+
+static std::vector<wss::user_id_t> without(const std::vector<wss::user_id_t> &members,
+                                           const std::vector<wss::user_id_t> &sortedUsers) {
+    std::vector<wss::user_id_t> out;
+    out.reserve(members.size());
+    std::set_difference(members.begin(), members.end(), sortedUsers.begin(), sortedUsers.end(),
+                        std::back_inserter(out));
+    return out;
+}
+
+static void encodeRecord(std::string &out, uint8_t op, wss::room_id_t room, const std::vector<wss::user_id_t> &sortedUsers) {
+    out += static_cast<char>(op);
+    writeVarint(out, room);
+    writeVarint(out, sortedUsers.size());
+    wss::user_id_t prev = 0;
+    for (wss::user_id_t id: sortedUsers) {
+        writeVarint(out, id - prev);
+        prev = id;
+    }
+}
+
+wss::RoomStorage::RoomStorage(std::string path, std::size_t compactMinSize) :
+    m_path(std::move(path)),
+    m_compactMinSize(compactMinSize) {
+}
+
+wss::RoomStorage::~RoomStorage() {
+    closeJournal();
+}
+
+std::size_t wss::RoomStorage::load() {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    if (m_path.empty()) {
+        return m_rooms.size();
+    }
+    closeJournal();
+
+    std::string data;
+    FILE *in = fopen(m_path.c_str(), "rb");
+    if (in) {
+        char buffer[64 * 1024];
+        std::size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            data.append(buffer, read);
+        }
+        fclose(in);
+    }
+
+    std::size_t pos = sizeof(JOURNAL_MAGIC);
+    if (!data.empty() && (data.size() < pos || memcmp(data.data(), JOURNAL_MAGIC, pos) != 0)) {
+        WSS_ERR_F("Chat::Rooms", "%s is not a rooms journal, it will be overwritten", m_path.c_str());
+        data.clear();
+    }
+
+    std::size_t records = 0;
+    while (pos < data.size()) {
+        const auto op = static_cast<uint8_t>(data[pos++]);
+        uint64_t room, count;
+        if (!readVarint(data, pos, room) || !readVarint(data, pos, count) || count > data.size() - pos) {
+            WSS_WARN_F("Chat::Rooms", "Incomplete record at the end of %s, skipped", m_path.c_str());
+            break;
+        }
+        std::vector<user_id_t> users;
+        users.reserve(count);
+        uint64_t prev = 0, delta = 0;
+        bool complete = true;
+        for (uint64_t i = 0; i < count; i++) {
+            if (!readVarint(data, pos, delta)) {
+                complete = false;
+                break;
+            }
+            prev += delta;
+            users.push_back(prev);
+        }
+        if (!complete) {
+            WSS_WARN_F("Chat::Rooms", "Incomplete record at the end of %s, skipped", m_path.c_str());
+            break;
+        }
+
+        auto it = m_rooms.find(room);
+        switch (op) {
+            case OP_CREATE:
+                m_rooms[room] = std::make_shared<const std::vector<user_id_t>>(std::move(users));
+                break;
+            case OP_REMOVE:
+                m_rooms.erase(room);
+                break;
+            case OP_JOIN:
+                if (it != m_rooms.end()) {
+                    it->second = std::make_shared<const std::vector<user_id_t>>(merged(*it->second, users));
+                }
+                break;
+            case OP_LEAVE:
+                if (it != m_rooms.end()) {
+                    it->second = std::make_shared<const std::vector<user_id_t>>(without(*it->second, users));
+                }
+                break;
+            default:
+                WSS_WARN_F("Chat::Rooms", "Unknown record %d in %s, skipped rest of journal", op, m_path.c_str());
+                pos = data.size();
+                break;
+        }
+        records++;
+    }
+
+    compact();
+    m_loaded = true;
+    WSS_INFO_F("Chat::Rooms", "Loaded %lu room(s) from %lu record(s) of %s", m_rooms.size(), records, m_path.c_str());
+    return m_rooms.size();
+}
+
+bool wss::RoomStorage::create(wss::room_id_t room, const std::vector<wss::user_id_t> &members) {
+    std::vector<user_id_t> sorted = sortedUnique(members);
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    if (m_rooms.find(room) != m_rooms.end()) {
+        return false;
+    }
+    m_rooms[room] = std::make_shared<const std::vector<user_id_t>>(sorted);
+    append(OP_CREATE, room, sorted);
+    return true;
+}
+
+bool wss::RoomStorage::remove(wss::room_id_t room) {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    if (m_rooms.erase(room) == 0) {
+        return false;
+    }
+    append(OP_REMOVE, room, {});
+    return true;
+}
+
+bool wss::RoomStorage::join(wss::room_id_t room, const std::vector<wss::user_id_t> &users) {
+    const std::vector<user_id_t> sorted = sortedUnique(users);
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end()) {
+        return false;
+    }
+    it->second = std::make_shared<const std::vector<user_id_t>>(merged(*it->second, sorted));
+    append(OP_JOIN, room, sorted);
+    return true;
+}
+
+bool wss::RoomStorage::leave(wss::room_id_t room, const std::vector<wss::user_id_t> &users) {
+    const std::vector<user_id_t> sorted = sortedUnique(users);
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end()) {
+        return false;
+    }
+    it->second = std::make_shared<const std::vector<user_id_t>>(without(*it->second, sorted));
+    append(OP_LEAVE, room, sorted);
+    return true;
+}
+
+wss::RoomStorage::Members wss::RoomStorage::getMembers(wss::room_id_t room) const {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    return it == m_rooms.end() ? nullptr : it->second;
+}
+
+bool wss::RoomStorage::exists(wss::room_id_t room) const {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    return m_rooms.find(room) != m_rooms.end();
+}
+
+bool wss::RoomStorage::isMember(wss::room_id_t room, wss::user_id_t user) const {
+    const Members members = getMembers(room);
+    return members && std::binary_search(members->begin(), members->end(), user);
+}
+
+std::size_t wss::RoomStorage::size() const {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    return m_rooms.size();
+}
+
+void wss::RoomStorage::append(Op op, wss::room_id_t room, const std::vector<wss::user_id_t> &users) {
+    if (m_path.empty()) {
+        return;
+    }
+    if (!m_journal) {
+        // not loaded yet: records are appended to existing journal and replayed after it by next load
+        m_journal = fopen(m_path.c_str(), "ab");
+        if (!m_journal) {
+            WSS_ERR_F("Chat::Rooms", "Unable to open %s: %s", m_path.c_str(), strerror(errno));
+            return;
+        }
+        if (ftell(m_journal) == 0) {
+            fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), m_journal);
+        }
+    }
+
+    std::string record;
+    encodeRecord(record, op, room, users);
+    if (fwrite(record.data(), 1, record.size(), m_journal) != record.size() || fflush(m_journal) != 0) {
+        WSS_ERR_F("Chat::Rooms", "Unable to write %s: %s", m_path.c_str(), strerror(errno));
+    }
+    m_journalSize += record.size();
+
+    // change is already applied to rooms, so compacted state includes this record
+    if (m_loaded && m_journalSize > COMPACT_RATIO * std::max(m_snapshotSize, m_compactMinSize)) {
+        closeJournal();
+        if (!compact()) {
+            // next try after journal grows again, not on every record
+            m_snapshotSize = m_journalSize;
+        }
+    }
+}
+
+bool wss::RoomStorage::compact() {
+    const std::string tmpPath = m_path + ".tmp";
+    FILE *out = fopen(tmpPath.c_str(), "wb");
+    if (!out) {
+        WSS_ERR_F("Chat::Rooms", "Unable to open %s: %s", tmpPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::string data(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    for (const auto &room: m_rooms) {
+        encodeRecord(data, OP_CREATE, room.first, *room.second);
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), out) == data.size();
+    if (fclose(out) != 0 || !written || rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+        WSS_ERR_F("Chat::Rooms", "Unable to write %s: %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+    m_snapshotSize = data.size();
+    m_journalSize = data.size();
+
+    m_journal = fopen(m_path.c_str(), "ab");
+    if (!m_journal) {
+        WSS_ERR_F("Chat::Rooms", "Unable to open %s: %s", m_path.c_str(), strerror(errno));
+    }
+    return true;
+}
+
+void wss::RoomStorage::closeJournal() {
+    if (m_journal) {
+        fclose(m_journal);
+        m_journal = nullptr;
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * wsserver
+ * RoomStorage.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_ROOMSTORAGE_H
+#define WSSERVER_ROOMSTORAGE_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../wsserver_core.h"
+#include "../base/LockProfiler.h"
+
+namespace wss {
+
+/// \brief Server-side rooms: room id -> sorted member ids. Members list is immutable snapshot, replaced on every
+/// change, so publishing takes it under short lock and fans out without holding any.
+/// Changes are appended to journal file (varint records), that is compacted on load, and after load - when it
+/// grows COMPACT_RATIO times larger than last compacted state (but not smaller than compactMinSize).
+class RoomStorage {
+ public:
+    using Members = std::shared_ptr<const std::vector<user_id_t>>;
+
+    static const std::size_t COMPACT_RATIO = 4;
+    static const std::size_t DEFAULT_COMPACT_MIN_SIZE = 1024 * 1024;
+
+    /// \param path journal file path. Empty - rooms are kept only in memory
+    /// \param compactMinSize journal is not compacted while it is smaller, bytes
+    explicit RoomStorage(std::string path = std::string(), std::size_t compactMinSize = DEFAULT_COMPACT_MIN_SIZE);
+    ~RoomStorage();
+
+    RoomStorage(const RoomStorage &) = delete;
+    RoomStorage &operator=(const RoomStorage &) = delete;
+
+    /// \brief Replays journal and rewrites it compacted. Incomplete tail record (interrupted write) is ignored
+    /// \return number of loaded rooms
+    std::size_t load();
+
+    /// \brief Create room
+    /// \param room room id, not 0
+    /// \param members initial members
+    /// \return false if room already exists
+    bool create(room_id_t room, const std::vector<user_id_t> &members = {});
+
+    /// \brief Delete room with its members
+    /// \return false if room does not exist
+    bool remove(room_id_t room);
+
+    /// \brief Add users to room. Already joined users are skipped
+    /// \return false if room does not exist
+    bool join(room_id_t room, const std::vector<user_id_t> &users);
+
+    /// \brief Remove users from room
+    /// \return false if room does not exist
+    bool leave(room_id_t room, const std::vector<user_id_t> &users);
+
+    /// \param room
+    /// \return members snapshot, nullptr if room does not exist
+    Members getMembers(room_id_t room) const;
+
+    bool exists(room_id_t room) const;
+    bool isMember(room_id_t room, user_id_t user) const;
+
+    /// \return number of rooms
+    std::size_t size() const;
+
+ private:
+    enum Op : uint8_t {
+      OP_CREATE = 1,
+      OP_REMOVE = 2,
+      OP_JOIN = 3,
+      OP_LEAVE = 4,
+    };
+
+    mutable wss::sync::Mutex m_mutex{"chat_rooms"};
+    std::unordered_map<room_id_t, Members> m_rooms;
+    const std::string m_path;
+    const std::size_t m_compactMinSize;
+    FILE *m_journal = nullptr;
+    /// \brief Journal is compacted only after it is loaded, records before load are not in memory yet
+    bool m_loaded = false;
+    /// \brief Size of journal written by last compaction and current journal size
+    std::size_t m_snapshotSize = 0;
+    std::size_t m_journalSize = 0;
+
+    /// \brief Appends record to journal and compacts it if it has grown, must be called under lock after change
+    /// is applied to rooms
+    void append(Op op, room_id_t room, const std::vector<user_id_t> &users);
+    /// \brief Writes current state as new journal and reopens it for appending, must be called under lock
+    /// \return false if journal can't be written, old journal is kept
+    bool compact();
+    void closeJournal();
+};
+
+}
+
+#endif //WSSERVER_ROOMSTORAGE_H
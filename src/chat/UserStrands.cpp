@@ -0,0 +1,65 @@
+/**
+ * wsserver
+ * UserStrands.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <boost/bind.hpp>
+#include "UserStrands.h"
+
+wss::UserStrands::UserStrands(std::size_t shards, std::size_t threads) :
+    m_ioService(),
+    m_work(std::make_unique<boost::asio::io_service::work>(m_ioService)),
+    m_threadsCount(threads == 0 ? 1 : threads) {
+    const std::size_t count = shards == 0 ? 1 : shards;
+    m_strands.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        m_strands.push_back(std::make_unique<boost::asio::io_service::strand>(m_ioService));
+    }
+}
+
+wss::UserStrands::~UserStrands() {
+    stop();
+    join();
+}
+
+void wss::UserStrands::start() {
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    for (std::size_t i = 0; i < m_threadsCount; i++) {
+        m_threads.create_thread(boost::bind(&boost::asio::io_service::run, &m_ioService));
+    }
+}
+
+void wss::UserStrands::stop() {
+    m_work.reset();
+    m_ioService.stop();
+}
+
+void wss::UserStrands::join() {
+    m_threads.join_all();
+}
+
+void wss::UserStrands::post(wss::user_id_t id, wss::UserStrands::Task task) {
+    m_strands[shardOf(id)]->post(std::move(task));
+}
+
+void wss::UserStrands::postToShard(std::size_t shard, wss::UserStrands::Task task) {
+    m_strands[shard]->post(std::move(task));
+}
+
+bool wss::UserStrands::isInShard(wss::user_id_t id) const {
+    return m_strands[shardOf(id)]->running_in_this_thread();
+}
+
+std::size_t wss::UserStrands::getShards() const {
+    return m_strands.size();
+}
+
+std::size_t wss::UserStrands::getThreads() const {
+    return m_threadsCount;
+}
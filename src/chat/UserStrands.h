@@ -0,0 +1,80 @@
+/**
+ * wsserver
+ * UserStrands.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_USERSTRANDS_H
+#define WSSERVER_USERSTRANDS_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/thread.hpp>
+#include "../wsserver_core.h"
+
+namespace wss {
+
+/// \brief Serialized executors of users. Users are spread over fixed number of shards by id, every shard is asio strand
+/// on shared thread pool: tasks of one shard run one at a time, in order they were posted, tasks of different shards
+/// run in parallel. Everything that touches user delivery state (sends, redelivery, connection changes) is posted
+/// to user shard, so such state needs no locks, if it is split by shards too (see shardOf()).
+class UserStrands {
+ public:
+    using Task = std::function<void()>;
+
+    /// \param shards number of shards, at least 1
+    /// \param threads number of pool threads, at least 1
+    UserStrands(std::size_t shards, std::size_t threads);
+    ~UserStrands();
+
+    UserStrands(const UserStrands &) = delete;
+    UserStrands &operator=(const UserStrands &) = delete;
+
+    /// \brief Starts pool threads. Tasks posted before start are kept and run after it
+    void start();
+
+    /// \brief Stops pool, not started tasks are dropped
+    void stop();
+
+    void join();
+
+    /// \brief Run task on user shard, after all tasks posted to shard before. Never runs task inline
+    /// \param id user id
+    /// \param task
+    void post(user_id_t id, Task task);
+
+    /// \brief Run task on shard, used to run one task for many users of that shard
+    /// \param shard shard index, [0, getShards())
+    /// \param task
+    void postToShard(std::size_t shard, Task task);
+
+    /// \return true if current thread runs task of user shard
+    bool isInShard(user_id_t id) const;
+
+    /// \param id user id
+    /// \return shard index, [0, getShards())
+    std::size_t shardOf(user_id_t id) const {
+        return id % m_strands.size();
+    }
+
+    std::size_t getShards() const;
+    std::size_t getThreads() const;
+
+ private:
+    boost::asio::io_service m_ioService;
+    std::unique_ptr<boost::asio::io_service::work> m_work;
+    std::vector<std::unique_ptr<boost::asio::io_service::strand>> m_strands;
+    boost::thread_group m_threads;
+    const std::size_t m_threadsCount;
+    bool m_started = false;
+};
+
+}
+
+#endif //WSSERVER_USERSTRANDS_H
@@ -0,0 +1,588 @@
+/**
+ * wsserver
+ * Cluster.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/write.hpp>
+#include "Cluster.h"
+#include "Protocol.h"
+#include "../base/Log.h"
+#include "../base/Metrics.h"
+
+using boost::asio::ip::tcp;
+using wss::metrics::Registry;
+
+/// \brief Bytes queued to one node, while link is down or slow. Messages above are returned
+static const std::size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+/// \brief Delay before next connection attempt to node
+static const long RECONNECT_INTERVAL_MS = 1000;
+
+static wss::metrics::Counter &metricForwarded =
+    Registry::get().counter("wss_cluster_forwarded_total", "Messages queued to other cluster nodes");
+static wss::metrics::Counter &metricReceived =
+    Registry::get().counter("wss_cluster_received_total", "Messages received from other cluster nodes");
+static wss::metrics::Counter &metricReturned =
+    Registry::get().counter("wss_cluster_returned_total",
+                            "Messages not sent to other cluster node, because its link was lost or overflowed");
+static wss::metrics::Counter &metricWrites =
+    Registry::get().counter("wss_cluster_writes_total", "Socket writes to other cluster nodes, each carries batch of frames");
+
+/// \brief Compares secrets in time that does not depend on position of first difference
+static bool secretEquals(const std::string &expected, const std::string &actual) {
+    if (expected.size() != actual.size()) {
+        return false;
+    }
+    unsigned char diff = 0;
+    for (std::size_t i = 0; i < actual.size(); i++) {
+        diff |= static_cast<unsigned char>(expected[i] ^ actual[i]);
+    }
+    return diff == 0;
+}
+
+/// \brief Outgoing link to node. Socket is used only on cluster thread, queue is filled from any thread
+class wss::cluster::Cluster::Peer : public std::enable_shared_from_this<Peer> {
+ public:
+    Peer(Cluster &cluster, NodeAddress node) :
+        m_cluster(cluster),
+        m_node(std::move(node)),
+        m_socket(cluster.m_ioService),
+        m_resolver(cluster.m_ioService),
+        m_retry(cluster.m_ioService) {
+    }
+
+    const NodeAddress &getNode() const {
+        return m_node;
+    }
+
+    bool isConnected() const {
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        return m_connected;
+    }
+
+    /// \brief Cluster thread
+    void connect() {
+        auto self = shared_from_this();
+        const tcp::resolver::query query(m_node.address, std::to_string(m_node.port));
+        m_resolver.async_resolve(query, [this, self](const boost::system::error_code &ec, tcp::resolver::iterator it) {
+          if (m_cluster.m_stopped) {
+              return;
+          }
+          if (ec) {
+              retry(ec);
+              return;
+          }
+          boost::asio::async_connect(m_socket, it, [this, self](const boost::system::error_code &ec,
+                                                                tcp::resolver::iterator) {
+            if (m_cluster.m_stopped) {
+                return;
+            }
+            if (ec) {
+                retry(ec);
+                return;
+            }
+            boost::system::error_code ignored;
+            m_socket.set_option(tcp::no_delay(true), ignored);
+            WSS_INFO_F("Cluster", "Link to node %u (%s:%u) established",
+                       m_node.id, m_node.address.c_str(), (unsigned) m_node.port);
+            m_cluster.onPeerConnected(*this);
+            read(m_generation);
+          });
+        });
+    }
+
+    /// \brief Cluster thread, under cluster local presence lock: greeting goes before any queued frame
+    void open(std::string &&greeting) {
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        m_connected = true;
+        m_generation++;
+        m_pending = std::move(greeting);
+        if (!m_writing) {
+            m_writing = true;
+            m_cluster.m_ioService.post([self = shared_from_this()] { self->write(); });
+        }
+    }
+
+    /// \brief Any thread
+    /// \return false if link is down or queue is full
+    bool enqueue(const std::string &frames) {
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        if (!m_connected || m_pending.size() + frames.size() > MAX_PENDING_BYTES) {
+            return false;
+        }
+        m_pending += frames;
+        if (!m_writing) {
+            m_writing = true;
+            m_cluster.m_ioService.post([self = shared_from_this()] { self->write(); });
+        }
+        return true;
+    }
+
+    /// \brief Cluster thread
+    void close() {
+        boost::system::error_code ignored;
+        m_retry.cancel(ignored);
+        m_resolver.cancel();
+        m_socket.close(ignored);
+        std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+        m_connected = false;
+    }
+
+ private:
+    Cluster &m_cluster;
+    const NodeAddress m_node;
+    tcp::socket m_socket;
+    tcp::resolver m_resolver;
+    boost::asio::deadline_timer m_retry;
+    char m_readBuffer[512];
+    // cluster thread only
+    std::string m_writeBuffer;
+    bool m_inFlight = false;
+    bool m_lossReported = false;
+
+    mutable wss::sync::Mutex m_mutex{"cluster_peer"};
+    bool m_connected = false;
+    bool m_writing = false;
+    // handlers of previous connection are ignored
+    uint64_t m_generation = 0;
+    std::string m_pending;
+
+    /// \brief Sends everything queued while previous write was in progress by single write
+    void write() {
+        if (m_inFlight) {
+            // completion of current write calls it again
+            return;
+        }
+        uint64_t generation;
+        {
+            std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+            if (!m_connected || m_pending.empty()) {
+                m_writing = false;
+                return;
+            }
+            m_writeBuffer.swap(m_pending);
+            m_pending.clear();
+            generation = m_generation;
+        }
+
+        metricWrites.inc();
+        m_inFlight = true;
+        auto self = shared_from_this();
+        boost::asio::async_write(m_socket, boost::asio::buffer(m_writeBuffer),
+                                 [this, self, generation](const boost::system::error_code &ec, std::size_t) {
+                                   m_inFlight = false;
+                                   if (ec) {
+                                       // node may have got part of batch: duplicates are preferred to losses
+                                       m_cluster.returnMessages(m_writeBuffer);
+                                       m_writeBuffer.clear();
+                                       fail(generation, ec);
+                                   }
+                                   // continues with frames queued meanwhile, or with new connection ones
+                                   write();
+                                 });
+    }
+
+    /// \brief Nothing is expected from node on this link, read only detects its close
+    void read(uint64_t generation) {
+        auto self = shared_from_this();
+        m_socket.async_read_some(boost::asio::buffer(m_readBuffer),
+                                 [this, self, generation](const boost::system::error_code &ec, std::size_t) {
+                                   if (ec) {
+                                       fail(generation, ec);
+                                       return;
+                                   }
+                                   read(generation);
+                                 });
+    }
+
+    void fail(uint64_t generation, const boost::system::error_code &ec) {
+        std::string unsent;
+        {
+            std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+            if (!m_connected || generation != m_generation) {
+                return;
+            }
+            m_connected = false;
+            m_writing = false;
+            unsent.swap(m_pending);
+        }
+        boost::system::error_code ignored;
+        m_socket.close(ignored);
+        m_cluster.returnMessages(unsent);
+        if (m_cluster.m_stopped) {
+            return;
+        }
+        retry(ec);
+    }
+
+    void retry(const boost::system::error_code &ec) {
+        if (!m_lossReported) {
+            WSS_WARN_F("Cluster", "Link to node %u (%s:%u) is down: %s. Reconnecting...",
+                       m_node.id, m_node.address.c_str(), (unsigned) m_node.port, ec.message().c_str());
+            m_lossReported = true;
+        }
+        boost::system::error_code ignored;
+        m_socket.close(ignored);
+        m_retry.expires_from_now(boost::posix_time::milliseconds(RECONNECT_INTERVAL_MS));
+        m_retry.async_wait([this, self = shared_from_this()](const boost::system::error_code &ec) {
+          if (ec || m_cluster.m_stopped) {
+              return;
+          }
+          connect();
+        });
+    }
+
+    friend class Cluster;
+};
+
+/// \brief Incoming link from node. Cluster thread only
+class wss::cluster::Cluster::Session : public std::enable_shared_from_this<Session> {
+ public:
+    explicit Session(Cluster &cluster) :
+        m_cluster(cluster),
+        m_socket(cluster.m_ioService) {
+    }
+
+    tcp::socket &getSocket() {
+        return m_socket;
+    }
+
+    /// \return node id, 0 until hello is received
+    uint32_t getNode() const {
+        return m_node;
+    }
+
+    void read() {
+        auto self = shared_from_this();
+        m_socket.async_read_some(boost::asio::buffer(m_buffer),
+                                 [this, self](const boost::system::error_code &ec, std::size_t length) {
+                                   if (ec) {
+                                       m_cluster.onSessionClosed(self);
+                                       return;
+                                   }
+                                   m_reader.feed(m_buffer, length);
+                                   Frame frame;
+                                   while (m_reader.next(frame)) {
+                                       if (!handle(frame)) {
+                                           close();
+                                           m_cluster.onSessionClosed(self);
+                                           return;
+                                       }
+                                   }
+                                   if (m_reader.isBroken()) {
+                                       WSS_WARN("Cluster", "Invalid frame size, closing link");
+                                       close();
+                                       m_cluster.onSessionClosed(self);
+                                       return;
+                                   }
+                                   read();
+                                 });
+    }
+
+    void close() {
+        boost::system::error_code ignored;
+        m_socket.close(ignored);
+    }
+
+ private:
+    Cluster &m_cluster;
+    tcp::socket m_socket;
+    FrameReader m_reader;
+    char m_buffer[64 * 1024];
+    uint32_t m_node = 0;
+    std::vector<PresenceChange> m_changes;
+
+    bool handle(const Frame &frame) {
+        if (m_node == 0) {
+            uint32_t node;
+            std::string secret;
+            if (!decodeHello(frame, node, secret) || node == 0 || node > MAX_NODES || node == m_cluster.m_nodeId) {
+                WSS_WARN("Cluster", "Invalid hello frame, closing link");
+                return false;
+            }
+            if (!secretEquals(m_cluster.m_secret, secret)) {
+                boost::system::error_code ignored;
+                WSS_WARN_F("Cluster", "Link from %s with wrong cluster secret, closing it",
+                           m_socket.remote_endpoint(ignored).address().to_string().c_str());
+                return false;
+            }
+            m_node = node;
+            m_cluster.onSessionHello(*this, node);
+            return true;
+        }
+
+        switch (frame.type) {
+            case FrameType::Presence:
+                if (!decodePresence(frame, m_changes)) {
+                    return false;
+                }
+                for (const auto &change: m_changes) {
+                    m_cluster.m_directory.set(change.first, m_node, change.second);
+                }
+                return true;
+            case FrameType::Message: {
+                user_id_t recipient;
+                std::string json;
+                if (!decodeMessage(frame, recipient, json)) {
+                    return false;
+                }
+                metricReceived.inc();
+                if (m_cluster.m_onMessage) {
+                    m_cluster.m_onMessage(recipient, std::move(json));
+                }
+                return true;
+            }
+            default:
+                WSS_WARN_F("Cluster", "Unknown frame type %d from node %u", (int) frame.type, m_node);
+                return false;
+        }
+    }
+};
+
+wss::cluster::Cluster::Cluster(uint32_t nodeId,
+                               const std::string &address,
+                               uint16_t port,
+                               const std::vector<wss::cluster::NodeAddress> &nodes,
+                               const std::string &secret) :
+    m_nodeId(nodeId),
+    m_address(address),
+    m_port(port),
+    m_secret(secret),
+    m_work(std::make_unique<boost::asio::io_service::work>(m_ioService)),
+    m_acceptor(m_ioService),
+    m_peers(MAX_NODES) {
+    if (nodeId == 0 || nodeId > MAX_NODES) {
+        throw std::invalid_argument("Cluster node id must be in range 1.." + std::to_string(MAX_NODES));
+    }
+    boost::system::error_code ec;
+    const auto listenAddress = boost::asio::ip::address::from_string(address, ec);
+    if (ec) {
+        throw std::invalid_argument("Invalid cluster listen address " + address);
+    }
+    if (secret.empty() && !listenAddress.is_loopback()) {
+        // anyone who reaches the port could change presence and send messages on behalf of any user
+        throw std::invalid_argument("Cluster secret is required to listen on " + address);
+    }
+    for (const auto &node: nodes) {
+        if (node.id == 0 || node.id > MAX_NODES) {
+            throw std::invalid_argument("Cluster node id must be in range 1.." + std::to_string(MAX_NODES));
+        }
+        if (node.id != nodeId) {
+            m_peers[node.id - 1] = std::make_shared<Peer>(*this, node);
+        }
+    }
+
+    Registry::get().addCollector(this, "wss_cluster_links", "Cluster nodes with established outgoing link",
+                                 [this](Registry::Samples &samples) {
+                                   samples.emplace_back("", (double) getConnectedPeers());
+                                 });
+}
+
+wss::cluster::Cluster::~Cluster() {
+    Registry::get().removeCollectors(this);
+    stop();
+    join();
+}
+
+void wss::cluster::Cluster::setMessageHandler(wss::cluster::Cluster::MessageHandler handler) {
+    m_onMessage = std::move(handler);
+}
+
+void wss::cluster::Cluster::setReturnHandler(wss::cluster::Cluster::MessageHandler handler) {
+    m_onReturn = std::move(handler);
+}
+
+void wss::cluster::Cluster::start() {
+    if (m_thread) {
+        return;
+    }
+    const tcp::endpoint endpoint(boost::asio::ip::address::from_string(m_address), m_port);
+    m_acceptor.open(endpoint.protocol());
+    m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+    m_acceptor.bind(endpoint);
+    m_acceptor.listen();
+    m_port = m_acceptor.local_endpoint().port();
+    WSS_INFO_F("Cluster", "Node %u is listening at %s:%u", m_nodeId, m_address.c_str(), (unsigned) m_port);
+
+    accept();
+    for (auto &peer: m_peers) {
+        if (peer) {
+            peer->connect();
+        }
+    }
+    m_thread = std::make_unique<boost::thread>([this] {
+      m_ioService.run();
+    });
+}
+
+void wss::cluster::Cluster::stop() {
+    if (!m_work) {
+        return;
+    }
+    m_ioService.post([this] {
+      closeAll();
+    });
+    // thread exits, when handlers of closed sockets are done
+    m_work.reset();
+}
+
+void wss::cluster::Cluster::join() {
+    if (m_thread) {
+        m_thread->join();
+        m_thread.reset();
+    }
+}
+
+void wss::cluster::Cluster::setLocalPresence(wss::user_id_t user, bool online) {
+    std::string frame;
+    encodePresence(frame, {{user, online}});
+
+    std::lock_guard<wss::sync::Mutex> lock(m_localMutex);
+    if (online) {
+        m_local.insert(user);
+    } else {
+        m_local.erase(user);
+    }
+    // links that are down get whole presence on connect
+    for (auto &peer: m_peers) {
+        if (peer) {
+            peer->enqueue(frame);
+        }
+    }
+}
+
+uint64_t wss::cluster::Cluster::getRemoteNodes(wss::user_id_t user) const {
+    return m_directory.getNodes(user);
+}
+
+void wss::cluster::Cluster::forward(uint64_t nodes, wss::user_id_t recipient, const std::string &json) {
+    std::string frame;
+    encodeMessage(frame, recipient, json);
+    for (uint32_t node = 1; node <= MAX_NODES && nodes != 0; node++) {
+        if ((nodes & Directory::maskOf(node)) == 0) {
+            continue;
+        }
+        nodes &= ~Directory::maskOf(node);
+
+        const auto &peer = m_peers[node - 1];
+        if (peer && peer->enqueue(frame)) {
+            metricForwarded.inc();
+        } else {
+            metricReturned.inc();
+            if (m_onReturn) {
+                m_onReturn(recipient, std::string(json));
+            }
+        }
+    }
+}
+
+uint32_t wss::cluster::Cluster::getNodeId() const {
+    return m_nodeId;
+}
+
+uint16_t wss::cluster::Cluster::getPort() const {
+    return m_port;
+}
+
+std::size_t wss::cluster::Cluster::getConnectedPeers() const {
+    std::size_t connected = 0;
+    for (const auto &peer: m_peers) {
+        if (peer && peer->isConnected()) {
+            connected++;
+        }
+    }
+    return connected;
+}
+
+void wss::cluster::Cluster::accept() {
+    auto session = std::make_shared<Session>(*this);
+    m_acceptor.async_accept(session->getSocket(), [this, session](const boost::system::error_code &ec) {
+      if (m_stopped) {
+          return;
+      }
+      if (ec) {
+          WSS_WARN_F("Cluster", "Unable to accept link: %s", ec.message().c_str());
+      } else {
+          boost::system::error_code ignored;
+          session->getSocket().set_option(tcp::no_delay(true), ignored);
+          m_sessions.insert(session);
+          session->read();
+      }
+      accept();
+    });
+}
+
+void wss::cluster::Cluster::closeAll() {
+    m_stopped = true;
+    boost::system::error_code ignored;
+    m_acceptor.close(ignored);
+    for (auto &session: m_sessions) {
+        session->close();
+    }
+    for (auto &peer: m_peers) {
+        if (peer) {
+            peer->close();
+        }
+    }
+}
+
+void wss::cluster::Cluster::onPeerConnected(wss::cluster::Cluster::Peer &peer) {
+    std::string greeting;
+    encodeHello(greeting, m_nodeId, m_secret);
+
+    std::lock_guard<wss::sync::Mutex> lock(m_localMutex);
+    std::vector<PresenceChange> snapshot;
+    snapshot.reserve(m_local.size());
+    for (user_id_t user: m_local) {
+        snapshot.emplace_back(user, true);
+    }
+    encodePresence(greeting, snapshot);
+    peer.m_lossReported = false;
+    peer.open(std::move(greeting));
+}
+
+void wss::cluster::Cluster::onSessionHello(wss::cluster::Cluster::Session &session, uint32_t node) {
+    auto it = m_nodeSessions.find(node);
+    if (it != m_nodeSessions.end() && it->second != &session) {
+        // node reconnected before previous link was detected as closed
+        it->second->close();
+    }
+    m_nodeSessions[node] = &session;
+    // presence snapshot follows hello
+    m_directory.clearNode(node);
+    WSS_INFO_F("Cluster", "Node %u connected", node);
+}
+
+void wss::cluster::Cluster::onSessionClosed(const std::shared_ptr<wss::cluster::Cluster::Session> &session) {
+    if (m_sessions.erase(session) == 0) {
+        return;
+    }
+    const uint32_t node = session->getNode();
+    auto it = m_nodeSessions.find(node);
+    if (node != 0 && it != m_nodeSessions.end() && it->second == session.get()) {
+        m_nodeSessions.erase(it);
+        // users of node are offline for this node, until it connects again
+        m_directory.clearNode(node);
+        WSS_INFO_F("Cluster", "Node %u disconnected", node);
+    }
+}
+
+void wss::cluster::Cluster::returnMessages(const std::string &frames) {
+    FrameReader reader;
+    reader.feed(frames.data(), frames.size());
+    Frame frame;
+    user_id_t recipient;
+    std::string json;
+    while (reader.next(frame)) {
+        if (decodeMessage(frame, recipient, json)) {
+            metricReturned.inc();
+            if (m_onReturn) {
+                m_onReturn(recipient, std::move(json));
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * wsserver
+ * Cluster.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_CLUSTER_H
+#define WSSERVER_CLUSTER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/thread.hpp>
+#include "../wsserver_core.h"
+#include "../base/LockProfiler.h"
+#include "Directory.h"
+
+namespace wss {
+namespace cluster {
+
+struct NodeAddress {
+  uint32_t id;
+  std::string address;
+  uint16_t port;
+};
+
+/// \brief Node of chat servers cluster. Keeps persistent TCP link to every other node and accepts theirs.
+/// Outgoing link carries presence changes of local users and messages to users connected to that node,
+/// incoming links fill presence directory and bring messages for local users.
+/// Frames queued while previous write is in progress are sent together by single write.
+/// Incoming link is accepted only if its hello carries the same cluster secret.
+/// All socket work runs on single own thread.
+class Cluster {
+ public:
+    /// \brief Handler of message json for user
+    using MessageHandler = std::function<void(user_id_t recipient, std::string &&json)>;
+
+    /// \param nodeId this node id, 1..MAX_NODES
+    /// \param address listen address
+    /// \param port listen port, 0 - any free
+    /// \param nodes other nodes, entry with nodeId is skipped, so all nodes may share the same list
+    /// \param secret shared by all nodes: sent in hello of outgoing links and required in hello of incoming ones.
+    /// Throws std::invalid_argument if it is empty and listen address is not loopback
+    Cluster(uint32_t nodeId,
+            const std::string &address,
+            uint16_t port,
+            const std::vector<NodeAddress> &nodes,
+            const std::string &secret = "");
+    ~Cluster();
+
+    Cluster(const Cluster &) = delete;
+    Cluster &operator=(const Cluster &) = delete;
+
+    /// \brief Messages forwarded to this node by others. Called on cluster thread, must not block
+    void setMessageHandler(MessageHandler handler);
+
+    /// \brief Messages that were not sent to other node, because its link is lost or overflowed. Batch that was being
+    /// written when link broke is returned too, node may have got part of it. Called on cluster thread or inside forward()
+    void setReturnHandler(MessageHandler handler);
+
+    /// \brief Binds listen port and starts connecting to nodes. Throws boost::system::system_error if port is busy
+    void start();
+    void stop();
+    void join();
+
+    /// \brief Announce local user presence to other nodes. Calls for one user must be serialized by caller
+    /// \param user
+    /// \param online true if user has at least one local connection
+    void setLocalPresence(user_id_t user, bool online);
+
+    /// \param user
+    /// \return mask of other nodes user is connected to (see Directory::maskOf())
+    uint64_t getRemoteNodes(user_id_t user) const;
+
+    /// \brief Queue message to user connected to other nodes
+    /// \param nodes nodes mask
+    /// \param recipient
+    /// \param json payload json
+    void forward(uint64_t nodes, user_id_t recipient, const std::string &json);
+
+    uint32_t getNodeId() const;
+
+    /// \return bound listen port, valid after start()
+    uint16_t getPort() const;
+
+    /// \return number of nodes with established outgoing link
+    std::size_t getConnectedPeers() const;
+
+ private:
+    class Peer;
+    class Session;
+
+    const uint32_t m_nodeId;
+    const std::string m_address;
+    uint16_t m_port;
+    const std::string m_secret;
+
+    boost::asio::io_service m_ioService;
+    std::unique_ptr<boost::asio::io_service::work> m_work;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    std::unique_ptr<boost::thread> m_thread;
+    bool m_stopped = false;
+
+    MessageHandler m_onMessage;
+    MessageHandler m_onReturn;
+    Directory m_directory;
+
+    // peers list is fixed after construction, index by node id - 1
+    std::vector<std::shared_ptr<Peer>> m_peers;
+
+    // local presence, announced to every link on connect; guards order of snapshot and changes
+    mutable wss::sync::Mutex m_localMutex{"cluster_local"};
+    std::unordered_set<user_id_t> m_local;
+
+    // cluster thread only
+    std::unordered_set<std::shared_ptr<Session>> m_sessions;
+    std::unordered_map<uint32_t, Session *> m_nodeSessions;
+
+    void accept();
+    void closeAll();
+    void onPeerConnected(Peer &peer);
+    void onSessionHello(Session &session, uint32_t node);
+    void onSessionClosed(const std::shared_ptr<Session> &session);
+    void returnMessages(const std::string &frames);
+};
+
+}
+}
+
+#endif //WSSERVER_CLUSTER_H
@@ -0,0 +1,53 @@
+/**
+ * wsserver
+ * Directory.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include "Directory.h"
+
+void wss::cluster::Directory::set(wss::user_id_t user, uint32_t node, bool online) {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    if (online) {
+        m_nodes[user] |= maskOf(node);
+    } else {
+        auto it = m_nodes.find(user);
+        if (it == m_nodes.end()) {
+            return;
+        }
+        it->second &= ~maskOf(node);
+        if (it->second == 0) {
+            m_nodes.erase(it);
+        }
+    }
+    m_size.store(m_nodes.size(), std::memory_order_release);
+}
+
+void wss::cluster::Directory::clearNode(uint32_t node) {
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    const uint64_t mask = ~maskOf(node);
+    for (auto it = m_nodes.begin(); it != m_nodes.end();) {
+        it->second &= mask;
+        if (it->second == 0) {
+            it = m_nodes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_size.store(m_nodes.size(), std::memory_order_release);
+}
+
+uint64_t wss::cluster::Directory::getNodes(wss::user_id_t user) const {
+    if (m_size.load(std::memory_order_acquire) == 0) {
+        return 0;
+    }
+    std::lock_guard<wss::sync::Mutex> lock(m_mutex);
+    auto it = m_nodes.find(user);
+    return it == m_nodes.end() ? 0 : it->second;
+}
+
+std::size_t wss::cluster::Directory::size() const {
+    return m_size.load(std::memory_order_acquire);
+}
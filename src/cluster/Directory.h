@@ -0,0 +1,54 @@
+/**
+ * wsserver
+ * Directory.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_CLUSTER_DIRECTORY_H
+#define WSSERVER_CLUSTER_DIRECTORY_H
+
+#include <atomic>
+#include <cstdint>
+#include "../wsserver_core.h"
+#include "../base/LockProfiler.h"
+
+namespace wss {
+namespace cluster {
+
+/// \brief Node ids are 1..MAX_NODES, node is bit (id - 1) of nodes mask
+static const uint32_t MAX_NODES = 64;
+
+/// \brief Presence directory of remote nodes: user -> mask of nodes user is connected to.
+/// Filled from presence frames of each node, node entries are cleared when its link is lost.
+class Directory {
+ public:
+    /// \brief Set or clear node in user mask
+    void set(user_id_t user, uint32_t node, bool online);
+
+    /// \brief Clear node from all users
+    void clearNode(uint32_t node);
+
+    /// \param user
+    /// \return mask of nodes user is connected to, 0 if user is offline on all of them
+    uint64_t getNodes(user_id_t user) const;
+
+    /// \return number of users online on at least one remote node
+    std::size_t size() const;
+
+    static uint64_t maskOf(uint32_t node) {
+        return uint64_t(1) << (node - 1);
+    }
+
+ private:
+    mutable wss::sync::Mutex m_mutex{"cluster_directory"};
+    UserMap<uint64_t> m_nodes;
+    // lets local-only deliveries skip lock while no one is online remotely
+    std::atomic_size_t m_size{0};
+};
+
+}
+}
+
+#endif //WSSERVER_CLUSTER_DIRECTORY_H
@@ -0,0 +1,110 @@
+/**
+ * wsserver
+ * Protocol.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include "Protocol.h"
+
+static void writeUint(std::string &out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        out += static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+}
+
+static uint64_t readUint(const std::string &in, std::size_t pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | static_cast<uint8_t>(in[pos + i]);
+    }
+    return value;
+}
+
+static void writeHeader(std::string &out, wss::cluster::FrameType type, std::size_t bodyLength) {
+    writeUint(out, bodyLength + 1, 4);
+    out += static_cast<char>(type);
+}
+
+void wss::cluster::encodeHello(std::string &out, uint32_t nodeId, const std::string &secret) {
+    writeHeader(out, FrameType::Hello, 4 + secret.size());
+    writeUint(out, nodeId, 4);
+    out += secret;
+}
+
+void wss::cluster::encodePresence(std::string &out, const std::vector<wss::cluster::PresenceChange> &changes) {
+    writeHeader(out, FrameType::Presence, changes.size() * 9);
+    for (const auto &change: changes) {
+        writeUint(out, change.first, 8);
+        out += static_cast<char>(change.second ? 1 : 0);
+    }
+}
+
+void wss::cluster::encodeMessage(std::string &out, wss::user_id_t recipient, const std::string &json) {
+    writeHeader(out, FrameType::Message, 8 + json.size());
+    writeUint(out, recipient, 8);
+    out += json;
+}
+
+bool wss::cluster::decodeHello(const wss::cluster::Frame &frame, uint32_t &nodeId, std::string &secret) {
+    if (frame.type != FrameType::Hello || frame.body.size() < 4) {
+        return false;
+    }
+    nodeId = static_cast<uint32_t>(readUint(frame.body, 0, 4));
+    secret = frame.body.substr(4);
+    return true;
+}
+
+bool wss::cluster::decodePresence(const wss::cluster::Frame &frame, std::vector<wss::cluster::PresenceChange> &changes) {
+    if (frame.type != FrameType::Presence || frame.body.size() % 9 != 0) {
+        return false;
+    }
+    changes.clear();
+    changes.reserve(frame.body.size() / 9);
+    for (std::size_t pos = 0; pos < frame.body.size(); pos += 9) {
+        changes.emplace_back(readUint(frame.body, pos, 8), frame.body[pos + 8] != 0);
+    }
+    return true;
+}
+
+bool wss::cluster::decodeMessage(const wss::cluster::Frame &frame, wss::user_id_t &recipient, std::string &json) {
+    if (frame.type != FrameType::Message || frame.body.size() < 8) {
+        return false;
+    }
+    recipient = readUint(frame.body, 0, 8);
+    json = frame.body.substr(8);
+    return true;
+}
+
+void wss::cluster::FrameReader::feed(const char *data, std::size_t length) {
+    // consumed prefix is dropped only before appending, so buffer is not moved on every frame
+    if (m_position > 0) {
+        m_buffer.erase(0, m_position);
+        m_position = 0;
+    }
+    m_buffer.append(data, length);
+}
+
+bool wss::cluster::FrameReader::next(wss::cluster::Frame &frame) {
+    if (m_broken || m_buffer.size() - m_position < 4) {
+        return false;
+    }
+    const auto length = static_cast<uint32_t>(readUint(m_buffer, m_position, 4));
+    if (length == 0 || length > MAX_FRAME_SIZE) {
+        m_broken = true;
+        return false;
+    }
+    if (m_buffer.size() - m_position - 4 < length) {
+        return false;
+    }
+
+    frame.type = static_cast<FrameType>(m_buffer[m_position + 4]);
+    frame.body.assign(m_buffer, m_position + 5, length - 1);
+    m_position += 4 + length;
+    return true;
+}
+
+bool wss::cluster::FrameReader::isBroken() const {
+    return m_broken;
+}
@@ -0,0 +1,73 @@
+/**
+ * wsserver
+ * Protocol.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_CLUSTER_PROTOCOL_H
+#define WSSERVER_CLUSTER_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../wsserver_core.h"
+
+namespace wss {
+namespace cluster {
+
+/// \brief Inter-node frame: 4-byte big-endian length of type and body, 1-byte type, body.
+/// Integers in bodies are big-endian too.
+enum class FrameType : uint8_t {
+  /// \brief First frame of link, body: uint32 node id, cluster secret
+  Hello = 1,
+  /// \brief Presence changes of sender node users, body: repeated {uint64 user id, uint8 online}
+  Presence = 2,
+  /// \brief Message to user connected to receiver node, body: uint64 recipient id, payload json
+  Message = 3,
+};
+
+struct Frame {
+  FrameType type = FrameType::Hello;
+  std::string body;
+};
+
+using PresenceChange = std::pair<user_id_t, bool>;
+
+/// \brief Frames larger than this are treated as broken stream
+static const uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+void encodeHello(std::string &out, uint32_t nodeId, const std::string &secret);
+void encodePresence(std::string &out, const std::vector<PresenceChange> &changes);
+void encodeMessage(std::string &out, user_id_t recipient, const std::string &json);
+
+bool decodeHello(const Frame &frame, uint32_t &nodeId, std::string &secret);
+bool decodePresence(const Frame &frame, std::vector<PresenceChange> &changes);
+bool decodeMessage(const Frame &frame, user_id_t &recipient, std::string &json);
+
+/// \brief Splits stream of bytes into frames
+class FrameReader {
+ public:
+    /// \brief Append received bytes
+    void feed(const char *data, std::size_t length);
+
+    /// \brief Take next complete frame
+    /// \param frame
+    /// \return false if there is no complete frame yet or stream is broken
+    bool next(Frame &frame);
+
+    /// \return true if stream contains frame of invalid size, connection must be closed
+    bool isBroken() const;
+
+ private:
+    std::string m_buffer;
+    std::size_t m_position = 0;
+    bool m_broken = false;
+};
+
+}
+}
+
+#endif //WSSERVER_CLUSTER_PROTOCOL_H
@@ -0,0 +1,241 @@
+/**
+ * wsserver
+ * CircuitBreaker.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_CIRCUITBREAKER_HPP
+#define WSSERVER_CIRCUITBREAKER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace wss {
+namespace event {
+
+/// \brief Circuit breaker settings
+struct CircuitBreakerPolicy {
+  bool enabled = true;
+  /// \brief Fraction of failed calls in window to open circuit, range (0, 1]
+  double failureRateThreshold = 0.5;
+  /// \brief Call is slow if it took longer than this value
+  std::chrono::milliseconds slowCallDuration = std::chrono::seconds(5);
+  /// \brief Fraction of slow calls in window to open circuit, range (0, 1]
+  double slowCallRateThreshold = 0.8;
+  /// \brief Count of last calls used to calculate rates
+  uint32_t windowSize = 100;
+  /// \brief Rates are not calculated until window has this count of calls
+  uint32_t minimumCalls = 20;
+  /// \brief How long circuit stays open before trial calls
+  std::chrono::milliseconds openDuration = std::chrono::seconds(30);
+  /// \brief Trial calls in half-open state. All of them must succeed to close circuit
+  uint32_t halfOpenCalls = 3;
+};
+
+/// \brief Count-based circuit breaker.
+/// Closed: all calls are allowed, outcomes are recorded into ring of windowSize last calls.
+/// When failure rate or slow call rate exceeds threshold, circuit opens and rejects all calls for openDuration.
+/// After that it becomes half-open and lets through halfOpenCalls trial calls:
+/// any failed or slow trial opens circuit again, if all of them succeeded - circuit is closed.
+class CircuitBreaker {
+ public:
+    using clock = std::chrono::steady_clock;
+
+    enum State {
+      Closed,
+      Open,
+      HalfOpen
+    };
+
+    using OnStateChanged = std::function<void(State from, State to)>;
+
+    explicit CircuitBreaker(CircuitBreakerPolicy policy = CircuitBreakerPolicy()) :
+        m_policy(policy),
+        m_state(Closed),
+        m_ringPos(0),
+        m_failed(0),
+        m_slow(0),
+        m_halfOpenPermitted(0),
+        m_halfOpenSucceeded(0) {
+        if (m_policy.windowSize == 0) {
+            m_policy.windowSize = 1;
+        }
+        if (m_policy.minimumCalls > m_policy.windowSize) {
+            m_policy.minimumCalls = m_policy.windowSize;
+        }
+        if (m_policy.halfOpenCalls == 0) {
+            m_policy.halfOpenCalls = 1;
+        }
+        m_ring.reserve(m_policy.windowSize);
+    }
+
+    CircuitBreaker(const CircuitBreaker &) = delete;
+    CircuitBreaker &operator=(const CircuitBreaker &) = delete;
+
+    static const char *stateName(State state) {
+        switch (state) {
+            case Closed: return "closed";
+            case Open: return "open";
+            case HalfOpen: return "half-open";
+        }
+        return "unknown";
+    }
+
+    /// \brief Listener called on each state transition. Called under breaker lock, must not call breaker back
+    /// \param listener
+    void setOnStateChanged(OnStateChanged listener) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_onStateChanged = std::move(listener);
+    }
+
+    /// \brief Check call is permitted. In half-open state each permitted call is a trial and must be reported with onResult()
+    /// \param now
+    /// \return false if circuit is open (or all trial calls are already in flight)
+    bool allowRequest(clock::time_point now = clock::now()) {
+        if (!m_policy.enabled) {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_state == Open) {
+            if (now - m_openedAt < m_policy.openDuration) {
+                return false;
+            }
+            m_halfOpenPermitted = 0;
+            m_halfOpenSucceeded = 0;
+            transit(HalfOpen);
+        }
+
+        if (m_state == HalfOpen) {
+            if (m_halfOpenPermitted >= m_policy.halfOpenCalls) {
+                return false;
+            }
+            m_halfOpenPermitted++;
+        }
+
+        return true;
+    }
+
+    /// \brief Record outcome of permitted call
+    /// \param success
+    /// \param latency call duration
+    /// \param now
+    void onResult(bool success, std::chrono::milliseconds latency, clock::time_point now = clock::now()) {
+        if (!m_policy.enabled) {
+            return;
+        }
+
+        const bool slow = latency > m_policy.slowCallDuration;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        switch (m_state) {
+            case Closed:
+                record(!success, slow);
+                if (m_ring.size() >= m_policy.minimumCalls
+                    && (rate(m_failed) >= m_policy.failureRateThreshold
+                        || rate(m_slow) >= m_policy.slowCallRateThreshold)) {
+                    open(now);
+                }
+                break;
+
+            case HalfOpen:
+                if (!success || slow) {
+                    open(now);
+                } else if (++m_halfOpenSucceeded >= m_policy.halfOpenCalls) {
+                    reset();
+                    transit(Closed);
+                }
+                break;
+
+            case Open:
+                // late result of call permitted before circuit opened
+                break;
+        }
+    }
+
+    /// \brief Check circuit is open and rejects calls. Unlike allowRequest(), does not change state
+    /// \param now
+    /// \return true if calls are rejected
+    bool isOpen(clock::time_point now = clock::now()) const {
+        if (!m_policy.enabled) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_state == Open && now - m_openedAt < m_policy.openDuration;
+    }
+
+    State getState() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_state;
+    }
+
+    const CircuitBreakerPolicy &getPolicy() const {
+        return m_policy;
+    }
+
+ private:
+    CircuitBreakerPolicy m_policy;
+    mutable std::mutex m_mutex;
+    State m_state;
+    clock::time_point m_openedAt;
+    OnStateChanged m_onStateChanged;
+
+    /// \brief Ring of last outcomes: bit 0 - failed, bit 1 - slow
+    std::vector<uint8_t> m_ring;
+    size_t m_ringPos;
+    uint32_t m_failed;
+    uint32_t m_slow;
+
+    uint32_t m_halfOpenPermitted;
+    uint32_t m_halfOpenSucceeded;
+
+    void record(bool failed, bool slow) {
+        const uint8_t outcome = (uint8_t) ((failed ? 1 : 0) | (slow ? 2 : 0));
+        if (m_ring.size() < m_policy.windowSize) {
+            m_ring.push_back(outcome);
+        } else {
+            const uint8_t evicted = m_ring[m_ringPos];
+            m_failed -= evicted & 1;
+            m_slow -= (evicted >> 1) & 1;
+            m_ring[m_ringPos] = outcome;
+            m_ringPos = (m_ringPos + 1) % m_policy.windowSize;
+        }
+        m_failed += outcome & 1;
+        m_slow += (outcome >> 1) & 1;
+    }
+
+    double rate(uint32_t count) const {
+        return (double) count / (double) m_ring.size();
+    }
+
+    void reset() {
+        m_ring.clear();
+        m_ringPos = 0;
+        m_failed = 0;
+        m_slow = 0;
+    }
+
+    void open(clock::time_point now) {
+        m_openedAt = now;
+        reset();
+        transit(Open);
+    }
+
+    void transit(State to) {
+        const State from = m_state;
+        m_state = to;
+        if (from != to && m_onStateChanged) {
+            m_onStateChanged(from, to);
+        }
+    }
+};
+
+}
+}
+
+#endif //WSSERVER_CIRCUITBREAKER_HPP
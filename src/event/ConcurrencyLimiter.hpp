@@ -0,0 +1,143 @@
+/**
+ * wsserver
+ * ConcurrencyLimiter.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_CONCURRENCYLIMITER_HPP
+#define WSSERVER_CONCURRENCYLIMITER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace wss {
+namespace event {
+
+/// \brief AIMD limiter settings
+struct ConcurrencyPolicy {
+  bool enabled = true;
+  uint32_t initialLimit = 16;
+  uint32_t minLimit = 1;
+  uint32_t maxLimit = 256;
+  /// \brief Successful call that took longer is treated as congestion signal
+  std::chrono::milliseconds latencyThreshold = std::chrono::seconds(1);
+  /// \brief Multiplicative decrease factor, range (0, 1)
+  double backoffRatio = 0.5;
+  /// \brief Limit is decreased at most once per this interval, so burst of failures of already running calls
+  /// does not collapse limit to minimum
+  std::chrono::milliseconds decreaseCooldown = std::chrono::seconds(1);
+};
+
+/// \brief Adaptive concurrency limiter (additive increase, multiplicative decrease).
+/// Each fast successful call increases limit by 1/limit (about +1 per round of calls),
+/// failed or slow call multiplies limit by backoffRatio.
+/// Items that exceed limit are not rejected: they are deferred and handed out to completing calls in FIFO order,
+/// so there is never more than limit calls in flight and no thread waits for permit.
+/// \tparam T movable item type
+template<typename T>
+class ConcurrencyLimiter {
+ public:
+    using clock = std::chrono::steady_clock;
+
+    explicit ConcurrencyLimiter(ConcurrencyPolicy policy = ConcurrencyPolicy()) :
+        m_policy(policy),
+        m_inFlight(0) {
+        m_policy.minLimit = std::max(1u, m_policy.minLimit);
+        m_policy.maxLimit = std::max(m_policy.minLimit, m_policy.maxLimit);
+        m_limit = (double) std::min(m_policy.maxLimit, std::max(m_policy.minLimit, m_policy.initialLimit));
+    }
+
+    ConcurrencyLimiter(const ConcurrencyLimiter &) = delete;
+    ConcurrencyLimiter &operator=(const ConcurrencyLimiter &) = delete;
+
+    /// \brief Take permit for item or defer it
+    /// \param item moved to deferred queue if limit is reached
+    /// \return true if caller may start call now (and must release() permit after)
+    bool acquireOrDefer(T &item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_policy.enabled || m_inFlight < currentLimit()) {
+            m_inFlight++;
+            return true;
+        }
+
+        m_deferred.push_back(std::move(item));
+        return false;
+    }
+
+    /// \brief Adjust limit by outcome of finished call. Does not release permit
+    /// \param success
+    /// \param latency
+    /// \param now
+    void onSample(bool success, std::chrono::milliseconds latency, clock::time_point now = clock::now()) {
+        if (!m_policy.enabled) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!success || latency > m_policy.latencyThreshold) {
+            if (now - m_lastDecrease >= m_policy.decreaseCooldown) {
+                m_limit = std::max((double) m_policy.minLimit, m_limit * m_policy.backoffRatio);
+                m_lastDecrease = now;
+            }
+            return;
+        }
+
+        m_limit = std::min((double) m_policy.maxLimit, m_limit + 1.0 / m_limit);
+    }
+
+    /// \brief Release permit. If deferred item can be started, permit passes to it
+    /// \param next receives deferred item
+    /// \return true if next is set and caller must start it (and release its permit after)
+    bool release(T &next) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_inFlight > 0) {
+            m_inFlight--;
+        }
+
+        if (m_deferred.empty() || (m_policy.enabled && m_inFlight >= currentLimit())) {
+            return false;
+        }
+
+        next = std::move(m_deferred.front());
+        m_deferred.pop_front();
+        m_inFlight++;
+        return true;
+    }
+
+    uint32_t getLimit() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return currentLimit();
+    }
+
+    uint32_t getInFlight() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_inFlight;
+    }
+
+    size_t getDeferredCount() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_deferred.size();
+    }
+
+ private:
+    ConcurrencyPolicy m_policy;
+    mutable std::mutex m_mutex;
+    double m_limit;
+    uint32_t m_inFlight;
+    clock::time_point m_lastDecrease;
+    std::deque<T> m_deferred;
+
+    uint32_t currentLimit() const {
+        return (uint32_t) m_limit;
+    }
+};
+
+}
+}
+
+#endif //WSSERVER_CONCURRENCYLIMITER_HPP
@@ -0,0 +1,83 @@
+/**
+ * wsserver
+ * Event.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_EVENT_HPP
+#define WSSERVER_EVENT_HPP
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "../chat/Message.h"
+
+namespace wss {
+namespace event {
+
+/// \brief Immutable event, passed to all targets. Payload is serialized exactly once, on construction,
+/// and the serialized body is shared by all targets, their fallbacks and retries without copying.
+class Event {
+ public:
+    using Body = std::shared_ptr<const std::string>;
+    using Framer = std::function<std::string(const std::string &)>;
+
+    explicit Event(wss::MessagePayload &&payload) :
+        m_payload(std::move(payload)),
+        m_body(std::make_shared<const std::string>(m_payload.toJson())) {
+    }
+
+    explicit Event(const wss::MessagePayload &payload) :
+        m_payload(payload),
+        m_body(std::make_shared<const std::string>(m_payload.toJson())) {
+    }
+
+    Event(const Event &) = delete;
+    Event(Event &&) = delete;
+    Event &operator=(const Event &) = delete;
+    Event &operator=(Event &&) = delete;
+
+    /// \brief Source message payload
+    const wss::MessagePayload &getPayload() const {
+        return m_payload;
+    }
+
+    /// \brief Serialized payload (json)
+    const Body &getBody() const {
+        return m_body;
+    }
+
+    /// \brief Body wrapped into target-specific frame. Frame is built once per key, so targets (and fallbacks)
+    /// with the same framing share the result
+    /// \param key framing identifier
+    /// \param framer function, that wraps serialized body
+    /// \return framed body
+    Body getFramedBody(const std::string &key, const Framer &framer) const {
+        std::lock_guard<std::mutex> lock(m_framedMutex);
+        auto it = m_framed.find(key);
+        if (it != m_framed.end()) {
+            return it->second;
+        }
+
+        Body framed = std::make_shared<const std::string>(framer(*m_body));
+        m_framed.emplace(key, framed);
+        return framed;
+    }
+
+ private:
+    const wss::MessagePayload m_payload;
+    const Body m_body;
+    mutable std::mutex m_framedMutex;
+    mutable std::unordered_map<std::string, Body> m_framed;
+};
+
+using EventPtr = std::shared_ptr<const Event>;
+
+}
+}
+
+#endif //WSSERVER_EVENT_HPP
@@ -0,0 +1,448 @@
+/**
+ * wsserver
+ * EventFilter.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+#include <vector>
+#include <fmt/format.h>
+#include "EventFilter.h"
+
+namespace {
+
+using Predicate = wss::event::EventFilter::Predicate;
+using wss::event::FilterSyntaxError;
+
+std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
+      return (char) std::tolower(c);
+    });
+    return s;
+}
+
+struct Token {
+  enum Kind {
+    Ident,
+    Number,
+    String,
+    LParen,
+    RParen,
+    LBrace,
+    RBrace,
+    Comma,
+    Range,
+    Op,
+    End
+  };
+
+  Kind kind;
+  std::string text;
+  size_t pos;
+};
+
+std::vector<Token> tokenize(const std::string &rule) {
+    std::vector<Token> out;
+    size_t i = 0;
+    const size_t n = rule.size();
+
+    while (i < n) {
+        const char c = rule[i];
+        if (std::isspace((unsigned char) c)) {
+            i++;
+            continue;
+        }
+
+        const size_t start = i;
+        switch (c) {
+            case '(': out.push_back({Token::LParen, "(", start});
+                i++;
+                continue;
+            case ')': out.push_back({Token::RParen, ")", start});
+                i++;
+                continue;
+            case '{':
+            case '[': out.push_back({Token::LBrace, std::string(1, c), start});
+                i++;
+                continue;
+            case '}':
+            case ']': out.push_back({Token::RBrace, std::string(1, c), start});
+                i++;
+                continue;
+            case ',': out.push_back({Token::Comma, ",", start});
+                i++;
+                continue;
+            default: break;
+        }
+
+        if (c == '.' && i + 1 < n && rule[i + 1] == '.') {
+            out.push_back({Token::Range, "..", start});
+            i += 2;
+            continue;
+        }
+
+        if (c == '=' || c == '!' || c == '<' || c == '>') {
+            std::string op(1, c);
+            i++;
+            if (i < n && rule[i] == '=') {
+                op += '=';
+                i++;
+            }
+            if (op == "=" || op == "!") {
+                throw FilterSyntaxError(fmt::format("Unknown operator '{0}' at {1}", op, start));
+            }
+            out.push_back({Token::Op, op, start});
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            i++;
+            std::string value;
+            while (i < n && rule[i] != c) {
+                value += rule[i++];
+            }
+            if (i >= n) {
+                throw FilterSyntaxError(fmt::format("Unterminated string at {0}", start));
+            }
+            i++;
+            out.push_back({Token::String, value, start});
+            continue;
+        }
+
+        if (std::isdigit((unsigned char) c)) {
+            while (i < n && std::isdigit((unsigned char) rule[i])) i++;
+            out.push_back({Token::Number, rule.substr(start, i - start), start});
+            continue;
+        }
+
+        if (std::isalpha((unsigned char) c) || c == '_') {
+            while (i < n && (std::isalnum((unsigned char) rule[i]) || rule[i] == '_' || rule[i] == '-')) i++;
+            out.push_back({Token::Ident, rule.substr(start, i - start), start});
+            continue;
+        }
+
+        throw FilterSyntaxError(fmt::format("Unexpected character '{0}' at {1}", c, start));
+    }
+
+    out.push_back({Token::End, "", n});
+    return out;
+}
+
+/// \brief Recursive descent parser, builds predicate closures while parsing
+class Parser {
+ public:
+    explicit Parser(std::vector<Token> &&tokens) :
+        m_tokens(std::move(tokens)),
+        m_pos(0) {
+    }
+
+    Predicate parse() {
+        Predicate out = parseOr();
+        if (peek().kind != Token::End) {
+            fail("end of rule");
+        }
+        return out;
+    }
+
+ private:
+    enum Field {
+      Type,
+      Sender,
+      Recipient
+    };
+
+    std::vector<Token> m_tokens;
+    size_t m_pos;
+
+    const Token &peek() const {
+        return m_tokens[m_pos];
+    }
+
+    const Token &next() {
+        const Token &t = m_tokens[m_pos];
+        if (t.kind != Token::End) {
+            m_pos++;
+        }
+        return t;
+    }
+
+    bool acceptKeyword(const char *keyword) {
+        if (peek().kind == Token::Ident && toLower(peek().text) == keyword) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool accept(Token::Kind kind) {
+        if (peek().kind == kind) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    [[noreturn]] void fail(const char *expected) const {
+        const Token &t = peek();
+        throw FilterSyntaxError(fmt::format("Expected {0} at {1}, got '{2}'",
+                                            expected,
+                                            t.pos,
+                                            t.kind == Token::End ? "end of rule" : t.text));
+    }
+
+    Predicate parseOr() {
+        std::vector<Predicate> terms{parseAnd()};
+        while (acceptKeyword("or")) {
+            terms.push_back(parseAnd());
+        }
+        if (terms.size() == 1) {
+            return terms[0];
+        }
+        return [terms](const wss::MessagePayload &p) {
+          for (const auto &t: terms) {
+              if (t(p)) return true;
+          }
+          return false;
+        };
+    }
+
+    Predicate parseAnd() {
+        std::vector<Predicate> terms{parseUnary()};
+        while (acceptKeyword("and")) {
+            terms.push_back(parseUnary());
+        }
+        if (terms.size() == 1) {
+            return terms[0];
+        }
+        return [terms](const wss::MessagePayload &p) {
+          for (const auto &t: terms) {
+              if (!t(p)) return false;
+          }
+          return true;
+        };
+    }
+
+    Predicate parseUnary() {
+        if (acceptKeyword("not")) {
+            Predicate inner = parseUnary();
+            return [inner](const wss::MessagePayload &p) {
+              return !inner(p);
+            };
+        }
+
+        if (accept(Token::LParen)) {
+            Predicate inner = parseOr();
+            if (!accept(Token::RParen)) {
+                fail("')'");
+            }
+            return inner;
+        }
+
+        return parseCondition();
+    }
+
+    Field parseField() {
+        if (peek().kind != Token::Ident) {
+            fail("field (type, sender, recipient)");
+        }
+        const std::string name = toLower(peek().text);
+        Field field;
+        if (name == "type") {
+            field = Type;
+        } else if (name == "sender") {
+            field = Sender;
+        } else if (name == "recipient" || name == "recipients") {
+            field = Recipient;
+        } else {
+            fail("field (type, sender, recipient)");
+        }
+        m_pos++;
+        return field;
+    }
+
+    std::string parseStringValue() {
+        const Token &t = peek();
+        if (t.kind != Token::Ident && t.kind != Token::String && t.kind != Token::Number) {
+            fail("type value");
+        }
+        m_pos++;
+        return toLower(t.text);
+    }
+
+    user_id_t parseNumber() {
+        const Token &t = peek();
+        if (t.kind != Token::Number) {
+            fail("number");
+        }
+        m_pos++;
+        try {
+            return std::stoull(t.text);
+        } catch (const std::out_of_range &) {
+            throw FilterSyntaxError(fmt::format("Number is too large at {0}", t.pos));
+        }
+    }
+
+    /// \brief Wraps id predicate to match sender or any of recipients
+    static Predicate forField(Field field, std::function<bool(user_id_t)> &&match) {
+        if (field == Sender) {
+            return [match](const wss::MessagePayload &p) {
+              return match(p.getSender());
+            };
+        }
+
+        return [match](const wss::MessagePayload &p) {
+          for (user_id_t id: p.getRecipients()) {
+              if (match(id)) return true;
+          }
+          return false;
+        };
+    }
+
+    Predicate parseCondition() {
+        const Field field = parseField();
+
+        if (acceptKeyword("not")) {
+            if (!acceptKeyword("in")) {
+                fail("'in'");
+            }
+            return negated(parseSet(field), true);
+        }
+
+        if (acceptKeyword("in")) {
+            return parseSet(field);
+        }
+
+        if (peek().kind != Token::Op) {
+            fail("operator");
+        }
+        const std::string op = next().text;
+
+        if (field == Type) {
+            if (op != "==" && op != "!=") {
+                fail("'==' or '!=' for type");
+            }
+            const std::string value = parseStringValue();
+            Predicate eq = [value](const wss::MessagePayload &p) {
+              const std::string &type = p.getType();
+              return type.size() == value.size()
+                  && std::equal(type.begin(), type.end(), value.begin(), [](char a, char b) {
+                    return std::tolower((unsigned char) a) == b;
+                  });
+            };
+            return negated(std::move(eq), op == "!=");
+        }
+
+        const user_id_t value = parseNumber();
+        std::function<bool(user_id_t)> match;
+        if (op == "==") {
+            match = [value](user_id_t id) { return id == value; };
+        } else if (op == "!=") {
+            match = [value](user_id_t id) { return id != value; };
+        } else if (op == "<") {
+            match = [value](user_id_t id) { return id < value; };
+        } else if (op == "<=") {
+            match = [value](user_id_t id) { return id <= value; };
+        } else if (op == ">") {
+            match = [value](user_id_t id) { return id > value; };
+        } else {
+            match = [value](user_id_t id) { return id >= value; };
+        }
+
+        return forField(field, std::move(match));
+    }
+
+    Predicate parseSet(Field field) {
+        if (field != Type && peek().kind == Token::Number && m_tokens[m_pos + 1].kind == Token::Range) {
+            const user_id_t from = parseNumber();
+            next();
+            const user_id_t to = parseNumber();
+            if (from > to) {
+                throw FilterSyntaxError(fmt::format("Invalid range {0}..{1}", from, to));
+            }
+            return forField(field, [from, to](user_id_t id) {
+              return id >= from && id <= to;
+            });
+        }
+
+        if (!accept(Token::LBrace)) {
+            fail(field == Type ? "'{'" : "'{' or range");
+        }
+
+        if (field == Type) {
+            auto types = std::make_shared<std::unordered_set<std::string>>();
+            do {
+                types->insert(parseStringValue());
+            } while (accept(Token::Comma));
+            if (!accept(Token::RBrace)) {
+                fail("'}'");
+            }
+
+            return [types](const wss::MessagePayload &p) {
+              const std::string &type = p.getType();
+              // types are mostly lowercase already, don't allocate for them
+              if (types->count(type) > 0) {
+                  return true;
+              }
+              if (std::none_of(type.begin(), type.end(), [](unsigned char c) { return std::isupper(c); })) {
+                  return false;
+              }
+              return types->count(toLower(type)) > 0;
+            };
+        }
+
+        auto ids = std::make_shared<std::unordered_set<user_id_t>>();
+        do {
+            ids->insert(parseNumber());
+        } while (accept(Token::Comma));
+        if (!accept(Token::RBrace)) {
+            fail("'}'");
+        }
+
+        return forField(field, [ids](user_id_t id) {
+          return ids->count(id) > 0;
+        });
+    }
+
+    static Predicate negated(Predicate &&inner, bool negate) {
+        if (!negate) {
+            return std::move(inner);
+        }
+        return [inner](const wss::MessagePayload &p) {
+          return !inner(p);
+        };
+    }
+};
+
+}
+
+wss::event::EventFilter wss::event::EventFilter::compile(const std::string &rule) {
+    if (std::all_of(rule.begin(), rule.end(), [](unsigned char c) { return std::isspace(c); })) {
+        return EventFilter();
+    }
+
+    Parser parser(tokenize(rule));
+    return EventFilter(rule, parser.parse());
+}
+
+wss::event::EventFilter::EventFilter() = default;
+
+wss::event::EventFilter::EventFilter(std::string rule, Predicate predicate) :
+    m_rule(std::move(rule)),
+    m_predicate(std::move(predicate)) {
+}
+
+bool wss::event::EventFilter::operator()(const wss::MessagePayload &payload) const {
+    return !m_predicate || m_predicate(payload);
+}
+
+bool wss::event::EventFilter::acceptsAll() const {
+    return !m_predicate;
+}
+
+const std::string &wss::event::EventFilter::getRule() const {
+    return m_rule;
+}
@@ -0,0 +1,71 @@
+/**
+ * wsserver
+ * EventFilter.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_EVENTFILTER_H
+#define WSSERVER_EVENTFILTER_H
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "../chat/Message.h"
+
+namespace wss {
+namespace event {
+
+struct FilterSyntaxError : std::runtime_error {
+  explicit FilterSyntaxError(const std::string &what) : std::runtime_error(what) { }
+};
+
+/// \brief Event routing rule, compiled once at startup into predicate closures.
+/// Syntax:
+/// \code
+///     rule  := and ("or" and)*
+///     and   := unary ("and" unary)*
+///     unary := "not" unary | "(" rule ")" | cond
+///     cond  := field ["not"] "in" set | field op value
+///     field := type | sender | recipient
+///     set   := "{" value ("," value)* "}" | number ".." number
+///     op    := == | != | < | <= | > | >=
+/// \endcode
+/// Type comparison is case insensitive, type sets are hashed. "recipient" matches if any of recipients matches.
+/// Example: type in {order, payment} and sender in 1000..1999
+class EventFilter {
+ public:
+    using Predicate = std::function<bool(const wss::MessagePayload &)>;
+
+    /// \brief Compile rule
+    /// \param rule rule string, empty rule accepts every event
+    /// \throws FilterSyntaxError
+    /// \return compiled filter
+    static EventFilter compile(const std::string &rule);
+
+    /// \brief Creates filter accepting every event
+    EventFilter();
+
+    /// \brief Check event matches rule
+    /// \param payload
+    /// \return true if target must receive this event
+    bool operator()(const wss::MessagePayload &payload) const;
+
+    /// \brief Whether filter has no rule
+    bool acceptsAll() const;
+
+    /// \brief Source rule
+    const std::string &getRule() const;
+
+ private:
+    EventFilter(std::string rule, Predicate predicate);
+
+    std::string m_rule;
+    Predicate m_predicate;
+};
+
+}
+}
+
+#endif //WSSERVER_EVENTFILTER_H
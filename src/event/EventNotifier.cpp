@@ -7,7 +7,12 @@
  */
 
 #include "EventNotifier.h"
+#include <boost/algorithm/string/case_conv.hpp>
 #include "../base/Settings.hpp"
+#include "../base/Probes.h"
+#include "../base/Log.h"
+#include "UnixSocketTarget.h"
+#include "NdjsonFileTarget.h"
 
 #ifdef ENABLE_REDIS_TARGET
 #include "RedisTarget.h"
@@ -20,19 +25,94 @@ wss::event::EventNotifier::EventNotifier(std::shared_ptr<wss::ChatServer> &ws) :
     m_enableRetry(wss::Settings::get().event.enableRetry),
     m_maxParallelWorkers(wss::Settings::get().event.maxParallelWorkers),
     m_maxRetries(3),
-    m_retryIntervalSeconds(10),
+    m_ingestThreads(wss::Settings::get().event.ingestThreads),
+    m_deliveryWorkers(wss::Settings::get().event.deliveryWorkers),
     m_ioService(),
     m_threadGroup(),
-    m_work(m_ioService) { }
+    m_work(m_ioService) {
+
+    for (const auto &type: wss::Settings::get().event.ignoreTypes) {
+        m_ignoredTypes.insert(boost::algorithm::to_lower_copy(type));
+    }
+
+    BackoffPolicy policy;
+    policy.initialDelay = std::chrono::seconds(wss::Settings::get().event.retryIntervalSeconds);
+    policy.maxDelay = std::chrono::seconds(wss::Settings::get().event.retryMaxIntervalSeconds);
+    policy.jitter = wss::Settings::get().event.retryJitter;
+    m_retryScheduler.setPolicy(policy);
+    m_retryScheduler.setOnReady([this](SendStatus &&status) {
+      enqueue(std::move(status));
+    });
+
+    registerMetrics();
+}
+
+void wss::event::EventNotifier::registerMetrics() {
+    using wss::metrics::Registry;
+    auto &registry = Registry::get();
+
+    registry.addCollector(this, "wss_event_ingest_queue_depth", "Events waiting for dispatch to targets",
+                          [this](Registry::Samples &samples) {
+                            samples.emplace_back("", (double) m_sendQueue.size_approx());
+                          });
+    registry.addCollector(this, "wss_event_retry_queue_depth", "Failed events waiting for retry",
+                          [this](Registry::Samples &samples) {
+                            samples.emplace_back("", (double) m_retryScheduler.size());
+                          });
+
+    // guards are created before service is started, so map is not changed while scraped
+    const auto perTarget = [this](std::function<double(TargetGuard &)> read) {
+      return [this, read](Registry::Samples &samples) {
+        for (auto &item: m_guards) {
+            samples.emplace_back(fmt::format("target=\"{0}\"", item.second->name), read(*item.second));
+        }
+      };
+    };
+    registry.addCollector(this, "wss_event_target_queue_depth", "Events waiting for target concurrency permit",
+                          perTarget([](TargetGuard &guard) { return (double) guard.limiter.getDeferredCount(); }));
+    registry.addCollector(this, "wss_event_target_in_flight", "Events being sent to target",
+                          perTarget([](TargetGuard &guard) { return (double) guard.limiter.getInFlight(); }));
+    registry.addCollector(this, "wss_event_target_concurrency_limit", "Current adaptive concurrency limit of target",
+                          perTarget([](TargetGuard &guard) { return (double) guard.limiter.getLimit(); }));
+    registry.addCollector(this, "wss_event_target_circuit_open", "1 if target circuit breaker is open",
+                          perTarget([](TargetGuard &guard) { return guard.breaker.isOpen() ? 1.0 : 0.0; }));
+}
 
 wss::event::EventNotifier::~EventNotifier() {
-    m_keepGoing = false;
-    m_readCondition.notify_one();
+    wss::metrics::Registry::get().removeCollectors(this);
     onStop();
+    {
+        // asynchronous targets may complete sends from their own threads until they are destroyed
+        boost::unique_lock<boost::shared_mutex> lock(m_completionGate->mutex);
+        m_completionGate->open = false;
+    }
+    m_retryScheduler.join();
 }
 
 void wss::event::EventNotifier::setRetryIntervalSeconds(int seconds) {
-    m_retryIntervalSeconds = seconds;
+    BackoffPolicy policy = m_retryScheduler.getPolicy();
+    policy.initialDelay = std::chrono::seconds(seconds);
+    m_retryScheduler.setPolicy(policy);
+}
+
+void wss::event::EventNotifier::setMaxRetryIntervalSeconds(int seconds) {
+    BackoffPolicy policy = m_retryScheduler.getPolicy();
+    policy.maxDelay = std::chrono::seconds(seconds);
+    m_retryScheduler.setPolicy(policy);
+}
+
+void wss::event::EventNotifier::setRetryJitter(double jitter) {
+    BackoffPolicy policy = m_retryScheduler.getPolicy();
+    policy.jitter = jitter;
+    m_retryScheduler.setPolicy(policy);
+}
+
+void wss::event::EventNotifier::setIngestThreads(uint32_t threads) {
+    m_ingestThreads = std::max(1u, threads);
+}
+
+void wss::event::EventNotifier::setDeliveryWorkers(uint32_t workers) {
+    m_deliveryWorkers = workers;
 }
 
 std::shared_ptr<wss::event::Target> wss::event::EventNotifier::createTargetByConfig(const nlohmann::json &json) {
@@ -49,6 +129,10 @@ std::shared_ptr<wss::event::Target> wss::event::EventNotifier::createTargetByCon
 
     if (eq(type, "postback")) {
         out = std::make_shared<wss::event::PostbackTarget>(json);
+    } else if (eq(type, "unixsocket")) {
+        out = std::make_shared<wss::event::UnixSocketTarget>(json);
+    } else if (eq(type, "ndjson")) {
+        out = std::make_shared<wss::event::NdjsonFileTarget>(json);
     } else
         //@TODO shared modules and target map in config, instead of hardcode
         #ifdef ENABLE_REDIS_TARGET
@@ -84,40 +168,118 @@ void wss::event::EventNotifier::addTarget(const std::shared_ptr<wss::event::Targ
         throw std::runtime_error(target->getErrorMessage());
     }
 
-    m_targets.insert({target->getType(), target});
+    // index in config order, guard names of targets and their fallbacks are unique metrics labels
+    const std::size_t index = m_targets.size();
+    if (!m_targets.insert({target->getType(), target}).second) {
+        throw std::runtime_error(fmt::format("Event target of type {0} is already added, "
+                                             "only one target of each type is supported", target->getType()));
+    }
+    addGuard(target, fmt::format("{0}#{1}", target->getType(), index));
 }
 void wss::event::EventNotifier::addTarget(std::shared_ptr<wss::event::Target> &&target) {
-    if (!target->isValid()) {
-        throw std::runtime_error(target->getErrorMessage());
+    const std::shared_ptr<wss::event::Target> added(std::move(target));
+    addTarget(added);
+}
+
+void wss::event::EventNotifier::addGuard(const std::shared_ptr<wss::event::Target> &target, const std::string &name) {
+    if (m_guards.find(target.get()) != m_guards.end()) {
+        return;
     }
 
-    m_targets.insert({target->getType(), std::move(target)});
+    const nlohmann::json &config = target->getConfig();
+    const nlohmann::json breakerConfig = config.value("circuitBreaker", nlohmann::json::object());
+    const nlohmann::json concurrencyConfig = config.value("concurrency", nlohmann::json::object());
+
+    CircuitBreakerPolicy breakerPolicy;
+    breakerPolicy.enabled = breakerConfig.value("enabled", breakerPolicy.enabled);
+    breakerPolicy.failureRateThreshold = breakerConfig.value("failureRateThreshold", breakerPolicy.failureRateThreshold);
+    breakerPolicy.slowCallDuration = std::chrono::milliseconds(
+        breakerConfig.value("slowCallDurationMs", (long) breakerPolicy.slowCallDuration.count()));
+    breakerPolicy.slowCallRateThreshold =
+        breakerConfig.value("slowCallRateThreshold", breakerPolicy.slowCallRateThreshold);
+    breakerPolicy.windowSize = breakerConfig.value("windowSize", breakerPolicy.windowSize);
+    breakerPolicy.minimumCalls = breakerConfig.value("minimumCalls", breakerPolicy.minimumCalls);
+    breakerPolicy.openDuration = std::chrono::seconds(breakerConfig.value("openDurationSeconds", 30L));
+    breakerPolicy.halfOpenCalls = breakerConfig.value("halfOpenCalls", breakerPolicy.halfOpenCalls);
+
+    ConcurrencyPolicy concurrencyPolicy;
+    concurrencyPolicy.enabled = concurrencyConfig.value("enabled", concurrencyPolicy.enabled);
+    concurrencyPolicy.initialLimit = concurrencyConfig.value("initialLimit", concurrencyPolicy.initialLimit);
+    concurrencyPolicy.minLimit = concurrencyConfig.value("minLimit", concurrencyPolicy.minLimit);
+    concurrencyPolicy.maxLimit = concurrencyConfig.value("maxLimit", concurrencyPolicy.maxLimit);
+    concurrencyPolicy.latencyThreshold = std::chrono::milliseconds(
+        concurrencyConfig.value("latencyThresholdMs", (long) concurrencyPolicy.latencyThreshold.count()));
+    concurrencyPolicy.backoffRatio = concurrencyConfig.value("backoffRatio", concurrencyPolicy.backoffRatio);
+
+    auto guard = std::make_unique<TargetGuard>(breakerPolicy, concurrencyPolicy);
+    const uint32_t workers = config.value("workers", 0u);
+    if (workers > 0) {
+        guard->pool = std::make_unique<WorkerPool>(workers);
+    }
+    guard->name = name;
+    guard->deliveryLatency = &wss::metrics::Registry::get().histogram(
+        "wss_event_delivery_seconds", "Time of sending event to target", fmt::format("target=\"{0}\"", name));
+    guard->breaker.setOnStateChanged([name](CircuitBreaker::State from, CircuitBreaker::State to) {
+      WSS_WARN_F("Event::Breaker", "Target %s circuit: %s -> %s",
+                 name.c_str(), CircuitBreaker::stateName(from), CircuitBreaker::stateName(to));
+    });
+    m_guards.emplace(target.get(), std::move(guard));
+
+    const auto &fallbacks = target->getFallbacks();
+    for (std::size_t i = 0; i < fallbacks.size(); i++) {
+        addGuard(fallbacks[i], fmt::format("{0}.fallback#{1}", name, i));
+    }
+}
+
+wss::event::EventNotifier::TargetGuard &wss::event::EventNotifier::getGuard(const wss::event::Target *target) {
+    // guards are created by addTarget() before service is started, so map is read-only here
+    return *m_guards.at(target);
 }
 
 void wss::event::EventNotifier::subscribe() {
-    for (int i = 0; i < 4; i++) {
+    for (uint32_t i = 0; i < std::max(1u, m_ingestThreads); i++) {
         m_threadGroup.create_thread(
             boost::bind(&boost::asio::io_service::run, &m_ioService)
         );
     }
+    // queue handler never returns, so it has own thread and does not take one of ingest threads
+    m_threadGroup.create_thread(boost::bind(&EventNotifier::handleMessageQueue, this));
+
+    if (m_deliveryWorkers > 0) {
+        m_deliveryPool = std::make_unique<WorkerPool>(m_deliveryWorkers);
+    }
 
     m_ws->addMessageListener(std::bind(&EventNotifier::onMessage, this, std::placeholders::_1));
     m_ws->addStopListener(std::bind(&EventNotifier::onStop, this));
     addErrorListener(std::bind(&EventNotifier::onErrorSending, this, std::placeholders::_1));
-    m_ioService.post(boost::bind(&EventNotifier::handleMessageQueue, this));
+    if (m_enableRetry) {
+        m_retryScheduler.start();
+    }
 }
 void wss::event::EventNotifier::joinThreads() {
     m_threadGroup.join_all();
+    if (m_deliveryPool) {
+        m_deliveryPool->join();
+    }
+    for (auto &guard: m_guards) {
+        if (guard.second->pool) {
+            guard.second->pool->join();
+        }
+    }
 }
 void wss::event::EventNotifier::detachThreads() {
 
 }
 void wss::event::EventNotifier::runService() {
-    L_INFO("EventNotifier", "Started with targets:");
+    const std::string delivery = m_deliveryWorkers > 0
+                                 ? fmt::format("{0} delivery workers", m_deliveryWorkers)
+                                 : std::string("thread per delivery");
+    WSS_INFO_F("EventNotifier", "Started with %u ingest threads, %s", m_ingestThreads, delivery.c_str());
+    WSS_INFO("EventNotifier", "Started with targets:");
     for (const auto &target: m_targets) {
-        Logger::get().info(__FILE__, __LINE__, "EventNotifier", fmt::format(" - {0}", target.second->getType()));
+        WSS_INFO("EventNotifier", fmt::format(" - {0}", target.second->getType()));
         for (const auto &fb: target.second->getFallbacks()) {
-            Logger::get().info(__FILE__, __LINE__, "EventNotifier", fmt::format("   - fallback: {0}", fb->getType()));
+            WSS_INFO("EventNotifier", fmt::format("   - fallback: {0}", fb->getType()));
         }
     }
     subscribe();
@@ -126,122 +288,239 @@ void wss::event::EventNotifier::stopService() {
     onStop();
 }
 void wss::event::EventNotifier::onStop() {
+    {
+        std::lock_guard<wss::sync::Mutex> lock(m_readMutex);
+        m_keepGoing = false;
+    }
+    m_readCondition.notify_all();
+    m_retryScheduler.stop();
     m_ioService.stop();
-    m_keepGoing = false;
+    if (m_deliveryPool) {
+        m_deliveryPool->stop();
+    }
+    for (auto &guard: m_guards) {
+        if (guard.second->pool) {
+            guard.second->pool->stop();
+        }
+    }
     m_threadGroup.interrupt_all();
 }
 
 void wss::event::EventNotifier::handleMessageQueue() {
-    std::unique_lock<std::mutex> lock(m_readMutex);
-    const auto &ready = [this](SendStatus status) {
-      if (!m_enableRetry) return true;
-
-      const long diff = abs(std::time(nullptr) - status.sendTime);
-      return diff >= m_retryIntervalSeconds;
-    };
+    std::vector<SendStatus> bulk;
+    bulk.reserve(m_maxParallelWorkers);
 
     while (m_keepGoing) {
-        // @TODO play around this time, check performance and cpu consumption
-
-        m_readCondition.wait_for(lock, std::chrono::seconds(m_retryIntervalSeconds));
+        {
+            // fresh events and due retries are enqueued with notify, so there is no need to poll queue by timer
+            wss::sync::UniqueLock lock(m_readMutex);
+            m_readCondition.wait(lock, [this] {
+              return !m_keepGoing || m_sendQueue.size_approx() > 0;
+            });
+        }
 
-        std::vector<SendStatus> bulk;
+        if (!m_keepGoing) {
+            break;
+        }
 
         try {
-            size_t extract;
-            const size_t approxSize = m_sendQueue.size_approx();
-            if (approxSize > m_maxParallelWorkers) {
-                // maximum connections per cycle
-                extract = m_maxParallelWorkers;
-            } else {
-                extract = approxSize;
-            }
-
-            bulk.resize(extract);
-            m_sendQueue.try_dequeue_bulk(bulk.begin(), bulk.size());
+            // maximum connections per cycle
+            bulk.resize(m_maxParallelWorkers);
+            const size_t extracted = m_sendQueue.try_dequeue_bulk(bulk.begin(), bulk.size());
+            bulk.resize(extracted);
         } catch (const std::exception &e) {
-            L_DEBUG_F("Event::Send", "Can't dequeue bulk: %s", e.what());
+            WSS_DEBUG_F("Event::Send", "Can't dequeue bulk: %s", e.what());
+            bulk.clear();
             continue;
         }
 
-        int i = 0;
-        for (auto it: bulk) {
-            if (!ready(it)) {
-                m_sendQueue.enqueue(std::move(it));
-                continue;
-            }
-
-            auto sender = boost::thread([this, s = std::move(it)]() {
-              SendStatus status = s;
-              status.hasSent = status.target->send(status.payload, status.sendResult);
-              if (m_enableRetry && !status.hasSent) {
-                  Logger::get().debug(__FILE__,
-                                      __LINE__,
-                                      "Event::Send",
-                                      fmt::format("Can't send message to target {0}: {1}",
-                                                  status.target->getType(),
-                                                  status.sendResult));
-
-                  m_readCondition.notify_one();
-
-                  // if tries < maxRetries
-                  if (status.sendTries < m_maxRetries) {
-                      status.sendTries++;
-                      status.sendTime = std::time(nullptr);
-                      m_sendQueue.enqueue(status);
-                  } else {
-                      // can't send over maxTries times
-                      // notify listeners
-                      for (auto &listener: m_sendErrorListeners) {
-                          listener(std::move(status));
-                      }
-                  }
-              } else {
-                  Logger::get().debug(__FILE__,
-                                      __LINE__,
-                                      "Event::Send",
-                                      fmt::format("Message has sent to target: {0}", status.target->getType()));
-              }
-            });
-            // we don't need to join this thread back, we just need to send, and if not, re-enqueue payload
-            sender.detach();
-
-            i++;
+        for (auto &it: bulk) {
+            dispatch(std::move(it));
         }
 
+        if (!bulk.empty()) {
+            WSS_DEBUG_F("Event::Send", "Prepared %lu messages", bulk.size());
+        }
         bulk.clear();
-        if (i > 0) {
-            L_DEBUG_F("Event::Send", "Prepared %d messages", i);
+    }
+}
+
+void wss::event::EventNotifier::dispatch(wss::event::EventNotifier::SendStatus &&status) {
+    TargetGuard &guard = getGuard(status.target.get());
+    if (guard.breaker.isOpen()) {
+        // shed load without occupying thread, retry scheduler (or fallback) will take care of event
+        status.hasSent = false;
+        status.sendResult = "Circuit breaker is open";
+        onSendFailed(std::move(status));
+        return;
+    }
+
+    if (!guard.limiter.acquireOrDefer(status)) {
+        // will be sent by one of running workers of this target
+        return;
+    }
+
+    post(guard, [this, s = std::move(status)]() mutable {
+      deliver(std::move(s));
+    });
+}
+
+void wss::event::EventNotifier::post(wss::event::EventNotifier::TargetGuard &guard, std::function<void()> &&task) {
+    if (guard.pool) {
+        guard.pool->post(std::move(task));
+    } else if (m_deliveryPool) {
+        m_deliveryPool->post(std::move(task));
+    } else {
+        auto sender = boost::thread(std::move(task));
+        // we don't need to join this thread back, we just need to send, and if not, schedule retry
+        sender.detach();
+    }
+}
+
+void wss::event::EventNotifier::deliver(wss::event::EventNotifier::SendStatus &&first) {
+    SendStatus status = std::move(first);
+    while (true) {
+        const std::shared_ptr<Target> target = status.target;
+        TargetGuard &guard = getGuard(target.get());
+
+        if (!guard.breaker.allowRequest()) {
+            status.hasSent = false;
+            status.sendResult = "Circuit breaker is open";
+        } else if (target->isAsync()) {
+            deliverAsync(guard, std::move(status));
+            return;
+        } else {
+            const auto start = std::chrono::steady_clock::now();
+            status.hasSent = target->send(status.event, status.sendResult);
+            onSendResult(guard, status, std::chrono::steady_clock::now() - start);
+        }
+
+        if (!finishSend(guard, status)) {
+            break;
         }
     }
 }
-void wss::event::EventNotifier::addMessage(wss::MessagePayload payload) {
+
+void wss::event::EventNotifier::deliverAsync(wss::event::EventNotifier::TargetGuard &guard,
+                                             wss::event::EventNotifier::SendStatus &&status) {
+    const std::shared_ptr<Target> target = status.target;
+    const EventPtr event = status.event;
+    const auto start = std::chrono::steady_clock::now();
+    const std::shared_ptr<CompletionGate> gate = m_completionGate;
+
+    target->sendAsync(event, [this, gate, &guard, start, s = std::move(status)](bool success,
+                                                                                 std::string &&error) mutable {
+      boost::shared_lock<boost::shared_mutex> lock(gate->mutex);
+      if (!gate->open) {
+          return;
+      }
+
+      s.hasSent = success;
+      s.sendResult = std::move(error);
+      onSendResult(guard, s, std::chrono::steady_clock::now() - start);
+      // completion may come from target thread: next deferred event is sent by worker
+      if (finishSend(guard, s)) {
+          post(guard, [this, next = std::move(s)]() mutable {
+            deliver(std::move(next));
+          });
+      }
+    });
+}
+
+void wss::event::EventNotifier::onSendResult(wss::event::EventNotifier::TargetGuard &guard,
+                                             const wss::event::EventNotifier::SendStatus &status,
+                                             std::chrono::steady_clock::duration elapsed) {
+    guard.deliveryLatency->observe(elapsed);
+    if (status.hasSent) {
+        WSS_PROBE(event_sent, status.target->getType().c_str(), status.event->getPayload().getSender(),
+                  status.event->getBody()->length(),
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+    guard.breaker.onResult(status.hasSent, latency);
+    guard.limiter.onSample(status.hasSent, latency);
+}
+
+bool wss::event::EventNotifier::finishSend(wss::event::EventNotifier::TargetGuard &guard,
+                                           wss::event::EventNotifier::SendStatus &status) {
+    if (!status.hasSent) {
+        onSendFailed(std::move(status));
+    } else {
+        WSS_DEBUG("Event::Send", fmt::format("Message has sent to target: {0}", status.target->getType()));
+    }
+
+    // permit passes to the next deferred event of this target, if current limit allows
+    return m_keepGoing && guard.limiter.release(status);
+}
+
+void wss::event::EventNotifier::onSendFailed(wss::event::EventNotifier::SendStatus &&status) {
+    WSS_PROBE(event_failed, status.target->getType().c_str(), status.event->getPayload().getSender(),
+              status.sendTries, status.sendResult.c_str());
+    WSS_DEBUG("Event::Send", fmt::format("Can't send message to target {0}: {1}",
+                                         status.target->getType(),
+                                         status.sendResult));
+
+    // if tries < maxRetries
+    const int attempt = m_enableRetry ? BackoffPolicy::nextAttempt(status.sendTries, m_maxRetries) : 0;
+    if (attempt > 0) {
+        const auto delay = m_retryScheduler.schedule(std::move(status), attempt);
+        WSS_DEBUG_F("Event::Send", "Retry #%d scheduled in %lld ms", attempt, (long long) delay.count());
+        return;
+    }
+
+    // can't send over maxTries times
+    // notify listeners
+    for (auto &listener: m_sendErrorListeners) {
+        listener(std::move(status));
+    }
+}
+
+void wss::event::EventNotifier::enqueue(wss::event::EventNotifier::SendStatus &&status) {
+    m_sendQueue.enqueue(std::move(status));
+    {
+        // empty critical section prevents lost wake-up between predicate check and wait in handleMessageQueue
+        std::lock_guard<wss::sync::Mutex> lock(m_readMutex);
+    }
+    m_readCondition.notify_one();
+}
+
+void wss::event::EventNotifier::addMessage(wss::MessagePayload &&payload) {
+    // all targets, fallbacks and retries share one serialized body.
+    // Event is built only if at least one target accepts payload, after that payload lives inside event
+    EventPtr event;
     for (auto &target: m_targets) {
-        m_sendQueue.enqueue(SendStatus(target.second, payload, 0L, 1));
-        m_readCondition.notify_one();
+        if (!target.second->accepts(event ? event->getPayload() : payload)) {
+            continue;
+        }
+        if (!event) {
+            event = std::make_shared<const Event>(std::move(payload));
+        }
+        enqueue(SendStatus(target.second, event, FIRST_SEND_TRY));
     }
 }
 
 void wss::event::EventNotifier::onMessage(wss::MessagePayload &&payload) {
     if (payload.isFromBot() && not wss::Settings::get().event.sendBotMessages) {
-        L_DEBUG("Event::Enqueue", "Skipping Bot message (sender=0)");
+        WSS_DEBUG("Event::Enqueue", "Skipping Bot message (sender=0)");
         return;
     }
 
-    bool isIgnoredType = false;
-    for (const auto &ignoredType: wss::Settings::get().event.ignoreTypes) {
-        if (toolboxpp::strings::equalsIgnoreCase(ignoredType, payload.getType())) {
-            isIgnoredType = true;
-            break;
-        }
+    if (m_ignoredTypes.empty() || m_ignoredTypes.count(boost::algorithm::to_lower_copy(payload.getType())) == 0) {
+        m_ioService.post([this, p = std::move(payload)]() mutable {
+          addMessage(std::move(p));
+        });
     }
+}
 
-    if (!isIgnoredType) {
-        m_ioService.post(boost::bind(&EventNotifier::addMessage, this, payload));
-    }
+void wss::event::EventNotifier::publish(wss::MessagePayload &&payload) {
+    onMessage(std::move(payload));
 }
 
 void wss::event::EventNotifier::onErrorSending(wss::event::EventNotifier::SendStatus &&status) {
+    // fallback has own routing rule, event goes to the first fallback that accepts it
+    while (!status.fallbackQueue.empty() && !status.fallbackQueue.front()->accepts(status.event->getPayload())) {
+        status.fallbackQueue.pop();
+    }
     if (status.fallbackQueue.empty()) {
         return;
     }
@@ -249,9 +528,10 @@ void wss::event::EventNotifier::onErrorSending(wss::event::EventNotifier::SendSt
     // getting new target from fallback
     status.target = status.fallbackQueue.front();
     status.fallbackQueue.pop();
-    status.sendTries = 0;
+    // fallback gets the same retries as primary target
+    status.sendTries = FIRST_SEND_TRY;
     // and re-re-enqueue this message (and reset tries)
-    m_sendQueue.enqueue(std::move(status));
+    enqueue(std::move(status));
 }
 
 void wss::event::EventNotifier::addErrorListener(wss::event::EventNotifier::OnSendError listener) {
@@ -18,13 +18,20 @@
 #include <atomic>
 #include <deque>
 #include <algorithm>
+#include <unordered_set>
 #include <boost/thread.hpp>
 #include <cmath>
 #include <boost/asio/io_service.hpp>
 #include "../chat/ChatServer.h"
 #include "../base/StandaloneService.h"
+#include "../base/Metrics.h"
+#include "../base/LockProfiler.h"
 #include "Target.hpp"
 #include "PostbackTarget.h"
+#include "RetryScheduler.hpp"
+#include "CircuitBreaker.hpp"
+#include "ConcurrencyLimiter.hpp"
+#include "WorkerPool.hpp"
 #include "concurrentqueue.h"
 
 namespace wss {
@@ -40,17 +47,19 @@ class EventNotifier : public virtual wss::StandaloneService {
     static std::shared_ptr<Target> createTargetByConfig(const nlohmann::json &json);
     void onStop();
 
-    /// \brief Start the service. Producer: onMessage(), consumer: handleMessageQueue(), but consumer can be a producer at the same time, cause re-enqueues undelivered messages
-    /// \todo calculate performance, cause here we create hardcoded 4 threads,
-    ///     but event emitter (wss::ChatMessageServer) can generate message from the N threads at the same time.
-    ///     Potential bottleneck
+    /// \brief Start the service. Producer: onMessage(), consumer: handleMessageQueue().
+    /// Thread topology:
+    ///  - ingestThreads: io_service threads, that build events and enqueue them for targets
+    ///  - one queue handler thread: dispatches queued events to delivery
+    ///  - deliveryWorkers: shared pool of sending threads. 0 - separate thread for each send
+    ///  - target "workers": dedicated pool of sending threads for this target only
+    /// Failed events are moved to retry scheduler, it re-enqueues them when backoff delay expires
     void subscribe();
 
  public:
     struct SendStatus {
       std::shared_ptr<wss::event::Target> target;
-      wss::MessagePayload payload;
-      std::time_t sendTime;
+      wss::event::EventPtr event;
       int sendTries;
       int sendRetryIndex;
       bool hasSent = false;
@@ -58,12 +67,10 @@ class EventNotifier : public virtual wss::StandaloneService {
       std::queue<std::shared_ptr<wss::event::Target>> fallbackQueue;
 
       SendStatus(std::shared_ptr<wss::event::Target> target,
-                 wss::MessagePayload payload,
-                 std::time_t sendTime,
+                 wss::event::EventPtr event,
                  int tries) :
           target(target),
-          payload(payload),
-          sendTime(sendTime),
+          event(std::move(event)),
           sendTries(tries) {
           for (const auto &t: target->getFallbacks()) {
               fallbackQueue.push(t);
@@ -84,15 +91,35 @@ class EventNotifier : public virtual wss::StandaloneService {
     explicit EventNotifier(std::shared_ptr<wss::ChatServer> &ws);
     ~EventNotifier();
 
-    /// \brief Set retry interval seconds.
-    /// \param seconds seconds between retries sending event
+    /// \brief Set initial retry interval seconds. Each next retry doubles interval
+    /// \param seconds seconds before first retry sending event
     void setRetryIntervalSeconds(int seconds);
 
+    /// \brief Set upper bound of retry interval (exponential backoff cap)
+    /// \param seconds
+    void setMaxRetryIntervalSeconds(int seconds);
+
+    /// \brief Set retry interval jitter
+    /// \param jitter value in range [0, 1], fraction of interval that randomly subtracted from it
+    void setRetryJitter(double jitter);
+
+    /// \brief Set number of threads, that receive messages from chat server and build events. Call before runService()
+    /// \param threads at least 1
+    void setIngestThreads(uint32_t threads);
+
+    /// \brief Set size of shared pool of sending threads. Call before runService()
+    /// \param workers 0 - each send runs in its own thread (limited by target concurrency limit)
+    void setDeliveryWorkers(uint32_t workers);
+
+    /// \brief Publish message directly, bypassing chat server. Goes the same way as message from chat server
+    /// \param payload
+    void publish(wss::MessagePayload &&payload);
+
     /// \brief Set maximum retries to send event
     /// \param tries Tries number
     void setMaxTries(int tries);
 
-    /// \brief Adds event target
+    /// \brief Adds event target. Throws std::runtime_error if target is invalid or target of the same type is added
     /// \param targetConfig
     void addTarget(const nlohmann::json &targetConfig);
     void addTarget(const std::shared_ptr<Target> &target);
@@ -118,29 +145,109 @@ class EventNotifier : public virtual wss::StandaloneService {
     void onErrorSending(wss::event::EventNotifier::SendStatus &&status);
 
     /// \brief Calling after event in separate thread (io_service.post)
-    /// Adds message to send queue
+    /// Serializes payload once and adds event to send queue for each target, which routing rule accepts it
     /// \param payload
-    void addMessage(wss::MessagePayload payload);
+    void addMessage(wss::MessagePayload &&payload);
 
-    /// \brief Running in separate thread with sleep timer. Handling queued messages and trying to send them
+    /// \brief Running in separate thread. Waits for queued messages and trying to send them
     void handleMessageQueue();
 
+    /// \brief Put message to send queue and wake up queue handler
+    /// \param status
+    void enqueue(SendStatus &&status);
+
+    /// \brief Called from worker thread when target failed to accept message
+    /// \param status
+    void onSendFailed(SendStatus &&status);
+
+    /// \brief Per-target load shedding: circuit breaker and adaptive concurrency limit
+    struct TargetGuard {
+      wss::event::CircuitBreaker breaker;
+      wss::event::ConcurrencyLimiter<SendStatus> limiter;
+      /// \brief Dedicated sending threads of target, if "workers" is set
+      std::unique_ptr<wss::event::WorkerPool> pool;
+      /// \brief Unique metrics label: type and config index of target, e.g. postback#0. Fallbacks are named after
+      /// their target: postback#0.fallback#1 is second fallback of first target
+      std::string name;
+      wss::metrics::Histogram *deliveryLatency = nullptr;
+
+      TargetGuard(const CircuitBreakerPolicy &breakerPolicy, const ConcurrencyPolicy &concurrencyPolicy) :
+          breaker(breakerPolicy),
+          limiter(concurrencyPolicy) {
+      }
+    };
+
+    /// \brief Creates guards for target and its fallbacks using "circuitBreaker" and "concurrency" config objects
+    /// \param target
+    /// \param name guard name, fallbacks get names prefixed by it
+    void addGuard(const std::shared_ptr<Target> &target, const std::string &name);
+
+    /// \brief Adds collectors of queues depth to metrics registry, removed in destructor
+    void registerMetrics();
+    TargetGuard &getGuard(const Target *target);
+
+    /// \brief Start sending in worker thread, if target circuit is closed and its concurrency limit allows.
+    /// Over the limit event waits in target deferred queue, while circuit is open - fails immediately
+    /// \param status
+    void dispatch(SendStatus &&status);
+
+    /// \brief Run sending task in target dedicated pool, in shared delivery pool or in own thread
+    /// \param guard
+    /// \param task
+    void post(TargetGuard &guard, std::function<void()> &&task);
+
+    /// \brief Worker thread: sends event, and after that - deferred events of the same target while limit allows
+    /// \param status
+    void deliver(SendStatus &&status);
+
+    /// \brief Send event to asynchronous target: worker is free right away, target permit is held until completion.
+    /// Completion releases permit and posts next deferred event of the target to worker
+    /// \param guard
+    /// \param status
+    void deliverAsync(TargetGuard &guard, SendStatus &&status);
+
+    /// \brief Account send result in target latency histogram, circuit breaker and concurrency limiter
+    /// \param guard
+    /// \param status
+    /// \param elapsed
+    void onSendResult(TargetGuard &guard, const SendStatus &status, std::chrono::steady_clock::duration elapsed);
+
+    /// \brief Pass failed event to retry or fallbacks, and release target permit
+    /// \param guard
+    /// \param status
+    /// \return true if status is replaced by next deferred event of the same target, that caller must send
+    bool finishSend(TargetGuard &guard, SendStatus &status);
+
+    /// \brief Completions of asynchronous targets hold it shared, destructor closes it exclusively:
+    /// completion that comes after notifier is destroyed is dropped
+    struct CompletionGate {
+      boost::shared_mutex mutex;
+      bool open = true;
+    };
+
     std::atomic_bool m_keepGoing;
-    std::condition_variable m_readCondition;
-    std::mutex m_readMutex;
+    wss::sync::ConditionVariable m_readCondition;
+    wss::sync::Mutex m_readMutex{"event_read"};
 
     std::shared_ptr<wss::ChatServer> m_ws;
     const bool m_enableRetry;
     const uint32_t m_maxParallelWorkers;
     int m_maxRetries;
-    int m_retryIntervalSeconds;
+    uint32_t m_ingestThreads;
+    uint32_t m_deliveryWorkers;
+    std::unique_ptr<wss::event::WorkerPool> m_deliveryPool;
     boost::asio::io_service m_ioService;
     boost::thread_group m_threadGroup;
     boost::asio::io_service::work m_work;
 
     std::unordered_map<std::string, std::shared_ptr<Target>> m_targets, m_targetsUndelivered;
+    /// \brief Lowercase event.ignoreTypes, compiled once
+    std::unordered_set<std::string> m_ignoredTypes;
     moodycamel::ConcurrentQueue<SendStatus> m_sendQueue;
+    wss::event::RetryScheduler<SendStatus> m_retryScheduler;
+    std::unordered_map<const Target *, std::unique_ptr<TargetGuard>> m_guards;
     std::vector<wss::event::EventNotifier::OnSendError> m_sendErrorListeners;
+    std::shared_ptr<CompletionGate> m_completionGate = std::make_shared<CompletionGate>();
 };
 
 }
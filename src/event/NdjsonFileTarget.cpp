@@ -0,0 +1,254 @@
+/**
+ * wsserver
+ * NdjsonFileTarget.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "NdjsonFileTarget.h"
+#include "../base/Log.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+wss::event::NdjsonFileTarget::NdjsonFileTarget(const nlohmann::json &config) :
+    Target(config),
+    m_durable(config.value("durable", true)),
+    m_groupWindow(config.value("fsyncIntervalMs", 5L) * 1000L),
+    m_maxFileSize(config.value("maxFileSizeBytes", (uint64_t) 100 * 1024 * 1024)),
+    m_maxFiles(config.value("maxFiles", 5u)),
+    m_maxBuffered(config.value("maxBuffered", (size_t) 100000)),
+    m_writeTimeout(config.value("writeTimeoutSeconds", 10L) * 1000L),
+    m_fd(-1),
+    m_fileSize(0),
+    m_group(std::make_shared<Group>()),
+    m_running(false) {
+
+    if (config.find("path") == config.end() || !config.at("path").is_string()) {
+        setErrorMessage("Ndjson target requires \"path\"");
+        return;
+    }
+    m_path = config.at("path").get<std::string>();
+
+    std::string error;
+    if (!openFile(error)) {
+        setErrorMessage(std::move(error));
+        return;
+    }
+
+    m_running = true;
+    m_writer = std::thread(&NdjsonFileTarget::writeLoop, this);
+}
+
+wss::event::NdjsonFileTarget::~NdjsonFileTarget() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_bufferCond.notify_all();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    closeFile();
+}
+
+bool wss::event::NdjsonFileTarget::send(const wss::event::EventPtr &event, std::string &error) {
+    wss::event::Event::Body line = getBody(event);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_buffer.size() >= m_maxBuffered) {
+        error = fmt::format("Ndjson buffer is full ({0} events)", m_maxBuffered);
+        return false;
+    }
+
+    const bool wasEmpty = m_buffer.empty();
+    m_buffer.push_back(std::move(line));
+    const std::shared_ptr<Group> group = m_group;
+    if (wasEmpty) {
+        m_bufferCond.notify_one();
+    }
+
+    if (!m_durable) {
+        return true;
+    }
+
+    // group commit: all senders of the group are woken up after single fdatasync
+    if (!m_syncedCond.wait_for(lock, m_writeTimeout, [&group] { return group->done; })) {
+        error = "Ndjson write timed out";
+        return false;
+    }
+
+    if (!group->success) {
+        error = group->error;
+    }
+    return group->success;
+}
+
+std::string wss::event::NdjsonFileTarget::getType() {
+    return "ndjson";
+}
+
+bool wss::event::NdjsonFileTarget::hasFraming() const {
+    return true;
+}
+
+std::string wss::event::NdjsonFileTarget::getFramingKey() const {
+    return "ndjson";
+}
+
+std::string wss::event::NdjsonFileTarget::frame(const std::string &body) const {
+    // json.dump() without indent never contains raw newlines
+    std::string out;
+    out.reserve(body.size() + 1);
+    out.append(body);
+    out.push_back('\n');
+    return out;
+}
+
+bool wss::event::NdjsonFileTarget::openFile(std::string &error) {
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        error = fmt::format("Can't open {0}: {1}", m_path, strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    m_fileSize = fstat(m_fd, &st) == 0 ? (uint64_t) st.st_size : 0;
+    return true;
+}
+
+void wss::event::NdjsonFileTarget::closeFile() {
+    if (m_fd >= 0) {
+        ::fdatasync(m_fd);
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool wss::event::NdjsonFileTarget::rotate(std::string &error) {
+    closeFile();
+
+    if (m_maxFiles == 0) {
+        ::unlink(m_path.c_str());
+    } else {
+        ::unlink(fmt::format("{0}.{1}", m_path, m_maxFiles).c_str());
+        for (uint32_t i = m_maxFiles - 1; i >= 1; i--) {
+            ::rename(fmt::format("{0}.{1}", m_path, i).c_str(), fmt::format("{0}.{1}", m_path, i + 1).c_str());
+        }
+        if (::rename(m_path.c_str(), (m_path + ".1").c_str()) != 0) {
+            WSS_WARN_F("Event::Ndjson", "Can't rotate %s: %s", m_path.c_str(), strerror(errno));
+        }
+    }
+
+    return openFile(error);
+}
+
+bool wss::event::NdjsonFileTarget::writeGroup(const std::vector<wss::event::Event::Body> &lines, std::string &error) {
+    if (m_fd < 0 && !openFile(error)) {
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (const auto &line: lines) {
+        total += line->size();
+    }
+
+    if (m_fileSize > 0 && m_fileSize + total > m_maxFileSize && !rotate(error)) {
+        return false;
+    }
+
+    std::vector<struct iovec> iov;
+    iov.reserve(std::min(lines.size(), (size_t) IOV_MAX));
+
+    size_t index = 0, lineOffset = 0;
+    while (index < lines.size()) {
+        iov.clear();
+        for (size_t i = index; i < lines.size() && iov.size() < (size_t) IOV_MAX; i++) {
+            const size_t skip = i == index ? lineOffset : 0;
+            iov.push_back({(void *) (lines[i]->data() + skip), lines[i]->size() - skip});
+        }
+
+        const ssize_t written = ::writev(m_fd, iov.data(), (int) iov.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = fmt::format("Can't write to {0}: {1}", m_path, strerror(errno));
+            return false;
+        }
+
+        // advance over written bytes, write may be partial
+        size_t left = (size_t) written;
+        m_fileSize += left;
+        while (left > 0 && index < lines.size()) {
+            const size_t rest = lines[index]->size() - lineOffset;
+            if (left >= rest) {
+                left -= rest;
+                index++;
+                lineOffset = 0;
+            } else {
+                lineOffset += left;
+                left = 0;
+            }
+        }
+    }
+
+    if (::fdatasync(m_fd) != 0) {
+        error = fmt::format("Can't sync {0}: {1}", m_path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void wss::event::NdjsonFileTarget::writeLoop() {
+    std::vector<wss::event::Event::Body> lines;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_bufferCond.wait(lock, [this] {
+          return !m_running || !m_buffer.empty();
+        });
+        if (m_buffer.empty()) {
+            // stopped and nothing left to write
+            break;
+        }
+
+        // collect group: events arrived during window share one write and one fsync
+        if (m_running && m_groupWindow.count() > 0) {
+            m_bufferCond.wait_for(lock, m_groupWindow, [this] {
+              return !m_running || m_buffer.size() >= m_maxBuffered;
+            });
+        }
+
+        lines.swap(m_buffer);
+        std::shared_ptr<Group> group = std::move(m_group);
+        m_group = std::make_shared<Group>();
+        lock.unlock();
+
+        std::string error;
+        const bool written = writeGroup(lines, error);
+        lines.clear();
+        if (!written) {
+            WSS_WARN_F("Event::Ndjson", "%s", error.c_str());
+            // file will be reopened by next group
+            closeFile();
+        }
+
+        lock.lock();
+        group->done = true;
+        group->success = written;
+        group->error = std::move(error);
+        m_syncedCond.notify_all();
+    }
+}
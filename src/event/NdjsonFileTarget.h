@@ -0,0 +1,95 @@
+/**
+ * wsserver
+ * NdjsonFileTarget.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_NDJSONFILETARGET_H
+#define WSSERVER_NDJSONFILETARGET_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Target.hpp"
+
+namespace wss {
+namespace event {
+
+/// \brief Appends events as newline-delimited json to local file (log shipper on the same host).
+/// Writer thread collects events during fsyncIntervalMs and writes them with single gather write
+/// followed by single fdatasync (group commit). In durable mode send() returns after its group is synced,
+/// otherwise - right after event is buffered.
+/// When file exceeds maxFileSizeBytes, it's rotated: path -> path.1 -> path.2 ... path.{maxFiles}
+///     "path": "/var/log/wsserver/events.ndjson",
+///     "durable": true,
+///     "fsyncIntervalMs": 5,
+///     "maxFileSizeBytes": 104857600,
+///     "maxFiles": 5,
+///     "maxBuffered": 100000
+class NdjsonFileTarget : public wss::event::Target {
+ public:
+    explicit NdjsonFileTarget(const nlohmann::json &config);
+    ~NdjsonFileTarget();
+
+    bool send(const wss::event::EventPtr &event, std::string &error) override;
+    std::string getType() override;
+
+ protected:
+    bool hasFraming() const override;
+    std::string getFramingKey() const override;
+    std::string frame(const std::string &body) const override;
+
+ private:
+    std::string m_path;
+    bool m_durable;
+    std::chrono::microseconds m_groupWindow;
+    uint64_t m_maxFileSize;
+    uint32_t m_maxFiles;
+    std::size_t m_maxBuffered;
+    std::chrono::milliseconds m_writeTimeout;
+
+    int m_fd;
+    uint64_t m_fileSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_bufferCond;
+    std::condition_variable m_syncedCond;
+    std::vector<wss::event::Event::Body> m_buffer;
+
+    /// \brief Result of single write + fsync, shared by all events of group
+    struct Group {
+      bool done = false;
+      bool success = false;
+      std::string error;
+    };
+    /// \brief Group of currently buffered events
+    std::shared_ptr<Group> m_group;
+
+    std::atomic_bool m_running;
+    std::thread m_writer;
+
+    bool openFile(std::string &error);
+    void closeFile();
+    bool rotate(std::string &error);
+
+    void writeLoop();
+
+    /// \brief Write and sync group of lines
+    /// \param lines
+    /// \param error
+    /// \return false on io error
+    bool writeGroup(const std::vector<wss::event::Event::Body> &lines, std::string &error);
+};
+
+}
+}
+
+#endif //WSSERVER_NDJSONFILETARGET_H
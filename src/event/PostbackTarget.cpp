@@ -9,14 +9,9 @@
 #include "PostbackTarget.h"
 #include <type_traits>
 
-bool wss::event::PostbackTarget::send(const wss::MessagePayload &payload, std::string &error) {
-    const std::string out = payload.toJson();
-    if (out.length() < 1000) {
-        //L_DEBUG_F("Event-Send", "Request body: %s", out.c_str());
-    }
-
+bool wss::event::PostbackTarget::send(const wss::event::EventPtr &event, std::string &error) {
     wss::web::Request request(m_url);
-    request.setBody(out);
+    request.setBody(getBody(event));
     request.setMethod(m_httpMethod);
     request.setHeader({"Content-Type", "application/json"});
 
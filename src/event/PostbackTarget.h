@@ -25,7 +25,7 @@ class PostbackTarget : public Target {
     /// \param config
     explicit PostbackTarget(const json &config);
 
-    bool send(const wss::MessagePayload &payload, std::string &error) override;
+    bool send(const wss::event::EventPtr &event, std::string &error) override;
     std::string getType() override;
 
  protected:
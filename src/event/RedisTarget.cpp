@@ -6,110 +6,334 @@
  * @link https://github.com/edwardstock
  */
 
+#include <algorithm>
 #include "RedisTarget.h"
+#include "../base/Log.h"
 wss::event::RedisTarget::RedisTarget(const nlohmann::json &config) :
     Target(config),
     modeTargetName("wsserver_events_queue"),
-    mode(Queue) {
-
-    if (config.find("unixSocket") != config.end()) {
-        const std::string sock = config.at("unixSocket").get<std::string>();
-        client.connect(sock,
-                       0,
-                       [this, &config](const std::string &host, size_t, cpp_redis::client::connect_state status) {
-                         if (status == cpp_redis::client::connect_state::failed) {
-                             appendErrorMessage(fmt::format("Can't connect to redis: {0}", host));
-                         } else if (status == cpp_redis::client::connect_state::ok) {
-                             onConnected(config);
-                         }
-                       });
-    } else {
-        const std::string addr = config.value("address", "127.0.0.1");
-        size_t portNum = config.value("port", (size_t) 6379);
-        try {
-            client.connect(addr,
-                           portNum,
-                           [this, &config](const std::string &host,
-                                           size_t port,
-                                           cpp_redis::client::connect_state status) {
-                             if (status == cpp_redis::client::connect_state::failed) {
-                                 appendErrorMessage(fmt::format("Can't connect to redis: {0}:{1}", host, port));
-                             } else if (status == cpp_redis::client::connect_state::ok) {
-                                 onConnected(config);
-                             }
-                           });
-        } catch (const std::exception &err) {
-            appendErrorMessage(err.what());
+    mode(Queue),
+    m_nextConnection(0),
+    m_batchSize(config.value("batchSize", (size_t) 256)),
+    m_batchWindow(config.value("batchWindowMicroseconds", 500L)),
+    m_commandTimeout(config.value("commandTimeoutSeconds", 10L) * 1000L),
+    m_maxBuffered(config.value("maxBuffered", (size_t) 100000)),
+    m_running(false) {
+
+    if (m_batchSize == 0) {
+        m_batchSize = 1;
+    }
+
+    if (config.find("mode") != config.end()) {
+        const nlohmann::json modeObj = config.at("mode");
+        const std::string m = modeObj.value("type", "queue");
+
+        if (toolboxpp::strings::equalsIgnoreCase(m, "queue")) {
+            mode = Queue;
+            modeTargetName = modeObj.value("name", "wsserver_events_queue");
+        } else if (toolboxpp::strings::equalsIgnoreCase(m, "channel")) {
+            mode = Channel;
+            modeTargetName = modeObj.value("name", "wsserver_events_channel");
+        } else {
+            appendErrorMessage(fmt::format("Unknown mode for redis target: {0}", m));
             return;
         }
+    }
 
+    const size_t connections = std::max((size_t) 1, config.value("connections", (size_t) 1));
+    for (size_t i = 0; i < connections; i++) {
+        m_connections.push_back(std::make_unique<Connection>());
+        connect(*m_connections.back(), config);
     }
 
-    client.sync_commit();
-}
+    if (!isValid()) {
+        return;
+    }
 
-bool wss::event::RedisTarget::send(const wss::MessagePayload &msg, std::string &err) {
-    const std::string jsonMsg = msg.toJson();
+    m_running = true;
+    m_flusher = std::thread(&RedisTarget::flushLoop, this);
+}
 
-    bool success = true;
+void wss::event::RedisTarget::connect(Connection &connection, const nlohmann::json &config) {
+    // cpp_redis reconnects by itself and re-sends AUTH and SELECT
+    const int32_t maxReconnects = config.value("maxReconnects", -1);
+    const uint32_t reconnectInterval = config.value("reconnectIntervalMs", 1000u);
 
-    const auto result = [&success, &err](const cpp_redis::reply &reply) {
-      if (reply.is_error()) {
-          success = false;
-          err = reply.error();
+    const auto onState = [this, &connection](const std::string &host,
+                                             size_t port,
+                                             cpp_redis::client::connect_state status) {
+      switch (status) {
+          case cpp_redis::client::connect_state::ok:
+              connection.alive = true;
+              m_batchCond.notify_one();
+              break;
+          case cpp_redis::client::connect_state::dropped:
+          case cpp_redis::client::connect_state::failed:
+          case cpp_redis::client::connect_state::lookup_failed:
+          case cpp_redis::client::connect_state::stopped:
+              if (connection.alive.exchange(false)) {
+                  WSS_WARN_F("Event::Redis", "Connection to redis %s:%lu lost", host.c_str(), port);
+              }
+              break;
+          default:
+              break;
       }
     };
 
+    try {
+        if (config.find("unixSocket") != config.end()) {
+            const std::string sock = config.at("unixSocket").get<std::string>();
+            connection.client.connect(sock, 0, onState, 0, maxReconnects, reconnectInterval);
+        } else {
+            const std::string addr = config.value("address", "127.0.0.1");
+            size_t portNum = config.value("port", (size_t) 6379);
+            connection.client.connect(addr, portNum, onState, 0, maxReconnects, reconnectInterval);
+        }
+    } catch (const std::exception &err) {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        appendErrorMessage(fmt::format("Can't connect to redis: {0}", err.what()));
+        return;
+    }
+
+    onConnected(connection, config);
+    connection.client.sync_commit();
+}
+
+void wss::event::RedisTarget::PendingCommand::resolve(bool success, std::string &&error) {
+    if (done.exchange(true)) {
+        // reply came after timeout, or timeout after reply
+        return;
+    }
+    // captured state of caller is released right away, command may stay in flight queue for a while
+    SendCallback cb = std::move(callback);
+    cb(success, std::move(error));
+}
+
+bool wss::event::RedisTarget::send(const wss::event::EventPtr &event, std::string &err) {
+    // completion is bounded by commandTimeout: flusher resolves commands left without reply
+    auto result = std::make_shared<std::promise<std::pair<bool, std::string>>>();
+    auto future = result->get_future();
+    sendAsync(event, [result](bool success, std::string &&error) {
+      result->set_value({success, std::move(error)});
+    });
+
+    auto reply = future.get();
+    if (!reply.first) {
+        err = std::move(reply.second);
+    }
+
+    return reply.first;
+}
+
+void wss::event::RedisTarget::sendAsync(const wss::event::EventPtr &event, SendCallback &&callback) {
+    auto pending = std::make_shared<PendingCommand>();
+    pending->body = getBody(event);
+    pending->callback = std::move(callback);
+
+    std::string error;
+    {
+        std::lock_guard<std::mutex> lock(m_batchMutex);
+        if (!m_running) {
+            error = "Redis target is not running";
+        } else if (m_batch.size() >= m_maxBuffered) {
+            error = fmt::format("Redis buffer is full ({0} events), connection is probably lost", m_maxBuffered);
+        } else {
+            const auto now = std::chrono::steady_clock::now();
+            pending->deadline = now + m_commandTimeout;
+            if (m_batch.empty()) {
+                // batch window starts at first event
+                m_batchStarted = now;
+                m_batch.push_back(std::move(pending));
+                m_batchCond.notify_one();
+            } else {
+                m_batch.push_back(std::move(pending));
+                if (m_batch.size() >= m_batchSize) {
+                    m_batchCond.notify_one();
+                }
+            }
+            return;
+        }
+    }
+
+    pending->resolve(false, std::move(error));
+}
+
+bool wss::event::RedisTarget::isAsync() const {
+    return true;
+}
+
+wss::event::RedisTarget::Connection *wss::event::RedisTarget::nextConnection() {
+    for (size_t i = 0; i < m_connections.size(); i++) {
+        Connection *conn = m_connections[m_nextConnection++ % m_connections.size()].get();
+        if (conn->alive && conn->client.is_connected()) {
+            return conn;
+        }
+    }
+
+    return nullptr;
+}
+
+void wss::event::RedisTarget::flushLoop() {
+    std::vector<PendingPtr> expired;
+    std::unique_lock<std::mutex> lock(m_batchMutex);
+    while (m_running) {
+        takeExpired(std::chrono::steady_clock::now(), expired);
+        if (!expired.empty()) {
+            lock.unlock();
+            for (auto &pending: expired) {
+                pending->resolve(false, "Redis reply timed out");
+            }
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+
+        if (m_batch.empty()) {
+            // idle flusher sleeps until first event comes, or until oldest command in flight is timed out
+            const auto hasEvents = [this] {
+              return !m_running || !m_batch.empty();
+            };
+            if (m_inFlight.empty()) {
+                m_batchCond.wait(lock, hasEvents);
+            } else {
+                m_batchCond.wait_until(lock, m_inFlight.front()->deadline, hasEvents);
+            }
+            continue;
+        }
+
+        // events left after previous flush are already past their window
+        m_batchCond.wait_until(lock, m_batchStarted + m_batchWindow, [this] {
+          return !m_running || m_batch.size() >= m_batchSize;
+        });
+        if (!m_running) {
+            break;
+        }
+
+        Connection *conn = nextConnection();
+        if (conn == nullptr) {
+            // keep batch buffered, it will be replayed after reconnect. Timed out events are dropped by next loop
+            m_batchCond.wait_for(lock, std::chrono::milliseconds(100));
+            continue;
+        }
+
+        const size_t take = std::min(m_batchSize, m_batch.size());
+        std::vector<PendingPtr> batch(m_batch.begin(), m_batch.begin() + take);
+        m_batch.erase(m_batch.begin(), m_batch.begin() + take);
+        m_inFlight.insert(m_inFlight.end(), batch.begin(), batch.end());
+
+        lock.unlock();
+        commit(*conn, std::move(batch));
+        lock.lock();
+    }
+
+    std::vector<PendingPtr> left(m_batch.begin(), m_batch.end());
+    left.insert(left.end(), m_inFlight.begin(), m_inFlight.end());
+    m_batch.clear();
+    m_inFlight.clear();
+    lock.unlock();
+    for (auto &pending: left) {
+        pending->resolve(false, "Redis target stopped");
+    }
+}
+
+void wss::event::RedisTarget::takeExpired(std::chrono::steady_clock::time_point now,
+                                          std::vector<PendingPtr> &expired) {
+    // both queues are in order of deadlines. Replied commands are dropped only from queue front
+    while (!m_inFlight.empty() && (m_inFlight.front()->done || m_inFlight.front()->deadline <= now)) {
+        if (!m_inFlight.front()->done) {
+            expired.push_back(std::move(m_inFlight.front()));
+        }
+        m_inFlight.pop_front();
+    }
+
+    auto last = m_batch.begin();
+    while (last != m_batch.end() && (*last)->deadline <= now) {
+        ++last;
+    }
+    // buffered command is not sent at all: caller retries it by itself
+    expired.insert(expired.end(), m_batch.begin(), last);
+    m_batch.erase(m_batch.begin(), last);
+}
+
+void wss::event::RedisTarget::commit(Connection &connection, std::vector<PendingPtr> &&batch) {
     switch (mode) {
-        case Queue:client.rpush(modeTargetName, {msg.toJson()}, result);
+        case Queue: {
+            // single RPUSH with multiple values: one reply resolves whole batch
+            std::vector<std::string> values;
+            values.reserve(batch.size());
+            for (const auto &pending: batch) {
+                values.push_back(*pending->body);
+            }
+
+            auto shared = std::make_shared<std::vector<PendingPtr>>(std::move(batch));
+            connection.client.rpush(modeTargetName, values, [shared](const cpp_redis::reply &reply) {
+              for (auto &pending: *shared) {
+                  if (reply.is_error()) {
+                      pending->resolve(false, std::string(reply.error()));
+                  } else {
+                      pending->resolve(true, std::string());
+                  }
+              }
+            });
+        }
             break;
-        case Channel:client.publish(modeTargetName, msg.toJson(), result);
+        case Channel:
+            for (auto &pending: batch) {
+                connection.client.publish(modeTargetName, *pending->body, [pending](const cpp_redis::reply &reply) {
+                  if (reply.is_error()) {
+                      pending->resolve(false, std::string(reply.error()));
+                  } else {
+                      pending->resolve(true, std::string());
+                  }
+                });
+            }
             break;
     }
 
-    client.sync_commit();
-
-    return success;
+    // non-blocking: replies are handled by cpp_redis network thread
+    try {
+        connection.client.commit();
+    } catch (const std::exception &e) {
+        WSS_WARN_F("Event::Redis", "Can't commit pipeline: %s", e.what());
+    }
 }
+
 std::string wss::event::RedisTarget::getType() {
     return "redis";
 }
 wss::event::RedisTarget::~RedisTarget() {
-    if (client.is_connected()) {
-        client.disconnect(true);
+    {
+        std::lock_guard<std::mutex> lock(m_batchMutex);
+        m_running = false;
+    }
+    m_batchCond.notify_all();
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+
+    for (auto &conn: m_connections) {
+        if (conn->client.is_connected()) {
+            conn->client.disconnect(true);
+        }
     }
 }
-void wss::event::RedisTarget::onConnected(const nlohmann::json &config) {
+void wss::event::RedisTarget::onConnected(Connection &connection, const nlohmann::json &config) {
     if (config.find("database") != config.end()) {
-        client.select(config.at("database").get<int>(), [this](cpp_redis::reply &reply) {
-          if (reply.is_error()) {
-              appendErrorMessage(std::string(reply.error()));
-          }
+        connection.client.select(config.at("database").get<int>(), [this](cpp_redis::reply &reply) {
+          onSetupReply(reply);
         });
     }
 
     if (config.find("password") != config.end()) {
         const std::string pass = config.at("password").get<std::string>();
-        client.auth(pass, [this](const cpp_redis::reply &reply) {
-          if (reply.is_error()) {
-              appendErrorMessage(std::string(reply.error()));
-          }
+        connection.client.auth(pass, [this](const cpp_redis::reply &reply) {
+          onSetupReply(reply);
         });
     }
-
-    if (config.find("mode") != config.end()) {
-        const nlohmann::json modeObj = config.at("mode");
-        const std::string m = modeObj.value("type", "queue");
-
-        if (toolboxpp::strings::equalsIgnoreCase(m, "queue")) {
-            mode = Queue;
-            modeTargetName = modeObj.value("name", "wsserver_events_queue");
-        } else if (toolboxpp::strings::equalsIgnoreCase(m, "channel")) {
-            mode = Channel;
-            modeTargetName = modeObj.value("name", "wsserver_events_channel");
-        } else {
-            appendErrorMessage(fmt::format("Unknown mode for redis target: {0}", m));
-            return;
-        }
+}
+void wss::event::RedisTarget::onSetupReply(const cpp_redis::reply &reply) {
+    if (reply.is_error()) {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        appendErrorMessage(std::string(reply.error()));
     }
 }
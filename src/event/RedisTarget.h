@@ -9,11 +9,32 @@
 #ifndef WSSERVER_REDISTARGET_H
 #define WSSERVER_REDISTARGET_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <cpp_redis/core/client.hpp>
 #include "Target.hpp"
 
 namespace wss {
 namespace event {
+
+/// \brief Pipelined redis target.
+/// Events are not committed one by one: they are collected into batch during short window (or up to batchSize),
+/// and whole batch is committed by flusher thread with single write, using one of the pooled connections.
+/// Window starts at first event of batch, idle flusher does not wake up.
+///
+/// Target is asynchronous: sendAsync() only buffers event, redis reply completes it from cpp_redis network thread.
+/// So sending thread is not held while event waits for window and reply, and batch size is limited by
+/// target concurrency limit, not by number of sending threads. send() waits for completion, for callers without
+/// notifier (tools and tests).
+/// Event without reply for commandTimeout fails with timeout: if it is still buffered, it is not sent at all.
+/// While no one connection is alive, events are buffered (up to maxBuffered) and replayed after reconnect.
 class RedisTarget : public wss::event::Target {
  public:
     enum Mode {
@@ -21,18 +42,79 @@ class RedisTarget : public wss::event::Target {
       Channel
     };
 
-    RedisTarget(const nlohmann::json &config);
+    explicit RedisTarget(const nlohmann::json &config);
     ~RedisTarget();
 
-    bool send(const wss::MessagePayload &payload, std::string &error) override;
+    bool send(const wss::event::EventPtr &event, std::string &error) override;
+    void sendAsync(const wss::event::EventPtr &event, SendCallback &&callback) override;
+    bool isAsync() const override;
     std::string getType() override;
 
  private:
-    cpp_redis::client client;
+    /// \brief Single event waiting for redis reply
+    struct PendingCommand {
+      wss::event::Event::Body body;
+      SendCallback callback;
+      /// \brief Command fails by timeout after this time
+      std::chrono::steady_clock::time_point deadline;
+      /// \brief Callback is called, later replies are ignored
+      std::atomic_bool done{false};
+
+      void resolve(bool success, std::string &&error);
+    };
+    using PendingPtr = std::shared_ptr<PendingCommand>;
+
+    /// \brief Pooled redis client
+    struct Connection {
+      cpp_redis::client client;
+      std::atomic_bool alive;
+
+      Connection() : alive(false) { }
+    };
+
     std::string modeTargetName;
     Mode mode;
 
-    void onConnected(const nlohmann::json &config);
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    std::size_t m_nextConnection;
+
+    std::size_t m_batchSize;
+    std::chrono::microseconds m_batchWindow;
+    std::chrono::milliseconds m_commandTimeout;
+    std::size_t m_maxBuffered;
+
+    std::mutex m_batchMutex;
+    std::condition_variable m_batchCond;
+    std::vector<PendingPtr> m_batch;
+    /// \brief Committed commands in commit order, waiting for reply or timeout
+    std::deque<PendingPtr> m_inFlight;
+    std::chrono::steady_clock::time_point m_batchStarted;
+    std::atomic_bool m_running;
+    std::thread m_flusher;
+
+    /// \brief Guards error message of target: replies to setup commands come from cpp_redis network thread
+    std::mutex m_errorMutex;
+
+    void connect(Connection &connection, const nlohmann::json &config);
+    void onConnected(Connection &connection, const nlohmann::json &config);
+    void onSetupReply(const cpp_redis::reply &reply);
+
+    /// \brief Find alive connection using round-robin
+    /// \return nullptr if all connections are down
+    Connection *nextConnection();
+
+    /// \brief Flusher thread loop
+    void flushLoop();
+
+    /// \brief Take commands that are timed out, from buffer and in-flight queue. Called under batch lock
+    /// \param now
+    /// \param expired receives timed out commands, to resolve them without lock
+    void takeExpired(std::chrono::steady_clock::time_point now, std::vector<PendingPtr> &expired);
+
+    /// \brief Write batch to connection and commit it asynchronously. Replies resolve pending commands
+    /// \param connection
+    /// \param batch
+    void commit(Connection &connection, std::vector<PendingPtr> &&batch);
 };
 }
 }
@@ -0,0 +1,242 @@
+/**
+ * wsserver
+ * RetryScheduler.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_RETRYSCHEDULER_HPP
+#define WSSERVER_RETRYSCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace wss {
+namespace event {
+
+/// \brief Send tries of event after its first send. Primary and fallback targets both start from it,
+/// so every target gets the same number of retries and the same backoff sequence
+static const int FIRST_SEND_TRY = 1;
+
+/// \brief Exponential backoff policy: delay = initialDelay * multiplier^(attempt - 1), capped by maxDelay.
+/// Jitter randomly reduces computed delay by up to jitter * delay, so failed events of one target don't retry at once
+struct BackoffPolicy {
+  std::chrono::milliseconds initialDelay = std::chrono::seconds(10);
+  std::chrono::milliseconds maxDelay = std::chrono::seconds(300);
+  double multiplier = 2.0;
+  /// \brief Value in range [0, 1]. 0 - no jitter
+  double jitter = 0.2;
+
+  /// \brief Calculate delay before next attempt
+  /// \param attempt 1-based number of failed attempts
+  /// \param random01 random value in range [0, 1)
+  /// \return delay in milliseconds, never more than maxDelay
+  std::chrono::milliseconds delayFor(int attempt, double random01) const {
+      if (attempt < 1) {
+          attempt = 1;
+      }
+
+      const double cap = (double) maxDelay.count();
+      double delay = (double) initialDelay.count() * std::pow(multiplier, (double) (attempt - 1));
+      if (delay > cap || std::isinf(delay) || std::isnan(delay)) {
+          delay = cap;
+      }
+
+      const double j = std::min(1.0, std::max(0.0, jitter));
+      delay -= delay * j * std::min(1.0, std::max(0.0, random01));
+
+      return std::chrono::milliseconds((long long) delay);
+  }
+
+  /// \brief Count failed send
+  /// \param sendTries tries made so far, starting from FIRST_SEND_TRY; incremented if retry is allowed
+  /// \param maxRetries maximum tries, including first send
+  /// \return attempt number for delayFor(), 0 if no tries left
+  static int nextAttempt(int &sendTries, int maxRetries) {
+      if (sendTries >= maxRetries) {
+          return 0;
+      }
+      return sendTries++;
+  }
+};
+
+/// \brief Timer-driven delayed queue. Items are stored in min-heap keyed by next attempt time,
+/// single scheduler thread sleeps until the earliest item is due and passes it to ready handler.
+/// \tparam T movable item type
+template<typename T>
+class RetryScheduler {
+ public:
+    using clock = std::chrono::steady_clock;
+    using OnReady = std::function<void(T &&)>;
+
+    explicit RetryScheduler(BackoffPolicy policy = BackoffPolicy()) :
+        m_policy(policy),
+        m_running(false),
+        m_seq(0),
+        m_random(std::random_device()()) {
+    }
+
+    RetryScheduler(const RetryScheduler &) = delete;
+    RetryScheduler(RetryScheduler &&) = delete;
+
+    ~RetryScheduler() {
+        stop();
+        join();
+    }
+
+    /// \brief Set backoff policy. Affects only items scheduled after call
+    /// \param policy
+    void setPolicy(const BackoffPolicy &policy) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_policy = policy;
+    }
+
+    /// \brief Return copy of current backoff policy
+    BackoffPolicy getPolicy() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_policy;
+    }
+
+    /// \brief Handler called from scheduler thread, when item is due. Must be set before start()
+    /// \param handler
+    void setOnReady(OnReady handler) {
+        m_onReady = std::move(handler);
+    }
+
+    /// \brief Starts scheduler thread
+    void start() {
+        if (m_running.exchange(true)) {
+            return;
+        }
+        m_thread = std::thread(&RetryScheduler::run, this);
+    }
+
+    /// \brief Stops scheduler thread. Pending items are dropped on destruction
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cond.notify_all();
+    }
+
+    void join() {
+        if (m_thread.joinable() && m_thread.get_id() != std::this_thread::get_id()) {
+            m_thread.join();
+        }
+    }
+
+    /// \brief Schedule item using backoff policy
+    /// \param item
+    /// \param attempt 1-based number of failed attempts
+    /// \return computed delay
+    std::chrono::milliseconds schedule(T &&item, int attempt) {
+        std::chrono::milliseconds delay;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            delay = m_policy.delayFor(attempt, dist(m_random));
+            push(clock::now() + delay, std::move(item));
+        }
+        m_cond.notify_one();
+        return delay;
+    }
+
+    /// \brief Schedule item at exact time point
+    /// \param item
+    /// \param due
+    void scheduleAt(T &&item, clock::time_point due) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            push(due, std::move(item));
+        }
+        m_cond.notify_one();
+    }
+
+    /// \brief Number of pending items
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_heap.size();
+    }
+
+ private:
+    struct Entry {
+      clock::time_point due;
+      uint64_t seq;
+      T item;
+    };
+
+    /// \brief Min-heap comparator: earliest due on top, equal due time - FIFO
+    struct Later {
+      bool operator()(const Entry &lhs, const Entry &rhs) const {
+          if (lhs.due != rhs.due) {
+              return lhs.due > rhs.due;
+          }
+          return lhs.seq > rhs.seq;
+      }
+    };
+
+    void push(clock::time_point due, T &&item) {
+        m_heap.push_back(Entry{due, m_seq++, std::move(item)});
+        std::push_heap(m_heap.begin(), m_heap.end(), Later());
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<T> ready;
+
+        while (m_running) {
+            if (m_heap.empty()) {
+                m_cond.wait(lock);
+                continue;
+            }
+
+            const clock::time_point now = clock::now();
+            if (now < m_heap.front().due) {
+                m_cond.wait_until(lock, m_heap.front().due);
+                continue;
+            }
+
+            while (!m_heap.empty() && m_heap.front().due <= now) {
+                std::pop_heap(m_heap.begin(), m_heap.end(), Later());
+                ready.push_back(std::move(m_heap.back().item));
+                m_heap.pop_back();
+            }
+
+            // handler may schedule items again, so don't hold the lock
+            lock.unlock();
+            for (auto &item: ready) {
+                if (m_onReady) {
+                    m_onReady(std::move(item));
+                }
+            }
+            ready.clear();
+            lock.lock();
+        }
+    }
+
+    BackoffPolicy m_policy;
+    std::atomic_bool m_running;
+    uint64_t m_seq;
+    std::mt19937 m_random;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Entry> m_heap;
+    OnReady m_onReady;
+    std::thread m_thread;
+};
+
+}
+}
+
+#endif //WSSERVER_RETRYSCHEDULER_HPP
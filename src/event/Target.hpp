@@ -9,12 +9,15 @@
 #ifndef WSSERVER_EVENTCONFIG_H
 #define WSSERVER_EVENTCONFIG_H
 
+#include <functional>
 #include <string>
 #include <curl/curl.h>
 #include "../helpers/base64.h"
 #include "../chat/Message.h"
 #include "../web/HttpClient.h"
 #include "../base/Settings.hpp"
+#include "Event.hpp"
+#include "EventFilter.h"
 //#include "EventNotifier.h"
 
 namespace wss {
@@ -23,6 +26,9 @@ namespace event {
 /// \brief Available:
 /// postback: PostbackTarget
 ///     "url": "http://example.com/postback",
+/// Common:
+///     "filter": "type in {order, payment}" - routing rule, see wss::event::EventFilter
+///     "circuitBreaker": {...}, "concurrency": {...} - load shedding, see wss::event::EventNotifier
 class Target {
  public:
     /// \brief Accept json config of entire target object
@@ -31,15 +37,67 @@ class Target {
         m_config(config),
         m_validState(true),
         m_errorMessage("") {
+
+        if (config.find("filter") != config.end()) {
+            try {
+                m_filter = EventFilter::compile(config.at("filter").get<std::string>());
+            } catch (const std::exception &e) {
+                setErrorMessage(fmt::format("Invalid filter: {0}", e.what()));
+            }
+        }
     }
 
     /// \brief Send event to entire target
-    /// \param payload Payload to send
+    /// \param event Event to send. Contains payload and its serialized body, shared with other targets
     /// \param error if method returned false, error will contains error message
     /// \return true if sending complete
-    virtual bool send(const wss::MessagePayload &payload, std::string &error) = 0;
+    virtual bool send(const wss::event::EventPtr &event, std::string &error) = 0;
     virtual std::string getType() = 0;
 
+    /// \brief Completion of sendAsync(): true if sending complete, otherwise error message
+    using SendCallback = std::function<void(bool success, std::string &&error)>;
+
+    /// \brief Send event without waiting for delivery. Used by notifier instead of send(), if isAsync() is true.
+    /// Callback is called exactly once, from any thread, possibly before this method returns.
+    /// Default implementation calls send() in caller thread
+    /// \param event Event to send
+    /// \param callback
+    virtual void sendAsync(const wss::event::EventPtr &event, SendCallback &&callback) {
+        std::string error;
+        const bool success = send(event, error);
+        callback(success, std::move(error));
+    }
+
+    /// \brief Whether target completes sendAsync() by itself, without holding sending thread until delivery
+    virtual bool isAsync() const {
+        return false;
+    }
+
+    /// \brief Serialized event body as this target sends it. Without framing - shared body of event, without copy
+    /// \param event
+    /// \return body
+    wss::event::Event::Body getBody(const wss::event::EventPtr &event) const {
+        if (!hasFraming()) {
+            return event->getBody();
+        }
+
+        return event->getFramedBody(getFramingKey(), [this](const std::string &body) {
+          return frame(body);
+        });
+    }
+
+    /// \brief Check event matches target routing rule. Non-matching events must not be enqueued to this target
+    /// \param payload
+    /// \return true if target accepts event
+    bool accepts(const wss::MessagePayload &payload) const {
+        return m_filter(payload);
+    }
+
+    /// \brief Json config of target
+    const nlohmann::json &getConfig() const {
+        return m_config;
+    }
+
     /// \brief Check target is in valid state
     /// \return valid state of target object
     bool isValid() const {
@@ -61,6 +119,23 @@ class Target {
     }
 
  protected:
+    /// \brief Whether target wraps serialized payload into own frame
+    virtual bool hasFraming() const {
+        return false;
+    }
+
+    /// \brief Frame identifier. Targets with the same key share framed body of event
+    virtual std::string getFramingKey() const {
+        return std::string();
+    }
+
+    /// \brief Wrap serialized payload into target frame. Called once per event and framing key
+    /// \param body serialized payload
+    /// \return framed body
+    virtual std::string frame(const std::string &body) const {
+        return body;
+    }
+
     /// \brief Set error message to read when object is invalid state. Mark object as in invalid state/
     /// \param msg
     void setErrorMessage(const std::string &msg) {
@@ -102,6 +177,7 @@ class Target {
     nlohmann::json m_config;
     bool m_validState;
     std::string m_errorMessage;
+    wss::event::EventFilter m_filter;
     std::vector<std::shared_ptr<wss::event::Target>> fallbackTargets;
 };
 
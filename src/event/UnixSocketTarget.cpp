@@ -0,0 +1,176 @@
+/**
+ * wsserver
+ * UnixSocketTarget.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <boost/asio/write.hpp>
+#include "UnixSocketTarget.h"
+#include "../base/Log.h"
+
+/// \brief Maximum buffers per one gather write
+static const std::size_t MAX_WRITE_BUFFERS = 1024;
+
+wss::event::UnixSocketTarget::UnixSocketTarget(const nlohmann::json &config) :
+    Target(config),
+    m_ioService(),
+    m_socket(m_ioService),
+    m_maxBuffered(config.value("maxBuffered", (size_t) 100000)),
+    m_reconnectInterval(config.value("reconnectIntervalMs", 1000L)),
+    m_connected(false),
+    m_running(false) {
+
+    if (config.find("path") == config.end() || !config.at("path").is_string()) {
+        setErrorMessage("Unix socket target requires \"path\"");
+        return;
+    }
+    m_path = config.at("path").get<std::string>();
+
+    // sidecar may start later than server, so not connected socket is not an error
+    ensureConnected();
+
+    m_running = true;
+    m_writer = std::thread(&UnixSocketTarget::writeLoop, this);
+}
+
+wss::event::UnixSocketTarget::~UnixSocketTarget() {
+    {
+        std::lock_guard<std::mutex> lock(m_bufferMutex);
+        m_running = false;
+    }
+    m_bufferCond.notify_all();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+
+    boost::system::error_code ec;
+    m_socket.close(ec);
+}
+
+bool wss::event::UnixSocketTarget::send(const wss::event::EventPtr &event, std::string &error) {
+    wss::event::Event::Body frame = getBody(event);
+
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(m_bufferMutex);
+        if (m_buffer.size() >= m_maxBuffered) {
+            error = fmt::format("Unix socket buffer is full ({0} events), {1} is probably unavailable",
+                                m_maxBuffered,
+                                m_path);
+            return false;
+        }
+        wasEmpty = m_buffer.empty();
+        m_buffer.push_back(std::move(frame));
+    }
+
+    // writer wakes up only on first event, all next events will be taken with the same write
+    if (wasEmpty) {
+        m_bufferCond.notify_one();
+    }
+
+    return true;
+}
+
+std::string wss::event::UnixSocketTarget::getType() {
+    return "unixsocket";
+}
+
+bool wss::event::UnixSocketTarget::hasFraming() const {
+    return true;
+}
+
+std::string wss::event::UnixSocketTarget::getFramingKey() const {
+    return "length32be";
+}
+
+std::string wss::event::UnixSocketTarget::frame(const std::string &body) const {
+    const auto len = (uint32_t) body.size();
+    std::string out;
+    out.reserve(body.size() + 4);
+    out.push_back((char) ((len >> 24) & 0xFF));
+    out.push_back((char) ((len >> 16) & 0xFF));
+    out.push_back((char) ((len >> 8) & 0xFF));
+    out.push_back((char) (len & 0xFF));
+    out.append(body);
+    return out;
+}
+
+bool wss::event::UnixSocketTarget::ensureConnected() {
+    if (m_connected) {
+        return true;
+    }
+
+    boost::system::error_code ec;
+    m_socket.close(ec);
+    m_socket.connect(boost::asio::local::stream_protocol::endpoint(m_path), ec);
+    if (ec) {
+        WSS_DEBUG_F("Event::UnixSocket", "Can't connect to %s: %s", m_path.c_str(), ec.message().c_str());
+        return false;
+    }
+
+    WSS_INFO_F("Event::UnixSocket", "Connected to %s", m_path.c_str());
+    m_connected = true;
+    return true;
+}
+
+bool wss::event::UnixSocketTarget::writeFrames(const std::vector<wss::event::Event::Body> &frames) {
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(std::min(frames.size(), MAX_WRITE_BUFFERS));
+
+    for (std::size_t offset = 0; offset < frames.size(); offset += MAX_WRITE_BUFFERS) {
+        const std::size_t end = std::min(frames.size(), offset + MAX_WRITE_BUFFERS);
+        buffers.clear();
+        for (std::size_t i = offset; i < end; i++) {
+            buffers.emplace_back(frames[i]->data(), frames[i]->size());
+        }
+
+        boost::system::error_code ec;
+        boost::asio::write(m_socket, buffers, ec);
+        if (ec) {
+            WSS_WARN_F("Event::UnixSocket", "Connection to %s lost: %s", m_path.c_str(), ec.message().c_str());
+            m_connected = false;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void wss::event::UnixSocketTarget::writeLoop() {
+    std::vector<wss::event::Event::Body> frames;
+    std::unique_lock<std::mutex> lock(m_bufferMutex);
+
+    while (m_running) {
+        m_bufferCond.wait(lock, [this] {
+          return !m_running || !m_buffer.empty();
+        });
+        if (m_buffer.empty()) {
+            continue;
+        }
+
+        frames.swap(m_buffer);
+        lock.unlock();
+
+        const bool written = ensureConnected() && writeFrames(frames);
+
+        lock.lock();
+        if (!written) {
+            // keep order: not written frames go before buffered while writing
+            frames.insert(frames.end(), std::make_move_iterator(m_buffer.begin()), std::make_move_iterator(m_buffer.end()));
+            m_buffer.swap(frames);
+            m_bufferCond.wait_for(lock, m_reconnectInterval, [this] {
+              return !m_running;
+            });
+        }
+        frames.clear();
+    }
+
+    // last attempt to deliver buffered events. They are already acknowledged to notifier, so not written ones are lost
+    if (!m_buffer.empty() && !(ensureConnected() && writeFrames(m_buffer))) {
+        WSS_WARN_F("Event::UnixSocket", "Stopped with %lu events not written to %s, they are dropped",
+                   m_buffer.size(), m_path.c_str());
+    }
+    m_buffer.clear();
+}
@@ -0,0 +1,78 @@
+/**
+ * wsserver
+ * UnixSocketTarget.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_UNIXSOCKETTARGET_H
+#define WSSERVER_UNIXSOCKETTARGET_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include "Target.hpp"
+
+namespace wss {
+namespace event {
+
+/// \brief Writes events to local unix domain stream socket (sidecar on the same host).
+/// Each event is framed as 4-byte big-endian length followed by json payload.
+/// send() only puts frame into buffer, writer thread sends everything buffered with single gather write.
+/// While sidecar is unavailable, up to maxBuffered events are kept and re-sent after reconnect
+/// (frames of failed write are sent again from the beginning, so delivery is at-least-once).
+/// send() succeeds once event is buffered: events still buffered when target is destroyed and sidecar is
+/// unavailable are dropped, their count is logged.
+///     "path": "/var/run/sidecar.sock",
+///     "maxBuffered": 100000,
+///     "reconnectIntervalMs": 1000
+class UnixSocketTarget : public wss::event::Target {
+ public:
+    explicit UnixSocketTarget(const nlohmann::json &config);
+    ~UnixSocketTarget();
+
+    bool send(const wss::event::EventPtr &event, std::string &error) override;
+    std::string getType() override;
+
+ protected:
+    bool hasFraming() const override;
+    std::string getFramingKey() const override;
+    std::string frame(const std::string &body) const override;
+
+ private:
+    boost::asio::io_service m_ioService;
+    boost::asio::local::stream_protocol::socket m_socket;
+    std::string m_path;
+    std::size_t m_maxBuffered;
+    std::chrono::milliseconds m_reconnectInterval;
+    bool m_connected;
+
+    std::mutex m_bufferMutex;
+    std::condition_variable m_bufferCond;
+    std::vector<wss::event::Event::Body> m_buffer;
+    std::atomic_bool m_running;
+    std::thread m_writer;
+
+    void writeLoop();
+
+    /// \brief Connect if not connected yet
+    /// \return connection state
+    bool ensureConnected();
+
+    /// \brief Write all frames
+    /// \param frames
+    /// \return false if connection lost
+    bool writeFrames(const std::vector<wss::event::Event::Body> &frames);
+};
+
+}
+}
+
+#endif //WSSERVER_UNIXSOCKETTARGET_H
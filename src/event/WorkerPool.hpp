@@ -0,0 +1,72 @@
+/**
+ * wsserver
+ * WorkerPool.hpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_WORKERPOOL_HPP
+#define WSSERVER_WORKERPOOL_HPP
+
+#include <cstddef>
+#include <boost/asio/io_service.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+namespace wss {
+namespace event {
+
+/// \brief Fixed set of threads running tasks from shared io_service queue
+class WorkerPool {
+ public:
+    /// \brief Starts threads immediately
+    /// \param threads number of threads, at least 1
+    explicit WorkerPool(std::size_t threads) :
+        m_ioService(),
+        m_work(m_ioService),
+        m_size(threads == 0 ? 1 : threads) {
+        for (std::size_t i = 0; i < m_size; i++) {
+            m_threads.create_thread(boost::bind(&boost::asio::io_service::run, &m_ioService));
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        stop();
+        join();
+    }
+
+    /// \brief Run task in one of pool threads
+    /// \param task callable
+    template<typename Task>
+    void post(Task &&task) {
+        m_ioService.post(std::forward<Task>(task));
+    }
+
+    /// \brief Stops pool. Not started tasks are dropped
+    void stop() {
+        m_ioService.stop();
+    }
+
+    void join() {
+        m_threads.join_all();
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+ private:
+    boost::asio::io_service m_ioService;
+    boost::asio::io_service::work m_work;
+    boost::thread_group m_threads;
+    std::size_t m_size;
+};
+
+}
+}
+
+#endif //WSSERVER_WORKERPOOL_HPP
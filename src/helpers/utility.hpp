@@ -373,6 +373,10 @@ class RegexOrderable : public regexns::regex {
     bool operator<(const RegexOrderable &rhs) const noexcept {
         return str < rhs.str;
     }
+    /// Source pattern
+    const std::string &pattern() const noexcept {
+        return str;
+    }
 };
 
 } // namespace wss
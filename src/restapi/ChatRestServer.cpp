@@ -6,7 +6,91 @@
  * @link https://github.com/edwardstock
  */
 
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <boost/algorithm/string/trim.hpp>
 #include "ChatRestServer.h"
+#include "MessageBatch.h"
+#include "StatsPage.h"
+#include "../base/Metrics.h"
+#include "../base/LockProfiler.h"
+#include "../chat/MessageTracer.h"
+#include "../base/Log.h"
+
+/// \brief Rows per chunk of streamed /stats response
+static const std::size_t STATS_CHUNK_ROWS = 512;
+/// \brief Number of parsed /send-messages items, routed at once
+static const std::size_t BATCH_ROUTE_WINDOW = 256;
+/// \brief Maximum ids in single /presence request
+static const std::size_t PRESENCE_MAX_IDS = 100000;
+
+wss::ChatRestServer::StatsStream::StatsStream(std::shared_ptr<wss::ChatServer> ws,
+                                              wss::HttpResponse response,
+                                              std::vector<wss::user_id_t> &&ids,
+                                              bool hasNext) :
+    m_ws(std::move(ws)),
+    m_response(std::move(response)),
+    m_ids(std::move(ids)),
+    m_position(0),
+    m_hasNext(hasNext) {
+}
+
+void wss::ChatRestServer::StatsStream::next() {
+    std::string chunk;
+    const bool first = m_position == 0;
+    if (first) {
+        chunk = "{\"success\":true,\"data\":[";
+    }
+
+    const std::size_t end = std::min(m_ids.size(), m_position + STATS_CHUNK_ROWS);
+    const std::vector<wss::user_id_t> page(m_ids.begin() + m_position, m_ids.begin() + end);
+    chunk.reserve(chunk.size() + page.size() * 320);
+
+    // rows are written straight from statistics, without json objects
+    m_ws->forEachStat(page, [this, &chunk](wss::user_id_t id, wss::Statistics &stat) {
+      if (m_written++ > 0) {
+          chunk += ',';
+      }
+      chunk += fmt::format("{{\"id\":{0},\"isOnline\":{1},\"lastConnection\":{2},\"connectedTimes\":{3},"
+                           "\"disconnectedTimes\":{4},\"lastMessageTime\":{5},\"timeOnline\":{6},\"timeOffline\":{7},"
+                           "\"timeInactivity\":{8},\"sentMessages\":{9},\"receivedMessages\":{10},\"bytesTransferred\":{11}}}",
+                           id,
+                           stat.isOnline() ? "true" : "false",
+                           stat.getConnectionTime(),
+                           stat.getConnectedTimes(),
+                           stat.getDisconnectedTimes(),
+                           stat.getLastMessageTime(),
+                           stat.getOnlineTime(),
+                           stat.getOfflineTime(),
+                           stat.getInactiveTime(),
+                           stat.getSentMessages(),
+                           stat.getReceivedMessages(),
+                           stat.getBytesTransferred());
+    });
+    m_position = end;
+
+    const bool last = m_position >= m_ids.size();
+    if (last) {
+        chunk += "],\"nextCursor\":";
+        chunk += m_hasNext && !m_ids.empty() ? std::to_string(m_ids.back()) : "null";
+        chunk += '}';
+    }
+
+    *m_response << fmt::format("{0:x}\r\n", chunk.size()) << chunk << "\r\n";
+    if (last) {
+        // terminating chunk is flushed by server together with response completion
+        *m_response << "0\r\n\r\n";
+        return;
+    }
+
+    auto self = shared_from_this();
+    m_response->send([self](const boost::system::error_code &ec) {
+      if (!ec) {
+          self->next();
+      }
+    });
+}
 
 
 wss::ChatRestServer::ChatRestServer(std::shared_ptr<ChatServer> &chatMessageServer,
@@ -40,8 +124,16 @@ void wss::ChatRestServer::createEndpoints() {
     addEndpoint("stats", "GET", ACTION_BIND(ChatRestServer, actionStats));
     addEndpoint("stat", "GET", ACTION_BIND(ChatRestServer, actionStat));
     addEndpoint("check-online", "GET", ACTION_BIND(ChatRestServer, actionCheckOnline));
+    addEndpoint("presence", "GET", ACTION_BIND(ChatRestServer, actionPresence));
+    addEndpoint("presence", "POST", ACTION_BIND(ChatRestServer, actionPresence));
     addEndpoint("send-message", "POST", ACTION_BIND(ChatRestServer, actionSendMessage));
+    addEndpoint("send-messages", "POST", ACTION_BIND(ChatRestServer, actionSendMessages));
+    addEndpoint("room", "GET", ACTION_BIND(ChatRestServer, actionRoom));
+    addEndpoint("room", "POST", ACTION_BIND(ChatRestServer, actionRoom));
     addEndpoint("status", "HEAD", ACTION_BIND(ChatRestServer, actionStatus));
+    addEndpoint("metrics", "GET", ACTION_BIND(ChatRestServer, actionMetrics));
+    addEndpoint("trace", "GET", ACTION_BIND(ChatRestServer, actionTrace));
+    addEndpoint("locks", "GET", ACTION_BIND(ChatRestServer, actionLocks));
 }
 
 void wss::ChatRestServer::actionCheckOnline(wss::HttpResponse response, wss::HttpRequest request) {
@@ -63,15 +155,65 @@ void wss::ChatRestServer::actionCheckOnline(wss::HttpResponse response, wss::Htt
     content["success"] = true;
 
     json statItem;
-
-    const auto begin = m_ws->getStats().find(id);
-    statItem["isOnline"] = begin != m_ws->getStats().end() && begin->second->isOnline();
+    statItem["isOnline"] = m_ws->isOnline(id);
     content["data"] = statItem;
     const std::string out = content.dump();
     setResponseStatus(response, HttpStatus::success_ok, out.length());
     setContent(response, out, "application/json");
 }
 
+void wss::ChatRestServer::actionPresence(wss::HttpResponse response, wss::HttpRequest request) {
+    std::vector<wss::user_id_t> ids;
+    try {
+        if (request->method == "POST") {
+            const json body = json::parse(request->content);
+            if (!body.is_array()) {
+                setError(response, HttpStatus::client_error_bad_request, 400, "Body must be json array of ids");
+                return;
+            }
+            ids = body.get<std::vector<wss::user_id_t>>();
+        } else {
+            wss::web::Request req(request);
+            if (!req.hasParam("ids")) {
+                setError(response, HttpStatus::client_error_bad_request, 400, "Ids required");
+                return;
+            }
+            std::stringstream ss(req.getParam("ids"));
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                if (!item.empty()) {
+                    ids.push_back(std::stoul(item));
+                }
+            }
+        }
+    } catch (const std::exception &) {
+        setError(response, HttpStatus::client_error_bad_request, 400, "Invalid ids");
+        return;
+    }
+
+    if (ids.size() > PRESENCE_MAX_IDS) {
+        setError(response, HttpStatus::client_error_bad_request, 400,
+                 fmt::format("Too many ids, maximum is {0}", PRESENCE_MAX_IDS));
+        return;
+    }
+
+    std::string online, offline;
+    online.reserve(ids.size() * 8);
+    offline.reserve(ids.size() * 8);
+    for (wss::user_id_t id: ids) {
+        std::string &out = m_ws->isOnline(id) ? online : offline;
+        if (!out.empty()) {
+            out += ',';
+        }
+        out += std::to_string(id);
+    }
+
+    const std::string out = fmt::format("{{\"success\":true,\"data\":{{\"online\":[{0}],\"offline\":[{1}]}}}}",
+                                        online, offline);
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "application/json");
+}
+
 void wss::ChatRestServer::actionStat(wss::HttpResponse response, wss::HttpRequest request) {
     wss::web::Request req(request);
     if (!req.hasParam("id")) {
@@ -90,43 +232,34 @@ void wss::ChatRestServer::actionStat(wss::HttpResponse response, wss::HttpReques
     json content;
     content["success"] = true;
 
-    if (m_ws->getStats().find(id) == m_ws->getStats().end()) {
-        json statItem;
-        statItem["id"] = id;
-        statItem["isOnline"] = false;
-        statItem["lastConnection"] = 0;
-        statItem["connectedTimes"] = 0;
-        statItem["disconnectedTimes"] = 0;
-        statItem["lastMessageTime"] = 0;
-        statItem["timeOnline"] = 0;
-        statItem["timeOffline"] = 0;
-        statItem["timeInactivity"] = 0;
-        statItem["sentMessages"] = 0;
-        statItem["receivedMessages"] = 0;
-        statItem["bytesTransferred"] = 0;
-
-        content["data"] = statItem;
-
-        const std::string out = content.dump();
-        setResponseStatus(response, HttpStatus::success_ok, out.length());
-        setContent(response, out, "application/json");
-        return;
-    }
-
+    // handlers run in several threads, statistics are read under chat server lock
     json statItem;
-    const auto idStat = m_ws->getStats().find(id);
-    statItem["id"] = idStat->first;
-    statItem["isOnline"] = idStat->second->isOnline();
-    statItem["lastConnection"] = idStat->second->getConnectionTime();
-    statItem["connectedTimes"] = idStat->second->getConnectedTimes();
-    statItem["disconnectedTimes"] = idStat->second->getDisconnectedTimes();
-    statItem["lastMessageTime"] = idStat->second->getLastMessageTime();
-    statItem["timeOnline"] = idStat->second->getOnlineTime();
-    statItem["timeOffline"] = idStat->second->getOfflineTime();
-    statItem["timeInactivity"] = idStat->second->getInactiveTime();
-    statItem["sentMessages"] = idStat->second->getSentMessages();
-    statItem["receivedMessages"] = idStat->second->getReceivedMessages();
-    statItem["bytesTransferred"] = idStat->second->getBytesTransferred();
+    statItem["id"] = id;
+    statItem["isOnline"] = false;
+    statItem["lastConnection"] = 0;
+    statItem["connectedTimes"] = 0;
+    statItem["disconnectedTimes"] = 0;
+    statItem["lastMessageTime"] = 0;
+    statItem["timeOnline"] = 0;
+    statItem["timeOffline"] = 0;
+    statItem["timeInactivity"] = 0;
+    statItem["sentMessages"] = 0;
+    statItem["receivedMessages"] = 0;
+    statItem["bytesTransferred"] = 0;
+
+    m_ws->forEachStat({id}, [&statItem](wss::user_id_t, wss::Statistics &stat) {
+      statItem["isOnline"] = stat.isOnline();
+      statItem["lastConnection"] = stat.getConnectionTime();
+      statItem["connectedTimes"] = stat.getConnectedTimes();
+      statItem["disconnectedTimes"] = stat.getDisconnectedTimes();
+      statItem["lastMessageTime"] = stat.getLastMessageTime();
+      statItem["timeOnline"] = stat.getOnlineTime();
+      statItem["timeOffline"] = stat.getOfflineTime();
+      statItem["timeInactivity"] = stat.getInactiveTime();
+      statItem["sentMessages"] = stat.getSentMessages();
+      statItem["receivedMessages"] = stat.getReceivedMessages();
+      statItem["bytesTransferred"] = stat.getBytesTransferred();
+    });
 
     content["data"] = statItem;
 
@@ -136,42 +269,66 @@ void wss::ChatRestServer::actionStat(wss::HttpResponse response, wss::HttpReques
 }
 
 void wss::ChatRestServer::actionStats(wss::HttpResponse response, wss::HttpRequest request) {
-    L_DEBUG_F("Http::Server", "%s %s", request->method.c_str(), request->path.c_str())
-    json content;
-    content["success"] = true;
-
-    std::vector<json> statItems(m_ws->getStats().size());
-    L_DEBUG_F("Http::Server", "Statistics: available %lu records", m_ws->getStats().size());
-    std::size_t i = 0;
-    for (auto &idStat: m_ws->getStats()) {
-        json statItem;
-        statItem["id"] = idStat.first;
-        statItem["isOnline"] = idStat.second->isOnline();
-        statItem["lastConnection"] = idStat.second->getConnectionTime();
-        statItem["connectedTimes"] = idStat.second->getConnectedTimes();
-        statItem["disconnectedTimes"] = idStat.second->getDisconnectedTimes();
-        statItem["lastMessageTime"] = idStat.second->getLastMessageTime();
-        statItem["timeOnline"] = idStat.second->getOnlineTime();
-        statItem["timeOffline"] = idStat.second->getOfflineTime();
-        statItem["timeInactivity"] = idStat.second->getInactiveTime();
-        statItem["sentMessages"] = idStat.second->getSentMessages();
-        statItem["receivedMessages"] = idStat.second->getReceivedMessages();
-        statItem["bytesTransferred"] = idStat.second->getBytesTransferred();
-
-        statItems[i] = std::move(statItem);
-        i++;
-    }
-
-    content["data"] = statItems;
+    WSS_DEBUG_F("Http::Server", "%s %s", request->method.c_str(), request->path.c_str());
+    wss::web::Request req(request);
 
-    const std::string out = content.dump();
+    bool hasCursor = false, onlineFilter = false, onlineValue = false;
+    wss::user_id_t cursor = 0;
+    std::size_t limit = 0;
+    time_t inactiveSeconds = 0;
+    try {
+        if (req.hasParam("cursor") && !req.getParam("cursor").empty()) {
+            cursor = std::stoul(req.getParam("cursor"));
+            hasCursor = true;
+        }
+        if (req.hasParam("limit")) {
+            limit = std::stoul(req.getParam("limit"));
+        }
+        if (req.hasParam("online")) {
+            const std::string online = req.getParam("online");
+            onlineFilter = true;
+            onlineValue = online == "1" || toolboxpp::strings::equalsIgnoreCase(online, "true");
+        }
+        if (req.hasParam("inactiveSeconds")) {
+            inactiveSeconds = (time_t) std::stol(req.getParam("inactiveSeconds"));
+        }
+    } catch (const std::exception &) {
+        setError(response, HttpStatus::client_error_bad_request, 400, "Invalid cursor, limit or filter value");
+        return;
+    }
 
-    setResponseStatus(response, HttpStatus::success_ok, out.length());
-    setContent(response, out, "application/json");
+    wss::StatsPage page(limit);
+    if (hasCursor) {
+        page.setCursor(cursor);
+    }
+    if (onlineFilter) {
+        page.setOnline(onlineValue);
+    }
+    page.setInactiveSeconds(inactiveSeconds);
+
+    // snapshot only ids
+    m_ws->forEachStat([&page](wss::user_id_t id, wss::Statistics &stat) {
+      page.add(id, stat);
+    });
+    page.finish();
+    std::vector<wss::user_id_t> &ids = page.getIds();
+    const bool hasNext = page.hasNext();
+    WSS_DEBUG_F("Http::Server", "Statistics: streaming %lu records", ids.size());
+
+    *response << buildResponse({
+                                   {"HTTP/1.1",          wss::server::status_code(HttpStatus::success_ok)},
+                                   {"Server",            "WS Rest Server"},
+                                   {"Content-Type",      "application/json"},
+                                   {"Transfer-Encoding", "chunked"},
+                                   {"Cache-Control",     "no-cache"},
+                               });
+    *response << "\r\n";
+
+    auto stream = std::make_shared<StatsStream>(m_ws, response, std::move(ids), hasNext);
+    stream->next();
 }
 
 void wss::ChatRestServer::actionSendMessage(wss::HttpResponse response, wss::HttpRequest request) {
-    response->close_connection_after_response = true;
     auto ctype = request->header.find("content-type");
 
     if (ctype == request->header.end() || ctype->second != "application/json") {
@@ -191,12 +348,163 @@ void wss::ChatRestServer::actionSendMessage(wss::HttpResponse response, wss::Htt
     }
 
     m_ws->send(payload);
-    setResponseStatus(response, HttpStatus::success_accepted, 0u);
+    setEmptyResponse(response, HttpStatus::success_accepted);
+
+}
+
+void wss::ChatRestServer::actionSendMessages(wss::HttpResponse response, wss::HttpRequest request) {
+    auto ctype = request->header.find("content-type");
+    std::string contentType = ctype == request->header.end() ? "" : ctype->second.substr(0, ctype->second.find(';'));
+    boost::algorithm::trim(contentType);
+
+    const bool ndjson = contentType == "application/x-ndjson";
+    if (!ndjson && contentType != "application/json") {
+        setError(response, HttpStatus::client_error_bad_request, 400,
+                 "Content-Type must be application/json or application/x-ndjson");
+        return;
+    }
 
+    wss::MessageBatch batch(BATCH_ROUTE_WINDOW, [this](const std::vector<MessagePayload> &window) {
+      m_ws->sendBatch(window);
+    });
+    if (ndjson) {
+        batch.addNdjson(request->content);
+    } else {
+        // items are parsed one by one, as ndjson lines, without document of whole body
+        std::string error;
+        if (!batch.addJsonArray(request->content.string(), error)) {
+            setError(response, HttpStatus::client_error_bad_request, 400, error);
+            return;
+        }
+    }
+    batch.flush();
+    WSS_DEBUG_F("Http::Server", "Batch: accepted %lu, rejected %lu", batch.getAccepted(), batch.getRejected());
+
+    const std::string out = fmt::format("{{\"success\":{0},\"accepted\":{1},\"rejected\":{2},\"results\":[{3}]}}",
+                                        batch.getRejected() == 0 ? "true" : "false",
+                                        batch.getAccepted(), batch.getRejected(), batch.getResults());
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "application/json");
+}
+
+void wss::ChatRestServer::actionRoom(wss::HttpResponse response, wss::HttpRequest request) {
+    wss::RoomStorage &rooms = m_ws->getRooms();
+    if (request->method == "GET") {
+        wss::web::Request req(request);
+        wss::room_id_t id;
+        try {
+            id = req.hasParam("id") ? std::stoul(req.getParam("id")) : 0;
+        } catch (const std::exception &) {
+            id = 0;
+        }
+        if (id == 0) {
+            setError(response, HttpStatus::client_error_bad_request, 400, "Invalid id");
+            return;
+        }
+
+        const wss::RoomStorage::Members members = rooms.getMembers(id);
+        if (!members) {
+            setError(response, HttpStatus::client_error_not_found, 404, "Room not found");
+            return;
+        }
+
+        std::string list;
+        list.reserve(members->size() * 8);
+        for (wss::user_id_t uid: *members) {
+            if (!list.empty()) {
+                list += ',';
+            }
+            list += std::to_string(uid);
+        }
+        const std::string out = fmt::format("{{\"success\":true,\"data\":{{\"id\":{0},\"members\":[{1}]}}}}", id, list);
+        setResponseStatus(response, HttpStatus::success_ok, out.length());
+        setContent(response, out, "application/json");
+        return;
+    }
+
+    wss::room_id_t id;
+    std::string action;
+    std::vector<wss::user_id_t> users;
+    try {
+        const json body = json::parse(request->content);
+        id = body.at("id").get<wss::room_id_t>();
+        action = body.at("action").get<std::string>();
+        if (body.find("users") != body.end()) {
+            users = body.at("users").get<std::vector<wss::user_id_t>>();
+        }
+    } catch (const std::exception &) {
+        setError(response, HttpStatus::client_error_bad_request, 400,
+                 "Body must be json object: {\"id\": uint64, \"action\": string, \"users\": uint64[]}");
+        return;
+    }
+    if (id == 0) {
+        setError(response, HttpStatus::client_error_bad_request, 400, "Invalid id");
+        return;
+    }
+
+    bool done;
+    if (action == "create") {
+        if (!rooms.create(id, users)) {
+            setError(response, HttpStatus::client_error_conflict, 409, "Room already exists");
+            return;
+        }
+        done = true;
+    } else if (action == "join") {
+        done = rooms.join(id, users);
+    } else if (action == "leave") {
+        done = rooms.leave(id, users);
+    } else if (action == "delete") {
+        done = rooms.remove(id);
+    } else {
+        setError(response, HttpStatus::client_error_bad_request, 400, "Unknown action, must be create, join, leave or delete");
+        return;
+    }
+    if (!done) {
+        setError(response, HttpStatus::client_error_not_found, 404, "Room not found");
+        return;
+    }
+
+    const std::string out = "{\"success\":true}";
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "application/json");
+}
+
+void wss::ChatRestServer::actionMetrics(wss::HttpResponse response, wss::HttpRequest) {
+    const std::string out = wss::metrics::Registry::get().expose();
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "text/plain; version=0.0.4");
+}
+
+void wss::ChatRestServer::actionTrace(wss::HttpResponse response, wss::HttpRequest request) {
+    wss::web::Request req(request);
+    wss::MessageTracer &tracer = wss::MessageTracer::get();
+
+    json content;
+    content["success"] = true;
+    content["sampleEvery"] = tracer.getSampleEvery();
+    content["data"] = tracer.toJson();
+    if (req.hasParam("clear") && req.getParam("clear") == "1") {
+        tracer.clear();
+    }
+
+    const std::string out = content.dump();
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "application/json");
+}
+
+void wss::ChatRestServer::actionLocks(wss::HttpResponse response, wss::HttpRequest) {
+    json content;
+    content["success"] = true;
+    content["enabled"] = wss::sync::LockProfiler::isEnabled();
+    content["data"] = wss::sync::LockProfiler::get().toJson();
+
+    const std::string out = content.dump();
+    setResponseStatus(response, HttpStatus::success_ok, out.length());
+    setContent(response, out, "application/json");
 }
 
 void wss::ChatRestServer::actionStatus(wss::HttpResponse response, wss::HttpRequest) {
-    setResponseStatus(response, HttpStatus::success_ok, 0u);
+    setEmptyResponse(response, HttpStatus::success_ok);
 }
 
 
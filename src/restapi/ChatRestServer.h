@@ -35,7 +35,13 @@ class ChatRestServer : public RestServer {
     ChatRestServer(std::shared_ptr<ChatServer> &chatMessageServer, const std::string &host, unsigned short port);
  protected:
     // actions
-    /// \brief Statistics list method: GET /stats
+    /// \brief Statistics list method: GET /stats?cursor={UserId}&limit={N}&online=1&inactiveSeconds={N}
+    /// Response is streamed with chunked encoding: {"success": true, "data": [...], "nextCursor": UserId|null}
+    /// Items are ordered by user id. Params (all optional):
+    ///  - cursor: return users with id greater than cursor (nextCursor of previous page)
+    ///  - limit: page size, 0 - without limit
+    ///  - online: 1 - only online users, 0 - only offline users
+    ///  - inactiveSeconds: only users, inactive at least N seconds
     /// \param response Http response
     /// \param request Http request
     ACTION_DEFINE(actionStats);
@@ -50,6 +56,13 @@ class ChatRestServer : public RestServer {
     /// \param request Http request
     ACTION_DEFINE(actionCheckOnline);
 
+    /// \brief Bulk online checking method: GET /presence?ids={UserId},{UserId},... or POST /presence
+    /// with json array of ids in body. Up to PRESENCE_MAX_IDS ids per request, answered from presence bitmap
+    /// without locks. Response: {"success": true, "data": {"online": [UserId...], "offline": [UserId...]}}
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionPresence);
+
     /// \brief Send message to recipient: POST /send-message
     /// content-type must be JSON and data must have a valid structure
     /// \see wss::MessagePayload
@@ -57,6 +70,48 @@ class ChatRestServer : public RestServer {
     /// \param request Http request
     ACTION_DEFINE(actionSendMessage);
 
+    /// \brief Send batch of messages: POST /send-messages
+    /// Body is json array of payloads (content-type application/json) or newline-delimited payloads
+    /// (content-type application/x-ndjson). Items are validated and routed by windows of BATCH_ROUTE_WINDOW
+    /// while body is parsed, messages to one recipient in window share connections lookup.
+    /// Response: {"success": bool, "accepted": N, "rejected": N, "results": [{"index": 0, "success": true}, ...]}
+    /// Failed item contains "message" with reason, other items are sent anyway.
+    /// \see wss::MessagePayload
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionSendMessages);
+
+    /// \brief Server-side rooms. GET /room?id={RoomId} - members of room:
+    /// {"success": true, "data": {"id": RoomId, "members": [UserId...]}}
+    /// POST /room with json body {"id": RoomId, "action": "create|join|leave|delete", "users": [UserId...]} -
+    /// change room, users are initial members for "create". Unknown room - 404, creating existing one - 409.
+    /// Messages with "room" field are delivered to room members
+    /// \see wss::RoomStorage
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionRoom);
+
+    /// \brief Prometheus metrics: GET /metrics
+    /// \see wss::metrics::Registry
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionMetrics);
+
+    /// \brief Sampled message traces: GET /trace[?clear=1]
+    /// Response: {"success": true, "sampleEvery": N, "data": [...]}, clear=1 drops returned samples
+    /// \see wss::MessageTracer::toJson()
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionTrace);
+
+    /// \brief Lock contention profile: GET /locks
+    /// Response: {"success": true, "enabled": bool, "data": [...]}, data is empty if server was built without
+    /// ENABLE_LOCK_PROFILING
+    /// \see wss::sync::LockProfiler::toJson()
+    /// \param response Http response
+    /// \param request Http request
+    ACTION_DEFINE(actionLocks);
+
     /// \brief Check server is online
     /// \param response
     /// \param request
@@ -66,6 +121,27 @@ class ChatRestServer : public RestServer {
     void createEndpoints() override;
 
  private:
+    /// \brief Writes /stats rows by chunks. Next chunk is prepared only after previous one was sent,
+    /// so memory usage does not depend on number of users
+    class StatsStream : public std::enable_shared_from_this<StatsStream> {
+     public:
+        StatsStream(std::shared_ptr<wss::ChatServer> ws,
+                    wss::HttpResponse response,
+                    std::vector<wss::user_id_t> &&ids,
+                    bool hasNext);
+
+        /// \brief Write next chunk and schedule following one after it's sent
+        void next();
+
+     private:
+        std::shared_ptr<wss::ChatServer> m_ws;
+        wss::HttpResponse m_response;
+        std::vector<wss::user_id_t> m_ids;
+        std::size_t m_position;
+        std::size_t m_written = 0;
+        bool m_hasNext;
+    };
+
     std::shared_ptr<ChatServer> m_ws;
 };
 }
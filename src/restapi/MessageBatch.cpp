@@ -0,0 +1,179 @@
+/**
+ * wsserver
+ * MessageBatch.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <fmt/format.h>
+#include "json.hpp"
+#include "MessageBatch.h"
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+wss::MessageBatch::MessageBatch(std::size_t window, wss::MessageBatch::Sink sink) :
+    m_windowSize(window == 0 ? 1 : window),
+    m_sink(std::move(sink)) {
+    m_window.reserve(m_windowSize);
+}
+
+bool wss::MessageBatch::splitArray(const std::string &body, std::vector<Slice> &items, std::string &error) {
+    std::size_t pos = 0;
+    while (pos < body.size() && isSpace(body[pos])) {
+        pos++;
+    }
+    if (pos == body.size() || body[pos] != '[') {
+        error = "Body must be json array of messages";
+        return false;
+    }
+    pos++;
+
+    std::size_t start = std::string::npos;
+    std::size_t depth = 0;
+    bool inString = false;
+    bool closed = false;
+    for (; pos < body.size() && !closed; pos++) {
+        const char c = body[pos];
+        if (inString) {
+            if (c == '\\') {
+                // escaped char can't close string
+                pos++;
+            } else if (c == '"') {
+                inString = false;
+            }
+            continue;
+        }
+        if (start == std::string::npos && isSpace(c)) {
+            continue;
+        }
+
+        const bool end = depth == 0 && (c == ',' || c == ']');
+        if (!end) {
+            if (start == std::string::npos) {
+                start = pos;
+            }
+            if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) {
+                    error = fmt::format("Invalid json: unexpected '{0}' at {1}", c, pos);
+                    return false;
+                }
+                depth--;
+            }
+            continue;
+        }
+
+        if (start == std::string::npos) {
+            // "[]" is the only place where element may be missing
+            if (c == ']' && items.empty()) {
+                closed = true;
+                continue;
+            }
+            error = fmt::format("Invalid json: missing array element at {0}", pos);
+            return false;
+        }
+        std::size_t last = pos;
+        while (isSpace(body[last - 1])) {
+            last--;
+        }
+        items.emplace_back(start, last - start);
+        start = std::string::npos;
+        closed = c == ']';
+    }
+
+    if (!closed) {
+        error = "Invalid json: unexpected end of array";
+        return false;
+    }
+    while (pos < body.size() && isSpace(body[pos])) {
+        pos++;
+    }
+    if (pos != body.size()) {
+        error = fmt::format("Invalid json: unexpected data after array at {0}", pos);
+        return false;
+    }
+    return true;
+}
+
+bool wss::MessageBatch::addJsonArray(const std::string &body, std::string &error) {
+    std::vector<Slice> items;
+    if (!splitArray(body, items, error)) {
+        return false;
+    }
+    for (const auto &item: items) {
+        add(MessagePayload(body.substr(item.first, item.second)));
+    }
+    return true;
+}
+
+void wss::MessageBatch::addNdjson(std::istream &body) {
+    // line by line from request buffer, without copying whole body
+    std::string line;
+    while (std::getline(body, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        add(MessagePayload(line));
+    }
+}
+
+void wss::MessageBatch::add(wss::MessagePayload &&payload) {
+    if (!payload.isValid()) {
+        addResult(payload.getError());
+        return;
+    }
+    if (payload.isForBot()) {
+        addResult("Can't send message to bot through the api");
+        return;
+    }
+
+    addResult(std::string());
+    m_window.push_back(std::move(payload));
+    if (m_window.size() >= m_windowSize) {
+        flush();
+    }
+}
+
+void wss::MessageBatch::flush() {
+    if (m_window.empty()) {
+        return;
+    }
+    m_sink(m_window);
+    m_window.clear();
+}
+
+std::size_t wss::MessageBatch::getAccepted() const {
+    return m_accepted;
+}
+
+std::size_t wss::MessageBatch::getRejected() const {
+    return m_rejected;
+}
+
+const std::string &wss::MessageBatch::getResults() const {
+    return m_results;
+}
+
+void wss::MessageBatch::addResult(const std::string &error) {
+    if (m_index > 0) {
+        m_results += ',';
+    }
+    if (error.empty()) {
+        m_results += fmt::format("{{\"index\":{0},\"success\":true}}", m_index);
+        m_accepted++;
+    } else {
+        m_results += fmt::format("{{\"index\":{0},\"success\":false,\"message\":{1}}}",
+                                 m_index, nlohmann::json(error).dump());
+        m_rejected++;
+    }
+    m_index++;
+}
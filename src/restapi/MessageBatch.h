@@ -0,0 +1,79 @@
+/**
+ * wsserver
+ * MessageBatch.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_MESSAGEBATCH_H
+#define WSSERVER_MESSAGEBATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../chat/Message.h"
+
+namespace wss {
+
+/// \brief Body of /send-messages request: json array or ndjson of message payloads. Every item is parsed on its own,
+/// without document of whole body. Valid items are passed to sink in windows, result of each item is kept by its index
+class MessageBatch {
+ public:
+    /// \brief Receives window of valid payloads, e.g. ChatServer::sendBatch()
+    using Sink = std::function<void(const std::vector<wss::MessagePayload> &)>;
+    /// \brief Offset and length of item in body
+    using Slice = std::pair<std::size_t, std::size_t>;
+
+    /// \param window maximum payloads passed to sink at once
+    /// \param sink
+    MessageBatch(std::size_t window, Sink sink);
+
+    /// \brief Find top-level elements of json array. Only structure is checked: strings, escapes and nesting,
+    /// elements are not parsed
+    /// \param body
+    /// \param items receives element slices, without surrounding whitespace
+    /// \param error receives reason if body is not json array
+    /// \return false if body is not json array
+    static bool splitArray(const std::string &body, std::vector<Slice> &items, std::string &error);
+
+    /// \brief Route json array items. Nothing is routed, if body is not json array
+    /// \param body
+    /// \param error
+    /// \return false if body is not json array
+    bool addJsonArray(const std::string &body, std::string &error);
+
+    /// \brief Route each not empty line
+    /// \param body
+    void addNdjson(std::istream &body);
+
+    /// \brief Route single item
+    void add(wss::MessagePayload &&payload);
+
+    /// \brief Pass rest of window to sink
+    void flush();
+
+    std::size_t getAccepted() const;
+    std::size_t getRejected() const;
+
+    /// \return comma separated result objects: {"index":N,"success":true} or {"index":N,"success":false,"message":"..."}
+    const std::string &getResults() const;
+
+ private:
+    const std::size_t m_windowSize;
+    Sink m_sink;
+    std::vector<wss::MessagePayload> m_window;
+    std::string m_results;
+    std::size_t m_index = 0;
+    std::size_t m_accepted = 0;
+    std::size_t m_rejected = 0;
+
+    void addResult(const std::string &error);
+};
+
+}
+
+#endif //WSSERVER_MESSAGEBATCH_H
@@ -7,12 +7,14 @@
  */
 
 #include "RestServer.h"
+#include "../base/Log.h"
 
 wss::RestServer::RestServer(
     const std::string &crtPath, const std::string &keyPath,
     const std::string &host, uint16_t port) :
     m_server(std::make_unique<HttpsServer>(crtPath, keyPath)),
-    m_useSSL(true) {
+    m_useSSL(true),
+    m_keepAlive(true) {
 
     m_server->config.port = port;
     if (host.length() > 1) {
@@ -21,7 +23,8 @@ wss::RestServer::RestServer(
 }
 wss::RestServer::RestServer(const std::string &host, unsigned short port) :
     m_server(std::make_unique<HttpServer>()),
-    m_useSSL(false) {
+    m_useSSL(false),
+    m_keepAlive(true) {
 
     m_server->config.port = port;
     if (host.length() > 1) {
@@ -55,6 +58,15 @@ void wss::RestServer::setPort(uint16_t portNumber) {
     m_server->config.port = portNumber;
 }
 
+void wss::RestServer::setWorkers(uint32_t workers) {
+    m_server->config.thread_pool_size = std::max((uint32_t) 1, workers);
+}
+void wss::RestServer::setKeepAlive(bool enabled, uint32_t idleTimeoutSeconds) {
+    m_keepAlive = enabled;
+    // server waits next request header with the same timeout as first one
+    m_server->config.timeout_request = idleTimeoutSeconds;
+}
+
 void wss::RestServer::setResponseStatus(wss::HttpResponse &response,
                                         HttpStatus status,
                                         std::size_t contentLength) {
@@ -71,6 +83,11 @@ void wss::RestServer::setResponseStatus(wss::HttpResponse &response,
         });
 }
 
+void wss::RestServer::setEmptyResponse(wss::HttpResponse &response, wss::HttpStatus status) {
+    setResponseStatus(response, status, 0u);
+    *response << "\r\n";
+}
+
 void wss::RestServer::setContent(wss::HttpResponse &response,
                                  const std::string &content,
                                  const std::string &contentType) {
@@ -140,7 +157,8 @@ void wss::RestServer::runService() {
 
     const char *proto = m_useSSL ? "https" : "http";
     const char *hostname = m_server->config.address.empty() ? "0.0.0.0" : m_server->config.address.c_str();
-    L_INFO_F("HttpServer", "Started at %s://%s:%d", proto, hostname, m_server->config.port);
+    WSS_INFO_F("HttpServer", "Started at %s://%s:%d (workers: %lu, keep-alive: %s)", proto, hostname, m_server->config.port,
+               m_server->config.thread_pool_size, m_keepAlive ? "on" : "off");
 
 }
 void wss::RestServer::stopService() {
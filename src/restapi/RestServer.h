@@ -24,6 +24,7 @@
 #include "../base/auth/Auth.h"
 #include "../helpers/helpers.h"
 #include "../base/Settings.hpp"
+#include "../base/Log.h"
 
 #define ACTION_DEFINE(name) void name(HttpResponse response, HttpRequest request)
 #define ACTION_BIND(cName, mName) std::bind(&cName::mName, this, std::placeholders::_1, std::placeholders::_2)
@@ -57,16 +58,24 @@ class RestServer : public virtual StandaloneService {
     void setAddress(const std::string &address);
     void setAddress(std::string &&host);
     void setPort(uint16_t portNumber);
+    /// \brief Number of threads handling requests. Handlers must be thread-safe
+    /// \param workers at least 1
+    void setWorkers(uint32_t workers);
+    /// \brief HTTP/1.1 persistent connections. Requests of one connection (including pipelined) are handled
+    /// one by one, in order they were received
+    /// \param enabled if false, connection is closed after each response
+    /// \param idleTimeoutSeconds time to wait for next request before closing connection
+    void setKeepAlive(bool enabled, uint32_t idleTimeoutSeconds);
 
     template<typename ResponseCallback = std::function<void(HttpResponse, HttpRequest)> >
     RestServer &addEndpoint(const std::string &path, const std::string &methodName, ResponseCallback &&callback) {
         const std::string endpoint = "^/" + path + "$";
-        L_INFO_F("HttpServer", "Endpoint: %s /%s", methodName.c_str(), path.c_str());
+        WSS_INFO_F("HttpServer", "Endpoint: %s /%s", methodName.c_str(), path.c_str());
 
         m_server->resource[endpoint][toolboxpp::strings::toUpper(methodName)] =
             [this, callback](wss::HttpResponse response, wss::HttpRequest request) {
               const wss::web::Request verifyRequest(request);
-              response->close_connection_after_response = true;
+              response->close_connection_after_response = !m_keepAlive;
               if (!m_auth->validateAuth(verifyRequest)) {
 
                   if (m_auth->getType() == "basic") {
@@ -105,6 +114,9 @@ class RestServer : public virtual StandaloneService {
     std::unique_ptr<wss::Auth> &getAuth();
 
     void setResponseStatus(HttpResponse &response, HttpStatus status, std::size_t contentLength = 0u);
+    /// \brief Status line and headers of response without body. Header block is terminated, so persistent
+    /// and pipelining clients know where response ends
+    void setEmptyResponse(HttpResponse &response, HttpStatus status);
     void setContent(HttpResponse &response,
                     const std::string &content,
                     const std::string &contentType = "text/html");
@@ -121,6 +133,7 @@ class RestServer : public virtual StandaloneService {
     std::unique_ptr<HttpBase> m_server;
     std::unique_ptr<std::thread> m_workerThread;
     bool m_useSSL;
+    bool m_keepAlive;
 
     void cleanupEndpoints();
 };
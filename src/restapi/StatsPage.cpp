@@ -0,0 +1,68 @@
+/**
+ * wsserver
+ * StatsPage.cpp
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include "StatsPage.h"
+
+wss::StatsPage::StatsPage(std::size_t limit) :
+    m_limit(limit),
+    m_keep(limit > 0 ? limit + 1 : 0) {
+    if (m_keep > 0) {
+        m_ids.reserve(m_keep);
+    }
+}
+
+void wss::StatsPage::setCursor(wss::user_id_t cursor) {
+    m_cursor = cursor;
+    m_hasCursor = true;
+}
+
+void wss::StatsPage::setOnline(bool online) {
+    m_onlineFilter = true;
+    m_onlineValue = online;
+}
+
+void wss::StatsPage::setInactiveSeconds(time_t seconds) {
+    m_inactiveSeconds = seconds;
+}
+
+void wss::StatsPage::add(wss::user_id_t id, bool online, time_t inactiveSeconds) {
+    if (m_hasCursor && id <= m_cursor) return;
+    if (m_onlineFilter && online != m_onlineValue) return;
+    if (m_inactiveSeconds > 0 && inactiveSeconds < m_inactiveSeconds) return;
+
+    // max-heap of smallest ids
+    if (m_keep == 0 || m_ids.size() < m_keep) {
+        m_ids.push_back(id);
+        if (m_keep > 0) std::push_heap(m_ids.begin(), m_ids.end());
+    } else if (id < m_ids.front()) {
+        std::pop_heap(m_ids.begin(), m_ids.end());
+        m_ids.back() = id;
+        std::push_heap(m_ids.begin(), m_ids.end());
+    }
+}
+
+void wss::StatsPage::add(wss::user_id_t id, const wss::Statistics &stat) {
+    add(id, stat.isOnline(), stat.getInactiveTime());
+}
+
+void wss::StatsPage::finish() {
+    std::sort(m_ids.begin(), m_ids.end());
+    if (m_limit > 0 && m_ids.size() > m_limit) {
+        m_ids.resize(m_limit);
+        m_hasNext = true;
+    }
+}
+
+std::vector<wss::user_id_t> &wss::StatsPage::getIds() {
+    return m_ids;
+}
+
+bool wss::StatsPage::hasNext() const {
+    return m_hasNext;
+}
@@ -0,0 +1,67 @@
+/**
+ * wsserver
+ * StatsPage.h
+ *
+ * @author Eduard Maximovich <edward.vstock@gmail.com>
+ * @link https://github.com/edwardstock
+ */
+
+#ifndef WSSERVER_STATSPAGE_H
+#define WSSERVER_STATSPAGE_H
+
+#include <cstddef>
+#include <ctime>
+#include <vector>
+#include "../wsserver_core.h"
+#include "../chat/Statistics.h"
+
+namespace wss {
+
+/// \brief Ids of one GET /stats page: users after cursor, matching filters, in ascending id order.
+/// Users may be offered in any order. With limit, only limit+1 smallest ids are kept (extra one tells there is
+/// next page), so memory does not depend on number of users
+class StatsPage {
+ public:
+    /// \param limit page size, 0 - all users
+    explicit StatsPage(std::size_t limit);
+
+    /// \brief Only users with id greater than cursor (nextCursor of previous page)
+    void setCursor(user_id_t cursor);
+
+    /// \brief Only online or only offline users
+    void setOnline(bool online);
+
+    /// \brief Only users inactive at least N seconds, 0 - any
+    void setInactiveSeconds(time_t seconds);
+
+    /// \brief Offer user to page
+    /// \param id
+    /// \param online
+    /// \param inactiveSeconds
+    void add(user_id_t id, bool online, time_t inactiveSeconds);
+    void add(user_id_t id, const wss::Statistics &stat);
+
+    /// \brief Sort and cut page to limit. Call once, after all users were offered
+    void finish();
+
+    /// \return page ids, sorted after finish()
+    std::vector<user_id_t> &getIds();
+
+    /// \return true if there are more users after this page
+    bool hasNext() const;
+
+ private:
+    const std::size_t m_limit;
+    const std::size_t m_keep;
+    std::vector<user_id_t> m_ids;
+    user_id_t m_cursor = 0;
+    bool m_hasCursor = false;
+    bool m_onlineFilter = false;
+    bool m_onlineValue = false;
+    time_t m_inactiveSeconds = 0;
+    bool m_hasNext = false;
+};
+
+}
+
+#endif //WSSERVER_STATSPAGE_H
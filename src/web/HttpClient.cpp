@@ -10,18 +10,26 @@
 #include <future>
 #include "HttpClient.h"
 #include "../helpers/helpers.h"
+#include "../base/Log.h"
 
 // BASE IO
 wss::web::IOContainer::IOContainer() :
     body() { }
 void wss::web::IOContainer::setBody(const std::string &body) {
     this->body = body;
+    this->sharedBody.reset();
     setHeader({"Content-Length", wss::utils::toString(this->body.length())});
 }
 void wss::web::IOContainer::setBody(std::string &&body) {
     this->body = std::move(body);
+    this->sharedBody.reset();
     setHeader({"Content-Length", wss::utils::toString(this->body.length())});
 }
+void wss::web::IOContainer::setBody(std::shared_ptr<const std::string> body) {
+    this->body.clear();
+    this->sharedBody = std::move(body);
+    setHeader({"Content-Length", wss::utils::toString(this->sharedBody ? this->sharedBody->length() : 0)});
+}
 void wss::web::IOContainer::setHeader(wss::web::KeyValue &&keyValue) {
     using toolboxpp::strings::equalsIgnoreCase;
     bool found = false;
@@ -98,14 +106,23 @@ void wss::web::IOContainer::setHeaders(const std::unordered_multimap<std::string
     }
 }
 std::string wss::web::IOContainer::getBody() const {
+    if (sharedBody) {
+        return *sharedBody;
+    }
     return body;
 }
 const char *wss::web::IOContainer::getBodyC() const {
+    if (sharedBody) {
+        return sharedBody->c_str();
+    }
     const char *out = body.c_str();
     return out;
 }
 
 bool wss::web::IOContainer::hasBody() const {
+    if (sharedBody) {
+        return !sharedBody->empty();
+    }
     return !body.empty();
 }
 bool wss::web::IOContainer::hasHeaders() const {
@@ -404,7 +421,7 @@ wss::web::Response wss::web::HttpClient::execute(const wss::web::Request &reques
             struct curl_slist *headers = nullptr;
             for (const auto &h: request.getHeadersGlued()) {
                 if (m_verbose) {
-                    L_DEBUG_F("Http::Request", "Header -> %s", h.c_str());
+                    WSS_DEBUG_F("Http::Request", "Header -> %s", h.c_str());
                 }
 
                 headers = curl_slist_append(headers, h.c_str());
@@ -40,6 +40,7 @@ class IOContainer {
  protected:
     KeyValueVector headers;
     std::string body;
+    std::shared_ptr<const std::string> sharedBody;
 
  public:
     IOContainer();
@@ -52,6 +53,10 @@ class IOContainer {
     /// \param body string data for request/response
     void setBody(std::string &&body);
 
+    /// \brief Set shared immutable body data, without copying it
+    /// \param body shared string data for request/response
+    void setBody(std::shared_ptr<const std::string> body);
+
     /// \brief Set header. Overwrites if already contains
     /// \param keyValue std::pair<std::string, std::string>
     void setHeader(KeyValue &&keyValue);
@@ -20,6 +20,7 @@ namespace wss {
 
 using user_id_t = unsigned long;
 using conn_id_t = unsigned long;
+using room_id_t = unsigned long;
 
 using WsBase = wss::server::websocket::SocketServerBase;
 using WsServer = wss::server::websocket::SocketServer;
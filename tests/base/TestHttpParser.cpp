@@ -0,0 +1,184 @@
+/*!
+ * wsserver
+ * TestHttpParser.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../../src/base/http/HttpParser.h"
+
+#include "gtest/gtest.h"
+
+using wss::http::RequestParser;
+using wss::http::RequestView;
+using Status = wss::http::RequestParser::Status;
+
+static Status parse(const std::string &data, RequestView &view, std::size_t &consumed) {
+    return RequestParser::parse(data.data(), data.size(), view, consumed);
+}
+
+TEST(HttpParser, ParsesRequestLineAndHeaders) {
+    const std::string data = "GET /chat?id=10&x=1 HTTP/1.1\r\n"
+                             "Host: localhost:8085\r\n"
+                             "Sec-WebSocket-Key:dGhlIHNhbXBsZSBub25jZQ==  \r\n"
+                             "Upgrade:\t websocket\r\n"
+                             "Empty:\r\n"
+                             "\r\n"
+                             "{\"body\":1}";
+    RequestView view;
+    std::size_t consumed = 0;
+    ASSERT_EQ(Status::Complete, parse(data, view, consumed));
+    ASSERT_EQ(data.find("\r\n\r\n") + 4, consumed);
+
+    ASSERT_EQ("GET", view.method);
+    ASSERT_EQ("/chat", view.path);
+    ASSERT_EQ("id=10&x=1", view.queryString);
+    ASSERT_EQ("1.1", view.version);
+    ASSERT_EQ(4u, view.headersCount);
+    ASSERT_EQ("localhost:8085", view.header("host"));
+    ASSERT_EQ("dGhlIHNhbXBsZSBub25jZQ==", view.header("SEC-WEBSOCKET-KEY"));
+    ASSERT_EQ("websocket", view.header("Upgrade"));
+    ASSERT_EQ("", view.header("Empty"));
+    ASSERT_TRUE(view.header("Missing").empty());
+
+    // views point into source buffer
+    ASSERT_EQ(data.data() + 4, view.path.data());
+}
+
+TEST(HttpParser, AcceptsBareLineFeedsAndLeadingEmptyLines) {
+    RequestView view;
+    std::size_t consumed = 0;
+    const std::string data = "\r\n\nPOST /send-message HTTP/1.0\nContent-Length: 2\n\n{}";
+    ASSERT_EQ(Status::Complete, parse(data, view, consumed));
+    ASSERT_EQ(data.size() - 2, consumed);
+    ASSERT_EQ("POST", view.method);
+    ASSERT_EQ("/send-message", view.path);
+    ASSERT_TRUE(view.queryString.empty());
+    ASSERT_EQ("1.0", view.version);
+    ASSERT_EQ("2", view.header("content-length"));
+}
+
+TEST(HttpParser, IncompleteOnEveryPrefix) {
+    const std::string data = "GET /chat?id=1 HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n\r\n";
+    RequestView view;
+    std::size_t consumed = 0;
+    for (std::size_t i = 0; i < data.size(); i++) {
+        ASSERT_EQ(Status::Incomplete, RequestParser::parse(data.data(), i, view, consumed)) << i;
+    }
+    ASSERT_EQ(Status::Complete, parse(data, view, consumed));
+    ASSERT_EQ(data.size(), consumed);
+}
+
+TEST(HttpParser, RejectsMalformed) {
+    const std::vector<std::string> invalid = {
+        "GET\r\n\r\n",
+        "GET /chat\r\n\r\n",
+        "GET  /chat HTTP/1.1\r\n\r\n",
+        "GET /chat FTP/1.1\r\n\r\n",
+        "GET /chat HTTP/\r\n\r\n",
+        "GET /chat HTTP/1.1 extra\r\n\r\n",
+        "G(ET /chat HTTP/1.1\r\n\r\n",
+        "GET /ch\tat HTTP/1.1\r\n\r\n",
+        "GET /chat HTTP/1.1\rHost: a\r\n\r\n",
+        "GET /chat HTTP/1.1\r\nHost a\r\n\r\n",
+        "GET /chat HTTP/1.1\r\n: value\r\n\r\n",
+        "GET /chat HTTP/1.1\r\nHo st: a\r\n\r\n",
+        "GET /chat HTTP/1.1\r\nHost: a\r\n folded\r\n\r\n",
+        std::string("GET /chat HTTP/1.1\r\nHost: a\0b\r\n\r\n", 33),
+        "GET /chat HTTP/1.1\r\nHost: a\x7f\r\n\r\n",
+    };
+
+    RequestView view;
+    std::size_t consumed = 0;
+    for (const auto &data: invalid) {
+        ASSERT_EQ(Status::Invalid, parse(data, view, consumed)) << data;
+    }
+}
+
+TEST(HttpParser, LimitsHeadersCount) {
+    std::string data = "GET / HTTP/1.1\r\n";
+    for (std::size_t i = 0; i < RequestView::MAX_HEADERS; i++) {
+        data += "X-Header-" + std::to_string(i) + ": value\r\n";
+    }
+    RequestView view;
+    std::size_t consumed = 0;
+    ASSERT_EQ(Status::Complete, parse(data + "\r\n", view, consumed));
+    ASSERT_EQ(RequestView::MAX_HEADERS, view.headersCount);
+    ASSERT_EQ(Status::Invalid, parse(data + "X-One-More: value\r\n\r\n", view, consumed));
+}
+
+TEST(HttpParser, FindControlMatchesScalarScan) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> printable(0x20, 0x7E);
+    for (int round = 0; round < 2000; round++) {
+        std::string data(round % 97, 'a');
+        for (auto &c: data) {
+            c = (char) (rng() % 8 == 0 ? byte(rng) : printable(rng));
+        }
+        const char *expected = data.data() + data.size();
+        for (std::size_t i = 0; i < data.size(); i++) {
+            const auto c = (unsigned char) data[i];
+            if (c <= 0x1F || c == 0x7F) {
+                expected = data.data() + i;
+                break;
+            }
+        }
+        ASSERT_EQ(expected, RequestParser::findControl(data.data(), data.data() + data.size()));
+    }
+}
+
+TEST(HttpParser, RandomInputNeverReadsOutOfBounds) {
+    // heap copies of exact size, so out of bounds read is caught by sanitizers
+    std::mt19937 rng(7);
+    const std::string alphabet = "GET /?HTTP/1.:\r\n \t\x01\x7f" "abcXYZ";
+    RequestView view;
+    std::size_t consumed = 0;
+    for (int round = 0; round < 20000; round++) {
+        const std::size_t size = rng() % 64;
+        std::unique_ptr<char[]> data(new char[size == 0 ? 1 : size]);
+        for (std::size_t i = 0; i < size; i++) {
+            data[i] = alphabet[rng() % alphabet.size()];
+        }
+        const Status status = RequestParser::parse(data.get(), size, view, consumed);
+        if (status == Status::Complete) {
+            ASSERT_LE(consumed, size);
+            ASSERT_LE(view.method.data() + view.method.size(), data.get() + size);
+            for (std::size_t i = 0; i < view.headersCount; i++) {
+                ASSERT_LE(view.headers[i].value.data() + view.headers[i].value.size(), data.get() + size);
+            }
+        }
+    }
+}
+
+TEST(HttpParser, ParsesAndConsumesStreambuf) {
+    boost::asio::streambuf buffer;
+    std::ostream os(&buffer);
+    os << "GET /chat?id=5 HTTP/1.1\r\nSec-WebSocket-Key: abc\r\nX-A: 1\r\nX-A: 2\r\n\r\nframe";
+
+    std::string method, path, query, version;
+    wss::utils::CaseInsensitiveMultimap header;
+    ASSERT_TRUE(RequestParser::parse(buffer, method, path, query, version, header));
+    ASSERT_EQ("GET", method);
+    ASSERT_EQ("/chat", path);
+    ASSERT_EQ("id=5", query);
+    ASSERT_EQ("1.1", version);
+    ASSERT_EQ(3u, header.size());
+    ASSERT_EQ(2u, header.count("x-a"));
+    ASSERT_EQ("abc", header.find("sec-websocket-key")->second);
+    // only content is left
+    ASSERT_EQ(5u, buffer.size());
+
+    boost::asio::streambuf partial;
+    std::ostream pos(&partial);
+    pos << "GET /chat HTTP/1.1\r\nHost: a\r\n";
+    ASSERT_FALSE(RequestParser::parse(partial, method, path, query, version, header));
+    ASSERT_EQ(29u, partial.size());
+}
@@ -0,0 +1,97 @@
+/*!
+ * wsserver
+ * TestLockProfiler.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include "../../src/base/LockProfiler.h"
+
+#include "gtest/gtest.h"
+
+using wss::sync::LockProfiler;
+using wss::sync::LockStats;
+using wss::sync::ProfiledMutex;
+
+TEST(LockProfiler, SameNameSharesStats) {
+    LockStats &first = LockProfiler::get().stats("test_shared");
+    LockStats &second = LockProfiler::get().stats("test_shared");
+    ASSERT_EQ(&first, &second);
+
+    ProfiledMutex<std::mutex> a("test_shared");
+    ProfiledMutex<std::mutex> b("test_shared");
+    const uint64_t before = first.acquisitions.value();
+    { std::lock_guard<ProfiledMutex<std::mutex>> lock(a); }
+    { std::lock_guard<ProfiledMutex<std::mutex>> lock(b); }
+    ASSERT_EQ(before + 2, first.acquisitions.value());
+    ASSERT_EQ(before + 2, first.hold.snapshot().count);
+}
+
+TEST(LockProfiler, RecursiveCountsOutermostLock) {
+    ProfiledMutex<std::recursive_mutex> mutex("test_recursive");
+    LockStats &stats = LockProfiler::get().stats("test_recursive");
+    {
+        std::lock_guard<ProfiledMutex<std::recursive_mutex>> outer(mutex);
+        std::lock_guard<ProfiledMutex<std::recursive_mutex>> inner(mutex);
+        ASSERT_TRUE(mutex.try_lock());
+        mutex.unlock();
+    }
+    ASSERT_EQ(1u, stats.acquisitions.value());
+    ASSERT_EQ(1u, stats.hold.snapshot().count);
+    ASSERT_EQ(0u, stats.contended.value());
+}
+
+TEST(LockProfiler, ContendedAcquisitionRecordsWait) {
+    ProfiledMutex<std::mutex> mutex("test_contended");
+    LockStats &stats = LockProfiler::get().stats("test_contended");
+
+    std::atomic<bool> waiting(false);
+    mutex.lock();
+    std::thread waiter([&mutex, &waiting] {
+      waiting = true;
+      std::lock_guard<ProfiledMutex<std::mutex>> lock(mutex);
+    });
+    while (!waiting) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(mutex.try_lock());
+    mutex.unlock();
+    waiter.join();
+
+    ASSERT_EQ(2u, stats.acquisitions.value());
+    ASSERT_EQ(1u, stats.contended.value());
+    const auto wait = stats.wait.snapshot();
+    ASSERT_EQ(1u, wait.count);
+    ASSERT_GE(wait.sum, 10000000u);
+    ASSERT_GE(stats.hold.snapshot().sum, 20000000u);
+}
+
+TEST(LockProfiler, ReportsMostWaitedFirst) {
+    ProfiledMutex<std::mutex> idle("test_report_idle");
+    { std::lock_guard<ProfiledMutex<std::mutex>> lock(idle); }
+
+    LockStats &busy = LockProfiler::get().stats("test_report_busy");
+    busy.contended.inc();
+    busy.wait.observe((uint64_t) 3000);
+
+    const auto items = LockProfiler::get().toJson();
+    std::size_t busyIndex = items.size(), idleIndex = items.size();
+    for (std::size_t i = 0; i < items.size(); i++) {
+        if (items[i]["name"] == "test_report_busy") busyIndex = i;
+        if (items[i]["name"] == "test_report_idle") idleIndex = i;
+    }
+    ASSERT_LT(busyIndex, idleIndex);
+    ASSERT_LT(idleIndex, items.size());
+    // 3000ns falls to bucket [2048, 4095]
+    ASSERT_DOUBLE_EQ(4.095, items[busyIndex]["waitP99Us"].get<double>());
+
+    std::stringstream out;
+    LockProfiler::get().report(out);
+    ASSERT_NE(std::string::npos, out.str().find("test_report_busy"));
+}
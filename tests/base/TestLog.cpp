@@ -0,0 +1,140 @@
+/*!
+ * wsserver
+ * TestLog.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../../src/base/Log.h"
+
+#include "gtest/gtest.h"
+
+using wss::log::Level;
+using wss::log::Record;
+using wss::log::RecordRing;
+
+/// \brief Collects records written to sink, restores default sink and verbosity on destruction
+struct CollectingSink {
+  std::mutex mutex;
+  std::vector<Record> records;
+
+  CollectingSink() {
+      wss::log::setSink([this](const Record &record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        records.push_back(record);
+      });
+  }
+
+  ~CollectingSink() {
+      wss::log::setSink(nullptr);
+      wss::log::setVerbosity(2);
+  }
+};
+
+static int evaluated = 0;
+static int countEvaluation() {
+    return ++evaluated;
+}
+
+TEST(Log, RingPushPop) {
+    RecordRing ring(3);
+    ASSERT_EQ(4u, ring.capacity());
+    ASSERT_TRUE(ring.empty());
+
+    for (int i = 0; i < 4; i++) {
+        Record record;
+        record.line = i;
+        ASSERT_TRUE(ring.push(std::move(record)));
+    }
+    Record extra;
+    extra.message = "extra";
+    ASSERT_FALSE(ring.push(std::move(extra)));
+    ASSERT_EQ("extra", extra.message);
+
+    Record out;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(ring.pop(out));
+        ASSERT_EQ(i, out.line);
+    }
+    ASSERT_FALSE(ring.pop(out));
+    ASSERT_TRUE(ring.empty());
+}
+
+TEST(Log, DisabledLevelDoesNotEvaluateArguments) {
+    CollectingSink sink;
+    wss::log::setVerbosity(0);
+    evaluated = 0;
+
+    WSS_DEBUG_F("Test", "value %d", countEvaluation());
+    WSS_INFO_F("Test", "value %d", countEvaluation());
+    WSS_WARN_F("Test", "value %d", countEvaluation());
+    ASSERT_EQ(0, evaluated);
+    ASSERT_TRUE(sink.records.empty());
+
+    WSS_ERR_F("Test", "value %d", countEvaluation());
+    ASSERT_EQ(1, evaluated);
+    ASSERT_EQ(1u, sink.records.size());
+    ASSERT_EQ(Level::Error, sink.records[0].level);
+    ASSERT_EQ("value 1", sink.records[0].message);
+    ASSERT_STREQ("Test", sink.records[0].tag);
+}
+
+TEST(Log, VerbosityLevels) {
+    CollectingSink sink;
+    wss::log::setVerbosity(1);
+    ASSERT_TRUE(wss::log::isEnabled(Level::Error));
+    ASSERT_TRUE(wss::log::isEnabled(Level::Warning));
+    ASSERT_TRUE(wss::log::isEnabled(Level::Info));
+    ASSERT_FALSE(wss::log::isEnabled(Level::Debug));
+
+    wss::log::setVerbosity(2);
+    ASSERT_TRUE(wss::log::isEnabled(Level::Debug));
+}
+
+TEST(Log, WritesDirectlyWithoutWriter) {
+    CollectingSink sink;
+    WSS_INFO_F("Test", "%s %lu", "user", 10ul);
+    WSS_WARN("Test", std::string("plain"));
+
+    ASSERT_EQ(2u, sink.records.size());
+    ASSERT_EQ("user 10", sink.records[0].message);
+    ASSERT_EQ(Level::Info, sink.records[0].level);
+    ASSERT_EQ("plain", sink.records[1].message);
+    ASSERT_GT(sink.records[1].line, 0);
+}
+
+TEST(Log, AsyncWriterKeepsThreadOrder) {
+    CollectingSink sink;
+    // rings fit all records, so nothing is written around them
+    wss::log::startWriter(512);
+
+    const int threadsCount = 4;
+    const int perThread = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsCount; t++) {
+        threads.emplace_back([t] {
+          for (int i = 0; i < perThread; i++) {
+              WSS_ERR_F("Test", "%d %d", t, i);
+          }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    wss::log::stopWriter();
+
+    std::map<int, int> next;
+    for (const auto &record: sink.records) {
+        int t, i;
+        ASSERT_EQ(2, sscanf(record.message.c_str(), "%d %d", &t, &i));
+        ASSERT_EQ(next[t], i);
+        next[t] = i + 1;
+    }
+    ASSERT_EQ((std::size_t) threadsCount * perThread, sink.records.size());
+}
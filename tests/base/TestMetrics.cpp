@@ -0,0 +1,82 @@
+/*!
+ * wsserver
+ * TestMetrics.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <thread>
+#include <vector>
+#include "../../src/base/Metrics.h"
+
+#include "gtest/gtest.h"
+
+using wss::metrics::Histogram;
+using wss::metrics::Registry;
+
+TEST(Metrics, CounterSumsThreadSlots) {
+    auto &counter = Registry::get().counter("test_counter_total", "Test counter");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&counter] {
+          for (int i = 0; i < 10000; i++) {
+              counter.inc();
+          }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    ASSERT_EQ(80000, counter.value());
+    ASSERT_EQ(&counter, &Registry::get().counter("test_counter_total", "Test counter"));
+}
+
+TEST(Metrics, HistogramBuckets) {
+    ASSERT_EQ(0, Histogram::bucketOf(0));
+    ASSERT_EQ(1, Histogram::bucketOf(1));
+    ASSERT_EQ(2, Histogram::bucketOf(2));
+    ASSERT_EQ(2, Histogram::bucketOf(3));
+    ASSERT_EQ(11, Histogram::bucketOf(1024));
+    ASSERT_EQ(64, Histogram::bucketOf(UINT64_MAX));
+
+    Histogram histogram;
+    histogram.observe(std::chrono::microseconds(3));
+    histogram.observe(std::chrono::milliseconds(2));
+    const Histogram::Snapshot snapshot = histogram.snapshot();
+    ASSERT_EQ(2, snapshot.count);
+    ASSERT_EQ(2003000, snapshot.sum);
+    ASSERT_EQ(1, snapshot.buckets[Histogram::bucketOf(3000)]);
+}
+
+TEST(Metrics, TypeMismatchThrows) {
+    Registry::get().gauge("test_mismatch", "Gauge");
+    ASSERT_THROW(Registry::get().counter("test_mismatch", "Counter"), std::logic_error);
+}
+
+TEST(Metrics, Exposition) {
+    auto &registry = Registry::get();
+    registry.counter("test_expose_total", "Exposed counter", "result=\"ok\"").inc(5);
+    registry.histogram("test_expose_seconds", "Exposed histogram").observe(std::chrono::microseconds(3));
+
+    int owner = 0;
+    registry.addCollector(&owner, "test_expose_depth", "Exposed collector", [](Registry::Samples &samples) {
+      samples.emplace_back("target=\"a\"", 7);
+    });
+
+    std::string out = registry.expose();
+    ASSERT_NE(std::string::npos, out.find("# TYPE test_expose_total counter\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_total{result=\"ok\"} 5\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_depth{target=\"a\"} 7\n"));
+    ASSERT_NE(std::string::npos, out.find("# TYPE test_expose_seconds histogram\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_seconds_bucket{le=\"1.024e-06\"} 0\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_seconds_bucket{le=\"4.096e-06\"} 1\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_seconds_bucket{le=\"+Inf\"} 1\n"));
+    ASSERT_NE(std::string::npos, out.find("test_expose_seconds_count 1\n"));
+
+    registry.removeCollectors(&owner);
+    out = registry.expose();
+    ASSERT_EQ(std::string::npos, out.find("test_expose_depth{"));
+}
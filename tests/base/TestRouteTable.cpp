@@ -0,0 +1,125 @@
+/*!
+ * wsserver
+ * TestRouteTable.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include "../../src/base/http/RouteTable.h"
+
+#include "gtest/gtest.h"
+
+using wss::http::RouteTable;
+using wss::utils::RegexOrderable;
+using Kind = RouteTable<int>::Kind;
+
+static Kind classify(const std::string &pattern, std::string &literal) {
+    return RouteTable<int>::classify(pattern, literal);
+}
+
+/// \brief Builds table the same way servers do: from map of patterns
+class Routes {
+ public:
+    explicit Routes(const std::vector<std::string> &patterns) {
+        int id = 0;
+        for (const auto &p: patterns) {
+            m_patterns.emplace(p, id++);
+        }
+        for (auto &item: m_patterns) {
+            m_table.add(item.first.pattern(), item.first, item.second);
+        }
+    }
+
+    /// \return matched route ids in visiting order
+    std::vector<int> candidates(const std::string &path) const {
+        std::vector<int> out;
+        m_table.find(path, [&out](int value, regexns::smatch &) {
+          out.push_back(value);
+          return false;
+        });
+        return out;
+    }
+
+    int first(const std::string &path) const {
+        int found = -1;
+        m_table.find(path, [&found](int value, regexns::smatch &) {
+          found = value;
+          return true;
+        });
+        return found;
+    }
+
+ private:
+    std::map<RegexOrderable, int> m_patterns;
+    RouteTable<int> m_table;
+};
+
+TEST(RouteTable, ClassifiesPatterns) {
+    std::string literal;
+    ASSERT_EQ(Kind::Exact, classify("^/send-message$", literal));
+    ASSERT_EQ("/send-message", literal);
+    ASSERT_EQ(Kind::Exact, classify("/stat", literal));
+    ASSERT_EQ("/stat", literal);
+    ASSERT_EQ(Kind::Exact, classify("^/stats\\.json$", literal));
+    ASSERT_EQ("/stats.json", literal);
+    ASSERT_EQ(Kind::Prefix, classify("^/files/.*$", literal));
+    ASSERT_EQ("/files/", literal);
+    ASSERT_EQ(Kind::Prefix, classify("^.*", literal));
+    ASSERT_EQ("", literal);
+    ASSERT_EQ(Kind::Regex, classify("^/user/([0-9]+)$", literal));
+    ASSERT_EQ(Kind::Regex, classify("^/user/\\d+$", literal));
+    ASSERT_EQ(Kind::Regex, classify("^/a|/b$", literal));
+    ASSERT_EQ(Kind::Regex, classify("^/a.*/b$", literal));
+}
+
+TEST(RouteTable, MatchesWholePathOnly) {
+    Routes routes({"^/chat$", "^/static/.*$", "^/user/([0-9]+)$"});
+    ASSERT_EQ(0, routes.first("/chat"));
+    ASSERT_EQ(-1, routes.first("/chat/"));
+    ASSERT_EQ(-1, routes.first("/cha"));
+    ASSERT_EQ(-1, routes.first(""));
+    ASSERT_EQ(1, routes.first("/static/"));
+    ASSERT_EQ(1, routes.first("/static/a/b.js"));
+    ASSERT_EQ(-1, routes.first("/static"));
+    ASSERT_EQ(2, routes.first("/user/42"));
+    ASSERT_EQ(-1, routes.first("/user/x"));
+}
+
+TEST(RouteTable, VisitsExactThenLongestPrefixThenRegex) {
+    // ids are indexes in list
+    Routes routes({"^/a/.*$", "^/a/b.*$", "^/a/b/c$", "^/a/[a-z]/c$", "^.*$"});
+    ASSERT_EQ(std::vector<int>({2, 1, 0, 4, 3}), routes.candidates("/a/b/c"));
+    ASSERT_EQ(std::vector<int>({1, 0, 4}), routes.candidates("/a/b"));
+    ASSERT_EQ(std::vector<int>({0, 4, 3}), routes.candidates("/a/x/c"));
+    ASSERT_EQ(std::vector<int>({4}), routes.candidates("/z"));
+}
+
+TEST(RouteTable, RegexMatchRefersToPath) {
+    std::map<RegexOrderable, int> patterns;
+    patterns.emplace("^/user/([0-9]+)/messages$", 1);
+    RouteTable<int> table;
+    for (auto &item: patterns) {
+        table.add(item.first.pattern(), item.first, item.second);
+    }
+
+    const std::string path = "/user/123/messages";
+    std::string id;
+    ASSERT_TRUE(table.find(path, [&id](int, regexns::smatch &match) {
+      id = match[1].str();
+      return true;
+    }));
+    ASSERT_EQ("123", id);
+}
+
+TEST(RouteTable, ClearRemovesRoutes) {
+    const RegexOrderable regex("^/chat$");
+    RouteTable<int> table;
+    table.add(regex.pattern(), regex, 1);
+    table.clear();
+    ASSERT_FALSE(table.find("/chat", [](int, regexns::smatch &) { return true; }));
+}
@@ -0,0 +1,146 @@
+/*!
+ * wsserver
+ * TestBotChannel.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include "../../src/chat/BotChannel.h"
+
+#include "gtest/gtest.h"
+
+using wss::BotChannel;
+using boost::asio::local::stream_protocol;
+
+static std::string socketPath(const char *name) {
+    return ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".sock";
+}
+
+/// \brief Waits until condition is true, checking it every few milliseconds
+static bool waitFor(const std::function<bool()> &condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return condition();
+}
+
+/// \brief Bot side of channel, blocking
+struct Bot {
+  boost::asio::io_service ioService;
+  stream_protocol::socket socket{ioService};
+
+  explicit Bot(const std::string &path) {
+      socket.connect(stream_protocol::endpoint(path));
+  }
+
+  void write(const std::string &json) {
+      const auto size = (uint32_t) json.size();
+      std::string frame{(char) (size >> 24), (char) (size >> 16), (char) (size >> 8), (char) size};
+      frame += json;
+      boost::asio::write(socket, boost::asio::buffer(frame));
+  }
+
+  std::string read() {
+      unsigned char header[4];
+      boost::asio::read(socket, boost::asio::buffer(header));
+      const uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+          | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+      std::string json(size, '\0');
+      boost::asio::read(socket, boost::asio::buffer(&json[0], size));
+      return json;
+  }
+};
+
+TEST(BotChannel, MessagesBothWays) {
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    BotChannel channel(socketPath("bot_both"), 1024 * 1024);
+    channel.setMessageHandler([&](std::string &&json) {
+      std::lock_guard<std::mutex> lock(mutex);
+      replies.push_back(std::move(json));
+    });
+    channel.start();
+
+    // kept until bot connects
+    ASSERT_TRUE(channel.send("{\"text\":\"early\"}"));
+    Bot bot(channel.getPath());
+    ASSERT_TRUE(waitFor([&] { return channel.isConnected(); }));
+    ASSERT_EQ("{\"text\":\"early\"}", bot.read());
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(channel.send(std::to_string(i)));
+    }
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(std::to_string(i), bot.read());
+    }
+
+    // frame split between writes
+    bot.write("{\"reply\":1}");
+    bot.write(std::string(100 * 1024, 'r'));
+    ASSERT_TRUE(waitFor([&] {
+      std::lock_guard<std::mutex> lock(mutex);
+      return replies.size() == 2;
+    }));
+    ASSERT_EQ("{\"reply\":1}", replies[0]);
+    ASSERT_EQ(std::string(100 * 1024, 'r'), replies[1]);
+
+    channel.stop();
+    channel.join();
+}
+
+TEST(BotChannel, PendingLimitAndReconnect) {
+    // room for two 4 + 8 bytes frames
+    BotChannel channel(socketPath("bot_reconnect"), 24);
+    channel.start();
+    ASSERT_TRUE(channel.send("message1"));
+    ASSERT_TRUE(channel.send("message2"));
+    ASSERT_FALSE(channel.send("message3"));
+    ASSERT_EQ(24u, channel.getPending());
+
+    {
+        Bot bot(channel.getPath());
+        ASSERT_EQ("message1", bot.read());
+        ASSERT_EQ("message2", bot.read());
+        ASSERT_TRUE(waitFor([&] { return channel.getPending() == 0; }));
+    }
+    ASSERT_TRUE(waitFor([&] { return !channel.isConnected(); }));
+
+    // bot restarted: gets what was sent while it was away
+    ASSERT_TRUE(channel.send("message4"));
+    Bot bot(channel.getPath());
+    ASSERT_EQ("message4", bot.read());
+
+    // new connection replaces previous one
+    Bot replacement(channel.getPath());
+    boost::system::error_code ec;
+    char byte;
+    bot.socket.read_some(boost::asio::buffer(&byte, 1), ec);
+    ASSERT_EQ(boost::asio::error::eof, ec);
+    ASSERT_TRUE(channel.send("message5"));
+    ASSERT_EQ("message5", replacement.read());
+}
+
+TEST(BotChannel, OversizedFrameClosesConnection) {
+    BotChannel channel(socketPath("bot_oversized"), 1024);
+    channel.start();
+    Bot bot(channel.getPath());
+    ASSERT_TRUE(waitFor([&] { return channel.isConnected(); }));
+
+    const char header[] = {(char) 0x7F, (char) 0xFF, (char) 0xFF, (char) 0xFF};
+    boost::asio::write(bot.socket, boost::asio::buffer(header));
+    ASSERT_TRUE(waitFor([&] { return !channel.isConnected(); }));
+}
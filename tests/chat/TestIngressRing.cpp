@@ -0,0 +1,208 @@
+/*!
+ * wsserver
+ * TestIngressRing.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../src/chat/IngressRing.h"
+
+#include "gtest/gtest.h"
+
+using wss::IngressRing;
+
+static std::string ringPath(const char *name) {
+    return ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".ring";
+}
+
+static std::vector<std::string> drainAll(IngressRing &ring) {
+    std::vector<std::string> out;
+    ring.drain([&out](const char *data, std::size_t size) {
+      out.emplace_back(data, size);
+    }, SIZE_MAX);
+    return out;
+}
+
+TEST(IngressRing, PushDrainThroughAttachedProducer) {
+    const std::string path = ringPath("ingress_attach");
+    auto server = IngressRing::create(path, 1000);
+    ASSERT_EQ(4096u, server->getCapacity());
+
+    auto producer = IngressRing::attach(path);
+    ASSERT_EQ(4096u, producer->getCapacity());
+    ASSERT_TRUE(producer->push("{\"text\":\"a\"}"));
+    ASSERT_TRUE(producer->push(std::string(13, 'b')));
+    ASSERT_FALSE(producer->push(std::string()));
+
+    ASSERT_EQ(std::vector<std::string>({"{\"text\":\"a\"}", std::string(13, 'b')}), drainAll(*server));
+    ASSERT_EQ(0u, server->getUsed());
+    ASSERT_TRUE(drainAll(*server).empty());
+
+    // server gone: producer must reattach
+    ASSERT_FALSE(producer->isClosed());
+    server.reset();
+    ASSERT_TRUE(producer->isClosed());
+    ASSERT_FALSE(producer->push("x"));
+    ASSERT_THROW(IngressRing::attach(path), std::runtime_error);
+}
+
+TEST(IngressRing, FullRingRejectsAndWraps) {
+    const std::string path = ringPath("ingress_wrap");
+    auto ring = IngressRing::create(path, 4096);
+    // too large for ring
+    ASSERT_FALSE(ring->push(std::string(3000, 'x')));
+
+    // 1000 bytes payload + 8 header = 1008 bytes record, 4 records fit
+    const std::string payload(1000, 'p');
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(ring->push(payload));
+    }
+    ASSERT_FALSE(ring->push(payload));
+
+    // limited drain frees 2 records, next push does not fit before ring end and wraps
+    std::size_t drained = ring->drain([](const char *, std::size_t) {}, 2);
+    ASSERT_EQ(2u, drained);
+    ASSERT_TRUE(ring->push(std::string(1000, 'w')));
+
+    const auto rest = drainAll(*ring);
+    ASSERT_EQ(3u, rest.size());
+    ASSERT_EQ(payload, rest[0]);
+    ASSERT_EQ(payload, rest[1]);
+    ASSERT_EQ(std::string(1000, 'w'), rest[2]);
+    ASSERT_EQ(0u, ring->getUsed());
+
+    // wrapped many times with odd sizes
+    for (int i = 0; i < 10000; i++) {
+        const std::string value(1 + i % 700, char('a' + i % 26));
+        ASSERT_TRUE(ring->push(value));
+        const auto got = drainAll(*ring);
+        ASSERT_EQ(1u, got.size());
+        ASSERT_EQ(value, got[0]);
+    }
+}
+
+TEST(IngressRing, CorruptedRecordClosesRing) {
+    const std::string path = ringPath("ingress_corrupt");
+    auto server = IngressRing::create(path, 4096);
+    auto producer = IngressRing::attach(path);
+    ASSERT_TRUE(producer->push("first"));
+
+    // foreign producer commits record longer than ring, right after first one: data at 192, first record is 16 bytes
+    const int fd = ::open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    const uint32_t word = IngressRing::COMMITTED | 8192u;
+    ASSERT_EQ((ssize_t) sizeof(word), ::pwrite(fd, &word, sizeof(word), 192 + 16));
+    ::close(fd);
+
+    std::vector<std::string> out;
+    ASSERT_THROW(server->drain([&out](const char *data, std::size_t size) {
+      out.emplace_back(data, size);
+    }, SIZE_MAX), std::runtime_error);
+
+    // records before corrupted one are drained, producers see ring closed
+    ASSERT_EQ(std::vector<std::string>({"first"}), out);
+    ASSERT_EQ(0u, server->getUsed());
+    ASSERT_TRUE(producer->isClosed());
+    ASSERT_FALSE(producer->push("second"));
+    ASSERT_THROW(drainAll(*server), std::runtime_error);
+}
+
+TEST(IngressRing, ConcurrentProducersKeepOrderOfEach) {
+    const std::string path = ringPath("ingress_mpsc");
+    auto server = IngressRing::create(path, 64 * 1024);
+
+    const int producers = 4;
+    const int perProducer = 20000;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&path, p] {
+          auto ring = IngressRing::attach(path);
+          for (int i = 0; i < perProducer;) {
+              const std::string value = std::to_string(p) + ":" + std::to_string(i);
+              if (ring->push(value)) {
+                  i++;
+              } else {
+                  std::this_thread::yield();
+              }
+          }
+        });
+    }
+
+    std::vector<int> next(producers, 0);
+    int total = 0;
+    bool ordered = true;
+    while (total < producers * perProducer) {
+        total += (int) server->drain([&](const char *data, std::size_t size) {
+          const std::string value(data, size);
+          const auto sep = value.find(':');
+          const int p = std::stoi(value.substr(0, sep));
+          const int i = std::stoi(value.substr(sep + 1));
+          ordered = ordered && next[p] == i;
+          next[p] = i + 1;
+        }, 256);
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(std::vector<int>(producers, perProducer), next);
+    ASSERT_EQ(0u, server->getUsed());
+}
+
+TEST(IngressRing, DoorbellWakesIdleConsumer) {
+    using std::chrono::milliseconds;
+    using std::chrono::steady_clock;
+    const std::string path = ringPath("ingress_doorbell");
+    auto server = IngressRing::create(path, 4096);
+    auto producer = IngressRing::attach(path);
+
+    // nothing pushed: full timeout
+    auto start = steady_clock::now();
+    server->wait(milliseconds(50));
+    ASSERT_GE(steady_clock::now() - start, milliseconds(40));
+
+    // record is already there: no wait
+    ASSERT_TRUE(producer->push("ready"));
+    start = steady_clock::now();
+    server->wait(milliseconds(10000));
+    ASSERT_LT(steady_clock::now() - start, milliseconds(1000));
+    ASSERT_EQ(std::vector<std::string>({"ready"}), drainAll(*server));
+
+    // producer push wakes consumer long before timeout
+    for (int i = 0; i < 100; i++) {
+        std::thread thread([&producer, i] {
+          std::this_thread::sleep_for(std::chrono::microseconds(i * 20));
+          ASSERT_TRUE(producer->push(std::to_string(i)));
+        });
+        std::vector<std::string> got;
+        start = steady_clock::now();
+        while (got.empty()) {
+            server->wait(milliseconds(10000));
+            got = drainAll(*server);
+        }
+        thread.join();
+        ASSERT_LT(steady_clock::now() - start, milliseconds(5000));
+        ASSERT_EQ(std::vector<std::string>({std::to_string(i)}), got);
+    }
+
+    // explicit wake, used to stop consumer
+    std::thread waker([&server] {
+      std::this_thread::sleep_for(milliseconds(20));
+      server->wake();
+    });
+    start = steady_clock::now();
+    server->wait(milliseconds(10000));
+    waker.join();
+    ASSERT_LT(steady_clock::now() - start, milliseconds(5000));
+}
@@ -0,0 +1,170 @@
+/*!
+ * wsserver
+ * TestMessageTracer.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <thread>
+#include "../../src/chat/MessageTracer.h"
+
+#include "gtest/gtest.h"
+
+using wss::MessageTracer;
+
+/// \brief Passes message from sender through all trace points, with one delivery per recipient
+static void traceMessage(MessageTracer &tracer, wss::user_id_t sender, const std::vector<wss::user_id_t> &recipients) {
+    std::vector<MessageTracer::DeliveryTrace> deliveries;
+    {
+        MessageTracer::Scope scope(tracer, MessageTracer::Clock::now());
+        scope.dispatched();
+        scope.parsed(sender, 10);
+        for (wss::user_id_t recipient: recipients) {
+            MessageTracer::DeliveryTrace delivery(recipient, recipient * 10);
+            delivery.enqueued();
+            deliveries.push_back(delivery);
+        }
+    }
+    for (auto &delivery: deliveries) {
+        delivery.completed(MessageTracer::Clock::now(), true);
+    }
+}
+
+TEST(MessageTracer, SamplingDisabledByDefault) {
+    MessageTracer tracer(8);
+    ASSERT_EQ(0u, tracer.getSampleEvery());
+    for (int i = 0; i < 10; i++) {
+        traceMessage(tracer, 1, {2});
+    }
+    ASSERT_TRUE(tracer.dump().empty());
+}
+
+TEST(MessageTracer, SamplesEveryNthMessage) {
+    MessageTracer tracer(8);
+    tracer.configure(3, 8);
+    // fresh thread, so per-thread counter starts from zero
+    std::thread([&tracer] {
+      for (wss::user_id_t sender = 1; sender <= 7; sender++) {
+          traceMessage(tracer, sender, {100, 200});
+      }
+    }).join();
+
+    const auto samples = tracer.dump();
+    ASSERT_EQ(2u, samples.size());
+    ASSERT_EQ(3u, samples[0].sender);
+    ASSERT_EQ(6u, samples[1].sender);
+
+    const auto &sample = samples[0];
+    ASSERT_EQ(10u, sample.bytes);
+    ASSERT_LE(sample.frameComplete, sample.dispatched);
+    ASSERT_LE(sample.dispatched, sample.parsed);
+    ASSERT_EQ(2u, sample.deliveries.size());
+    ASSERT_EQ(100u, sample.deliveries[0].recipient);
+    ASSERT_EQ(1000u, sample.deliveries[0].connection);
+    ASSERT_EQ(200u, sample.deliveries[1].recipient);
+    for (const auto &delivery: sample.deliveries) {
+        ASSERT_TRUE(delivery.sent);
+        ASSERT_LE(sample.parsed, delivery.routed);
+        ASSERT_LE(delivery.routed, delivery.enqueued);
+        ASSERT_LE(delivery.enqueued, delivery.writeStarted);
+        ASSERT_LE(delivery.writeStarted, delivery.writeCompleted);
+    }
+}
+
+TEST(MessageTracer, SampleStoredAfterLastDelivery) {
+    MessageTracer tracer(8);
+    tracer.configure(1, 8);
+
+    std::unique_ptr<MessageTracer::DeliveryTrace> pending;
+    {
+        MessageTracer::Scope scope(tracer, MessageTracer::Clock::now());
+        scope.dispatched();
+        scope.parsed(1, 10);
+        pending = std::make_unique<MessageTracer::DeliveryTrace>(2, 20);
+        pending->enqueued();
+    }
+    ASSERT_TRUE(tracer.dump().empty());
+
+    pending->completed(MessageTracer::Clock::time_point(), false);
+    const auto samples = tracer.dump();
+    ASSERT_EQ(1u, samples.size());
+    ASSERT_FALSE(samples[0].deliveries[0].sent);
+    // unknown write start is taken as enqueue time
+    ASSERT_EQ(samples[0].deliveries[0].enqueued, samples[0].deliveries[0].writeStarted);
+}
+
+TEST(MessageTracer, RingKeepsLastSamples) {
+    MessageTracer tracer;
+    tracer.configure(1, 2);
+    for (wss::user_id_t sender = 1; sender <= 3; sender++) {
+        traceMessage(tracer, sender, {});
+    }
+
+    const auto samples = tracer.dump();
+    ASSERT_EQ(2u, samples.size());
+    ASSERT_EQ(2u, samples[0].sender);
+    ASSERT_EQ(3u, samples[1].sender);
+
+    const auto json = tracer.toJson();
+    ASSERT_EQ(2u, json.size());
+    ASSERT_EQ(3u, json[1]["sender"].get<wss::user_id_t>());
+    ASSERT_TRUE(json[1]["deliveries"].empty());
+
+    tracer.clear();
+    ASSERT_TRUE(tracer.dump().empty());
+}
+
+TEST(MessageTracer, DeliveryWithoutScopeIsNotSampled) {
+    MessageTracer tracer(8);
+    tracer.configure(1, 8);
+    MessageTracer::DeliveryTrace delivery(1, 10);
+    delivery.enqueued();
+    delivery.completed(MessageTracer::Clock::now(), true);
+    ASSERT_TRUE(tracer.dump().empty());
+}
+
+TEST(MessageTracer, HandoffResumesScopeOnAnotherThread) {
+    MessageTracer tracer(8);
+    tracer.configure(1, 8);
+
+    std::unique_ptr<MessageTracer::Handoff> handoff;
+    {
+        MessageTracer::Scope scope(tracer, MessageTracer::Clock::now());
+        scope.dispatched();
+        scope.parsed(1, 10);
+        handoff = std::make_unique<MessageTracer::Handoff>();
+    }
+    // captured scope keeps sample pending
+    ASSERT_TRUE(tracer.dump().empty());
+
+    std::thread([&handoff] {
+      MessageTracer::Scope resumed(*handoff);
+      MessageTracer::DeliveryTrace delivery(2, 20);
+      delivery.enqueued();
+      delivery.completed(MessageTracer::Clock::now(), true);
+    }).join();
+    handoff.reset();
+
+    const auto samples = tracer.dump();
+    ASSERT_EQ(1u, samples.size());
+    ASSERT_EQ(1u, samples[0].sender);
+    ASSERT_EQ(1u, samples[0].deliveries.size());
+    ASSERT_EQ(2u, samples[0].deliveries[0].recipient);
+    ASSERT_TRUE(samples[0].deliveries[0].sent);
+    ASSERT_LE(samples[0].parsed, samples[0].deliveries[0].routed);
+}
+
+TEST(MessageTracer, EmptyHandoffIsNotSampled) {
+    MessageTracer tracer(8);
+    tracer.configure(1, 8);
+    MessageTracer::Handoff handoff;
+    {
+        MessageTracer::Scope resumed(handoff);
+        MessageTracer::DeliveryTrace delivery(1, 10);
+        delivery.enqueued();
+        delivery.completed(MessageTracer::Clock::now(), true);
+    }
+    ASSERT_TRUE(tracer.dump().empty());
+}
@@ -0,0 +1,94 @@
+/*!
+ * wsserver
+ * TestPresenceMap.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <thread>
+#include <vector>
+#include "../../src/chat/PresenceMap.h"
+
+#include "gtest/gtest.h"
+
+using wss::PresenceMap;
+
+TEST(PresenceMap, SetAndClear) {
+    PresenceMap presence;
+    ASSERT_FALSE(presence.isOnline(1));
+
+    presence.set(1, true);
+    presence.set(65536, true);
+    ASSERT_TRUE(presence.isOnline(1));
+    ASSERT_TRUE(presence.isOnline(65536));
+    ASSERT_FALSE(presence.isOnline(2));
+    ASSERT_FALSE(presence.isOnline(65535));
+    ASSERT_EQ(2, presence.count());
+
+    presence.set(1, false);
+    ASSERT_FALSE(presence.isOnline(1));
+    ASSERT_TRUE(presence.isOnline(65536));
+    ASSERT_EQ(1, presence.count());
+}
+
+TEST(PresenceMap, RepeatedSetDoesNotChangeCount) {
+    PresenceMap presence;
+    presence.set(10, true);
+    presence.set(10, true);
+    ASSERT_EQ(1, presence.count());
+
+    presence.set(10, false);
+    presence.set(10, false);
+    presence.set(777777, false);
+    ASSERT_EQ(0, presence.count());
+}
+
+TEST(PresenceMap, BlocksAllocatedLazily) {
+    PresenceMap presence;
+    const std::size_t empty = presence.getAllocatedBytes();
+
+    presence.set(5, true);
+    presence.set(6, true);
+    const std::size_t oneBlock = presence.getAllocatedBytes();
+    ASSERT_GT(oneBlock, empty);
+
+    presence.set(UINT32_MAX, true);
+    ASSERT_GT(presence.getAllocatedBytes(), oneBlock);
+    ASSERT_TRUE(presence.isOnline(UINT32_MAX));
+}
+
+TEST(PresenceMap, IdsOver32Bits) {
+    PresenceMap presence;
+    const wss::user_id_t big = (wss::user_id_t) UINT32_MAX + 5;
+    presence.set(big, true);
+    ASSERT_TRUE(presence.isOnline(big));
+    ASSERT_FALSE(presence.isOnline(4));
+    ASSERT_EQ(1, presence.count());
+
+    presence.set(big, false);
+    ASSERT_FALSE(presence.isOnline(big));
+    ASSERT_EQ(0, presence.count());
+}
+
+TEST(PresenceMap, ConcurrentWritersOfDifferentIds) {
+    PresenceMap presence;
+    std::vector<std::thread> threads;
+    for (wss::user_id_t t = 0; t < 4; t++) {
+        threads.emplace_back([&presence, t] {
+          // neighbour ids share words, bits must not be lost
+          for (wss::user_id_t id = t; id < 200000; id += 4) {
+              presence.set(id, true);
+          }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+
+    ASSERT_EQ(200000, presence.count());
+    for (wss::user_id_t id = 0; id < 200000; id++) {
+        ASSERT_TRUE(presence.isOnline(id));
+    }
+}
@@ -0,0 +1,66 @@
+/*!
+ * wsserver
+ * TestRecipientGroups.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <set>
+#include <string>
+#include <vector>
+#include "../../src/chat/RecipientGroups.h"
+
+#include "gtest/gtest.h"
+
+using wss::MessagePayload;
+using wss::RecipientGroup;
+
+static MessagePayload parse(const std::string &json) {
+    return MessagePayload(json);
+}
+
+TEST(RecipientGroups, OneGroupPerRecipientInBatchOrder) {
+    const std::vector<MessagePayload> batch = {
+        parse(R"({"type":"text","sender":9,"recipients":[1,2],"text":"0"})"),
+        parse(R"({"type":"text","sender":9,"recipients":[2],"text":"1"})"),
+        parse(R"({"type":"text","sender":9,"room":7,"text":"room"})"),
+        parse(R"({"type":"text","sender":9,"recipients":[0],"text":"bot"})"),
+        parse(R"({"type":"text","sender":9,"recipients":[3,1],"text":"4"})"),
+        parse(R"({"type":"text","sender":9,"recipients":[2],"text":"5"})"),
+        parse(R"({"type":"text","sender":9,"recipients":[1],"text":"6"})"),
+    };
+    for (const auto &payload: batch) {
+        ASSERT_TRUE(payload.isValid()) << payload.getError();
+    }
+
+    // each recipient is looked up once for all its messages, which keep batch order
+    const std::vector<RecipientGroup> expected = {
+        {1, {0, 4, 6}},
+        {2, {0, 1, 5}},
+        {3, {4}},
+    };
+    ASSERT_EQ(expected, wss::groupByRecipient(batch));
+}
+
+TEST(RecipientGroups, LargeBatchKeepsOrderOfEachRecipient) {
+    std::vector<MessagePayload> batch;
+    for (int i = 0; i < 1000; i++) {
+        batch.emplace_back(9, wss::user_id_t(1 + i % 7), std::to_string(i));
+    }
+
+    const auto groups = wss::groupByRecipient(batch);
+    ASSERT_EQ(7u, groups.size());
+    std::set<wss::user_id_t> recipients;
+    std::size_t total = 0;
+    for (const auto &group: groups) {
+        ASSERT_TRUE(recipients.insert(group.first).second);
+        for (std::size_t i = 0; i < group.second.size(); i++) {
+            ASSERT_EQ(group.first, batch[group.second[i]].getRecipients()[0]);
+            ASSERT_TRUE(i == 0 || group.second[i - 1] < group.second[i]);
+        }
+        total += group.second.size();
+    }
+    ASSERT_EQ(batch.size(), total);
+}
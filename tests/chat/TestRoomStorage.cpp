@@ -0,0 +1,152 @@
+/*!
+ * wsserver
+ * TestRoomStorage.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../../src/chat/RoomStorage.h"
+
+#include "gtest/gtest.h"
+
+using wss::RoomStorage;
+using Ids = std::vector<wss::user_id_t>;
+
+static std::string journalPath(const char *name) {
+    return ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".bin";
+}
+
+static std::size_t fileSize(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    const auto size = (std::size_t) ftell(f);
+    fclose(f);
+    return size;
+}
+
+TEST(RoomStorage, CreateJoinLeave) {
+    RoomStorage rooms;
+    ASSERT_TRUE(rooms.create(10, {5, 3, 5, 1}));
+    ASSERT_FALSE(rooms.create(10));
+    ASSERT_EQ(Ids({1, 3, 5}), *rooms.getMembers(10));
+
+    ASSERT_TRUE(rooms.join(10, {4, 3, 100}));
+    ASSERT_EQ(Ids({1, 3, 4, 5, 100}), *rooms.getMembers(10));
+    ASSERT_TRUE(rooms.isMember(10, 100));
+
+    ASSERT_TRUE(rooms.leave(10, {1, 100, 7}));
+    ASSERT_EQ(Ids({3, 4, 5}), *rooms.getMembers(10));
+    ASSERT_FALSE(rooms.isMember(10, 100));
+
+    ASSERT_FALSE(rooms.join(11, {1}));
+    ASSERT_FALSE(rooms.leave(11, {1}));
+    ASSERT_FALSE(rooms.isMember(11, 1));
+    ASSERT_EQ(nullptr, rooms.getMembers(11));
+
+    ASSERT_EQ(1u, rooms.size());
+    ASSERT_TRUE(rooms.remove(10));
+    ASSERT_FALSE(rooms.remove(10));
+    ASSERT_FALSE(rooms.exists(10));
+}
+
+TEST(RoomStorage, MembersSnapshotIsNotChanged) {
+    RoomStorage rooms;
+    rooms.create(1, {1, 2});
+    const RoomStorage::Members before = rooms.getMembers(1);
+    rooms.join(1, {3});
+    rooms.leave(1, {1});
+    ASSERT_EQ(Ids({1, 2}), *before);
+    ASSERT_EQ(Ids({2, 3}), *rooms.getMembers(1));
+}
+
+TEST(RoomStorage, JournalIsReplayedAndCompacted) {
+    const std::string path = journalPath("rooms_journal");
+    remove(path.c_str());
+    {
+        RoomStorage rooms(path);
+        ASSERT_EQ(0u, rooms.load());
+        rooms.create(1, {10, 20, 30});
+        rooms.create(2, {1000000000000ul});
+        rooms.create(3);
+        for (wss::user_id_t id = 100; id < 200; id++) {
+            rooms.join(1, {id});
+        }
+        rooms.leave(1, {20});
+        rooms.remove(3);
+    }
+    const std::size_t journalSize = fileSize(path);
+
+    RoomStorage rooms(path);
+    ASSERT_EQ(2u, rooms.load());
+    ASSERT_FALSE(rooms.exists(3));
+    ASSERT_EQ(Ids({1000000000000ul}), *rooms.getMembers(2));
+    const RoomStorage::Members members = rooms.getMembers(1);
+    ASSERT_EQ(102u, members->size());
+    ASSERT_FALSE(rooms.isMember(1, 20));
+    ASSERT_TRUE(rooms.isMember(1, 199));
+    ASSERT_LT(fileSize(path), journalSize);
+
+    // changes after load are appended to compacted journal
+    rooms.join(2, {5});
+    RoomStorage reloaded(path);
+    ASSERT_EQ(2u, reloaded.load());
+    ASSERT_EQ(Ids({5, 1000000000000ul}), *reloaded.getMembers(2));
+    remove(path.c_str());
+}
+
+TEST(RoomStorage, GrownJournalIsCompacted) {
+    const std::string path = journalPath("rooms_grown");
+    remove(path.c_str());
+    Ids members;
+    for (wss::user_id_t id = 1; id <= 50; id++) {
+        members.push_back(id);
+    }
+    {
+        RoomStorage rooms(path, 1024);
+        rooms.load();
+        rooms.create(1, members);
+        // live state does not change, journal grows with every record
+        for (int i = 0; i < 5000; i++) {
+            rooms.join(1, {1000});
+            rooms.leave(1, {1000});
+            ASSERT_LE(fileSize(path), RoomStorage::COMPACT_RATIO * 1024 + 16);
+        }
+        rooms.join(1, {2000});
+    }
+
+    RoomStorage rooms(path);
+    ASSERT_EQ(1u, rooms.load());
+    members.push_back(2000);
+    ASSERT_EQ(members, *rooms.getMembers(1));
+    remove(path.c_str());
+}
+
+TEST(RoomStorage, IncompleteTailIsSkipped) {
+    const std::string path = journalPath("rooms_tail");
+    remove(path.c_str());
+    {
+        RoomStorage rooms(path);
+        rooms.load();
+        rooms.create(7, {1, 2});
+    }
+    // record interrupted in the middle of room id varint
+    FILE *f = fopen(path.c_str(), "ab");
+    ASSERT_NE(nullptr, f);
+    const char tail[] = {3, (char) 0x80};
+    fwrite(tail, 1, sizeof(tail), f);
+    fclose(f);
+
+    RoomStorage rooms(path);
+    ASSERT_EQ(1u, rooms.load());
+    ASSERT_EQ(Ids({1, 2}), *rooms.getMembers(7));
+    remove(path.c_str());
+}
@@ -0,0 +1,139 @@
+/*!
+ * wsserver
+ * TestUserStrands.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../../src/chat/UserStrands.h"
+
+#include "gtest/gtest.h"
+
+using wss::UserStrands;
+
+/// \brief Counts finished tasks, so test can wait for all of them
+struct Latch {
+  explicit Latch(std::size_t count) : count(count) { }
+
+  void countDown() {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--count == 0) {
+          done.notify_all();
+      }
+  }
+
+  bool wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      return done.wait_for(lock, std::chrono::seconds(10), [this] { return count == 0; });
+  }
+
+  std::mutex mutex;
+  std::condition_variable done;
+  std::size_t count;
+};
+
+TEST(UserStrands, ShardOfUser) {
+    UserStrands strands(4, 1);
+    ASSERT_EQ(4u, strands.getShards());
+    ASSERT_EQ(1u, strands.getThreads());
+    ASSERT_EQ(1u, strands.shardOf(1));
+    ASSERT_EQ(1u, strands.shardOf(5));
+    ASSERT_EQ(0u, strands.shardOf(8));
+
+    UserStrands single(0, 0);
+    ASSERT_EQ(1u, single.getShards());
+    ASSERT_EQ(1u, single.getThreads());
+}
+
+TEST(UserStrands, FifoPerUserWithoutOverlap) {
+    const std::size_t shards = 8;
+    const std::size_t producers = 4;
+    const std::size_t users = 32;
+    const std::size_t perUser = 200;
+
+    UserStrands strands(shards, 4);
+    strands.start();
+
+    // written only by tasks of user shard, so no locks needed
+    std::vector<std::vector<std::size_t>> received(users);
+    std::vector<std::atomic<int>> running(shards);
+    for (auto &value: running) {
+        value = 0;
+    }
+    std::atomic<bool> overlapped(false);
+    Latch latch(users * perUser);
+
+    // every producer owns users with id % producers == producer, so per-user post order is known
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+          for (std::size_t seq = 0; seq < perUser; seq++) {
+              for (wss::user_id_t id = p; id < users; id += producers) {
+                  strands.post(id, [&, id, seq] {
+                    const std::size_t shard = strands.shardOf(id);
+                    if (running[shard].fetch_add(1) != 0) {
+                        overlapped = true;
+                    }
+                    EXPECT_TRUE(strands.isInShard(id));
+                    received[id].push_back(seq);
+                    running[shard].fetch_sub(1);
+                    latch.countDown();
+                  });
+              }
+          }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    ASSERT_TRUE(latch.wait());
+    ASSERT_FALSE(overlapped);
+    ASSERT_FALSE(strands.isInShard(0));
+    for (std::size_t id = 0; id < users; id++) {
+        ASSERT_EQ(perUser, received[id].size());
+        for (std::size_t seq = 0; seq < perUser; seq++) {
+            ASSERT_EQ(seq, received[id][seq]);
+        }
+    }
+}
+
+TEST(UserStrands, TasksPostedBeforeStartRunAfterIt) {
+    UserStrands strands(2, 2);
+    std::vector<int> order;
+    Latch latch(3);
+    for (int i = 0; i < 3; i++) {
+        strands.post(7, [&order, &latch, i] {
+          order.push_back(i);
+          latch.countDown();
+        });
+    }
+    strands.start();
+    ASSERT_TRUE(latch.wait());
+    ASSERT_EQ(std::vector<int>({0, 1, 2}), order);
+}
+
+TEST(UserStrands, TaskPostedFromOwnShardRunsAfterCurrent) {
+    UserStrands strands(1, 2);
+    strands.start();
+    std::vector<int> order;
+    Latch latch(2);
+    strands.post(1, [&] {
+      strands.post(2, [&] {
+        order.push_back(2);
+        latch.countDown();
+      });
+      order.push_back(1);
+      latch.countDown();
+    });
+    ASSERT_TRUE(latch.wait());
+    ASSERT_EQ(std::vector<int>({1, 2}), order);
+}
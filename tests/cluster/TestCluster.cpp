@@ -0,0 +1,258 @@
+/*!
+ * wsserver
+ * TestCluster.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "../../src/cluster/Cluster.h"
+#include "../../src/cluster/Protocol.h"
+
+#include "gtest/gtest.h"
+
+using namespace wss::cluster;
+
+/// \brief Waits until condition is true, checking it every few milliseconds
+static bool waitFor(const std::function<bool()> &condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return condition();
+}
+
+/// \brief Collects messages passed to cluster handler
+struct Inbox {
+  std::mutex mutex;
+  std::vector<std::pair<wss::user_id_t, std::string>> messages;
+
+  Cluster::MessageHandler handler() {
+      return [this](wss::user_id_t recipient, std::string &&json) {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(recipient, std::move(json));
+      };
+  }
+
+  std::size_t size() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return messages.size();
+  }
+};
+
+TEST(ClusterProtocol, FramesSplitFromStream) {
+    std::string stream;
+    encodeHello(stream, 3, "secret");
+    encodePresence(stream, {{10, true}, {1ul << 40, false}});
+    encodeMessage(stream, 77, "{\"text\":\"hi\"}");
+
+    // fed byte by byte, like the slowest socket
+    FrameReader reader;
+    std::vector<Frame> frames;
+    Frame frame;
+    for (char c: stream) {
+        reader.feed(&c, 1);
+        while (reader.next(frame)) {
+            frames.push_back(frame);
+        }
+    }
+    ASSERT_FALSE(reader.isBroken());
+    ASSERT_EQ(3u, frames.size());
+
+    uint32_t node = 0;
+    std::string secret;
+    ASSERT_TRUE(decodeHello(frames[0], node, secret));
+    ASSERT_EQ(3u, node);
+    ASSERT_EQ("secret", secret);
+
+    std::vector<PresenceChange> changes;
+    ASSERT_TRUE(decodePresence(frames[1], changes));
+    ASSERT_EQ(2u, changes.size());
+    ASSERT_EQ(10u, changes[0].first);
+    ASSERT_TRUE(changes[0].second);
+    ASSERT_EQ(1ul << 40, changes[1].first);
+    ASSERT_FALSE(changes[1].second);
+
+    wss::user_id_t recipient = 0;
+    std::string json;
+    ASSERT_FALSE(decodeHello(frames[2], node, secret));
+    ASSERT_TRUE(decodeMessage(frames[2], recipient, json));
+    ASSERT_EQ(77u, recipient);
+    ASSERT_EQ("{\"text\":\"hi\"}", json);
+}
+
+TEST(ClusterProtocol, OversizedFrameBreaksStream) {
+    const char header[] = {(char) 0x7F, (char) 0xFF, (char) 0xFF, (char) 0xFF, 3};
+    FrameReader reader;
+    reader.feed(header, sizeof(header));
+    Frame frame;
+    ASSERT_FALSE(reader.next(frame));
+    ASSERT_TRUE(reader.isBroken());
+}
+
+TEST(ClusterDirectory, NodesOfUser) {
+    Directory directory;
+    ASSERT_EQ(0u, directory.getNodes(1));
+    directory.set(1, 2, true);
+    directory.set(1, 5, true);
+    directory.set(2, 5, true);
+    ASSERT_EQ(Directory::maskOf(2) | Directory::maskOf(5), directory.getNodes(1));
+    ASSERT_EQ(2u, directory.size());
+
+    directory.set(1, 2, false);
+    ASSERT_EQ(Directory::maskOf(5), directory.getNodes(1));
+    directory.clearNode(5);
+    ASSERT_EQ(0u, directory.getNodes(1));
+    ASSERT_EQ(0u, directory.getNodes(2));
+    ASSERT_EQ(0u, directory.size());
+}
+
+TEST(Cluster, PresenceAndMessagesBetweenNodes) {
+    Inbox inbox1, inbox2;
+    auto node1 = std::make_unique<Cluster>(1, "127.0.0.1", 0, std::vector<NodeAddress>());
+    node1->setMessageHandler(inbox1.handler());
+    node1->start();
+
+    // second node knows first one only after its port is bound
+    auto node2 = std::make_unique<Cluster>(2, "127.0.0.1", 0,
+                                           std::vector<NodeAddress>{{1, "127.0.0.1", node1->getPort()}});
+    node2->setMessageHandler(inbox2.handler());
+    node2->setLocalPresence(20, true);
+    node2->start();
+    ASSERT_TRUE(waitFor([&] { return node2->getConnectedPeers() == 1; }));
+
+    // snapshot sent on connect and changes after it
+    ASSERT_TRUE(waitFor([&] { return node1->getRemoteNodes(20) == Directory::maskOf(2); }));
+    node2->setLocalPresence(21, true);
+    node2->setLocalPresence(20, false);
+    ASSERT_TRUE(waitFor([&] { return node1->getRemoteNodes(21) == Directory::maskOf(2); }));
+    ASSERT_EQ(0u, node1->getRemoteNodes(20));
+
+    // node2 -> node1 link carries messages for node1 users
+    for (int i = 0; i < 100; i++) {
+        node2->forward(Directory::maskOf(1), 10, std::to_string(i));
+    }
+    ASSERT_TRUE(waitFor([&] { return inbox1.size() == 100; }));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(10u, inbox1.messages[i].first);
+        ASSERT_EQ(std::to_string(i), inbox1.messages[i].second);
+    }
+
+    // node 1 has no link to node 2, message is returned right away
+    Inbox returned;
+    node1->setReturnHandler(returned.handler());
+    node1->forward(Directory::maskOf(2), 21, "{}");
+    ASSERT_EQ(1u, returned.size());
+    ASSERT_EQ(0u, inbox2.size());
+
+    // users of stopped node become offline
+    node2->stop();
+    node2->join();
+    ASSERT_TRUE(waitFor([&] { return node1->getRemoteNodes(21) == 0; }));
+    node1->stop();
+    node1->join();
+}
+
+TEST(Cluster, ReconnectsToRestartedNode) {
+    // take free port for node 1, then release it
+    uint16_t port;
+    {
+        Cluster probe(1, "127.0.0.1", 0, {});
+        probe.start();
+        port = probe.getPort();
+    }
+
+    Cluster node2(2, "127.0.0.1", 0, {{1, "127.0.0.1", port}, {2, "127.0.0.1", 0}});
+    node2.setLocalPresence(7, true);
+    node2.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(0u, node2.getConnectedPeers());
+
+    Inbox inbox;
+    Cluster node1(1, "127.0.0.1", port, {});
+    node1.setMessageHandler(inbox.handler());
+    node1.start();
+    ASSERT_TRUE(waitFor([&] { return node1.getRemoteNodes(7) == Directory::maskOf(2); }));
+    node2.forward(Directory::maskOf(1), 1, "{}");
+    ASSERT_TRUE(waitFor([&] { return inbox.size() == 1; }));
+}
+
+TEST(Cluster, ReturnsBatchInFlightWhenNodeDies) {
+    // node 1 is a bare socket, that accepts link and never reads from it
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, {boost::asio::ip::address::from_string("127.0.0.1"), 0});
+    boost::asio::ip::tcp::socket deadNode(ioService);
+
+    Inbox returned;
+    Cluster node2(2, "127.0.0.1", 0, {{1, "127.0.0.1", acceptor.local_endpoint().port()}});
+    node2.setReturnHandler(returned.handler());
+    node2.start();
+    acceptor.accept(deadNode);
+    ASSERT_TRUE(waitFor([&] { return node2.getConnectedPeers() == 1; }));
+
+    // far larger than socket buffers: write stays in flight until node dies
+    const std::string big(32 * 1024 * 1024, 'x');
+    node2.forward(Directory::maskOf(1), 5, big);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(0u, returned.size());
+
+    deadNode.close();
+    ASSERT_TRUE(waitFor([&] { return returned.size() == 1; }));
+    ASSERT_EQ(5u, returned.messages[0].first);
+    ASSERT_EQ(big.size(), returned.messages[0].second.size());
+}
+
+TEST(Cluster, RejectsLinkWithWrongSecret) {
+    Inbox inbox;
+    Cluster node1(1, "127.0.0.1", 0, {}, "cluster secret");
+    node1.setMessageHandler(inbox.handler());
+    node1.start();
+
+    // stranger knows protocol, but not secret
+    for (const std::string &secret: {std::string(), std::string("cluster secreT"), std::string("cluster secret!")}) {
+        boost::asio::io_service ioService;
+        boost::asio::ip::tcp::socket stranger(ioService);
+        stranger.connect({boost::asio::ip::address::from_string("127.0.0.1"), node1.getPort()});
+        std::string frames;
+        encodeHello(frames, 2, secret);
+        encodePresence(frames, {{30, true}});
+        encodeMessage(frames, 10, "{\"sender\":1}");
+        boost::asio::write(stranger, boost::asio::buffer(frames));
+
+        // link is closed without reading presence and message
+        boost::system::error_code ec;
+        char byte;
+        stranger.read_some(boost::asio::buffer(&byte, 1), ec);
+        ASSERT_TRUE(ec == boost::asio::error::eof || ec == boost::asio::error::connection_reset) << ec.message();
+        ASSERT_EQ(0u, node1.getRemoteNodes(30));
+        ASSERT_EQ(0u, inbox.size());
+    }
+
+    // node with the same secret is accepted
+    Cluster node2(2, "127.0.0.1", 0, {{1, "127.0.0.1", node1.getPort()}}, "cluster secret");
+    node2.setLocalPresence(30, true);
+    node2.start();
+    ASSERT_TRUE(waitFor([&] { return node1.getRemoteNodes(30) == Directory::maskOf(2); }));
+    node2.forward(Directory::maskOf(1), 10, "{}");
+    ASSERT_TRUE(waitFor([&] { return inbox.size() == 1; }));
+}
+
+TEST(Cluster, SecretIsRequiredOnPublicAddress) {
+    ASSERT_THROW(Cluster(1, "0.0.0.0", 0, {}), std::invalid_argument);
+    ASSERT_THROW(Cluster(1, "not address", 0, {}), std::invalid_argument);
+    Cluster secured(1, "0.0.0.0", 0, {}, "cluster secret");
+    Cluster local(1, "127.0.0.1", 0, {});
+}
@@ -0,0 +1,135 @@
+/*!
+ * wsserver
+ * TestCircuitBreaker.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include "../../src/event/CircuitBreaker.hpp"
+#include "../../src/event/ConcurrencyLimiter.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std::chrono;
+using wss::event::CircuitBreaker;
+using wss::event::CircuitBreakerPolicy;
+using wss::event::ConcurrencyLimiter;
+using wss::event::ConcurrencyPolicy;
+
+static CircuitBreakerPolicy smallWindow() {
+    CircuitBreakerPolicy policy;
+    policy.windowSize = 10;
+    policy.minimumCalls = 4;
+    policy.failureRateThreshold = 0.5;
+    policy.slowCallDuration = milliseconds(100);
+    policy.slowCallRateThreshold = 1.0;
+    policy.openDuration = seconds(10);
+    policy.halfOpenCalls = 2;
+    return policy;
+}
+
+TEST(CircuitBreakerTest, OpensOnFailureRate) {
+    CircuitBreaker breaker(smallWindow());
+    const auto now = CircuitBreaker::clock::now();
+
+    breaker.onResult(true, milliseconds(1), now);
+    breaker.onResult(false, milliseconds(1), now);
+    breaker.onResult(true, milliseconds(1), now);
+    ASSERT_EQ(CircuitBreaker::Closed, breaker.getState());
+
+    // 2 of 4 failed
+    breaker.onResult(false, milliseconds(1), now);
+    ASSERT_EQ(CircuitBreaker::Open, breaker.getState());
+    ASSERT_FALSE(breaker.allowRequest(now + seconds(1)));
+    ASSERT_TRUE(breaker.isOpen(now + seconds(1)));
+}
+
+TEST(CircuitBreakerTest, OpensOnSlowCalls) {
+    CircuitBreaker breaker(smallWindow());
+    const auto now = CircuitBreaker::clock::now();
+    for (int i = 0; i < 4; i++) {
+        breaker.onResult(true, milliseconds(500), now);
+    }
+    ASSERT_EQ(CircuitBreaker::Open, breaker.getState());
+}
+
+TEST(CircuitBreakerTest, HalfOpenTrials) {
+    CircuitBreaker breaker(smallWindow());
+    auto now = CircuitBreaker::clock::now();
+    for (int i = 0; i < 4; i++) {
+        breaker.onResult(false, milliseconds(1), now);
+    }
+    ASSERT_EQ(CircuitBreaker::Open, breaker.getState());
+
+    // only 2 trial calls
+    now += seconds(11);
+    ASSERT_TRUE(breaker.allowRequest(now));
+    ASSERT_EQ(CircuitBreaker::HalfOpen, breaker.getState());
+    ASSERT_TRUE(breaker.allowRequest(now));
+    ASSERT_FALSE(breaker.allowRequest(now));
+
+    // failed trial opens circuit again
+    breaker.onResult(false, milliseconds(1), now);
+    ASSERT_EQ(CircuitBreaker::Open, breaker.getState());
+
+    now += seconds(11);
+    ASSERT_TRUE(breaker.allowRequest(now));
+    ASSERT_TRUE(breaker.allowRequest(now));
+    breaker.onResult(true, milliseconds(1), now);
+    breaker.onResult(true, milliseconds(1), now);
+    ASSERT_EQ(CircuitBreaker::Closed, breaker.getState());
+}
+
+TEST(ConcurrencyLimiterTest, DefersOverLimitAndHandsOver) {
+    ConcurrencyPolicy policy;
+    policy.initialLimit = 2;
+    ConcurrencyLimiter<int> limiter(policy);
+
+    int a = 1, b = 2, c = 3, next = 0;
+    ASSERT_TRUE(limiter.acquireOrDefer(a));
+    ASSERT_TRUE(limiter.acquireOrDefer(b));
+    ASSERT_FALSE(limiter.acquireOrDefer(c));
+    ASSERT_EQ(1u, limiter.getDeferredCount());
+
+    // permit passes to deferred item
+    ASSERT_TRUE(limiter.release(next));
+    ASSERT_EQ(3, next);
+    ASSERT_EQ(2u, limiter.getInFlight());
+    ASSERT_FALSE(limiter.release(next));
+    ASSERT_FALSE(limiter.release(next));
+    ASSERT_EQ(0u, limiter.getInFlight());
+}
+
+TEST(ConcurrencyLimiterTest, AdditiveIncreaseMultiplicativeDecrease) {
+    ConcurrencyPolicy policy;
+    policy.initialLimit = 10;
+    policy.minLimit = 2;
+    policy.maxLimit = 12;
+    policy.latencyThreshold = milliseconds(100);
+    policy.decreaseCooldown = seconds(1);
+    ConcurrencyLimiter<int> limiter(policy);
+    auto now = ConcurrencyLimiter<int>::clock::now();
+
+    // ~ +1 per limit successful calls
+    for (int i = 0; i < 11; i++) {
+        limiter.onSample(true, milliseconds(1), now);
+    }
+    ASSERT_EQ(11u, limiter.getLimit());
+
+    limiter.onSample(false, milliseconds(1), now);
+    ASSERT_EQ(5u, limiter.getLimit());
+    // cooldown: burst of failures decreases limit once
+    limiter.onSample(false, milliseconds(1), now);
+    limiter.onSample(true, milliseconds(500), now);
+    ASSERT_EQ(5u, limiter.getLimit());
+
+    now += seconds(2);
+    limiter.onSample(true, milliseconds(500), now);
+    ASSERT_EQ(2u, limiter.getLimit());
+    now += seconds(2);
+    limiter.onSample(false, milliseconds(1), now);
+    ASSERT_EQ(2u, limiter.getLimit());
+}
@@ -0,0 +1,60 @@
+/*!
+ * wsserver
+ * TestEventFilter.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <string>
+#include <vector>
+#include "../../src/event/EventFilter.h"
+
+#include "gtest/gtest.h"
+
+using wss::event::EventFilter;
+using wss::event::FilterSyntaxError;
+
+static wss::MessagePayload makePayload(const std::string &type, user_id_t sender, std::vector<user_id_t> recipients) {
+    wss::json obj;
+    obj["type"] = type;
+    obj["sender"] = sender;
+    obj["recipients"] = recipients;
+    obj["text"] = "test";
+    return wss::MessagePayload(obj);
+}
+
+TEST(EventFilterTest, EmptyRuleAcceptsAll) {
+    EventFilter filter = EventFilter::compile("  ");
+    ASSERT_TRUE(filter.acceptsAll());
+    ASSERT_TRUE(filter(makePayload("text", 1, {2})));
+}
+
+TEST(EventFilterTest, TypeSetIsCaseInsensitive) {
+    EventFilter filter = EventFilter::compile("type in {order, Payment}");
+    ASSERT_TRUE(filter(makePayload("ORDER", 1, {2})));
+    ASSERT_TRUE(filter(makePayload("payment", 1, {2})));
+    ASSERT_FALSE(filter(makePayload("text", 1, {2})));
+}
+
+TEST(EventFilterTest, RangesAndLogic) {
+    EventFilter filter = EventFilter::compile("type == order and sender in 1000..1999 or recipient == 5");
+    ASSERT_TRUE(filter(makePayload("order", 1500, {1})));
+    ASSERT_FALSE(filter(makePayload("order", 999, {1})));
+    // any of recipients
+    ASSERT_TRUE(filter(makePayload("text", 1, {3, 5})));
+
+    EventFilter negated = EventFilter::compile("not (type == text) and recipient not in {1, 2}");
+    ASSERT_FALSE(negated(makePayload("Text", 1, {3})));
+    ASSERT_TRUE(negated(makePayload("image", 1, {3})));
+    ASSERT_FALSE(negated(makePayload("image", 1, {1})));
+}
+
+TEST(EventFilterTest, SyntaxErrors) {
+    ASSERT_THROW(EventFilter::compile("type in {a"), FilterSyntaxError);
+    ASSERT_THROW(EventFilter::compile("unknown == 1"), FilterSyntaxError);
+    ASSERT_THROW(EventFilter::compile("sender = 1"), FilterSyntaxError);
+    ASSERT_THROW(EventFilter::compile("sender in 5..1"), FilterSyntaxError);
+    ASSERT_THROW(EventFilter::compile("type > a"), FilterSyntaxError);
+}
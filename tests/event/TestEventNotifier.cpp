@@ -0,0 +1,165 @@
+/*!
+ * wsserver
+ * TestEventNotifier.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "../../src/base/Metrics.h"
+#include "../../src/chat/ChatServer.h"
+#include "../../src/event/EventNotifier.h"
+
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+
+/// \brief Asynchronous target, that completes sends only when test asks
+class ManualAsyncTarget : public wss::event::Target {
+ public:
+    explicit ManualAsyncTarget(const nlohmann::json &config) : Target(config) { }
+
+    bool send(const wss::event::EventPtr &, std::string &error) override {
+        error = "Synchronous send is not expected";
+        return false;
+    }
+    void sendAsync(const wss::event::EventPtr &, SendCallback &&callback) override {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_callbacks.push_back(std::move(callback));
+        m_received++;
+        m_cond.notify_all();
+    }
+    bool isAsync() const override {
+        return true;
+    }
+    std::string getType() override {
+        return "manual";
+    }
+
+    /// \return false if target did not receive count sends in total
+    bool waitReceived(std::size_t count) {
+        std::unique_lock<std::mutex> lock(m_lock);
+        return m_cond.wait_for(lock, milliseconds(5000), [this, count] { return m_received >= count; });
+    }
+    std::size_t getReceived() {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_received;
+    }
+    void completeFirst(bool success = true) {
+        SendCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            callback = std::move(m_callbacks.front());
+            m_callbacks.pop_front();
+        }
+        callback(success, success ? std::string() : std::string("Failed by test"));
+    }
+
+ private:
+    std::mutex m_lock;
+    std::condition_variable m_cond;
+    std::deque<SendCallback> m_callbacks;
+    std::size_t m_received = 0;
+};
+
+static nlohmann::json ndjsonConfig(const char *name) {
+    nlohmann::json config;
+    config["type"] = "ndjson";
+    config["path"] = ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".ndjson";
+    return config;
+}
+
+TEST(EventNotifier, GuardsOfTargetAndFallbacksHaveUniqueLabels) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    wss::event::EventNotifier notifier(ws);
+
+    // fallbacks of the same type as their target
+    auto config = ndjsonConfig("notifier_primary");
+    config["fallback"] = {ndjsonConfig("notifier_fallback_0"), ndjsonConfig("notifier_fallback_1")};
+    notifier.addTarget(config);
+
+    const std::string out = wss::metrics::Registry::get().expose();
+    ASSERT_NE(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson#0\"} 0\n"));
+    ASSERT_NE(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson#0.fallback#0\"} 0\n"));
+    ASSERT_NE(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson#0.fallback#1\"} 0\n"));
+    ASSERT_EQ(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson\"}"));
+}
+
+TEST(EventNotifier, SecondTargetOfSameTypeIsRejected) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    wss::event::EventNotifier notifier(ws);
+
+    notifier.addTarget(ndjsonConfig("notifier_first"));
+    ASSERT_THROW(notifier.addTarget(ndjsonConfig("notifier_second")), std::runtime_error);
+
+    // rejected target has no guard
+    const std::string out = wss::metrics::Registry::get().expose();
+    ASSERT_NE(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson#0\"} 0\n"));
+    ASSERT_EQ(std::string::npos, out.find("wss_event_target_in_flight{target=\"ndjson#1\"}"));
+}
+
+TEST(EventNotifier, AsyncTargetHoldsPermitUntilCompletion) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    wss::event::EventNotifier notifier(ws);
+    nlohmann::json config;
+    config["type"] = "manual";
+    config["concurrency"] = {{"initialLimit", 2}, {"minLimit", 2}, {"maxLimit", 2}};
+    auto target = std::make_shared<ManualAsyncTarget>(config);
+    notifier.addTarget(target);
+    notifier.setDeliveryWorkers(1);
+    notifier.runService();
+
+    for (int i = 0; i < 3; i++) {
+        notifier.publish(wss::MessagePayload(1, 2, "event " + std::to_string(i)));
+    }
+
+    // single worker is not held by sends in flight, third event waits for target permit
+    ASSERT_TRUE(target->waitReceived(2));
+    std::this_thread::sleep_for(milliseconds(100));
+    ASSERT_EQ(2u, target->getReceived());
+
+    // completion passes permit to deferred event
+    target->completeFirst();
+    ASSERT_TRUE(target->waitReceived(3));
+    target->completeFirst();
+    target->completeFirst();
+
+    notifier.stopService();
+    notifier.joinThreads();
+}
+
+TEST(EventNotifier, FallbackFilterIsCheckedWhenEventMovesToIt) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    wss::event::EventNotifier notifier(ws);
+    notifier.setMaxTries(0);
+
+    auto primary = std::make_shared<ManualAsyncTarget>(nlohmann::json{{"type", "manual"}});
+    auto orders = std::make_shared<ManualAsyncTarget>(nlohmann::json{{"type", "manual"}, {"filter", "type == order"}});
+    auto any = std::make_shared<ManualAsyncTarget>(nlohmann::json{{"type", "manual"}});
+    primary->addFallback(orders);
+    primary->addFallback(any);
+    notifier.addTarget(primary);
+    notifier.runService();
+
+    notifier.publish(wss::MessagePayload(1, 2, std::string("text event")));
+    ASSERT_TRUE(primary->waitReceived(1));
+    primary->completeFirst(false);
+
+    // fallback for orders does not accept text message
+    ASSERT_TRUE(any->waitReceived(1));
+    ASSERT_EQ(0u, orders->getReceived());
+    any->completeFirst();
+
+    notifier.stopService();
+    notifier.joinThreads();
+}
@@ -0,0 +1,172 @@
+/*!
+ * wsserver
+ * TestNdjsonFileTarget.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../../src/event/NdjsonFileTarget.h"
+
+#include "gtest/gtest.h"
+
+using wss::event::Event;
+using wss::event::EventPtr;
+using wss::event::NdjsonFileTarget;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+static std::string filePath(const char *name) {
+    return ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".ndjson";
+}
+
+static EventPtr makeEvent(const std::string &text) {
+    return std::make_shared<const Event>(wss::MessagePayload(1, 2, text));
+}
+
+/// \return file lines, empty if file is missing
+static std::vector<std::string> readLines(const std::string &path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static void removeFiles(const std::string &path, int rotated) {
+    ::unlink(path.c_str());
+    for (int i = 1; i <= rotated; i++) {
+        ::unlink((path + "." + std::to_string(i)).c_str());
+    }
+}
+
+static nlohmann::json targetConfig(const std::string &path) {
+    nlohmann::json config;
+    config["type"] = "ndjson";
+    config["path"] = path;
+    return config;
+}
+
+TEST(NdjsonFileTarget, RotatesToNumberedFiles) {
+    const std::string path = filePath("ndjson_rotate");
+    removeFiles(path, 3);
+    std::vector<EventPtr> events;
+    std::vector<std::string> bodies;
+    for (int i = 0; i < 5; i++) {
+        events.push_back(makeEvent("event " + std::to_string(i)));
+        bodies.push_back(*events.back()->getBody());
+    }
+
+    {
+        auto config = targetConfig(path);
+        // each line is larger than half of limit: every next group goes to new file
+        config["maxFileSizeBytes"] = bodies[0].size() + bodies[0].size() / 2;
+        config["maxFiles"] = 2;
+        config["fsyncIntervalMs"] = 0;
+        NdjsonFileTarget target(config);
+        ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+        std::string error;
+        for (const auto &event: events) {
+            ASSERT_TRUE(target.send(event, error)) << error;
+        }
+    }
+
+    // path is newest, path.1 and path.2 are previous ones, older are removed
+    ASSERT_EQ(std::vector<std::string>({bodies[4]}), readLines(path));
+    ASSERT_EQ(std::vector<std::string>({bodies[3]}), readLines(path + ".1"));
+    ASSERT_EQ(std::vector<std::string>({bodies[2]}), readLines(path + ".2"));
+    ASSERT_NE(0, ::access((path + ".3").c_str(), F_OK));
+    removeFiles(path, 3);
+}
+
+TEST(NdjsonFileTarget, DurableSendersShareGroupCommit) {
+    const std::string path = filePath("ndjson_durable");
+    removeFiles(path, 0);
+    auto config = targetConfig(path);
+    config["durable"] = true;
+    config["fsyncIntervalMs"] = 300;
+    NdjsonFileTarget target(config);
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    const int senders = 16;
+    std::vector<char> sent(senders, 0);
+    std::vector<char> visible(senders, 0);
+    std::set<std::string> bodies;
+    std::vector<EventPtr> events;
+    for (int i = 0; i < senders; i++) {
+        events.push_back(makeEvent("event " + std::to_string(i)));
+        bodies.insert(*events.back()->getBody());
+    }
+
+    const auto start = steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; i++) {
+        threads.emplace_back([&, i] {
+          std::string error;
+          sent[i] = (char) target.send(events[i], error);
+          // durable send returns after line is written and synced
+          const auto lines = readLines(path);
+          visible[i] = (char) (std::find(lines.begin(), lines.end(), *events[i]->getBody()) != lines.end());
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+    const auto took = steady_clock::now() - start;
+
+    ASSERT_EQ(std::vector<char>(senders, 1), sent);
+    ASSERT_EQ(std::vector<char>(senders, 1), visible);
+    // group per sender would take senders * window
+    ASSERT_LT(took, milliseconds(300 * senders / 2));
+    const auto lines = readLines(path);
+    ASSERT_EQ(bodies, std::set<std::string>(lines.begin(), lines.end()));
+    removeFiles(path, 0);
+}
+
+TEST(NdjsonFileTarget, NonDurableSendReturnsBeforeWrite) {
+    const std::string path = filePath("ndjson_buffered");
+    removeFiles(path, 0);
+    auto config = targetConfig(path);
+    config["durable"] = false;
+    config["fsyncIntervalMs"] = 500;
+
+    std::vector<EventPtr> events;
+    for (int i = 0; i < 10; i++) {
+        events.push_back(makeEvent("event " + std::to_string(i)));
+    }
+
+    {
+        NdjsonFileTarget target(config);
+        ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+        std::string error;
+        const auto start = steady_clock::now();
+        for (const auto &event: events) {
+            ASSERT_TRUE(target.send(event, error)) << error;
+        }
+        ASSERT_LT(steady_clock::now() - start, milliseconds(250));
+        // still collecting group
+        ASSERT_TRUE(readLines(path).empty());
+    }
+
+    // buffered events are written on stop
+    const auto lines = readLines(path);
+    ASSERT_EQ(10u, lines.size());
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(*events[i]->getBody(), lines[i]);
+    }
+    removeFiles(path, 0);
+}
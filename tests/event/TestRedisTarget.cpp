@@ -0,0 +1,238 @@
+/*!
+ * wsserver
+ * TestRedisTarget.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/event/RedisTarget.h"
+#include "../../src/benchmark/RedisStandIn.h"
+
+#include "gtest/gtest.h"
+
+using wss::event::Event;
+using wss::event::EventPtr;
+using wss::event::RedisTarget;
+using wss::benchmark::RedisStandIn;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+static EventPtr makeEvent(const std::string &text) {
+    return std::make_shared<const Event>(wss::MessagePayload(1, 2, text));
+}
+
+static nlohmann::json targetConfig(uint16_t port, const std::string &mode) {
+    nlohmann::json config;
+    config["type"] = "redis";
+    config["address"] = "127.0.0.1";
+    config["port"] = port;
+    config["reconnectIntervalMs"] = 50;
+    config["mode"] = {{"type", mode}, {"name", "wsstest_events"}};
+    return config;
+}
+
+static std::vector<RedisStandIn::Command> commandsNamed(const RedisStandIn &redis, const std::string &name) {
+    std::vector<RedisStandIn::Command> out;
+    for (auto &command: redis.getCommands()) {
+        if (toolboxpp::strings::equalsIgnoreCase(command[0], name)) {
+            out.push_back(command);
+        }
+    }
+    return out;
+}
+
+TEST(RedisTarget, ConcurrentSendsShareRpush) {
+    RedisStandIn redis(0, true);
+    redis.start();
+    auto config = targetConfig(redis.port(), "queue");
+    config["batchSize"] = 16;
+    config["batchWindowMicroseconds"] = 200000;
+    RedisTarget target(config);
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    const int senders = 64;
+    std::vector<EventPtr> events;
+    std::set<std::string> bodies;
+    for (int i = 0; i < senders; i++) {
+        events.push_back(makeEvent("event " + std::to_string(i)));
+        bodies.insert(*target.getBody(events.back()));
+    }
+
+    std::vector<char> sent(senders, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; i++) {
+        threads.emplace_back([&target, &events, &sent, i] {
+          std::string error;
+          sent[i] = (char) target.send(events[i], error);
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+    ASSERT_EQ(std::vector<char>(senders, 1), sent);
+
+    // events are grouped: one RPUSH with many values, not more than batch size each
+    const auto rpush = commandsNamed(redis, "RPUSH");
+    ASSERT_LT(rpush.size(), (size_t) senders);
+    std::set<std::string> pushed;
+    for (const auto &command: rpush) {
+        ASSERT_EQ("wsstest_events", command[1]);
+        ASSERT_GE(command.size(), 3u);
+        ASSERT_LE(command.size() - 2, 16u);
+        pushed.insert(command.begin() + 2, command.end());
+    }
+    ASSERT_EQ(bodies, pushed);
+}
+
+TEST(RedisTarget, AsyncSendsAreResolvedByReply) {
+    RedisStandIn redis(0, true);
+    redis.start();
+    auto config = targetConfig(redis.port(), "queue");
+    config["batchSize"] = 16;
+    config["batchWindowMicroseconds"] = 200000;
+    RedisTarget target(config);
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+    ASSERT_TRUE(target.isAsync());
+
+    // single caller thread is not held by window and reply: all events fit into batches
+    const int events = 64;
+    std::mutex lock;
+    std::condition_variable cond;
+    int resolved = 0, succeeded = 0;
+    const auto start = steady_clock::now();
+    for (int i = 0; i < events; i++) {
+        target.sendAsync(makeEvent("event " + std::to_string(i)), [&](bool success, std::string &&) {
+          std::lock_guard<std::mutex> guard(lock);
+          resolved++;
+          succeeded += success ? 1 : 0;
+          cond.notify_one();
+        });
+    }
+    ASSERT_LT(steady_clock::now() - start, milliseconds(100));
+
+    std::unique_lock<std::mutex> wait(lock);
+    ASSERT_TRUE(cond.wait_for(wait, milliseconds(5000), [&] { return resolved == events; }));
+    ASSERT_EQ(events, succeeded);
+    ASSERT_EQ((size_t) events / 16, commandsNamed(redis, "RPUSH").size());
+}
+
+TEST(RedisTarget, ChannelPublishesEachEvent) {
+    RedisStandIn redis(0, true);
+    redis.start();
+    RedisTarget target(targetConfig(redis.port(), "channel"));
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    std::string error;
+    std::vector<std::string> bodies;
+    for (int i = 0; i < 3; i++) {
+        const auto event = makeEvent("event " + std::to_string(i));
+        bodies.push_back(*target.getBody(event));
+        ASSERT_TRUE(target.send(event, error)) << error;
+    }
+
+    const auto publish = commandsNamed(redis, "PUBLISH");
+    ASSERT_EQ(3u, publish.size());
+    for (size_t i = 0; i < publish.size(); i++) {
+        ASSERT_EQ(RedisStandIn::Command({publish[i][0], "wsstest_events", bodies[i]}), publish[i]);
+    }
+}
+
+TEST(RedisTarget, WindowStartsAtFirstEvent) {
+    RedisStandIn redis(0, true);
+    redis.start();
+    auto config = targetConfig(redis.port(), "queue");
+    config["batchWindowMicroseconds"] = 300000;
+    RedisTarget target(config);
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    // flusher is idle between events: each of them waits whole window, wherever it comes
+    std::string error;
+    for (int i = 0; i < 3; i++) {
+        std::this_thread::sleep_for(milliseconds(70 * i));
+        const auto start = steady_clock::now();
+        ASSERT_TRUE(target.send(makeEvent("event"), error)) << error;
+        const auto took = steady_clock::now() - start;
+        ASSERT_GE(took, milliseconds(290));
+        ASSERT_LT(took, milliseconds(5000));
+    }
+    ASSERT_EQ(3u, commandsNamed(redis, "RPUSH").size());
+}
+
+TEST(RedisTarget, ReplaysBufferedEventsAfterReconnect) {
+    auto redis = std::make_unique<RedisStandIn>(0, true);
+    redis->start();
+    const uint16_t port = redis->port();
+    RedisTarget target(targetConfig(port, "queue"));
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    std::string error;
+    ASSERT_TRUE(target.send(makeEvent("before"), error)) << error;
+
+    // redis is down: events are kept in order they came
+    redis.reset();
+    std::this_thread::sleep_for(milliseconds(200));
+    const int senders = 5;
+    std::vector<std::string> bodies;
+    std::vector<char> sent(senders, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; i++) {
+        const auto event = makeEvent("buffered " + std::to_string(i));
+        bodies.push_back(*target.getBody(event));
+        threads.emplace_back([&target, &sent, event, i] {
+          std::string sendError;
+          sent[i] = (char) target.send(event, sendError);
+        });
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+
+    RedisStandIn restarted(port, true);
+    restarted.start();
+    for (auto &t: threads) {
+        t.join();
+    }
+    ASSERT_EQ(std::vector<char>(senders, 1), sent);
+
+    std::vector<std::string> pushed;
+    for (const auto &command: commandsNamed(restarted, "RPUSH")) {
+        pushed.insert(pushed.end(), command.begin() + 2, command.end());
+    }
+    ASSERT_EQ(bodies, pushed);
+}
+
+TEST(RedisTarget, TimedOutEventIsNotSentAfterReconnect) {
+    auto redis = std::make_unique<RedisStandIn>(0, true);
+    redis->start();
+    const uint16_t port = redis->port();
+    auto config = targetConfig(port, "queue");
+    config["commandTimeoutSeconds"] = 1;
+    RedisTarget target(config);
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    redis.reset();
+    std::this_thread::sleep_for(milliseconds(200));
+    const auto lost = makeEvent("lost");
+    std::string error;
+    ASSERT_FALSE(target.send(lost, error));
+    ASSERT_EQ("Redis reply timed out", error);
+
+    // caller retries timed out event by itself, target must not send it too
+    RedisStandIn restarted(port, true);
+    restarted.start();
+    const auto kept = makeEvent("kept");
+    error.clear();
+    ASSERT_TRUE(target.send(kept, error)) << error;
+
+    const auto rpush = commandsNamed(restarted, "RPUSH");
+    ASSERT_EQ(1u, rpush.size());
+    ASSERT_EQ(RedisStandIn::Command({rpush[0][0], "wsstest_events", *target.getBody(kept)}), rpush[0]);
+}
@@ -0,0 +1,106 @@
+/*!
+ * wsserver
+ * TestRetryScheduler.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "../../src/event/RetryScheduler.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std::chrono;
+
+TEST(RetrySchedulerTest, BackoffGrowsExponentially) {
+    wss::event::BackoffPolicy policy;
+    policy.initialDelay = seconds(1);
+    policy.maxDelay = seconds(60);
+    policy.jitter = 0.0;
+
+    ASSERT_EQ(milliseconds(1000), policy.delayFor(1, 0.5));
+    ASSERT_EQ(milliseconds(2000), policy.delayFor(2, 0.5));
+    ASSERT_EQ(milliseconds(4000), policy.delayFor(3, 0.5));
+    ASSERT_EQ(milliseconds(32000), policy.delayFor(6, 0.5));
+}
+
+TEST(RetrySchedulerTest, BackoffIsCapped) {
+    wss::event::BackoffPolicy policy;
+    policy.initialDelay = seconds(1);
+    policy.maxDelay = seconds(60);
+    policy.jitter = 0.0;
+
+    ASSERT_EQ(milliseconds(60000), policy.delayFor(7, 0.0));
+    ASSERT_EQ(milliseconds(60000), policy.delayFor(10000, 0.0));
+}
+
+TEST(RetrySchedulerTest, JitterReducesDelay) {
+    wss::event::BackoffPolicy policy;
+    policy.initialDelay = seconds(10);
+    policy.maxDelay = seconds(60);
+    policy.jitter = 0.5;
+
+    ASSERT_EQ(milliseconds(10000), policy.delayFor(1, 0.0));
+    ASSERT_EQ(milliseconds(7500), policy.delayFor(1, 0.5));
+    ASSERT_GE(policy.delayFor(1, 0.999), milliseconds(5000));
+}
+
+TEST(RetrySchedulerTest, EveryTargetGetsSameRetries) {
+    wss::event::BackoffPolicy policy;
+    policy.initialDelay = seconds(1);
+    policy.jitter = 0.0;
+
+    // primary target and fallback after it both start from first send
+    for (int target = 0; target < 2; target++) {
+        int tries = wss::event::FIRST_SEND_TRY;
+        std::vector<milliseconds> delays;
+        int attempt;
+        while ((attempt = wss::event::BackoffPolicy::nextAttempt(tries, 3)) > 0) {
+            delays.push_back(policy.delayFor(attempt, 0.0));
+        }
+        ASSERT_EQ(std::vector<milliseconds>({milliseconds(1000), milliseconds(2000)}), delays);
+        ASSERT_EQ(3, tries);
+    }
+}
+
+TEST(RetrySchedulerTest, ReleasesItemsInDueOrder) {
+    wss::event::RetryScheduler<int> scheduler;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<int> released;
+
+    scheduler.setOnReady([&](int &&item) {
+      std::lock_guard<std::mutex> guard(lock);
+      released.push_back(item);
+      cond.notify_one();
+    });
+    scheduler.start();
+
+    const auto now = wss::event::RetryScheduler<int>::clock::now();
+    scheduler.scheduleAt(3, now + milliseconds(60));
+    scheduler.scheduleAt(1, now + milliseconds(20));
+    scheduler.scheduleAt(2, now + milliseconds(40));
+
+    std::unique_lock<std::mutex> guard(lock);
+    ASSERT_TRUE(cond.wait_for(guard, seconds(5), [&] { return released.size() == 3; }));
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), released);
+    ASSERT_EQ(0u, scheduler.size());
+}
+
+TEST(RetrySchedulerTest, KeepsPendingItemsUntilDue) {
+    wss::event::BackoffPolicy policy;
+    policy.initialDelay = seconds(30);
+    policy.jitter = 0.0;
+    wss::event::RetryScheduler<int> scheduler(policy);
+    scheduler.setOnReady([](int &&) { });
+    scheduler.start();
+
+    ASSERT_EQ(milliseconds(30000), scheduler.schedule(1, 1));
+    ASSERT_EQ(milliseconds(60000), scheduler.schedule(2, 2));
+    ASSERT_EQ(2u, scheduler.size());
+}
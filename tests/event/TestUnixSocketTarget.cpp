@@ -0,0 +1,153 @@
+/*!
+ * wsserver
+ * TestUnixSocketTarget.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <boost/asio.hpp>
+#include "../../src/event/UnixSocketTarget.h"
+
+#include "gtest/gtest.h"
+
+using wss::event::Event;
+using wss::event::EventPtr;
+using wss::event::UnixSocketTarget;
+using boost::asio::local::stream_protocol;
+
+static std::string socketPath(const char *name) {
+    return ::testing::TempDir() + "/" + name + "_" + std::to_string(getpid()) + ".sock";
+}
+
+static EventPtr makeEvent(const std::string &text) {
+    return std::make_shared<const Event>(wss::MessagePayload(1, 2, text));
+}
+
+/// \brief Sidecar side: listens socket, reads frames blocking
+struct Sidecar {
+  boost::asio::io_service ioService;
+  stream_protocol::acceptor acceptor{ioService};
+  stream_protocol::socket socket{ioService};
+
+  explicit Sidecar(const std::string &path) {
+      ::unlink(path.c_str());
+      const stream_protocol::endpoint endpoint(path);
+      acceptor.open(endpoint.protocol());
+      acceptor.bind(endpoint);
+      acceptor.listen();
+  }
+
+  void accept() {
+      acceptor.accept(socket);
+  }
+
+  /// \brief Reads one frame
+  /// \param header receives 4 bytes of length
+  /// \return payload
+  std::string read(std::string *header = nullptr) {
+      unsigned char size[4];
+      boost::asio::read(socket, boost::asio::buffer(size));
+      if (header) {
+          header->assign(reinterpret_cast<char *>(size), 4);
+      }
+      const uint32_t length = (uint32_t(size[0]) << 24) | (uint32_t(size[1]) << 16)
+          | (uint32_t(size[2]) << 8) | uint32_t(size[3]);
+      std::string body(length, '\0');
+      boost::asio::read(socket, boost::asio::buffer(&body[0], length));
+      return body;
+  }
+};
+
+static nlohmann::json targetConfig(const std::string &path) {
+    nlohmann::json config;
+    config["type"] = "unixsocket";
+    config["path"] = path;
+    config["reconnectIntervalMs"] = 50;
+    return config;
+}
+
+TEST(UnixSocketTarget, Length32beFraming) {
+    const std::string path = socketPath("unix_target_framing");
+    Sidecar sidecar(path);
+    UnixSocketTarget target(targetConfig(path));
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+    sidecar.accept();
+
+    const std::vector<EventPtr> events = {
+        makeEvent("a"),
+        makeEvent(std::string(300, 'b')),
+        makeEvent(std::string(100 * 1024, 'c')),
+    };
+    std::string error;
+    for (const auto &event: events) {
+        ASSERT_TRUE(target.send(event, error)) << error;
+    }
+
+    for (const auto &event: events) {
+        std::string header;
+        const auto &body = *event->getBody();
+        ASSERT_EQ(body, sidecar.read(&header));
+        const std::string expected{(char) (body.size() >> 24), (char) (body.size() >> 16),
+                                   (char) (body.size() >> 8), (char) body.size()};
+        ASSERT_EQ(expected, header);
+        // framed body is shared by all targets with the same framing
+        ASSERT_EQ(header + body, *target.getBody(event));
+    }
+}
+
+TEST(UnixSocketTarget, ResendsInOrderAfterSidecarRestart) {
+    const std::string path = socketPath("unix_target_restart");
+    auto sidecar = std::make_unique<Sidecar>(path);
+    UnixSocketTarget target(targetConfig(path));
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+    sidecar->accept();
+
+    std::string error;
+    const auto first = makeEvent("first");
+    ASSERT_TRUE(target.send(first, error)) << error;
+    ASSERT_EQ(*first->getBody(), sidecar->read());
+
+    // sidecar is down: events are buffered and acknowledged
+    sidecar.reset();
+    ::unlink(path.c_str());
+    std::vector<std::string> bodies;
+    for (int i = 0; i < 50; i++) {
+        const auto event = makeEvent("event " + std::to_string(i));
+        bodies.push_back(*event->getBody());
+        ASSERT_TRUE(target.send(event, error)) << error;
+    }
+
+    Sidecar restarted(path);
+    restarted.accept();
+    for (const auto &body: bodies) {
+        ASSERT_EQ(body, restarted.read());
+    }
+}
+
+TEST(UnixSocketTarget, StopsWithoutSidecar) {
+    const std::string path = socketPath("unix_target_missing");
+    ::unlink(path.c_str());
+    auto config = targetConfig(path);
+    config["maxBuffered"] = 2;
+    config["reconnectIntervalMs"] = 10000;
+    UnixSocketTarget target(config);
+    // sidecar may start later
+    ASSERT_TRUE(target.isValid()) << target.getErrorMessage();
+
+    std::string error;
+    ASSERT_TRUE(target.send(makeEvent("1"), error));
+    // writer failed to connect and waits for next attempt, event is buffered again
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(target.send(makeEvent("2"), error));
+    ASSERT_FALSE(target.send(makeEvent("3"), error));
+    ASSERT_FALSE(error.empty());
+    // destroyed without waiting for reconnect interval, buffered events are dropped
+}
@@ -0,0 +1,147 @@
+/*!
+ * wsserver
+ * TestChatRestServer.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include "../../src/chat/ChatServer.h"
+#include "../../src/chat/Message.h"
+#include "../../src/restapi/ChatRestServer.h"
+
+#include "gtest/gtest.h"
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+/// \brief Takes free port and releases it
+static uint16_t freePort() {
+    asio::io_service ioService;
+    tcp::acceptor probe(ioService, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return probe.local_endpoint().port();
+}
+
+static bool connect(tcp::socket &socket, uint16_t port) {
+    const tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    for (int i = 0; i < 500; i++) {
+        boost::system::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec) {
+            return true;
+        }
+        socket.close(ec);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static std::string sendMessageRequest(const std::string &text) {
+    const std::string body = wss::MessagePayload(1, 2, text).toJson();
+    return "POST /send-message HTTP/1.1\r\n"
+           "Host: 127.0.0.1\r\n"
+           "Content-Type: application/json\r\n"
+           "Content-Length: " + std::to_string(body.length()) + "\r\n"
+           "\r\n" + body;
+}
+
+/// \brief Reads single response: header block and body by Content-Length
+/// \param content receives body if not null
+/// \return status line
+static std::string readResponse(tcp::socket &socket, asio::streambuf &buffer, std::string *content = nullptr) {
+    const size_t headerSize = asio::read_until(socket, buffer, "\r\n\r\n");
+    std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerSize);
+    buffer.consume(headerSize);
+
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+    size_t length = 0;
+    const size_t pos = headers.find("content-length:");
+    if (pos != std::string::npos) {
+        length = std::stoul(headers.substr(pos + 15));
+    }
+    if (buffer.size() < length) {
+        asio::read(socket, buffer, asio::transfer_exactly(length - buffer.size()));
+    }
+    if (content) {
+        content->assign(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + length);
+    }
+    buffer.consume(length);
+    return headers.substr(0, headers.find("\r\n"));
+}
+
+TEST(ChatRestServer, PipelinedResponsesWithoutBody) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    const uint16_t port = freePort();
+    wss::ChatRestServer server(ws, "127.0.0.1", port);
+    server.setAuth({{"type", "noauth"}});
+    server.setKeepAlive(true, 5);
+    server.runService();
+
+    asio::io_service ioService;
+    tcp::socket socket(ioService);
+    ASSERT_TRUE(connect(socket, port));
+
+    // 202 of send-message and HEAD /status have no body: each response must still end its header block
+    const std::string requests = sendMessageRequest("first")
+        + sendMessageRequest("second")
+        + "HEAD /status HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    asio::write(socket, asio::buffer(requests));
+
+    asio::streambuf buffer;
+    ASSERT_EQ("http/1.1 202 accepted", readResponse(socket, buffer));
+    ASSERT_EQ("http/1.1 202 accepted", readResponse(socket, buffer));
+    ASSERT_EQ("http/1.1 200 ok", readResponse(socket, buffer));
+
+    // connection is still usable
+    asio::write(socket, asio::buffer(sendMessageRequest("third")));
+    ASSERT_EQ("http/1.1 202 accepted", readResponse(socket, buffer));
+
+    server.stopService();
+    server.joinThreads();
+}
+
+TEST(ChatRestServer, PipelinedRequestAfterChunkedBody) {
+    auto ws = std::make_shared<wss::ChatServer>("127.0.0.1", 0, "^/chat$");
+    const uint16_t port = freePort();
+    wss::ChatRestServer server(ws, "127.0.0.1", port);
+    server.setAuth({{"type", "noauth"}});
+    server.setKeepAlive(true, 5);
+    server.runService();
+
+    asio::io_service ioService;
+    tcp::socket socket(ioService);
+    ASSERT_TRUE(connect(socket, port));
+
+    // body split into two chunks, next request follows last chunk in the same write
+    const std::string body = "[" + wss::MessagePayload(1, 2, "chunked").toJson() + "]";
+    const std::size_t half = body.size() / 2;
+    std::stringstream chunked;
+    chunked << "POST /send-messages HTTP/1.1\r\n"
+            << "Host: 127.0.0.1\r\n"
+            << "Content-Type: application/json\r\n"
+            << "Transfer-Encoding: chunked\r\n"
+            << "\r\n"
+            << std::hex << half << "\r\n" << body.substr(0, half) << "\r\n"
+            << std::hex << body.size() - half << "\r\n" << body.substr(half) << "\r\n"
+            << "0\r\n\r\n";
+    asio::write(socket, asio::buffer(chunked.str() + sendMessageRequest("after chunked")));
+
+    asio::streambuf buffer;
+    std::string content;
+    ASSERT_EQ("http/1.1 200 ok", readResponse(socket, buffer, &content));
+    const auto result = nlohmann::json::parse(content);
+    ASSERT_EQ(1u, result.at("accepted").get<std::size_t>());
+    ASSERT_EQ(0u, result.at("rejected").get<std::size_t>());
+    ASSERT_EQ("http/1.1 202 accepted", readResponse(socket, buffer));
+
+    server.stopService();
+    server.joinThreads();
+}
@@ -0,0 +1,128 @@
+/*!
+ * wsserver
+ * TestMessageBatch.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../src/restapi/MessageBatch.h"
+
+#include "gtest/gtest.h"
+
+using wss::MessageBatch;
+using wss::MessagePayload;
+
+static std::string message(wss::user_id_t recipient, const std::string &text) {
+    return nlohmann::json{
+        {"type", "text"}, {"sender", 1}, {"recipients", {recipient}}, {"text", text}
+    }.dump();
+}
+
+/// \brief Collects windows passed to sink
+struct Sink {
+  std::vector<std::vector<std::string>> windows;
+
+  MessageBatch::Sink get() {
+      return [this](const std::vector<MessagePayload> &window) {
+        std::vector<std::string> texts;
+        for (const auto &payload: window) {
+            texts.push_back(payload.getText());
+        }
+        windows.push_back(texts);
+      };
+  }
+};
+
+static std::vector<std::string> slices(const std::string &body) {
+    std::vector<MessageBatch::Slice> items;
+    std::string error;
+    EXPECT_TRUE(MessageBatch::splitArray(body, items, error)) << error;
+    std::vector<std::string> out;
+    for (const auto &item: items) {
+        out.push_back(body.substr(item.first, item.second));
+    }
+    return out;
+}
+
+TEST(MessageBatch, SplitsTopLevelElements) {
+    ASSERT_TRUE(slices("[]").empty());
+    ASSERT_TRUE(slices(" \r\n[ \t] \n").empty());
+    ASSERT_EQ(std::vector<std::string>({"1"}), slices("[1]"));
+    ASSERT_EQ(std::vector<std::string>({"{\"a\":[1,2]}", "[3,[4]]", "null"}),
+              slices("[ {\"a\":[1,2]} ,\n[3,[4]],null ]"));
+    // separators and brackets inside strings, escaped quotes and backslashes
+    ASSERT_EQ(std::vector<std::string>({"\"a,b]\"", "{\"t\":\"x\\\"],}\"}", "\"\\\\\"", "{\"t\":\"{[\"}"}),
+              slices("[\"a,b]\",{\"t\":\"x\\\"],}\"},\"\\\\\",{\"t\":\"{[\"}]"));
+}
+
+TEST(MessageBatch, RejectsBodyThatIsNotArray) {
+    const std::vector<std::string> bodies = {
+        "", "  ", "{}", "1", "[1,]", "[,1]", "[1,,2]", "[1", "[\"a]", "[1] x", "[1}]", "[\"a\\\"]",
+    };
+    for (const auto &body: bodies) {
+        std::vector<MessageBatch::Slice> items;
+        std::string error;
+        ASSERT_FALSE(MessageBatch::splitArray(body, items, error)) << body;
+        ASSERT_FALSE(error.empty()) << body;
+    }
+
+    // nothing routed
+    Sink sink;
+    MessageBatch batch(10, sink.get());
+    std::string error;
+    ASSERT_FALSE(batch.addJsonArray("[" + message(2, "a") + ",", error));
+    batch.flush();
+    ASSERT_TRUE(sink.windows.empty());
+    ASSERT_EQ(0u, batch.getAccepted() + batch.getRejected());
+}
+
+TEST(MessageBatch, ResultsKeepIndexesOfMixedItems) {
+    const std::vector<std::string> items = {
+        message(2, "first"),
+        "\"not an object\"",
+        message(0, "to bot"),
+        "{\"type\":\"text\",\"recipients\":[2],\"text\":\"no sender\"}",
+        message(3, "second"),
+        "[1,2]",
+        message(2, "third"),
+    };
+    const std::vector<bool> valid = {true, false, false, false, true, false, true};
+
+    std::string array = "[";
+    std::string ndjson;
+    for (std::size_t i = 0; i < items.size(); i++) {
+        array += (i ? ",\n  " : "") + items[i];
+        ndjson += items[i] + (i % 2 ? "\r\n" : "\n\n");
+    }
+    array += "]";
+
+    for (int mode = 0; mode < 2; mode++) {
+        Sink sink;
+        MessageBatch batch(2, sink.get());
+        if (mode == 0) {
+            std::string error;
+            ASSERT_TRUE(batch.addJsonArray(array, error)) << error;
+        } else {
+            std::istringstream in(ndjson);
+            batch.addNdjson(in);
+        }
+        batch.flush();
+
+        ASSERT_EQ(3u, batch.getAccepted());
+        ASSERT_EQ(4u, batch.getRejected());
+        const auto results = nlohmann::json::parse("[" + batch.getResults() + "]");
+        ASSERT_EQ(items.size(), results.size());
+        for (std::size_t i = 0; i < items.size(); i++) {
+            ASSERT_EQ(i, results[i].at("index").get<std::size_t>());
+            ASSERT_EQ(valid[i], results[i].at("success").get<bool>()) << i;
+            ASSERT_EQ(!valid[i], results[i].find("message") != results[i].end()) << i;
+        }
+        // valid ones only, in body order, by windows of 2
+        ASSERT_EQ(std::vector<std::vector<std::string>>({{"first", "second"}, {"third"}}), sink.windows);
+    }
+}
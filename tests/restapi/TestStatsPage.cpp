@@ -0,0 +1,197 @@
+/*!
+ * wsserver
+ * TestStatsPage.cpp
+ *
+ * \date   2018
+ * \author Eduard Maximovich (edward.vstock@gmail.com)
+ * \link   https://github.com/edwardstock
+ */
+
+#include <algorithm>
+#include <ctime>
+#include <map>
+#include <random>
+#include <vector>
+#include "../../src/restapi/StatsPage.h"
+
+#include "gtest/gtest.h"
+
+using wss::StatsPage;
+using wss::user_id_t;
+
+/// \brief Known statistics set: online state and inactivity of each user
+struct User {
+  bool online;
+  time_t inactive;
+};
+
+/// \brief Filters of /stats request
+struct Query {
+  std::size_t limit;
+  int online; // -1 - any
+  time_t inactiveSeconds;
+};
+
+static std::map<user_id_t, User> makeUsers(std::size_t count) {
+    std::map<user_id_t, User> users;
+    std::mt19937 random(42);
+    while (users.size() < count) {
+        // sparse ids, as in real chat
+        users[random() % 100000] = User{random() % 3 == 0, time_t(random() % 600)};
+    }
+    return users;
+}
+
+/// \brief Offers users in order that differs from id order, as stats map does
+static StatsPage queryPage(const std::map<user_id_t, User> &users, const Query &query, bool hasCursor, user_id_t cursor) {
+    std::vector<std::pair<user_id_t, User>> shuffled(users.begin(), users.end());
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(cursor));
+
+    StatsPage page(query.limit);
+    if (hasCursor) {
+        page.setCursor(cursor);
+    }
+    if (query.online >= 0) {
+        page.setOnline(query.online == 1);
+    }
+    page.setInactiveSeconds(query.inactiveSeconds);
+    for (const auto &user: shuffled) {
+        page.add(user.first, user.second.online, user.second.inactive);
+    }
+    page.finish();
+    return page;
+}
+
+/// \brief Pages through all users with nextCursor
+/// \param pages receives number of pages
+/// \return ids of all pages, in order they came
+static std::vector<user_id_t> pageThrough(const std::map<user_id_t, User> &users, const Query &query,
+                                          std::size_t &pages) {
+    std::vector<user_id_t> out;
+    bool hasCursor = false;
+    user_id_t cursor = 0;
+    pages = 0;
+    while (true) {
+        auto page = queryPage(users, query, hasCursor, cursor);
+        pages++;
+        const auto &ids = page.getIds();
+        if (query.limit > 0) {
+            EXPECT_LE(ids.size(), query.limit);
+            // only last page may be incomplete
+            EXPECT_TRUE(!page.hasNext() || ids.size() == query.limit);
+        }
+        out.insert(out.end(), ids.begin(), ids.end());
+        if (!page.hasNext()) {
+            break;
+        }
+        // nextCursor
+        hasCursor = true;
+        cursor = ids.back();
+        if (pages > users.size() + 1) {
+            ADD_FAILURE() << "paging does not end";
+            break;
+        }
+    }
+    return out;
+}
+
+static std::vector<user_id_t> expectedIds(const std::map<user_id_t, User> &users, const Query &query) {
+    std::vector<user_id_t> ids;
+    for (const auto &user: users) {
+        if (query.online >= 0 && user.second.online != (query.online == 1)) continue;
+        if (query.inactiveSeconds > 0 && user.second.inactive < query.inactiveSeconds) continue;
+        ids.push_back(user.first);
+    }
+    return ids;
+}
+
+TEST(StatsPage, EveryIdAppearsOnceAcrossPages) {
+    const auto users = makeUsers(1000);
+    const std::vector<Query> queries = {
+        {0, -1, 0},
+        {1, -1, 0},
+        {7, -1, 0},
+        {100, -1, 0},
+        {1000, -1, 0},
+        {5000, -1, 0},
+        {13, 1, 0},
+        {13, 0, 0},
+        {50, -1, 300},
+        {50, 0, 300},
+        {3, 1, 599},
+        {10, -1, 600},
+    };
+
+    for (const auto &query: queries) {
+        const auto expected = expectedIds(users, query);
+        std::size_t pages = 0;
+        // ascending id order means each id is present once
+        ASSERT_EQ(expected, pageThrough(users, query, pages))
+                            << "limit " << query.limit << ", online " << query.online
+                            << ", inactiveSeconds " << query.inactiveSeconds;
+
+        const std::size_t expectedPages = query.limit == 0 || expected.empty()
+                                          ? 1
+                                          : (expected.size() + query.limit - 1) / query.limit;
+        ASSERT_EQ(expectedPages, pages) << "limit " << query.limit;
+    }
+}
+
+TEST(StatsPage, LastFullPageHasNoNextCursor) {
+    std::map<user_id_t, User> users;
+    for (user_id_t id = 1; id <= 20; id++) {
+        users[id] = User{true, 0};
+    }
+
+    auto first = queryPage(users, {10, -1, 0}, false, 0);
+    ASSERT_TRUE(first.hasNext());
+    ASSERT_EQ(10u, first.getIds().back());
+
+    auto second = queryPage(users, {10, -1, 0}, true, 10);
+    ASSERT_FALSE(second.hasNext());
+    ASSERT_EQ(10u, second.getIds().size());
+    ASSERT_EQ(11u, second.getIds().front());
+
+    auto empty = queryPage(users, {10, -1, 0}, true, 20);
+    ASSERT_FALSE(empty.hasNext());
+    ASSERT_TRUE(empty.getIds().empty());
+}
+
+TEST(StatsPage, CursorSkipsUsersAddedBeforeIt) {
+    std::map<user_id_t, User> users;
+    for (user_id_t id = 10; id <= 100; id += 10) {
+        users[id] = User{false, 0};
+    }
+    auto first = queryPage(users, {4, -1, 0}, false, 0);
+    ASSERT_EQ(std::vector<user_id_t>({10, 20, 30, 40}), first.getIds());
+
+    // connected between pages: smaller id is not returned again, greater one is
+    users[15] = User{true, 0};
+    users[45] = User{true, 0};
+    users.erase(50);
+    auto second = queryPage(users, {4, -1, 0}, true, first.getIds().back());
+    ASSERT_EQ(std::vector<user_id_t>({45, 60, 70, 80}), second.getIds());
+    ASSERT_TRUE(second.hasNext());
+}
+
+TEST(StatsPage, ReadsStatistics) {
+    wss::Statistics online(1), offline(2);
+    online.addConnection();
+    offline.addConnection();
+    offline.addDisconnection();
+
+    StatsPage page(0);
+    page.setOnline(true);
+    page.add(1, online);
+    page.add(2, offline);
+    page.finish();
+    ASSERT_EQ(std::vector<user_id_t>({1}), page.getIds());
+
+    // just connected users are not inactive
+    StatsPage inactive(0);
+    inactive.setInactiveSeconds(60);
+    inactive.add(1, online);
+    inactive.add(2, offline);
+    inactive.finish();
+    ASSERT_TRUE(inactive.getIds().empty());
+}